@@ -0,0 +1,88 @@
+// AI benchmark.
+// Races N AI cars on every given track and times ModuleGame::UpdateAi: the
+// perception schedule, the think phase and the serial act. The perception
+// scheduler runs deterministic, without the time budget, so the sensing work
+// of a run only depends on the race. Physics runs between the frames untimed.
+// --threads 1 thinks on the calling thread, more hands the think phase to a
+// JobSystem, 0 uses one thread per hardware thread like the game.
+//
+// Usage: AIBench track.tmx... [--cars 10,20,40,80] [--threads 1,0] [--frames 600] [--seed 1]
+//        [--runs 10] [--warmup 2] [--out report.json]
+
+#include "BenchRace.h"
+#include "BenchReport.h"
+
+#include <memory>
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseBenchOptions(argc, argv, options) || options.args.empty())
+	{
+		printf("Usage: %s track.tmx... [--cars 10,20,40,80] [--threads 1,0] [--frames 600] [--seed 1] [--runs 10] [--warmup 2] [--out report.json]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<int> car_counts = options.GetIntList("cars", "10,20,40,80");
+	std::vector<int> thread_counts = options.GetIntList("threads", "1,0");
+	int frames = std::max(1, options.GetInt("frames", 600));
+	uint64_t seed = (uint64_t)options.GetInt("seed", 1);
+
+	BenchReport report("AIBench", options);
+	for (const std::string& path : options.args)
+	{
+		BenchTrack track;
+		if (!LoadBenchTrack(path.c_str(), track))
+		{
+			fprintf(stderr, "Could not load %s\n", path.c_str());
+			return 1;
+		}
+
+		std::vector<int> measured_threads;	// 0 may be 1 on a single core machine
+		for (int threads : thread_counts)
+		{
+			std::unique_ptr<JobSystem> jobs;
+			if (threads != 1)
+			{
+				jobs.reset(new JobSystem());
+				jobs->Init(threads > 1 ? threads - 1 : 0);
+			}
+			int thread_count = jobs ? jobs->GetThreadCount() : 1;
+			if (std::find(measured_threads.begin(), measured_threads.end(), thread_count) != measured_threads.end()) continue;
+			measured_threads.push_back(thread_count);
+
+			for (int cars : car_counts)
+			{
+				BenchSamples samples = report.Sample([&](BenchSamples& run)
+				{
+					std::unique_ptr<BenchRace> race(new BenchRace(track, cars, seed));
+					double ai_ms = 0.0;
+					int sensed = 0;
+					for (int f = 0; f < frames; ++f)
+					{
+						BenchClock::time_point start = BenchClock::now();
+						race->UpdateAi(jobs.get());
+						ai_ms += BenchMs(start, BenchClock::now());
+						sensed += race->perception.sensed_cars;
+
+						race->StepPhysics();
+					}
+					double frame_us = ai_ms * 1000.0 / frames;
+					run.Add("ai_ms", "ms", ai_ms);
+					run.Add("frame_us", "us", frame_us);
+					run.Add("car_us", "us", frame_us / std::max(1, cars));
+					run.Add("sensed_per_frame", "count", (double)sensed / frames);
+				});
+
+				report.AddCase(track.name + "/" + std::to_string(cars) + " cars/" + std::to_string(thread_count) + " threads")
+					.Param("track", track.name)
+					.Param("cars", cars)
+					.Param("threads", thread_count)
+					.Param("frames", frames)
+					.Metrics(samples);
+			}
+		}
+	}
+
+	return report.Write() ? 0 : 1;
+}
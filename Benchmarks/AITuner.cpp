@@ -0,0 +1,467 @@
+// Headless AI parameter search.
+// Races AI cars on a track with no window and no App: every race owns its
+// b2World, VehicleSystem, VehicleGrid and cars, and the worker threads only
+// share the track, which is read only. A generation evaluates every candidate
+// AIParams set on the same seeds, keeps the best quarter and mutates it into
+// the next one.
+// Scores each set on:
+//  - average lap time of its cars, unfinished cars count their time so far
+//    over the laps they did
+//  - wall hits per lap, COLLISION_PENALTY seconds each, car to car hits half
+//
+// Usage: AITuner track.tmx [threads] [generations] [population] [cars] [laps] [seed]
+
+#include "../Source/AIVehicle.h"
+#include "../Source/RacingLine.h"
+#include "../Source/VehicleGrid.h"
+#include "../Source/VehicleSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#define PIXELS_PER_METER 50.0f	// same scale as ModulePhysics.h
+#define STEP_RATE 120.0f		// RACE_STEP_RATE
+#define STEPS_PER_THINK 2		// the AI thinks once per 60 Hz frame
+#define RACES_PER_SET 2			// seeds every set runs on, the same for the whole generation
+#define VALIDATION_RACES 8		// best against hand tuned at the end
+#define COLLISION_PENALTY 0.5f	// seconds per wall hit
+#define TIMEOUT_FACTOR 3.0f		// of the estimated lap time of the racing line
+#define STUCK_TIME 10.0f		// seconds on the same waypoint before a car retires
+#define CAR_WIDTH 57.0f			// pixels, the car textures
+#define CAR_HEIGHT 103.0f
+
+struct Track
+{
+	RacingLine line;
+	std::vector<Waypoint> waypoints;
+	std::vector<std::vector<b2Vec2>> walls;
+	int start_index = 0;	// racing line sample of the first waypoint
+};
+
+struct RaceResult
+{
+	float lap_time = 0.0f;	// average over the cars
+	float wall_hits = 0.0f;	// per lap
+	float car_hits = 0.0f;
+	int laps = 0;			// completed, all the cars together
+	int finished = 0;		// cars that completed every lap
+	int retired = 0;		// stuck cars
+};
+
+struct Candidate
+{
+	AIParams params;
+	RaceResult result;
+	float score = 0.0f;
+};
+
+// Searched parameters and their bounds
+struct ParamRange
+{
+	const char* name;
+	float AIParams::* field;
+	float min;
+	float max;
+};
+
+static const ParamRange param_ranges[] =
+{
+	{ "acceleration", &AIParams::acceleration, 4.0f, 9.0f },
+	{ "cruise_speed", &AIParams::cruise_speed, 7.0f, 12.0f },
+	{ "chase_speed", &AIParams::chase_speed, 8.0f, 14.0f },
+	{ "chase_line_factor", &AIParams::chase_line_factor, 1.0f, 1.3f },
+	{ "line_speed_factor", &AIParams::line_speed_factor, 0.8f, 1.3f },
+	{ "sensor_length", &AIParams::sensor_length, 1.5f, 5.0f },
+	{ "waypoint_reach", &AIParams::waypoint_reach, 4.0f, 12.0f },
+	{ "line_lookahead", &AIParams::line_lookahead, 0.0f, 3.0f },
+	{ "line_lookahead_time", &AIParams::line_lookahead_time, 0.0f, 0.5f },
+	{ "line_correction", &AIParams::line_correction, 0.5f, 4.0f },
+	{ "line_brake_time", &AIParams::line_brake_time, 0.1f, 0.8f },
+	{ "line_off_distance", &AIParams::line_off_distance, 0.5f, 3.0f },
+	{ "aggressive_chance", &AIParams::aggressive_chance, 0.0f, 0.6f },
+	{ "fearful_chance", &AIParams::fearful_chance, 0.0f, 0.4f },
+	{ "aggression", &AIParams::aggression, 0.0f, 1.0f },
+	{ "panic", &AIParams::panic, 0.0f, 1.0f },
+};
+
+static const int param_count = sizeof(param_ranges) / sizeof(param_ranges[0]);
+
+// Wall and car hits of one world. Bodies carry their car index + 1, the
+// walls 0. A chain reports one contact per edge, so a wall hit is a car
+// starting to touch any wall.
+class HitCounter : public b2ContactListener
+{
+public:
+	explicit HitCounter(int cars) : touching(cars, 0) {}
+
+	void BeginContact(b2Contact* contact) override
+	{
+		int a = (int)contact->GetFixtureA()->GetBody()->GetUserData().pointer;
+		int b = (int)contact->GetFixtureB()->GetBody()->GetUserData().pointer;
+		if (a > 0 && b > 0) car_hits++;
+		else if (touching[a + b - 1]++ == 0) wall_hits++;
+	}
+
+	void EndContact(b2Contact* contact) override
+	{
+		int a = (int)contact->GetFixtureA()->GetBody()->GetUserData().pointer;
+		int b = (int)contact->GetFixtureB()->GetBody()->GetUserData().pointer;
+		if (a == 0 || b == 0) touching[a + b - 1]--;
+	}
+
+	int wall_hits = 0;
+	int car_hits = 0;
+
+private:
+	std::vector<int> touching;	// wall contacts of every car
+};
+
+static bool LoadTrack(const char* tmx_path, Track& track)
+{
+	std::vector<RacingLineWaypoint> hints;
+	if (!RacingLine::ReadTrack(tmx_path, PIXELS_PER_METER, hints, track.walls)) return false;
+
+	// Chain loops can't have repeated vertices, the maps close some polygons on the first point
+	for (std::vector<b2Vec2>& wall : track.walls)
+	{
+		std::vector<b2Vec2> points;
+		for (const b2Vec2& p : wall)
+		{
+			if (points.empty() || b2DistanceSquared(p, points.back()) > b2_linearSlop * b2_linearSlop) points.push_back(p);
+		}
+		while (points.size() > 1 && b2DistanceSquared(points.front(), points.back()) <= b2_linearSlop * b2_linearSlop) points.pop_back();
+		wall = points;
+	}
+
+	std::string line_path = RacingLine::GetLinePath(tmx_path);
+	if (!track.line.Load(line_path.c_str()) && !track.line.Compile(tmx_path, PIXELS_PER_METER)) return false;
+
+	// The maps link every waypoint to the next id, the last one back to the first
+	std::sort(hints.begin(), hints.end(), [](const RacingLineWaypoint& a, const RacingLineWaypoint& b) { return a.id < b.id; });
+	for (size_t i = 0; i < hints.size(); ++i)
+	{
+		Waypoint wp;
+		wp.id = hints[i].id;
+		wp.position = hints[i].position;
+		wp.next_ids.push_back(hints[(i + 1) % hints.size()].id);
+		track.waypoints.push_back(wp);
+	}
+
+	track.start_index = track.line.Locate(track.waypoints[0].position);
+	return true;
+}
+
+// Takes a car that finished or got stuck off the track, so it is not left
+// there as an obstacle for the ones still racing. Its wall contacts end here.
+static void Retire(b2World& world, VehicleSystem& vehicles, AIVehicle& car)
+{
+	car.active = false;
+	vehicles.RemoveVehicle(car.vehicle_id);
+	world.DestroyBody(car.body);
+	car.body = nullptr;
+	car.vehicle_id = -1;
+}
+
+// use_line false drives the reactive AI, waypoints and wall sensors only
+static RaceResult RunRace(const Track& track, const AIParams& params, unsigned int seed, int cars, int laps, bool use_line = true)
+{
+	b2World world(b2Vec2(0.0f, 0.0f));
+	world.SetAutoClearForces(false);
+	HitCounter hits(cars);
+	world.SetContactListener(&hits);
+
+	b2BodyDef wall_def;
+	b2Body* walls = world.CreateBody(&wall_def);
+	for (const std::vector<b2Vec2>& wall : track.walls)
+	{
+		if (wall.size() < 3) continue;
+		b2ChainShape shape;
+		shape.CreateLoop(wall.data(), (int)wall.size());
+		walls->CreateFixture(&shape, 0.0f);
+	}
+
+	VehicleSystem vehicles;
+	VehicleGrid grid;
+	int tuning = vehicles.AddTuning(AIVehicle::DefaultTuning(params));
+
+	Texture2D texture = {};
+	texture.width = (int)CAR_WIDTH;
+	texture.height = (int)CAR_HEIGHT;
+
+	// Starting grid behind the first waypoint, two columns on the racing line
+	std::vector<AIVehicle> ai(cars);
+	for (int i = 0; i < cars; ++i)
+	{
+		int index = track.line.Ahead(track.start_index, -4.0f - 3.5f * (i / 2 + 1));
+		b2Vec2 position = track.line.GetPoint(index);
+		b2Vec2 dir = track.line.GetPoint(index + 1) - position;
+		dir.Normalize();
+		b2Vec2 side(-dir.y, dir.x);
+		position += (i % 2 == 0 ? 0.6f : -0.6f) * side;
+
+		float rotation = (atan2f(dir.y, dir.x) + b2_pi / 2.0f) * 57.29577951308232f;
+		int start_waypoint = track.line.GetNextWaypoint(index);
+		ai[i].Init(&world, &vehicles, tuning, params, RandomStream(seed, i), position, AtlasSprite(texture), start_waypoint, rotation);
+		ai[i].body->GetUserData().pointer = (uintptr_t)(i + 1);
+
+		// Further back than the last waypoint, the lap count goes up once before the real first lap
+		if (start_waypoint != track.waypoints[0].id) ai[i].laps = 0;
+	}
+	vehicles.Gather();
+	grid.Build(vehicles);
+
+	AISenseContext context;
+	context.dt = STEPS_PER_THINK / STEP_RATE;
+	context.waypoints = &track.waypoints;
+	context.racing_line = use_line ? &track.line : nullptr;
+	context.grid = &grid;
+
+	float timeout = TIMEOUT_FACTOR * track.line.GetLapTime() * laps + 10.0f;
+	std::vector<float> finish_time(cars, 0.0f);
+	std::vector<float> waypoint_time(cars, 0.0f);
+	std::vector<int> waypoint(cars, -1);
+	int finished = 0;
+	int retired = 0;
+	float time = 0.0f;
+
+	while (time < timeout && finished + retired < cars)
+	{
+		for (AIVehicle& car : ai) car.Think(context);
+		for (AIVehicle& car : ai) car.Act();
+
+		for (int s = 0; s < STEPS_PER_THINK; ++s)
+		{
+			vehicles.Apply(1.0f / STEP_RATE);
+			world.Step(1.0f / STEP_RATE, 8, 3);
+		}
+		world.ClearForces();
+		vehicles.Gather();
+		time += context.dt;
+
+		for (int i = 0; i < cars; ++i)
+		{
+			if (finish_time[i] != 0.0f || !ai[i].active) continue;
+
+			// laps counts the one being driven
+			if (ai[i].laps > laps)
+			{
+				finish_time[i] = time;
+				finished++;
+				Retire(world, vehicles, ai[i]);
+			}
+			else if (ai[i].current_waypoint_id != waypoint[i])
+			{
+				waypoint[i] = ai[i].current_waypoint_id;
+				waypoint_time[i] = time;
+			}
+			else if (time - waypoint_time[i] > STUCK_TIME)
+			{
+				// Out of the race, its time so far counts over the laps it did
+				finish_time[i] = -time;
+				retired++;
+				Retire(world, vehicles, ai[i]);
+			}
+		}
+
+		// After the retirements, the grid only holds cars still racing
+		grid.Build(vehicles);
+	}
+
+	RaceResult result;
+	result.finished = finished;
+	result.retired = retired;
+	for (int i = 0; i < cars; ++i)
+	{
+		int car_laps = finish_time[i] > 0.0f ? laps : ai[i].laps - 1;
+		float car_time = finish_time[i] != 0.0f ? fabsf(finish_time[i]) : time;
+		result.lap_time += car_laps > 0 ? car_time / car_laps : 2.0f * timeout;
+		result.laps += car_laps;
+	}
+	result.lap_time /= cars;
+	float lap_count = result.laps > 0 ? (float)result.laps : 1.0f;
+	result.wall_hits = hits.wall_hits / lap_count;
+	result.car_hits = hits.car_hits / lap_count;
+	return result;
+}
+
+static float Score(const RaceResult& result)
+{
+	return result.lap_time + COLLISION_PENALTY * (result.wall_hits + 0.5f * result.car_hits);
+}
+
+// Races every set on every seed, the races are shared out to the workers
+static std::vector<RaceResult> RunRaces(const Track& track, const std::vector<AIParams>& sets, const std::vector<unsigned int>& seeds, int cars, int laps, int threads,
+	bool use_line = true)
+{
+	int races = (int)seeds.size();
+	int jobs = (int)sets.size() * races;
+	std::vector<RaceResult> results(jobs);
+	std::atomic<int> next_job(0);
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&]()
+		{
+			for (int job = next_job++; job < jobs; job = next_job++)
+			{
+				results[job] = RunRace(track, sets[job / races], seeds[job % races], cars, laps, use_line);
+			}
+		});
+	}
+	for (std::thread& worker : workers) worker.join();
+	return results;
+}
+
+// Average of the races of a set
+static void Summarize(const std::vector<RaceResult>& results, int set, int races, Candidate& candidate)
+{
+	candidate.result = RaceResult();
+	candidate.score = 0.0f;
+	for (int r = 0; r < races; ++r)
+	{
+		const RaceResult& result = results[set * races + r];
+		candidate.result.lap_time += result.lap_time / races;
+		candidate.result.wall_hits += result.wall_hits / races;
+		candidate.result.car_hits += result.car_hits / races;
+		candidate.result.laps += result.laps;
+		candidate.result.finished += result.finished;
+		candidate.result.retired += result.retired;
+		candidate.score += Score(result) / races;
+	}
+}
+
+static void Mutate(AIParams& params, std::mt19937& rng, float strength)
+{
+	std::normal_distribution<float> normal(0.0f, strength);
+	std::uniform_int_distribution<int> pick(0, param_count - 1);
+
+	// A few parameters at a time, steps relative to their range
+	int changes = 1 + pick(rng) % 3;
+	for (int c = 0; c < changes; ++c)
+	{
+		const ParamRange& range = param_ranges[pick(rng)];
+		float& value = params.*range.field;
+		value += normal(rng) * (range.max - range.min);
+		value = std::max(range.min, std::min(range.max, value));
+	}
+
+	// The rest of the cars are neutral
+	float personalities = params.aggressive_chance + params.fearful_chance;
+	if (personalities > 1.0f)
+	{
+		params.aggressive_chance /= personalities;
+		params.fearful_chance /= personalities;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s track.tmx [threads] [generations] [population] [cars] [laps] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	int threads = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+	int generations = argc > 3 ? atoi(argv[3]) : 10;
+	int population = argc > 4 ? atoi(argv[4]) : 32;
+	int cars = argc > 5 ? atoi(argv[5]) : 4;
+	int laps = argc > 6 ? atoi(argv[6]) : 1;
+	unsigned int seed = argc > 7 ? (unsigned int)atoi(argv[7]) : 1u;
+	if (threads < 1) threads = 1;
+	if (population < 4) population = 4;
+	if (cars < 1) cars = 1;
+	if (laps < 1) laps = 1;
+
+	Track track;
+	if (!LoadTrack(argv[1], track))
+	{
+		printf("Could not load %s, it needs AI_Waypoints and wall chains\n", argv[1]);
+		return 1;
+	}
+
+	printf("%s: %d waypoints, racing line %.0f m, %.1f s estimated lap\n", argv[1], (int)track.waypoints.size(), track.line.GetLength(), track.line.GetLapTime());
+	printf("%d threads, %d sets x %d races x %d cars x %d laps per generation\n\n", threads, population, RACES_PER_SET, cars, laps);
+
+	std::mt19937 rng(seed);
+
+	// First generation: the hand tuned defaults and mutations of them
+	std::vector<Candidate> candidates(population);
+	for (int i = 1; i < population; ++i) Mutate(candidates[i].params, rng, 0.25f);
+
+	int elite = population / 4;
+	long long total_laps = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	printf("%4s %10s %10s %10s %10s %10s %8s %12s\n", "gen", "score", "lap (s)", "walls/lap", "cars/lap", "finished", "retired", "laps/min");
+
+	for (int gen = 0; gen < generations; ++gen)
+	{
+		// Every set races on the same seeds, so the comparison is fair
+		std::vector<unsigned int> seeds(RACES_PER_SET);
+		for (unsigned int& s : seeds) s = (unsigned int)rng();
+
+		std::vector<AIParams> sets;
+		for (const Candidate& candidate : candidates) sets.push_back(candidate.params);
+		std::vector<RaceResult> results = RunRaces(track, sets, seeds, cars, laps, threads);
+
+		for (int i = 0; i < population; ++i)
+		{
+			Summarize(results, i, RACES_PER_SET, candidates[i]);
+			total_laps += candidates[i].result.laps;
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.score < b.score; });
+
+		float minutes = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() / 60.0f;
+		const Candidate& best = candidates[0];
+		printf("%4d %10.2f %10.2f %10.2f %10.2f %7d/%-2d %8d %12.0f\n", gen, best.score, best.result.lap_time, best.result.wall_hits,
+			best.result.car_hits, best.result.finished, RACES_PER_SET * cars, best.result.retired, total_laps / minutes);
+
+		// Elites stay, the rest are mutated elites, narrowing the steps over time
+		float strength = 0.2f * (1.0f - 0.7f * gen / (float)generations);
+		for (int i = elite; i < population; ++i)
+		{
+			candidates[i].params = candidates[i % elite].params;
+			Mutate(candidates[i].params, rng, strength);
+		}
+	}
+
+	float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	printf("\n%lld laps in %.1f s, %.0f laps per minute\n", total_laps, seconds, total_laps * 60.0f / seconds);
+
+	// The best set won on a few seeds, compare it with the hand tuned one on fresh
+	// ones, and both with the reactive AI the racing line replaced
+	std::vector<unsigned int> seeds(VALIDATION_RACES);
+	for (unsigned int& s : seeds) s = (unsigned int)rng();
+	std::vector<AIParams> sets = { AIParams(), candidates[0].params };
+	std::vector<RaceResult> results = RunRaces(track, sets, seeds, cars, laps, threads);
+	std::vector<RaceResult> reactive = RunRaces(track, { AIParams() }, seeds, cars, laps, threads, false);
+	results.insert(results.begin(), reactive.begin(), reactive.end());
+
+	const char* names[] = { "Reactive", "Hand tuned", "Best" };
+	printf("\nOver %d new races:\n", VALIDATION_RACES);
+	for (int i = 0; i < 3; ++i)
+	{
+		Candidate candidate;
+		Summarize(results, i, VALIDATION_RACES, candidate);
+		printf("%-10s score %7.2f, lap %7.2f s, %5.2f wall hits per lap, %5.2f car hits per lap, %d/%d finished\n", names[i], candidate.score,
+			candidate.result.lap_time, candidate.result.wall_hits, candidate.result.car_hits, candidate.result.finished, VALIDATION_RACES * cars);
+	}
+	printf("\n");
+
+	// Ready to paste over the AIParams defaults
+	const AIParams& best = candidates[0].params;
+	for (int i = 0; i < param_count; ++i)
+	{
+		printf("%-20s %6.2f\n", param_ranges[i].name, best.*param_ranges[i].field);
+	}
+	return 0;
+}
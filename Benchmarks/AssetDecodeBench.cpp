@@ -0,0 +1,189 @@
+// Asset decode benchmark.
+// Decodes every .png, .wav and .mp3 under the given folders with the decoders
+// raylib vendors, called the way LoadImage and LoadWave call them, so it
+// measures what LoadTexture and LoadSound spend before the upload. The files
+// are read into memory once before the runs, the disk is not measured. The
+// music is streamed in game; here it is decoded whole, which is the cost of
+// the stream over the whole song.
+//
+// Usage: AssetDecodeBench [folder...] [--runs 10] [--warmup 2] [--out report.json]
+//   folder defaults to Assets
+
+#include "BenchReport.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+#pragma warning(push)
+#pragma warning(disable : 4244 4267 4996 26451 6262 6386 6385)
+
+// rtextures.c and raudio.c
+#define STBI_NO_THREAD_LOCALS
+#define STB_IMAGE_IMPLEMENTATION
+#include "external/stb_image.h"
+#define DR_WAV_IMPLEMENTATION
+#include "external/dr_wav.h"
+#define DR_MP3_IMPLEMENTATION
+#include "external/dr_mp3.h"
+
+#pragma warning(pop)
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+enum class AssetType { IMAGE, WAV, MP3 };
+
+struct Asset
+{
+	std::string path;
+	std::string name;
+	AssetType type;
+	std::vector<unsigned char> data;
+};
+
+static const char* asset_type_names[] = { "image", "wav", "mp3" };
+
+// Decoded bytes, 0 on failure
+static size_t Decode(const Asset& asset)
+{
+	size_t size = 0;
+	switch (asset.type)
+	{
+	case AssetType::IMAGE:
+	{
+		int width = 0, height = 0, comp = 0;
+		unsigned char* pixels = stbi_load_from_memory(asset.data.data(), (int)asset.data.size(), &width, &height, &comp, 0);
+		if (pixels != nullptr) size = (size_t)width * height * comp;
+		stbi_image_free(pixels);
+		break;
+	}
+	case AssetType::WAV:
+	{
+		drwav wav;
+		if (drwav_init_memory(&wav, asset.data.data(), asset.data.size(), nullptr))
+		{
+			std::vector<short> samples((size_t)wav.totalPCMFrameCount * wav.channels);
+			size = (size_t)drwav_read_pcm_frames_s16(&wav, wav.totalPCMFrameCount, samples.data()) * wav.channels * sizeof(short);
+			drwav_uninit(&wav);
+		}
+		break;
+	}
+	case AssetType::MP3:
+	{
+		drmp3_config config = { 0 };
+		drmp3_uint64 frame_count = 0;
+		float* samples = drmp3_open_memory_and_read_pcm_frames_f32(asset.data.data(), asset.data.size(), &config, &frame_count, nullptr);
+		if (samples != nullptr) size = (size_t)frame_count * config.channels * sizeof(float);
+		drmp3_free(samples, nullptr);
+		break;
+	}
+	}
+	return size;
+}
+
+static bool LoadAssets(const std::string& folder, std::vector<Asset>& assets)
+{
+	std::error_code error;
+	std::filesystem::recursive_directory_iterator it(folder, error);
+	if (error) return false;
+
+	for (const std::filesystem::directory_entry& entry : it)
+	{
+		if (!entry.is_regular_file()) continue;
+
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		Asset asset;
+		if (extension == ".png") asset.type = AssetType::IMAGE;
+		else if (extension == ".wav") asset.type = AssetType::WAV;
+		else if (extension == ".mp3") asset.type = AssetType::MP3;
+		else continue;
+
+		asset.path = entry.path().generic_string();
+		asset.name = entry.path().filename().string();
+		std::ifstream file(entry.path(), std::ios::binary);
+		asset.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		assets.push_back(asset);
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseBenchOptions(argc, argv, options))
+	{
+		printf("Usage: %s [folder...] [--runs 10] [--warmup 2] [--out report.json]\n", argv[0]);
+		return 1;
+	}
+	if (options.args.empty()) options.args.push_back("Assets");
+
+	std::vector<Asset> assets;
+	for (const std::string& folder : options.args)
+	{
+		if (!LoadAssets(folder, assets))
+		{
+			fprintf(stderr, "Could not read %s\n", folder.c_str());
+			return 1;
+		}
+	}
+	std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.path < b.path; });
+
+	BenchReport report("AssetDecodeBench", options);
+	double type_encoded[3] = { 0.0, 0.0, 0.0 };
+	double type_decoded[3] = { 0.0, 0.0, 0.0 };
+	std::vector<double> type_ms[3];
+	for (int t = 0; t < 3; ++t) type_ms[t].assign(options.runs, 0.0);
+
+	for (const Asset& asset : assets)
+	{
+		size_t decoded = 0;
+		int run_index = -options.warmup;
+		BenchSamples samples = report.Sample([&](BenchSamples& run)
+		{
+			BenchClock::time_point start = BenchClock::now();
+			decoded = Decode(asset);
+			double ms = BenchMs(start, BenchClock::now());
+			run.Add("decode_ms", "ms", ms);
+			run.Add("throughput", "MB/s", ms > 0.0 ? asset.data.size() / (ms * 1000.0) : 0.0);
+			if (run_index >= 0) type_ms[(int)asset.type][run_index] += ms;
+			run_index++;
+		});
+
+		if (decoded == 0)
+		{
+			fprintf(stderr, "Could not decode %s\n", asset.path.c_str());
+			return 1;
+		}
+		type_encoded[(int)asset.type] += (double)asset.data.size();
+		type_decoded[(int)asset.type] += (double)decoded;
+
+		report.AddCase(asset.path)
+			.Param("type", asset_type_names[(int)asset.type])
+			.Param("file_bytes", (double)asset.data.size())
+			.Param("decoded_bytes", (double)decoded)
+			.Metrics(samples);
+	}
+
+	// Every file of a type in one run, what a level load pays
+	for (int t = 0; t < 3; ++t)
+	{
+		if (type_encoded[t] == 0.0) continue;
+		report.AddCase(std::string("all ") + asset_type_names[t])
+			.Param("type", asset_type_names[t])
+			.Param("file_bytes", type_encoded[t])
+			.Param("decoded_bytes", type_decoded[t])
+			.Metric("decode_ms", "ms", type_ms[t]);
+	}
+
+	return report.Write() ? 0 : 1;
+}
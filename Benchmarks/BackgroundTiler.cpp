@@ -0,0 +1,203 @@
+// Offline background tiler.
+// Cuts a track background into BACKGROUND_TILE_SIZE tiles, with every mip
+// level down to the one that fits a single tile, and writes them QOI encoded
+// into a .bgt file next to the image (see Source/TiledBackground.h). The game
+// streams the tiles around the camera from it instead of loading the image.
+// Tiles with nothing but transparent pixels are not stored.
+// Reports, per image: levels, stored tiles, file size against the image and
+// what the whole image takes as one RGBA texture.
+//
+// Usage: BackgroundTiler background.png [background.png ...]
+
+#include "../Source/TiledBackground.h"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#endif
+#pragma warning(push)
+#pragma warning(disable : 4244 4267 4996 26451 6262 6386 6385)
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "external/stb_image.h"
+#define QOI_IMPLEMENTATION
+#include "external/qoi.h"
+
+#pragma warning(pop)
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct MipLevel
+{
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;	// RGBA
+};
+
+// 2x2 box filter, the last row and column repeat on odd sizes
+static MipLevel Downsample(const MipLevel& level)
+{
+	MipLevel half;
+	half.width = (level.width + 1) / 2;
+	half.height = (level.height + 1) / 2;
+	half.pixels.resize((size_t)half.width * half.height * 4);
+	for (int y = 0; y < half.height; ++y)
+	{
+		int y0 = 2 * y;
+		int y1 = std::min(y0 + 1, level.height - 1);
+		for (int x = 0; x < half.width; ++x)
+		{
+			int x0 = 2 * x;
+			int x1 = std::min(x0 + 1, level.width - 1);
+			for (int c = 0; c < 4; ++c)
+			{
+				int sum = level.pixels[((size_t)y0 * level.width + x0) * 4 + c] + level.pixels[((size_t)y0 * level.width + x1) * 4 + c] +
+					level.pixels[((size_t)y1 * level.width + x0) * 4 + c] + level.pixels[((size_t)y1 * level.width + x1) * 4 + c];
+				half.pixels[((size_t)y * half.width + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return half;
+}
+
+// Same as TiledBackground::GetTilesPath
+static std::string GetTilesPath(const std::string& image_path)
+{
+	size_t dot = image_path.find_last_of('.');
+	size_t slash = image_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return image_path + ".bgt";
+	return image_path.substr(0, dot) + ".bgt";
+}
+
+static bool TileImage(const char* path, int& level_count, int& tile_count, long long& file_size)
+{
+	MipLevel level;
+	int channels = 0;
+	unsigned char* pixels = stbi_load(path, &level.width, &level.height, &channels, 4);
+	if (pixels == nullptr) return false;
+	level.pixels.assign(pixels, pixels + (size_t)level.width * level.height * 4);
+	stbi_image_free(pixels);
+
+	std::vector<MipLevel> levels;
+	levels.push_back(level);
+	while (levels.back().width > BACKGROUND_TILE_SIZE || levels.back().height > BACKGROUND_TILE_SIZE)
+	{
+		levels.push_back(Downsample(levels.back()));
+	}
+
+	std::vector<int> entries;	// offset, size of every tile, level by level
+	std::vector<std::vector<unsigned char>> blobs;
+	std::vector<unsigned char> tile((size_t)BACKGROUND_TILE_SIZE * BACKGROUND_TILE_SIZE * 4);
+	for (const MipLevel& mip : levels)
+	{
+		int columns = (mip.width + BACKGROUND_TILE_SIZE - 1) / BACKGROUND_TILE_SIZE;
+		int rows = (mip.height + BACKGROUND_TILE_SIZE - 1) / BACKGROUND_TILE_SIZE;
+		for (int row = 0; row < rows; ++row)
+		{
+			for (int column = 0; column < columns; ++column)
+			{
+				int x = column * BACKGROUND_TILE_SIZE;
+				int y = row * BACKGROUND_TILE_SIZE;
+				int width = std::min(BACKGROUND_TILE_SIZE, mip.width - x);
+				int height = std::min(BACKGROUND_TILE_SIZE, mip.height - y);
+
+				bool empty = true;
+				for (int line = 0; line < height; ++line)
+				{
+					const unsigned char* source = &mip.pixels[((size_t)(y + line) * mip.width + x) * 4];
+					std::copy(source, source + (size_t)width * 4, tile.begin() + (size_t)line * width * 4);
+					for (int p = 0; p < width && empty; ++p) empty = source[p * 4 + 3] == 0;
+				}
+
+				std::vector<unsigned char> blob;
+				if (!empty)
+				{
+					qoi_desc desc = { (unsigned int)width, (unsigned int)height, 4, QOI_SRGB };
+					int size = 0;
+					void* encoded = qoi_encode(tile.data(), &desc, &size);
+					if (encoded == nullptr) return false;
+					blob.assign((unsigned char*)encoded, (unsigned char*)encoded + size);
+					free(encoded);
+				}
+				entries.push_back(0);
+				entries.push_back((int)blob.size());
+				blobs.push_back(blob);
+			}
+		}
+	}
+
+	int header[5] = { BACKGROUND_FILE_VERSION, levels[0].width, levels[0].height, BACKGROUND_TILE_SIZE, (int)levels.size() };
+	std::vector<int> sizes;
+	for (const MipLevel& mip : levels)
+	{
+		sizes.push_back(mip.width);
+		sizes.push_back(mip.height);
+	}
+
+	int offset = (int)(4 + sizeof(header) + sizes.size() * sizeof(int) + entries.size() * sizeof(int));
+	tile_count = 0;
+	for (size_t i = 0; i < blobs.size(); ++i)
+	{
+		if (blobs[i].empty()) continue;
+		entries[i * 2] = offset;
+		offset += (int)blobs[i].size();
+		tile_count++;
+	}
+
+	std::string out_path = GetTilesPath(path);
+	std::ofstream file(out_path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	file.write("BGTL", 4);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)sizes.data(), sizes.size() * sizeof(int));
+	file.write((const char*)entries.data(), entries.size() * sizeof(int));
+	for (const std::vector<unsigned char>& blob : blobs) file.write((const char*)blob.data(), blob.size());
+
+	level_count = (int)levels.size();
+	file_size = offset;
+	return file.good();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s background.png [background.png ...]\n", argv[0]);
+		return 1;
+	}
+
+	int failed = 0;
+	printf("%-32s %7s %7s %10s %10s %12s\n", "image", "levels", "tiles", "png (KB)", "bgt (KB)", "texture (MB)");
+
+	for (int i = 1; i < argc; ++i)
+	{
+		int level_count = 0, tile_count = 0;
+		long long file_size = 0;
+		if (!TileImage(argv[i], level_count, tile_count, file_size))
+		{
+			printf("%-32s could not be tiled\n", argv[i]);
+			failed++;
+			continue;
+		}
+
+		std::ifstream image(argv[i], std::ios::binary | std::ios::ate);
+		int width = 0, height = 0, channels = 0;
+		stbi_info(argv[i], &width, &height, &channels);
+		printf("%-32s %7d %7d %10lld %10lld %12.1f\n", argv[i], level_count, tile_count, (long long)image.tellg() / 1024, file_size / 1024,
+			width * (double)height * 4.0 / (1024.0 * 1024.0));
+	}
+
+	return failed;
+}
@@ -0,0 +1,15 @@
+// Globals.h log() for the benchmarks, to stderr so stdout stays the JSON report
+
+#include "../Source/Globals.h"
+
+#include <stdarg.h>
+
+void log(const char file[], int line, const char* format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	fprintf(stderr, "%s(%d) : ", file, line);
+	vfprintf(stderr, format, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// Headless race for the physics and AI benchmarks. The walls, waypoints and
+// spawn points are read with TrackMap like in the game and the world is set up
+// like ModulePhysics does it. The cars are AI cars on a starting grid along
+// the racing line, two per row, so any car count fits on any track.
+
+#include "../Source/AIVehicle.h"
+#include "../Source/JobSystem.h"
+#include "../Source/PerceptionScheduler.h"
+#include "../Source/RacingLine.h"
+#include "../Source/TrackMap.h"
+#include "../Source/VehicleGrid.h"
+#include "../Source/VehicleSystem.h"
+
+#include <string>
+#include <vector>
+
+#define PIXELS_PER_METER 50.0f	// same scale as ModulePhysics.h
+#define METERS_PER_PIXEL 0.02f
+#define STEP_RATE 120.0f		// RACE_STEP_RATE
+#define STEPS_PER_FRAME 2		// at 60 frames per second
+#define CAR_WIDTH 57.0f			// pixels, the car textures
+#define CAR_HEIGHT 103.0f
+
+struct BenchTrack
+{
+	std::string name;	// file name without the folder and extension
+	std::vector<CollisionObject> walls;
+	std::vector<b2Vec2> spawn_points;
+	std::vector<Waypoint> waypoints;
+	RacingLine line;
+	int start_index = 0;	// racing line sample of the spawn
+};
+
+inline bool LoadBenchTrack(const char* tmx_path, BenchTrack& track)
+{
+	std::string path = tmx_path;
+	size_t slash = path.find_last_of("/\\");
+	track.name = slash != std::string::npos ? path.substr(slash + 1) : path;
+	size_t dot = track.name.find_last_of('.');
+	if (dot != std::string::npos) track.name = track.name.substr(0, dot);
+
+	if (!ReadMapCollisions(tmx_path, track.walls)) return false;
+	if (!ReadMapObjects(tmx_path, METERS_PER_PIXEL, track.spawn_points, track.waypoints)) return false;
+	if (track.spawn_points.empty() || track.waypoints.empty()) return false;
+
+	if (!track.line.Load(RacingLine::GetLinePath(tmx_path).c_str()) && !track.line.Compile(tmx_path, PIXELS_PER_METER)) return false;
+	const b2Vec2& spawn = track.spawn_points[0];
+	track.start_index = track.line.Locate(b2Vec2(METERS_PER_PIXEL * spawn.x, METERS_PER_PIXEL * spawn.y));
+	return true;
+}
+
+class BenchRace
+{
+public:
+	BenchRace(const BenchTrack& track, int cars, uint64_t seed) : world(b2Vec2(0.0f, 0.0f)), ai(cars)
+	{
+		world.SetAutoClearForces(false);
+		world.SetWideContactSolver(true);
+
+		// ModulePhysics::CreateChain
+		std::vector<int> points;
+		for (const CollisionObject& wall : track.walls)
+		{
+			if (!GetCollisionChain(wall, points)) continue;
+
+			std::vector<b2Vec2> vertices(points.size() / 2);
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				vertices[i].Set(METERS_PER_PIXEL * points[i * 2], METERS_PER_PIXEL * points[i * 2 + 1]);
+			}
+			b2BodyDef body_def;
+			b2Body* body = world.CreateBody(&body_def);
+			b2ChainShape shape;
+			shape.CreateLoop(vertices.data(), (int)vertices.size());
+			b2FixtureDef fixture_def;
+			fixture_def.shape = &shape;
+			fixture_def.friction = 0.5f;
+			body->CreateFixture(&fixture_def);
+		}
+
+		AIParams params;
+		int tuning = vehicles.AddTuning(AIVehicle::DefaultTuning(params));
+
+		Texture2D texture = { 0 };
+		texture.width = (int)CAR_WIDTH;
+		texture.height = (int)CAR_HEIGHT;
+
+		for (int i = 0; i < cars; ++i)
+		{
+			int index = track.line.Ahead(track.start_index, -3.5f * (i / 2));
+			b2Vec2 position = track.line.GetPoint(index);
+			b2Vec2 dir = track.line.GetPoint(index + 1) - position;
+			dir.Normalize();
+			b2Vec2 side(-dir.y, dir.x);
+			position += (i % 2 == 0 ? 0.6f : -0.6f) * side;
+
+			float rotation = (atan2f(dir.y, dir.x) + b2_pi / 2.0f) * 57.29577951308232f;
+			ai[i].Init(&world, &vehicles, tuning, params, RandomStream(seed, i), position, AtlasSprite(texture), track.line.GetNextWaypoint(index), rotation);
+		}
+
+		perception.deterministic = true;
+		context.dt = STEPS_PER_FRAME / STEP_RATE;
+		context.waypoints = &track.waypoints;
+		context.racing_line = &track.line;
+		context.grid = &grid;
+
+		vehicles.Gather();
+		grid.Build(vehicles);
+	}
+
+	// ModulePhysics::PreUpdate of a 60 Hz frame
+	void StepPhysics()
+	{
+		for (int s = 0; s < STEPS_PER_FRAME; ++s)
+		{
+			vehicles.Apply(1.0f / STEP_RATE);
+			world.Step(1.0f / STEP_RATE, 8, 3);
+		}
+		world.ClearForces();
+		vehicles.Gather();
+		grid.Build(vehicles);
+	}
+
+	// ModuleGame::UpdateAi, the think phase on the jobs when given
+	void UpdateAi(JobSystem* jobs)
+	{
+		perception.Schedule(ai, grid, b2Vec2_zero, context.dt);
+		if (jobs != nullptr)
+		{
+			jobs->ParallelFor((int)ai.size(), AI_THINK_BATCH, [this](int begin, int end)
+			{
+				for (int i = begin; i < end; ++i) ai[i].Think(context);
+			});
+		}
+		else
+		{
+			for (AIVehicle& car : ai) car.Think(context);
+		}
+		perception.EndFrame(ai);
+		for (AIVehicle& car : ai) car.Act();
+	}
+
+	b2World world;
+	VehicleSystem vehicles;
+	VehicleGrid grid;
+	std::vector<AIVehicle> ai;
+	PerceptionScheduler perception;
+	AISenseContext context;
+};
@@ -0,0 +1,364 @@
+#pragma once
+
+// Options, timing statistics and the JSON report shared by the benchmark
+// executables. A case runs its work warmup + runs times and keeps one sample
+// per run, so the statistics describe how much a measurement moves between
+// runs on the same machine. Compare the medians of two reports, the spread
+// (mad, cv) tells whether a difference is real.
+//
+// Common options:
+//   --runs N      measured runs of every case (10)
+//   --warmup N    runs thrown away before them (2)
+//   --out file    JSON report, stdout when missing
+// A summary of every metric goes to stderr as it is measured.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <deque>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define BENCH_REPORT_VERSION 1
+
+typedef std::chrono::steady_clock BenchClock;
+
+inline double BenchMs(BenchClock::time_point start, BenchClock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct BenchOptions
+{
+	int runs = 10;
+	int warmup = 2;
+	std::string out;
+	std::vector<std::string> args;	// positional arguments
+	std::vector<std::pair<std::string, std::string>> values;	// any other --name value
+
+	const char* GetValue(const char* name) const
+	{
+		for (const auto& value : values)
+		{
+			if (value.first == name) return value.second.c_str();
+		}
+		return nullptr;
+	}
+
+	int GetInt(const char* name, int default_value) const
+	{
+		const char* value = GetValue(name);
+		return value != nullptr ? atoi(value) : default_value;
+	}
+
+	// Comma separated list, like --cars 1,10,40
+	std::vector<int> GetIntList(const char* name, const char* default_value) const
+	{
+		const char* value = GetValue(name);
+		std::string list = value != nullptr ? value : default_value;
+		std::vector<int> result;
+		size_t start = 0;
+		while (start < list.size())
+		{
+			size_t end = list.find(',', start);
+			if (end == std::string::npos) end = list.size();
+			if (end > start) result.push_back(atoi(list.substr(start, end - start).c_str()));
+			start = end + 1;
+		}
+		return result;
+	}
+};
+
+inline bool ParseBenchOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0)
+		{
+			options.args.push_back(arg);
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value of %s\n", arg.c_str());
+			return false;
+		}
+		std::string value = argv[++i];
+		if (arg == "--runs") options.runs = std::max(1, atoi(value.c_str()));
+		else if (arg == "--warmup") options.warmup = std::max(0, atoi(value.c_str()));
+		else if (arg == "--out") options.out = value;
+		else options.values.push_back(std::make_pair(arg.substr(2), value));
+	}
+	return true;
+}
+
+struct BenchStats
+{
+	int count = 0;
+	double min = 0.0;
+	double max = 0.0;
+	double mean = 0.0;
+	double median = 0.0;
+	double p95 = 0.0;
+	double stddev = 0.0;
+	double mad = 0.0;	// median absolute deviation, not moved by a single slow run
+	double cv = 0.0;	// stddev / mean
+};
+
+inline double BenchPercentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+	double index = p * (sorted.size() - 1);
+	size_t below = (size_t)index;
+	size_t above = std::min(below + 1, sorted.size() - 1);
+	return sorted[below] + (sorted[above] - sorted[below]) * (index - below);
+}
+
+inline BenchStats ComputeStats(std::vector<double> samples)
+{
+	BenchStats stats;
+	stats.count = (int)samples.size();
+	if (samples.empty()) return stats;
+
+	std::sort(samples.begin(), samples.end());
+	stats.min = samples.front();
+	stats.max = samples.back();
+	stats.median = BenchPercentile(samples, 0.5);
+	stats.p95 = BenchPercentile(samples, 0.95);
+
+	double sum = 0.0;
+	for (double sample : samples) sum += sample;
+	stats.mean = sum / samples.size();
+
+	double variance = 0.0;
+	for (double sample : samples) variance += (sample - stats.mean) * (sample - stats.mean);
+	stats.stddev = samples.size() > 1 ? sqrt(variance / (samples.size() - 1)) : 0.0;
+	stats.cv = stats.mean != 0.0 ? stats.stddev / stats.mean : 0.0;
+
+	std::vector<double> deviations;
+	for (double sample : samples) deviations.push_back(fabs(sample - stats.median));
+	std::sort(deviations.begin(), deviations.end());
+	stats.mad = BenchPercentile(deviations, 0.5);
+	return stats;
+}
+
+inline std::string JsonString(const std::string& text)
+{
+	std::string result = "\"";
+	for (char c : text)
+	{
+		switch (c)
+		{
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			}
+			else result += c;
+		}
+	}
+	return result + "\"";
+}
+
+inline std::string JsonNumber(double value)
+{
+	if (!std::isfinite(value)) return "null";
+	char text[32];
+	snprintf(text, sizeof(text), "%.6g", value);
+	return text;
+}
+
+// Values of every metric over the runs of a case, one per run
+class BenchSamples
+{
+public:
+	struct Series
+	{
+		std::string name;
+		std::string unit;
+		std::vector<double> values;
+	};
+
+	void Add(const char* metric, const char* unit, double value)
+	{
+		for (Series& s : series)
+		{
+			if (s.name == metric)
+			{
+				s.values.push_back(value);
+				return;
+			}
+		}
+		Series s;
+		s.name = metric;
+		s.unit = unit;
+		s.values.push_back(value);
+		series.push_back(s);
+	}
+
+	std::vector<Series> series;
+};
+
+// One configuration of a benchmark, its parameters and measured metrics
+class BenchCase
+{
+public:
+	explicit BenchCase(const std::string& name) : name(name) {}
+
+	BenchCase& Param(const char* param, const std::string& value)
+	{
+		params.push_back(std::make_pair(std::string(param), JsonString(value)));
+		return *this;
+	}
+
+	BenchCase& Param(const char* param, double value)
+	{
+		params.push_back(std::make_pair(std::string(param), JsonNumber(value)));
+		return *this;
+	}
+
+	BenchCase& Metric(const char* metric, const char* unit, const std::vector<double>& samples)
+	{
+		Measurement measurement;
+		measurement.name = metric;
+		measurement.unit = unit;
+		measurement.stats = ComputeStats(samples);
+		metrics.push_back(measurement);
+
+		const BenchStats& s = measurement.stats;
+		fprintf(stderr, "%-40s %-16s median %10.4g %-5s min %10.4g  max %10.4g  cv %5.1f%%\n", name.c_str(), metric, s.median, unit,
+			s.min, s.max, s.cv * 100.0);
+		return *this;
+	}
+
+	BenchCase& Metrics(const BenchSamples& samples)
+	{
+		for (const BenchSamples::Series& s : samples.series) Metric(s.name.c_str(), s.unit.c_str(), s.values);
+		return *this;
+	}
+
+	std::string ToJson() const
+	{
+		std::string json = "    {\n      \"name\": " + JsonString(name) + ",\n      \"params\": {";
+		for (size_t i = 0; i < params.size(); ++i)
+		{
+			json += (i > 0 ? ", " : " ") + JsonString(params[i].first) + ": " + params[i].second;
+		}
+		json += params.empty() ? "},\n" : " },\n";
+		json += "      \"metrics\": {";
+		for (size_t i = 0; i < metrics.size(); ++i)
+		{
+			const BenchStats& s = metrics[i].stats;
+			json += (i > 0 ? ",\n        " : "\n        ") + JsonString(metrics[i].name) + ": { \"unit\": " + JsonString(metrics[i].unit) +
+				", \"count\": " + JsonNumber(s.count) + ", \"median\": " + JsonNumber(s.median) + ", \"mean\": " + JsonNumber(s.mean) +
+				", \"min\": " + JsonNumber(s.min) + ", \"max\": " + JsonNumber(s.max) + ", \"p95\": " + JsonNumber(s.p95) +
+				", \"stddev\": " + JsonNumber(s.stddev) + ", \"mad\": " + JsonNumber(s.mad) + ", \"cv\": " + JsonNumber(s.cv) + " }";
+		}
+		json += metrics.empty() ? "}\n    }" : "\n      }\n    }";
+		return json;
+	}
+
+	std::string name;
+
+private:
+	struct Measurement
+	{
+		std::string name;
+		std::string unit;
+		BenchStats stats;
+	};
+
+	std::vector<std::pair<std::string, std::string>> params;	// values already in JSON
+	std::vector<Measurement> metrics;
+};
+
+// Every case of one benchmark run plus what is needed to tell runs apart:
+// the compiler, the build and the machine's thread count
+class BenchReport
+{
+public:
+	BenchReport(const char* benchmark, const BenchOptions& options) : benchmark(benchmark), options(options) {}
+
+	// Stays valid while more cases are added
+	BenchCase& AddCase(const std::string& name)
+	{
+		cases.push_back(BenchCase(name));
+		return cases.back();
+	}
+
+	// Runs fn(samples) warmup + runs times, only the measured runs are kept
+	template<typename Fn>
+	BenchSamples Sample(Fn fn) const
+	{
+		BenchSamples warmup;
+		for (int i = 0; i < options.warmup; ++i) fn(warmup);
+		BenchSamples samples;
+		for (int i = 0; i < options.runs; ++i) fn(samples);
+		return samples;
+	}
+
+	bool Write() const
+	{
+		FILE* file = options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Could not write %s\n", options.out.c_str());
+			return false;
+		}
+
+		char date[32] = "";
+		time_t now = time(nullptr);
+		strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+		fprintf(file, "{\n  \"benchmark\": %s,\n  \"version\": %d,\n  \"date\": %s,\n", JsonString(benchmark).c_str(), BENCH_REPORT_VERSION,
+			JsonString(date).c_str());
+		fprintf(file, "  \"compiler\": %s,\n  \"build\": %s,\n  \"hardware_threads\": %u,\n", JsonString(GetCompiler()).c_str(),
+#ifdef NDEBUG
+			"\"release\"",
+#else
+			"\"debug\"",
+#endif
+			std::thread::hardware_concurrency());
+		fprintf(file, "  \"runs\": %d,\n  \"warmup\": %d,\n  \"cases\": [\n", options.runs, options.warmup);
+		for (size_t i = 0; i < cases.size(); ++i)
+		{
+			fprintf(file, "%s%s\n", cases[i].ToJson().c_str(), i + 1 < cases.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+
+		if (file != stdout) fclose(file);
+		return true;
+	}
+
+private:
+	static std::string GetCompiler()
+	{
+		char text[64];
+#if defined(__clang__)
+		snprintf(text, sizeof(text), "clang %d.%d.%d", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+		snprintf(text, sizeof(text), "gcc %d.%d.%d", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+		snprintf(text, sizeof(text), "msvc %d", _MSC_FULL_VER);
+#else
+		snprintf(text, sizeof(text), "unknown");
+#endif
+		return text;
+	}
+
+	std::string benchmark;
+	const BenchOptions& options;
+	std::deque<BenchCase> cases;
+};
@@ -0,0 +1,85 @@
+// Pile-up benchmark for the Box2D contact solver.
+// The same pile-up scene (see PileUpScene.h) is stepped once per solver mode
+// and the contact solver time is compared.
+//
+// Usage: ContactSolverBench [cars] [steps]
+
+#include "PileUpScene.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct BenchMode
+{
+	const char* name;
+	bool wide;
+	b2SimdLevel level;
+};
+
+struct BenchResult
+{
+	float solve_velocity;
+	float solve_position;
+	int contacts;
+};
+
+static BenchResult RunMode(const BenchMode& mode, int cars, int steps)
+{
+	b2SetSimdLevel(mode.level);
+
+	b2World* world = CreatePileUp(cars);
+	world->SetWideContactSolver(mode.wide);
+
+	BenchResult result = { 0.0f, 0.0f, 0 };
+	const float dt = 1.0f / 60.0f;
+
+	for (int i = 0; i < steps; ++i)
+	{
+		PushPileUp(world);
+
+		world->Step(dt, 8, 3);
+
+		const b2Profile& profile = world->GetProfile();
+		result.solve_velocity += profile.solveVelocity;
+		result.solve_position += profile.solvePosition;
+	}
+
+	result.contacts = world->GetContactCount();
+	delete world;
+
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int cars = argc > 1 ? atoi(argv[1]) : 200;
+	int steps = argc > 2 ? atoi(argv[2]) : 600;
+
+	b2SimdLevel supported = b2GetSupportedSimdLevel();
+
+	BenchMode modes[] = {
+		{ "scalar (block solver)", false, b2_simdScalar },
+		{ "wide scalar x4", true, b2_simdScalar },
+		{ "wide SSE2 x4", true, b2_simdSSE2 },
+		{ "wide AVX2 x8", true, b2_simdAVX2 },
+	};
+
+	printf("pile-up: %d cars, %d steps\n", cars, steps);
+	printf("%-24s %12s %12s %12s %10s\n", "mode", "velocity ms", "position ms", "total ms", "contacts");
+
+	for (int i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); ++i)
+	{
+		if (modes[i].level > supported)
+		{
+			printf("%-24s %12s\n", modes[i].name, "unsupported");
+			continue;
+		}
+
+		BenchResult result = RunMode(modes[i], cars, steps);
+		printf("%-24s %12.2f %12.2f %12.2f %10d\n", modes[i].name, result.solve_velocity, result.solve_position,
+			result.solve_velocity + result.solve_position, result.contacts);
+	}
+
+	b2SetSimdLevel(supported);
+	return 0;
+}
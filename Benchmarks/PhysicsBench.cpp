@@ -0,0 +1,71 @@
+// Physics scaling benchmark.
+// Races N AI cars on every given track and times the physics part of the
+// frame only: Apply, the two 120 Hz steps, ClearForces, Gather and the grid
+// build. The AI think runs between the frames untimed. Every run starts a new
+// race from the same seed, so every run does the same work.
+//
+// Usage: PhysicsBench track.tmx... [--cars 1,10,20,40,80] [--frames 600] [--seed 1]
+//        [--runs 10] [--warmup 2] [--out report.json]
+
+#include "BenchRace.h"
+#include "BenchReport.h"
+
+#include <memory>
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseBenchOptions(argc, argv, options) || options.args.empty())
+	{
+		printf("Usage: %s track.tmx... [--cars 1,10,20,40,80] [--frames 600] [--seed 1] [--runs 10] [--warmup 2] [--out report.json]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<int> car_counts = options.GetIntList("cars", "1,10,20,40,80");
+	int frames = std::max(1, options.GetInt("frames", 600));
+	uint64_t seed = (uint64_t)options.GetInt("seed", 1);
+
+	BenchReport report("PhysicsBench", options);
+	for (const std::string& path : options.args)
+	{
+		BenchTrack track;
+		if (!LoadBenchTrack(path.c_str(), track))
+		{
+			fprintf(stderr, "Could not load %s\n", path.c_str());
+			return 1;
+		}
+
+		for (int cars : car_counts)
+		{
+			BenchSamples samples = report.Sample([&](BenchSamples& run)
+			{
+				std::unique_ptr<BenchRace> race(new BenchRace(track, cars, seed));
+				double physics_ms = 0.0;
+				int contact_sum = 0;
+				for (int f = 0; f < frames; ++f)
+				{
+					race->UpdateAi(nullptr);
+
+					BenchClock::time_point start = BenchClock::now();
+					race->StepPhysics();
+					physics_ms += BenchMs(start, BenchClock::now());
+					contact_sum += race->world.GetContactCount();
+				}
+				double step_us = physics_ms * 1000.0 / (frames * STEPS_PER_FRAME);
+				run.Add("physics_ms", "ms", physics_ms);
+				run.Add("step_us", "us", step_us);
+				run.Add("car_step_us", "us", step_us / std::max(1, cars));
+				run.Add("contacts", "count", (double)contact_sum / frames);
+			});
+
+			report.AddCase(track.name + "/" + std::to_string(cars) + " cars")
+				.Param("track", track.name)
+				.Param("cars", cars)
+				.Param("frames", frames)
+				.Param("steps", frames * STEPS_PER_FRAME)
+				.Metrics(samples);
+		}
+	}
+
+	return report.Write() ? 0 : 1;
+}
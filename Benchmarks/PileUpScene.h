@@ -0,0 +1,72 @@
+// Shared pile-up scene for the solver benchmarks.
+// Cars are dropped into a closed arena without gravity and pushed towards the
+// centre every step, so every body ends up in contact with several others.
+
+#pragma once
+
+#include "box2d/box2d.h"
+
+inline b2World* CreatePileUp(int cars)
+{
+	b2World* world = new b2World(b2Vec2(0.0f, 0.0f));
+
+	// Arena wall, same kind of chain loop the tracks use.
+	const float arena = 40.0f;
+	b2Vec2 corners[4] = { b2Vec2(-arena, -arena), b2Vec2(arena, -arena), b2Vec2(arena, arena), b2Vec2(-arena, arena) };
+	b2ChainShape chain;
+	chain.CreateLoop(corners, 4);
+
+	b2BodyDef wall_def;
+	b2Body* wall = world->CreateBody(&wall_def);
+	wall->CreateFixture(&chain, 0.0f);
+
+	// Cars on a jittered grid, with a fixed seed so every mode sees the same scene.
+	unsigned int seed = 12345u;
+	int columns = 1;
+	while (columns * columns < cars)
+	{
+		++columns;
+	}
+
+	b2PolygonShape box;
+	box.SetAsBox(0.4f, 0.8f);
+
+	b2FixtureDef fixture;
+	fixture.shape = &box;
+	fixture.density = 1.0f;
+	fixture.friction = 0.3f;
+
+	float spacing = (2.0f * arena - 4.0f) / columns;
+	for (int i = 0; i < cars; ++i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		float jitter = ((seed >> 8) & 0xFFFF) / 65535.0f - 0.5f;
+
+		b2BodyDef def;
+		def.type = b2_dynamicBody;
+		def.position.Set(-arena + 2.0f + spacing * (i % columns + 0.5f) + 0.2f * jitter,
+			-arena + 2.0f + spacing * (i / columns + 0.5f) - 0.2f * jitter);
+		def.angle = jitter * b2_pi;
+		def.linearDamping = 0.5f;
+		def.angularDamping = 2.0f;
+
+		b2Body* body = world->CreateBody(&def);
+		body->CreateFixture(&fixture);
+	}
+
+	return world;
+}
+
+// Push everything towards the centre to keep the pile compressed.
+inline void PushPileUp(b2World* world)
+{
+	for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		if (body->GetType() == b2_dynamicBody)
+		{
+			b2Vec2 force = -body->GetPosition();
+			force.Normalize();
+			body->ApplyForceToCenter(20.0f * body->GetMass() * force, true);
+		}
+	}
+}
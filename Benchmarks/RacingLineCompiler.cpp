@@ -0,0 +1,54 @@
+// Offline racing line compiler.
+// Reads the AI_Waypoints (with their racing_line and speed_zone hints) and the
+// wall chains of each track, optimizes the racing line and its speed profile
+// (see Source/RacingLine.h) and writes it as a .line file next to the .tmx.
+// Reports, per track:
+//  - line length and number of samples
+//  - estimated lap time on the speed profile, against driving the waypoint
+//    polygon at the old fixed AI speed
+//  - the smallest clearance between the line and a wall
+//
+// Usage: RacingLineCompiler track.tmx [track.tmx ...]
+
+#include "../Source/RacingLine.h"
+
+#include <stdio.h>
+
+#define PIXELS_PER_METER 50.0f	// same scale as ModulePhysics.h
+#define OLD_AI_SPEED 9.0f		// speed limit of the reactive AI
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s track.tmx [track.tmx ...]\n", argv[0]);
+		return 1;
+	}
+
+	int failed = 0;
+	printf("%-32s %8s %8s %10s %10s %10s\n", "track", "samples", "length", "lap (s)", "old (s)", "clear (m)");
+
+	for (int i = 1; i < argc; ++i)
+	{
+		RacingLine line;
+		if (!line.Compile(argv[i], PIXELS_PER_METER))
+		{
+			printf("%-32s could not be compiled\n", argv[i]);
+			failed++;
+			continue;
+		}
+
+		std::string out_path = RacingLine::GetLinePath(argv[i]);
+		if (!line.Save(out_path.c_str()))
+		{
+			printf("%-32s could not write %s\n", argv[i], out_path.c_str());
+			failed++;
+			continue;
+		}
+
+		printf("%-32s %8d %8.1f %10.1f %10.1f %10.2f\n", argv[i], line.GetCount(), line.GetLength(), line.GetLapTime(),
+			line.GetWaypointLength() / OLD_AI_SPEED, line.GetMinClearance());
+	}
+
+	return failed;
+}
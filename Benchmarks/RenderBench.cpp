@@ -0,0 +1,221 @@
+// Render benchmark.
+// Draws the race frame the way the game does, through ModuleRender: the
+// background streamed by TiledBackground (the whole image when the track has
+// no .bgt, like ModuleGame::LoadBackground), the tiles under the view submitted
+// to the TRACK layer, N cars from the atlas on the VEHICLES layer and a HUD
+// line, then PostUpdate sorts and flushes the batch. The camera travels along
+// the waypoints and the cars turn around it, so every car is on screen. Every
+// frame ends with glFinish, so the time is what the GPU took too and not only
+// the batching on the CPU.
+//
+// Needs a GL context, build it where raylib is installed. Run from the
+// folder that has Assets, like the game.
+//
+// Usage: RenderBench [track.tmx] [--background file.png] [--cars 0,20,80] [--frames 300] [--zoom 1]
+//        [--runs 10] [--warmup 2] [--out report.json]
+
+#include "BenchReport.h"
+
+#include "../Source/Application.h"
+#include "../Source/ModulePhysics.h"
+#include "../Source/ModuleRender.h"
+#include "../Source/TiledBackground.h"
+#include "../Source/TrackMap.h"
+
+#include "raylib.h"
+
+#include <cmath>
+
+#if defined(_WIN32)
+#define BENCH_GL_API __stdcall
+#else
+#define BENCH_GL_API
+#endif
+extern "C" void BENCH_GL_API glFinish(void);
+
+#define MAP_WIDTH 60		// ModuleGame::LoadMap
+#define MAP_HEIGHT 50
+#define TILE_SIZE 128
+#define TILE_COLUMNS 18
+#define CAR_TEXTURES 8
+#define FRAME_TIME (1.0f / 60.0f)	// for the velocity the background prefetches with
+
+// The modules reach the renderer through it, Main.cpp is not linked
+Application* App = nullptr;
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseBenchOptions(argc, argv, options))
+	{
+		printf("Usage: %s [track.tmx] [--background file.png] [--cars 0,20,80] [--frames 300] [--zoom 1] [--runs 10] [--warmup 2] [--out report.json]\n", argv[0]);
+		return 1;
+	}
+
+	std::string map_path = options.args.empty() ? "Assets/Map/RaceTrack.tmx" : options.args[0];
+	const char* background_path = options.GetValue("background");
+	if (background_path == nullptr) background_path = "Assets/Map/background1.png";
+	std::vector<int> car_counts = options.GetIntList("cars", "0,20,80");
+	int frames = std::max(1, options.GetInt("frames", 300));
+	const char* zoom_value = options.GetValue("zoom");
+	float zoom = zoom_value != nullptr ? (float)atof(zoom_value) : 1.0f;
+
+	std::vector<int> tiles;
+	std::vector<b2Vec2> spawn_points;
+	std::vector<Waypoint> waypoints;
+	if (!ReadMapTiles(map_path.c_str(), tiles) || !ReadMapObjects(map_path.c_str(), METERS_PER_PIXEL, spawn_points, waypoints) || waypoints.empty())
+	{
+		fprintf(stderr, "Could not load %s\n", map_path.c_str());
+		return 1;
+	}
+	tiles.resize(MAP_WIDTH * MAP_HEIGHT, 0);
+
+	SetTraceLogLevel(LOG_WARNING);
+	SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "RenderBench");
+	if (!IsWindowReady())
+	{
+		fprintf(stderr, "Could not create a GL context\n");
+		return 1;
+	}
+
+	// Only the renderer is started, the other modules are never initialized
+	App = new Application();
+	ModuleRender* renderer = App->renderer;
+	renderer->Init();
+	renderer->SetCameraZoom(zoom);
+
+	TiledBackground background;
+	Texture2D background_image = { 0 };
+	if (!background.Open(TiledBackground::GetTilesPath(background_path).c_str()))
+	{
+		fprintf(stderr, "No background tiles for %s, drawing the whole image\n", background_path);
+		background_image = LoadTexture(background_path);
+	}
+
+	Texture2D tile_set = LoadTexture("Assets/Map/spritesheet_tiles.png");
+	std::vector<AtlasSprite> cars;
+	for (int i = 1; i <= CAR_TEXTURES; ++i)
+	{
+		AtlasSprite sprite = renderer->atlas.Get(TextFormat("Assets/Textures/Cars/car%d.png", i));
+		if (sprite.IsValid()) cars.push_back(sprite);
+	}
+	if (tile_set.id == 0 || cars.empty())
+	{
+		fprintf(stderr, "Could not load the textures, run it from the folder that has Assets\n");
+		renderer->CleanUp();
+		CloseWindow();
+		return 1;
+	}
+
+	BenchReport report("RenderBench", options);
+	for (int car_count : car_counts)
+	{
+		double sprites = 0.0;
+		double draw_calls = 0.0;
+		double submitted_draw_calls = 0.0;
+		double culled = 0.0;
+		int resident_tiles = 0;
+		BenchSamples samples = report.Sample([&](BenchSamples& run)
+		{
+			double frame_ms = 0.0;
+			double worst_ms = 0.0;
+			sprites = draw_calls = submitted_draw_calls = culled = 0.0;
+			Vector2 last_center = { 0.0f, 0.0f };
+			for (int f = 0; f < frames; ++f)
+			{
+				// Camera on the waypoints in turn, like following a car
+				float t = (float)f / frames * waypoints.size();
+				const Waypoint& from = waypoints[(size_t)t % waypoints.size()];
+				const Waypoint& to = waypoints[((size_t)t + 1) % waypoints.size()];
+				float blend = t - floorf(t);
+				Vector2 center = { (from.position.x + (to.position.x - from.position.x) * blend) / METERS_PER_PIXEL,
+					(from.position.y + (to.position.y - from.position.y) * blend) / METERS_PER_PIXEL };
+				Vector2 velocity = { 0.0f, 0.0f };
+				if (f > 0) velocity = { (center.x - last_center.x) / FRAME_TIME, (center.y - last_center.y) / FRAME_TIME };
+				last_center = center;
+				renderer->CenterCameraOn(center.x, center.y);
+
+				BenchClock::time_point start = BenchClock::now();
+				renderer->PreUpdate();
+
+				// ModuleGame::Update
+				if (background.IsOpen())
+				{
+					background.Update(renderer->GetViewRect(), velocity, renderer->GetCamera().zoom);
+					background.Draw();
+				}
+				else if (background_image.id != 0)
+				{
+					Rectangle source = { 0, 0, (float)background_image.width, (float)background_image.height };
+					renderer->DrawSprite(RenderLayer::BACKGROUND, background_image, source, source);
+				}
+
+				Rectangle view = renderer->GetViewRect();
+				int first_x = std::max(0, (int)floorf(view.x / TILE_SIZE) - 1);
+				int first_y = std::max(0, (int)floorf(view.y / TILE_SIZE) - 1);
+				int last_x = std::min(MAP_WIDTH - 1, (int)floorf((view.x + view.width) / TILE_SIZE) + 1);
+				int last_y = std::min(MAP_HEIGHT - 1, (int)floorf((view.y + view.height) / TILE_SIZE) + 1);
+				for (int y = first_y; y <= last_y; ++y)
+				{
+					for (int x = first_x; x <= last_x; ++x)
+					{
+						int id = tiles[y * MAP_WIDTH + x];
+						if (id <= 0) continue;
+
+						int gid = id - 1;
+						Rectangle source = { (float)(gid % TILE_COLUMNS) * TILE_SIZE, (float)(gid / TILE_COLUMNS) * TILE_SIZE, (float)TILE_SIZE, (float)TILE_SIZE };
+						renderer->Draw(tile_set, x * TILE_SIZE, y * TILE_SIZE, &source, 0, 0, 0, WHITE, RenderLayer::TRACK);
+					}
+				}
+
+				for (int i = 0; i < car_count; ++i)
+				{
+					const AtlasSprite& sprite = cars[i % cars.size()];
+					float angle = (float)i / std::max(1, car_count) * 2.0f * PI + f * 0.01f;
+					float radius = 80.0f + 25.0f * (i % 10);
+					renderer->Draw(sprite.texture, (int)(center.x + cosf(angle) * radius), (int)(center.y + sinf(angle) * radius), &sprite.source,
+						angle * RAD2DEG, sprite.GetWidth() / 2, sprite.GetHeight() / 2);
+				}
+
+				renderer->DrawDeferred(RenderLayer::HUD, []() { DrawText("Lap 1/3", 20, 20, 30, WHITE); });
+				renderer->PostUpdate();
+				glFinish();
+
+				double ms = BenchMs(start, BenchClock::now());
+				frame_ms += ms;
+				worst_ms = std::max(worst_ms, ms);
+
+				const RenderStats& stats = renderer->GetStats();
+				sprites += stats.sprites;
+				draw_calls += stats.draw_calls;
+				submitted_draw_calls += stats.submitted_draw_calls;
+				culled += stats.culled;
+			}
+			resident_tiles = background.GetResidentCount();
+			run.Add("frame_ms", "ms", frame_ms / frames);
+			run.Add("worst_frame_ms", "ms", worst_ms);
+		});
+
+		report.AddCase(std::to_string(car_count) + " cars")
+			.Param("track", map_path)
+			.Param("cars", car_count)
+			.Param("zoom", zoom)
+			.Param("frames", frames)
+			.Param("sprites_per_frame", sprites / frames)
+			.Param("draw_calls_per_frame", draw_calls / frames)
+			.Param("unsorted_draw_calls_per_frame", submitted_draw_calls / frames)
+			.Param("culled_per_frame", culled / frames)
+			.Param("background_tiles_resident", resident_tiles)
+			.Metrics(samples);
+	}
+
+	background.Close();
+	if (background_image.id != 0) UnloadTexture(background_image);
+	UnloadTexture(tile_set);
+	renderer->CleanUp();
+	CloseWindow();
+	delete App;
+
+	return report.Write() ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// Headless replay of a recorded race (F5 in game, race_<seed>.rrec).
+// Rebuilds the world as it stood at the green light and runs every frame the
+// way the game does: the physics steps the frame had, then the AI think with
+// the deterministic perception schedule, then the player buttons through the
+// same nitro and control mapping. Prints the state hash and time of every
+// frame and the first one that differs from the recorded hashes.
+// Running it more than once checks that the replay itself is deterministic and
+// gives the best time of the runs, to use the race as a benchmark.
+//
+// Usage: ReplayRunner race.rrec [runs] [track.tmx]
+//   track.tmx overrides the recorded map path, for the racing line
+
+#include "../Source/AIVehicle.h"
+#include "../Source/PerceptionScheduler.h"
+#include "../Source/PlayerInput.h"
+#include "../Source/RaceRecording.h"
+#include "../Source/RacingLine.h"
+#include "../Source/VehicleGrid.h"
+#include "../Source/VehicleSystem.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#define PIXELS_PER_METER 50.0f	// same scale as ModulePhysics.h
+
+typedef std::chrono::steady_clock Clock;
+
+struct ReplayResult
+{
+	std::vector<uint32_t> hashes;
+	int first_mismatch = -1;
+	double physics_ms = 0.0;
+	double ai_ms = 0.0;
+	double total_ms = 0.0;
+	int steps = 0;
+};
+
+static double Ms(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static ReplayResult Replay(const RaceRecording& recording, const RacingLine& line, bool print)
+{
+	ReplayResult result;
+
+	std::vector<b2Body*> bodies;
+	b2World* world = recording.CreateWorld(bodies);
+
+	VehicleSystem vehicles;
+	VehicleGrid grid;
+	std::vector<int> ids;
+	recording.CreateVehicles(vehicles, bodies, ids);
+
+	std::vector<AIVehicle> ai(recording.ai.size());
+	for (size_t i = 0; i < ai.size(); ++i)
+	{
+		int id = ids[recording.ai[i].vehicle_id];
+		ai[i].Attach(&vehicles, id, vehicles.GetBody(id), recording.ai_params, recording.ai[i].state);
+	}
+	int player_id = ids[recording.player_vehicle_id];
+	NitroState nitro = recording.player_nitro;
+
+	PerceptionScheduler perception;
+	perception.deterministic = true;
+
+	AISenseContext context;
+	context.waypoints = &recording.waypoints;
+	context.racing_line = line.IsValid() ? &line : nullptr;
+	context.grid = &grid;
+
+	vehicles.Gather();
+	grid.Build(vehicles);
+
+	if (print) printf("%6s %5s %7s %10s %10s %9s\n", "frame", "steps", "buttons", "hash", "recorded", "time (us)");
+
+	Clock::time_point race_start = Clock::now();
+	for (size_t f = 0; f < recording.frames.size(); ++f)
+	{
+		const RecordedFrame& frame = recording.frames[f];
+		Clock::time_point frame_start = Clock::now();
+
+		// ModulePhysics::PreUpdate, the first frame starts from the captured state
+		if (f > 0)
+		{
+			if (frame.steps > 0)
+			{
+				for (int s = 0; s < frame.steps; ++s)
+				{
+					vehicles.Apply(recording.fixed_step);
+					world->Step(recording.fixed_step, 8, 3);
+				}
+				world->ClearForces();
+			}
+			vehicles.Gather();
+			grid.Build(vehicles);
+			result.steps += frame.steps;
+		}
+		uint32_t hash = vehicles.Hash();
+		result.hashes.push_back(hash);
+		if (hash != frame.hash && result.first_mismatch < 0) result.first_mismatch = (int)f;
+		Clock::time_point physics_end = Clock::now();
+
+		// ModuleGame::UpdateAi, serial here, every car only writes its own state
+		context.dt = frame.dt;
+		perception.Schedule(ai, grid, b2Vec2_zero, frame.dt);
+		for (AIVehicle& car : ai) car.Think(context);
+		perception.EndFrame(ai);
+		for (AIVehicle& car : ai) car.Act();
+
+		// ModulePlayer::Update, the menu holds the car still and reads no buttons
+		if (frame.buttons & RECORDED_PLAYER_HELD)
+		{
+			vehicles.SetControls(player_id, VehicleControls());
+			b2Body* body = vehicles.GetBody(player_id);
+			body->SetLinearVelocity(b2Vec2(0, 0));
+			body->SetAngularVelocity(0);
+		}
+		else
+		{
+			nitro.Update(frame.dt, (frame.buttons & INPUT_NITRO) != 0);
+			vehicles.SetControls(player_id, PlayerControls(frame.buttons, vehicles.GetSpeed(player_id), vehicles.GetForwardSpeed(player_id), nitro.active));
+		}
+		Clock::time_point frame_end = Clock::now();
+
+		result.physics_ms += Ms(frame_start, physics_end);
+		result.ai_ms += Ms(physics_end, frame_end);
+
+		if (print)
+		{
+			printf("%6d %5d    0x%02x   %08x   %08x %9.1f%s\n", (int)f, frame.steps, frame.buttons, hash, frame.hash,
+				Ms(frame_start, frame_end) * 1000.0, hash != frame.hash ? "  *" : "");
+		}
+	}
+	result.total_ms = Ms(race_start, Clock::now());
+
+	delete world;
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s race.rrec [runs] [track.tmx]\n", argv[0]);
+		return 1;
+	}
+
+	int runs = argc > 2 ? atoi(argv[2]) : 1;
+	if (runs < 1) runs = 1;
+
+	RaceRecording recording;
+	if (!recording.Load(argv[1]))
+	{
+		printf("Could not load %s\n", argv[1]);
+		return 1;
+	}
+
+	// The game loads the compiled line next to the map and compiles it when missing
+	std::string map_path = argc > 3 ? argv[3] : recording.map_path;
+	RacingLine line;
+	if (!line.Load(RacingLine::GetLinePath(map_path.c_str()).c_str())) line.Compile(map_path.c_str(), PIXELS_PER_METER);
+
+	printf("%s: seed %llu, %s, %d frames, %d AI cars, racing line %s\n", argv[1], (unsigned long long)recording.seed, recording.map_path.c_str(),
+		(int)recording.frames.size(), (int)recording.ai.size(), line.IsValid() ? "yes" : "no");
+
+	ReplayResult first = Replay(recording, line, true);
+	double best_ms = first.total_ms;
+	int diverged_runs = 0;
+	for (int r = 1; r < runs; ++r)
+	{
+		ReplayResult run = Replay(recording, line, false);
+		if (run.hashes != first.hashes) diverged_runs++;
+		if (run.total_ms < best_ms) best_ms = run.total_ms;
+	}
+
+	int frames = (int)first.hashes.size();
+	printf("\n%d frames, %d steps: %.2f ms (physics %.2f, AI + player %.2f), %.1f us per frame\n", frames, first.steps,
+		first.total_ms, first.physics_ms, first.ai_ms, frames > 0 ? first.total_ms * 1000.0 / frames : 0.0);
+	if (runs > 1) printf("Best of %d runs: %.2f ms, %d runs differ from the first\n", runs, best_ms, diverged_runs);
+
+	if (first.first_mismatch < 0) printf("Every frame matches the recording\n");
+	else printf("First frame that differs from the recording: %d of %d\n", first.first_mismatch, frames);
+
+	return diverged_runs > 0 ? 2 : 0;
+}
@@ -0,0 +1,215 @@
+// Soft step benchmark for the Box2D island solver.
+// Steps the pile-up scene (see PileUpScene.h) with the iterative solver and with
+// the sub-stepped soft solver and reports, per mode:
+//  - solver time (velocity + position phases of the profile)
+//  - penetration: worst and average contact overlap over the last half of the run
+// Jitter is measured apart, on a box pyramid resting on the ground under gravity
+// with no other force and sleeping off, so anything that moves is the solver:
+//  - speed: mean body speed over the last half of the run
+//  - drift: worst and average distance a body moved over the last half of the run
+//
+// Usage: SoftStepBench [cars] [steps] [pyramid base]
+
+#include "PileUpScene.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+struct SoftMode
+{
+	const char* name;
+	int velocity_iterations;
+	int position_iterations;
+	int sub_steps;
+};
+
+struct SoftResult
+{
+	float solve_ms;
+	float max_penetration;
+	float avg_penetration;
+	float avg_speed;
+	float max_drift;
+	float avg_drift;
+};
+
+// Box2D testbed pyramid, base boxes on the bottom row
+static b2World* CreateRestingStack(int base)
+{
+	b2World* world = new b2World(b2Vec2(0.0f, -10.0f));
+	world->SetAllowSleeping(false);
+
+	b2BodyDef ground_def;
+	b2Body* ground = world->CreateBody(&ground_def);
+	b2EdgeShape edge;
+	edge.SetTwoSided(b2Vec2(-60.0f, 0.0f), b2Vec2(60.0f, 0.0f));
+	ground->CreateFixture(&edge, 0.0f);
+
+	const float half = 0.5f;
+	b2PolygonShape box;
+	box.SetAsBox(half, half);
+
+	b2Vec2 row_start(-base * half, half);
+	for (int row = 0; row < base; ++row)
+	{
+		b2Vec2 position = row_start;
+		for (int i = row; i < base; ++i)
+		{
+			b2BodyDef def;
+			def.type = b2_dynamicBody;
+			def.position = position;
+			b2Body* body = world->CreateBody(&def);
+			body->CreateFixture(&box, 5.0f);
+			position.x += 2.0f * half;
+		}
+		row_start += b2Vec2(half, 2.0f * half);
+	}
+
+	return world;
+}
+
+static void MeasureJitter(const SoftMode& mode, int base, int steps, SoftResult& result)
+{
+	b2World* world = CreateRestingStack(base);
+	world->SetSoftStepCount(mode.sub_steps);
+
+	const float dt = 1.0f / 60.0f;
+	const int settle = steps / 2;
+
+	std::vector<b2Vec2> rest;
+	double speed_sum = 0.0;
+	int speed_samples = 0;
+
+	for (int i = 0; i < steps; ++i)
+	{
+		world->Step(dt, mode.velocity_iterations, mode.position_iterations);
+
+		if (i < settle)
+		{
+			continue;
+		}
+
+		for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+		{
+			if (body->GetType() != b2_dynamicBody)
+			{
+				continue;
+			}
+
+			if (i == settle)
+			{
+				rest.push_back(body->GetPosition());
+			}
+			speed_sum += body->GetLinearVelocity().Length();
+			++speed_samples;
+		}
+	}
+
+	double drift_sum = 0.0;
+	size_t index = 0;
+	for (b2Body* body = world->GetBodyList(); body && index < rest.size(); body = body->GetNext())
+	{
+		if (body->GetType() != b2_dynamicBody)
+		{
+			continue;
+		}
+
+		float drift = b2Distance(body->GetPosition(), rest[index++]);
+		if (drift > result.max_drift)
+		{
+			result.max_drift = drift;
+		}
+		drift_sum += drift;
+	}
+
+	result.avg_speed = speed_samples > 0 ? (float)(speed_sum / speed_samples) : 0.0f;
+	result.avg_drift = index > 0 ? (float)(drift_sum / index) : 0.0f;
+
+	delete world;
+}
+
+static SoftResult RunMode(const SoftMode& mode, int cars, int base, int steps)
+{
+	b2World* world = CreatePileUp(cars);
+	world->SetSoftStepCount(mode.sub_steps);
+
+	SoftResult result = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	const float dt = 1.0f / 60.0f;
+	const int settle = steps / 2;
+
+	double penetration_sum = 0.0;
+	int penetration_samples = 0;
+
+	for (int i = 0; i < steps; ++i)
+	{
+		PushPileUp(world);
+		world->Step(dt, mode.velocity_iterations, mode.position_iterations);
+
+		const b2Profile& profile = world->GetProfile();
+		result.solve_ms += profile.solveVelocity + profile.solvePosition;
+
+		if (i < settle)
+		{
+			continue;
+		}
+
+		for (b2Contact* contact = world->GetContactList(); contact; contact = contact->GetNext())
+		{
+			if (contact->IsTouching() == false)
+			{
+				continue;
+			}
+
+			b2WorldManifold manifold;
+			contact->GetWorldManifold(&manifold);
+
+			int points = contact->GetManifold()->pointCount;
+			for (int j = 0; j < points; ++j)
+			{
+				float depth = -manifold.separations[j];
+				if (depth > result.max_penetration)
+				{
+					result.max_penetration = depth;
+				}
+				penetration_sum += depth > 0.0f ? depth : 0.0f;
+				++penetration_samples;
+			}
+		}
+	}
+
+	result.avg_penetration = penetration_samples > 0 ? (float)(penetration_sum / penetration_samples) : 0.0f;
+	delete world;
+
+	MeasureJitter(mode, base, steps, result);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int cars = argc > 1 ? atoi(argv[1]) : 200;
+	int steps = argc > 2 ? atoi(argv[2]) : 600;
+	int base = argc > 3 ? atoi(argv[3]) : 20;
+
+	SoftMode modes[] = {
+		{ "iterative 8/3", 8, 3, 0 },
+		{ "iterative 4/2", 4, 2, 0 },
+		{ "soft 2 sub-steps", 1, 3, 2 },
+		{ "soft 4 sub-steps", 1, 3, 4 },
+		{ "soft 8 sub-steps", 1, 3, 8 },
+	};
+
+	printf("pile-up: %d cars, resting pyramid: %d boxes, %d steps (stats over the last %d)\n", cars, base * (base + 1) / 2, steps,
+		steps - steps / 2);
+	printf("%-20s %10s %12s %12s %12s %12s %12s\n", "mode", "solve ms", "max pen m", "avg pen m", "speed m/s", "max drift m",
+		"avg drift m");
+
+	for (int i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); ++i)
+	{
+		SoftResult result = RunMode(modes[i], cars, base, steps);
+		printf("%-20s %10.2f %12.4f %12.4f %12.5f %12.5f %12.5f\n", modes[i].name, result.solve_ms, result.max_penetration,
+			result.avg_penetration, result.avg_speed, result.max_drift, result.avg_drift);
+	}
+
+	return 0;
+}
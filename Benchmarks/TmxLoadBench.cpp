@@ -0,0 +1,86 @@
+// Track load benchmark.
+// Times what ModuleGame::StartGame reads from disk for every given track, with
+// the same TrackMap code: the tile layer, the collision polygons, the spawn
+// points and waypoints, the compiled racing line next to the map, and the
+// wall chains built from the polygons. The files come from the OS cache after
+// the warmup runs, so this measures the parsing, not the disk.
+//
+// Usage: TmxLoadBench track.tmx... [--runs 10] [--warmup 2] [--out report.json]
+
+#include "BenchReport.h"
+
+#include "../Source/AIVehicle.h"
+#include "../Source/RacingLine.h"
+#include "../Source/TrackMap.h"
+
+#define METERS_PER_PIXEL 0.02f	// same scale as ModulePhysics.h
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseBenchOptions(argc, argv, options) || options.args.empty())
+	{
+		printf("Usage: %s track.tmx... [--runs 10] [--warmup 2] [--out report.json]\n", argv[0]);
+		return 1;
+	}
+
+	BenchReport report("TmxLoadBench", options);
+	for (const std::string& path : options.args)
+	{
+		const char* map_path = path.c_str();
+		std::string line_path = RacingLine::GetLinePath(map_path);
+
+		size_t tile_count = 0;
+		size_t wall_count = 0;
+		size_t waypoint_count = 0;
+		bool loaded = true;
+		BenchSamples samples = report.Sample([&](BenchSamples& run)
+		{
+			std::vector<int> tiles;
+			std::vector<CollisionObject> walls;
+			std::vector<b2Vec2> spawn_points;
+			std::vector<Waypoint> waypoints;
+			RacingLine line;
+			std::vector<int> chain;
+
+			BenchClock::time_point start = BenchClock::now();
+			loaded &= ReadMapTiles(map_path, tiles);
+			BenchClock::time_point tiles_end = BenchClock::now();
+			loaded &= ReadMapCollisions(map_path, walls);
+			BenchClock::time_point walls_end = BenchClock::now();
+			loaded &= ReadMapObjects(map_path, METERS_PER_PIXEL, spawn_points, waypoints);
+			BenchClock::time_point objects_end = BenchClock::now();
+			loaded &= line.Load(line_path.c_str());
+			BenchClock::time_point line_end = BenchClock::now();
+			for (const CollisionObject& wall : walls) GetCollisionChain(wall, chain);
+			BenchClock::time_point end = BenchClock::now();
+
+			run.Add("total_ms", "ms", BenchMs(start, end));
+			run.Add("tiles_ms", "ms", BenchMs(start, tiles_end));
+			run.Add("collisions_ms", "ms", BenchMs(tiles_end, walls_end));
+			run.Add("objects_ms", "ms", BenchMs(walls_end, objects_end));
+			run.Add("racing_line_ms", "ms", BenchMs(objects_end, line_end));
+			run.Add("chains_ms", "ms", BenchMs(line_end, end));
+
+			tile_count = tiles.size();
+			wall_count = walls.size();
+			waypoint_count = waypoints.size();
+		});
+
+		if (!loaded)
+		{
+			fprintf(stderr, "Could not load %s or its racing line %s\n", map_path, line_path.c_str());
+			return 1;
+		}
+
+		std::string name = path.substr(path.find_last_of("/\\") + 1);
+		report.AddCase(name)
+			.Param("path", path)
+			.Param("tiles", (double)tile_count)
+			.Param("walls", (double)wall_count)
+			.Param("waypoints", (double)waypoint_count)
+			.Metrics(samples);
+	}
+
+	return report.Write() ? 0 : 1;
+}
@@ -1,11 +1,9 @@
 #include "AIVehicle.h"
-#include "Application.h"
-#include "ModuleRender.h"
-#include "ModuleGame.h"
 #include "ModulePhysics.h" 
-#include "Player.h" 
 #include <cmath>
 #include <algorithm>
+#include <cfloat>
+#include <chrono>
 
 // Raycast callback that ignores sensors and the car itself
 class RayCastCallback : public b2RayCastCallback {
@@ -17,7 +15,7 @@ public:
 
     RayCastCallback(b2Body* self) : hit(false), fraction(1.0f), isDynamic(false), selfBody(self) {}
 
-    float ReportFixture(b2Fixture* fixture, const b2Vec2& point, const b2Vec2& normal, float fraction) override {
+    float ReportFixture(b2Fixture* fixture, const b2Vec2& /*point*/, const b2Vec2& /*normal*/, float fraction) override {
         // Ignore sensors and our own collider
         if (fixture->IsSensor() || fixture->GetBody() == selfBody) return -1.0f;
 
@@ -30,36 +28,138 @@ public:
     }
 };
 
-AIVehicle::AIVehicle() : body(nullptr), active(false), current_waypoint_id(-1),
-is_maneuvering(false), maneuver_timer(0), turn_direction(0),
-width(0), height(0), sensor_length(3.0f),
+// AABB query callback that looks for anything a car shape would touch, with
+// the car's own collision filter
+class OverlapCallback : public b2QueryCallback {
+public:
+    bool overlap;
+    const b2Fixture* self;
+    b2Filter filter;
+    b2Transform transform;
+
+    OverlapCallback(const b2Fixture* self_fixture, const b2Filter& self_filter, const b2Transform& xf)
+        : overlap(false), self(self_fixture), filter(self_filter), transform(xf) {}
+
+    bool ReportFixture(b2Fixture* fixture) override {
+        if (fixture->IsSensor() || fixture->GetBody() == self->GetBody()) return true;
+
+        const b2Filter& other = fixture->GetFilterData();
+        if ((filter.maskBits & other.categoryBits) == 0 || (other.maskBits & filter.categoryBits) == 0) return true;
+
+        // Chains, the walls, are one child per segment
+        const b2Shape* shape = fixture->GetShape();
+        for (int child = 0; child < shape->GetChildCount() && !overlap; ++child) {
+            overlap = b2TestOverlap(self->GetShape(), 0, shape, child, transform, fixture->GetBody()->GetTransform());
+        }
+        return !overlap;
+    }
+};
+
+AIVehicle::AIVehicle() : body(nullptr), vehicles(nullptr), vehicle_id(-1), active(false), current_waypoint_id(-1),
+behavior_mode(0), laps(1), sprite(), width(0), height(0), sensor_length(3.0f),
 wall_detected_center(false), wall_detected_left(false), wall_detected_right(false),
 is_car_center(false), is_car_left(false), is_car_right(false),
-dist_fraction_center(1.0f), waypoint_timer(0.0f),
-waypoint_offset(0, 0), currentTarget(0, 0), texture({ 0 }), drive_time(0.0f), behavior_mode(0), laps(1) {
+dist_fraction_center(1.0f), is_maneuvering(false), maneuver_timer(0), turn_direction(0), stuck_timer(0.0f),
+waypoint_timer(0.0f), waypoint_offset(0, 0), currentTarget(0, 0), drive_time(0.0f),
+target_valid(false), line_index(-1), lod(false), lod_speed(0.0f), lod_mask_bits(0xFFFF) {
 }
 
 AIVehicle::~AIVehicle() {}
 
-void AIVehicle::Init(b2World* world, b2Vec2 position, Texture2D tex, int start_waypoint_id, float rotation_degrees) {
-    texture = tex;
-    width = (float)texture.width;
-    height = (float)texture.height;
+AIVehicleState AIVehicle::SaveState() const {
+    AIVehicleState state;
+    state.active = active;
+    state.current_waypoint_id = current_waypoint_id;
+    state.behavior_mode = behavior_mode;
+    state.laps = laps;
+    state.is_maneuvering = is_maneuvering;
+    state.maneuver_timer = maneuver_timer;
+    state.turn_direction = turn_direction;
+    state.stuck_timer = stuck_timer;
+    state.waypoint_timer = waypoint_timer;
+    state.waypoint_offset = waypoint_offset;
+    state.currentTarget = currentTarget;
+    state.drive_time = drive_time;
+    state.lod = lod;
+    state.lod_speed = lod_speed;
+    state.random = random;
+    return state;
+}
+
+void AIVehicle::RestoreState(const AIVehicleState& state) {
+    active = state.active;
+    current_waypoint_id = state.current_waypoint_id;
+    behavior_mode = state.behavior_mode;
+    laps = state.laps;
+    is_maneuvering = state.is_maneuvering;
+    maneuver_timer = state.maneuver_timer;
+    turn_direction = state.turn_direction;
+    stuck_timer = state.stuck_timer;
+    waypoint_timer = state.waypoint_timer;
+    waypoint_offset = state.waypoint_offset;
+    currentTarget = state.currentTarget;
+    drive_time = state.drive_time;
+    target_valid = false;
+    line_index = -1;
+    perception = AIPerception();
+    // Sensors of the last sense are reused by the frames that skip it
+    wall_detected_center = wall_detected_left = wall_detected_right = false;
+    is_car_center = is_car_left = is_car_right = false;
+    dist_fraction_center = 1.0f;
+    SwitchLod(state.lod);
+    lod_speed = state.lod_speed;
+    random = state.random;
+}
+
+void AIVehicle::Attach(VehicleSystem* vehicle_system, int id, b2Body* car_body, const AIParams& ai_params, const AIVehicleState& state) {
+    params = ai_params;
+    sensor_length = params.sensor_length;
+    vehicles = vehicle_system;
+    vehicle_id = id;
+    body = car_body;
+    RestoreState(state);
+}
+
+VehicleTuning AIVehicle::DefaultTuning(const AIParams& params) {
+    VehicleTuning tuning;
+    tuning.engine_accel = params.acceleration;
+    tuning.max_speed_forward = 12.0f;
+    tuning.max_speed_reverse = 5.0f;
+    tuning.turn_speed = 5.0f;
+    tuning.steer_full_speed = 5.0f; // Smooth turning, full rate from 5 m/s
+    tuning.steer_release = 60.0f; // Firm, but two cars side by side can still slide apart
+    tuning.lateral_grip = 60.0f;
+    return tuning;
+}
+
+void AIVehicle::Init(b2World* world, VehicleSystem* vehicle_system, int tuning_profile, const AIParams& ai_params, const RandomStream& random_stream,
+    b2Vec2 position, const AtlasSprite& car_sprite, int start_waypoint_id, float rotation_degrees) {
+    params = ai_params;
+    sensor_length = params.sensor_length;
+    sprite = car_sprite;
+    vehicles = vehicle_system;
+    width = (float)sprite.GetWidth();
+    height = (float)sprite.GetHeight();
     current_waypoint_id = start_waypoint_id;
     active = true;
     is_maneuvering = false;
+    stuck_timer = 0.0f;
     waypoint_timer = 0.0f;
     drive_time = 0.0f;
+    line_index = -1;
     laps = 1; // Reset laps
 
+    // Own stream, nothing is shared with cars thinking on other threads
+    random = random_stream;
+
     // Assign random personality
-    int rand_behavior = rand() % 100;
-    if (rand_behavior < 50) behavior_mode = 0; // Neutral
-    else if (rand_behavior < 80) behavior_mode = 1; // Aggressive
-    else behavior_mode = 2; // Fearful
+    float rand_behavior = random.Float();
+    if (rand_behavior < params.aggressive_chance) behavior_mode = 1; // Aggressive
+    else if (rand_behavior < params.aggressive_chance + params.fearful_chance) behavior_mode = 2; // Fearful
+    else behavior_mode = 0; // Neutral
 
-    float rx = ((rand() % 100) / 30.0f) - 1.5f;
-    float ry = ((rand() % 100) / 30.0f) - 1.5f;
+    float rx = (random.Range(100) / 30.0f) - 1.5f;
+    float ry = (random.Range(100) / 30.0f) - 1.5f;
     waypoint_offset.Set(rx, ry);
 
     b2BodyDef bodyDef;
@@ -81,6 +181,8 @@ void AIVehicle::Init(b2World* world, b2Vec2 position, Texture2D tex, int start_w
     fixtureDef.restitution = 0.1f;
 
     body->CreateFixture(&fixtureDef);
+
+    vehicle_id = vehicles->AddVehicle(body, tuning_profile);
 }
 
 void AIVehicle::RaycastSensors() {
@@ -122,30 +224,49 @@ void AIVehicle::RaycastSensors() {
     }
 }
 
-void AIVehicle::Update(float dt, const std::vector<Waypoint>& waypoints) {
+// Think only reads the world and writes this car's own state, so cars can
+// think in parallel. The command is applied by Act.
+void AIVehicle::Think(const AISenseContext& context) {
+    command = VehicleControls();
     if (!active || !body) return;
 
+    float dt = context.dt;
+    const std::vector<Waypoint>& waypoints = *context.waypoints;
+
     drive_time += dt;
-    RaycastSensors();
-    float mass = body->GetMass();
-    float speed = body->GetLinearVelocity().Length();
+
+    // Sensors only refresh when the perception scheduler says so, the last
+    // results are kept in between
+    if (perception.sense) {
+        std::chrono::steady_clock::time_point sense_start = std::chrono::steady_clock::now();
+        RaycastSensors();
+        target_valid = false;
+        perception.cost_us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - sense_start).count();
+    }
+    else {
+        perception.cost_us = 0.0f;
+    }
+
+    float speed = vehicles->GetSpeed(vehicle_id);
+    b2Vec2 position = vehicles->GetPosition(vehicle_id);
+
+    VehicleControls& controls = command;
 
     // Maneuver logic (unstuck)
     if (is_maneuvering) {
         maneuver_timer += dt;
 
-        b2Vec2 backward = body->GetWorldVector(b2Vec2(0.0f, 1.0f));
-        body->ApplyForceToCenter(4.0f * mass * backward, true);
-
+        // Reverse at 4 m/s2 while turning
+        controls.throttle = -std::min(1.0f, 4.0f / params.acceleration);
         if (speed > 0.1f) {
-            body->SetAngularVelocity(2.0f * turn_direction);
+            controls.steer = 0.4f * turn_direction;
         }
 
         if (maneuver_timer > 1.2f) {
             is_maneuvering = false;
-            body->SetAngularVelocity(0);
-            b2Vec2 forward = body->GetWorldVector(b2Vec2(0.0f, -1.0f));
-            body->ApplyLinearImpulseToCenter(1.0f * mass * forward, true);
+            controls.throttle = 0.0f;
+            controls.steer = 0.0f;
+            controls.launch = 1.0f;
         }
         return;
     }
@@ -158,87 +279,61 @@ void AIVehicle::Update(float dt, const std::vector<Waypoint>& waypoints) {
         maneuver_timer = 0.0f;
         if (wall_detected_left) turn_direction = -1.0f;
         else if (wall_detected_right) turn_direction = 1.0f;
-        else turn_direction = (rand() % 2 == 0) ? 1.0f : -1.0f;
+        else turn_direction = (random.Range(2) == 0) ? 1.0f : -1.0f;
         return;
     }
 
-    // Waypoint search
-    b2Vec2 targetPos(0, 0);
-    bool found = false;
-    for (const auto& wp : waypoints) {
-        if (wp.id == current_waypoint_id) {
-            targetPos = wp.position + waypoint_offset;
-            currentTarget = targetPos;
-            found = true;
-            break;
-        }
-    }
-
-    if (!found) return;
-
-    waypoint_timer += dt;
-    float distToTarget = (targetPos - body->GetPosition()).Length();
-    bool reached = distToTarget < 8.0f;
-    bool stuckOnRoute = waypoint_timer > 5.0f;
-
-    if (reached || stuckOnRoute) {
-        for (const auto& wp : waypoints) {
-            if (wp.id == current_waypoint_id) {
-                if (!wp.next_ids.empty()) {
-                    int next = wp.next_ids[rand() % wp.next_ids.size()];
-
-                    if (next < current_waypoint_id && next < 3) {
-                        laps++;
-                    }
-
-                    current_waypoint_id = next;
-                    waypoint_timer = 0.0f;
-                    float rx = ((rand() % 100) / 30.0f) - 1.5f;
-                    float ry = ((rand() % 100) / 30.0f) - 1.5f;
-                    waypoint_offset.Set(rx, ry);
-                }
-                else {
-                    current_waypoint_id = 0;
-                    laps++; 
-                }
-                break;
-            }
-        }
-    }
-
-    b2Vec2 desiredDir = targetPos - body->GetPosition();
-    desiredDir.Normalize();
-
-    // Player interaction
-    b2Vec2 playerInteraction(0.0f, 0.0f);
+    // Interaction with the closest car around, player or AI
+    b2Vec2 carInteraction(0.0f, 0.0f);
     float interactionFactor = 0.0f;
 
-    if (App->player && App->player->vehicle && App->player->vehicle->body) {
-        b2Vec2 playerPos = App->player->vehicle->body->GetPosition();
-        b2Vec2 toPlayer = playerPos - body->GetPosition();
-        float distToPlayer = toPlayer.Length();
-
-        // If the player is close (less than 15 meters)
-        if (distToPlayer < 15.0f && drive_time > 3.0f) {
-            toPlayer.Normalize();
+    if (context.grid && behavior_mode != 0 && drive_time > 3.0f) {
+        // Only the nearest car matters
+        int nearby[1];
+        if (context.grid->Query(position, AI_INTERACTION_RADIUS, vehicle_id, nearby, 1) > 0) {
+            b2Vec2 toCar = vehicles->GetPosition(nearby[0]) - position;
+            toCar.Normalize();
 
             if (behavior_mode == 1) { // Agressive
-                // Try to crash: turn slightly towards the player
-                playerInteraction = toPlayer;
-                interactionFactor = 0.6f; // Aggression factor
+                // Try to crash: turn slightly towards the car
+                carInteraction = toCar;
+                interactionFactor = params.aggression;
             }
             else if (behavior_mode == 2) { // Fearul
-                // Try to avoid: turn away from the player
-                playerInteraction = -1.0f * toPlayer;
-                interactionFactor = 0.8f; // Panic factor
+                // Try to avoid: turn away from the car
+                carInteraction = -1.0f * toCar;
+                interactionFactor = params.panic;
             }
         }
     }
 
+    // Target from the racing line, or the waypoint search cached until the
+    // next sense or waypoint change
+    b2Vec2 targetPos = currentTarget;
+    float targetSpeed = 0.0f;
+    bool onLine = context.racing_line != nullptr;
+    if (context.racing_line) {
+        FollowLine(*context.racing_line, position, speed, interactionFactor * carInteraction, targetPos, targetSpeed);
+
+        // Pushed off the line, the car steers back to it at the cruise speed
+        onLine = b2DistanceSquared(position, context.racing_line->GetPoint(line_index)) <= params.line_off_distance * params.line_off_distance;
+    }
+    else {
+        if (!target_valid && !FindTarget(waypoints, targetPos)) return;
+        UpdateWaypoint(dt, waypoints, position, targetPos);
+    }
+
+    // The racing line keeps away from the walls, the sensors only steer when
+    // the car got pushed off it or a car alongside may push it into the wall
+    bool avoidWalls = !onLine || is_car_left || is_car_right;
+
+    b2Vec2 desiredDir = targetPos - position;
+    desiredDir.Normalize();
+
     b2Vec2 avoidDir(0.0f, 0.0f);
     float avoidFactor = 0.0f;
 
-    if (wall_detected_center) {
+    if (wall_detected_center && (avoidWalls || is_car_center)) {
         float multiplier = is_car_center ? 2.0f : 5.0f;
         avoidFactor += multiplier * (1.0f - dist_fraction_center);
 
@@ -260,11 +355,11 @@ void AIVehicle::Update(float dt, const std::vector<Waypoint>& waypoints) {
         }
     }
 
-    if (wall_detected_left && !is_car_left) {
+    if (avoidWalls && wall_detected_left && !is_car_left) {
         avoidFactor += 1.5f;
         avoidDir += body->GetWorldVector(b2Vec2(0.8f, 0.2f));
     }
-    if (wall_detected_right && !is_car_right) {
+    if (avoidWalls && wall_detected_right && !is_car_right) {
         avoidFactor += 1.5f;
         avoidDir += body->GetWorldVector(b2Vec2(-0.8f, 0.2f));
     }
@@ -272,9 +367,10 @@ void AIVehicle::Update(float dt, const std::vector<Waypoint>& waypoints) {
     // Combine: Desired direction + Wall Avoidance + Player Interaction
     b2Vec2 finalDir = desiredDir;
 
-    // Apply player influence
-    if (interactionFactor > 0.0f) {
-        finalDir = finalDir + (interactionFactor * playerInteraction);
+    // Apply the influence of the other car, with a racing line it only moved
+    // the car to one side of it
+    if (!context.racing_line && interactionFactor > 0.0f) {
+        finalDir = finalDir + (interactionFactor * carInteraction);
     }
 
     if (avoidFactor > 0.0f) {
@@ -285,109 +381,273 @@ void AIVehicle::Update(float dt, const std::vector<Waypoint>& waypoints) {
 
     // Smooth and realistic turning
     float desiredAngle = atan2f(finalDir.y, finalDir.x) + (b2_pi / 2.0f);
-    float currentAngle = body->GetAngle();
+    float currentAngle = vehicles->GetAngle(vehicle_id);
     float angleDiff = desiredAngle - currentAngle;
 
     while (angleDiff <= -b2_pi) angleDiff += 2 * b2_pi;
     while (angleDiff > b2_pi) angleDiff -= 2 * b2_pi;
 
-    float steerFactor = 0.0f;
-    if (speed > 0.5f) {
-        steerFactor = std::min(speed / 5.0f, 1.0f);
+    // Steering scales with speed in the vehicle system
+    if (fabs(angleDiff) >= 0.05f) {
+        controls.steer = std::max(-1.0f, std::min(1.0f, angleDiff));
     }
 
-    if (fabs(angleDiff) < 0.05f) {
-        body->SetAngularVelocity(0);
-    }
-    else {
-        float turnSpeed = 5.0f;
-        float clampedDiff = std::max(-1.0f, std::min(1.0f, angleDiff));
-        body->SetAngularVelocity(clampedDiff * turnSpeed * steerFactor);
+    // Pinned against a wall or a car at an angle the center sensor doesn't
+    // see as close: back off turning the nose to where the car wants to go
+    stuck_timer = drive_time > 4.0f && speed < 0.5f ? stuck_timer + dt : 0.0f;
+    if (stuck_timer > AI_STUCK_TIME) {
+        is_maneuvering = true;
+        maneuver_timer = 0.0f;
+        stuck_timer = 0.0f;
+        turn_direction = angleDiff > 0.0f ? 1.0f : -1.0f;
     }
 
     // Acceleration
-    float maxSpeed = 9.0f;
-    float acceleration = 6.0f;
+    float maxSpeed = onLine ? targetSpeed : params.cruise_speed;
+    controls.throttle = 1.0f;
 
     // Aggressive ones run a bit faster when chasing you
-    if (behavior_mode == 1 && interactionFactor > 0.0f) maxSpeed = 10.5f;
-
-    if (fabs(angleDiff) > 0.8f) acceleration *= 0.5f;
-    else if (wall_detected_center && !is_car_center && dist_fraction_center < 0.5f) {
-        acceleration *= 0.4f;
+    if (behavior_mode == 1 && interactionFactor > 0.0f) maxSpeed = onLine ? maxSpeed * params.chase_line_factor : params.chase_speed;
+    // The rest queue behind whoever is slower on the line
+    else if (onLine && context.grid) maxSpeed = std::min(maxSpeed, FollowSpeed(*context.grid, position));
+
+    if (onLine && speed > maxSpeed + 0.5f) {
+        // Braking zone of the speed profile
+        controls.throttle = 0.0f;
+        controls.brake = std::min(1.0f, (speed - maxSpeed) * 0.05f);
+    }
+    else if (fabs(angleDiff) > 0.8f) {
+        controls.throttle = 0.5f;
+        if (onLine) maxSpeed = std::min(maxSpeed, AI_LINE_TURN_SPEED);
+    }
+    else if (wall_detected_center && !is_car_center && avoidWalls && dist_fraction_center < 0.5f) {
+        controls.throttle = 0.4f;
         maxSpeed = 6.0f;
     }
+    controls.speed_limit = maxSpeed;
+}
 
-    if (speed < maxSpeed) {
-        b2Vec2 forward = body->GetWorldVector(b2Vec2(0.0f, -1.0f));
-        b2Vec2 force = forward;
-        force.x *= acceleration * mass;
-        force.y *= acceleration * mass;
-        body->ApplyForceToCenter(force, true);
+void AIVehicle::Act() {
+    // An inactive car gets the empty command of Think, controls last until replaced
+    if (!body) return;
+    vehicles->SetControls(vehicle_id, command);
+}
+
+bool AIVehicle::FindTarget(const std::vector<Waypoint>& waypoints, b2Vec2& target) {
+    for (const auto& wp : waypoints) {
+        if (wp.id == current_waypoint_id) {
+            target = wp.position + waypoint_offset;
+            currentTarget = target;
+            target_valid = true;
+            return true;
+        }
     }
+    target_valid = false;
+    return false;
+}
+
+// Shared by both physics modes so progress and laps don't depend on the LOD
+void AIVehicle::UpdateWaypoint(float dt, const std::vector<Waypoint>& waypoints, b2Vec2 position, b2Vec2 target) {
+    waypoint_timer += dt;
+    float distToTarget = (target - position).Length();
+    bool reached = distToTarget < params.waypoint_reach;
+    bool stuckOnRoute = waypoint_timer > 5.0f;
 
-    b2Vec2 rightNormal = body->GetWorldVector(b2Vec2(1.0f, 0.0f));
-    b2Vec2 vel = body->GetLinearVelocity();
-    float lateralSpeed = b2Dot(rightNormal, vel);
-    body->ApplyLinearImpulseToCenter(-1.0f * mass * lateralSpeed * rightNormal, true);
+    if (reached || stuckOnRoute) {
+        for (const auto& wp : waypoints) {
+            if (wp.id == current_waypoint_id) {
+                if (!wp.next_ids.empty()) {
+                    AdvanceWaypoint(wp.next_ids[random.Range((int)wp.next_ids.size())]);
+                    float rx = (random.Range(100) / 30.0f) - 1.5f;
+                    float ry = (random.Range(100) / 30.0f) - 1.5f;
+                    waypoint_offset.Set(rx, ry);
+                }
+                else {
+                    current_waypoint_id = 0;
+                    target_valid = false;
+                    laps++; 
+                }
+                break;
+            }
+        }
+    }
 }
 
-void AIVehicle::Draw(bool debug) {
-    if (!active || !body) return;
+void AIVehicle::AdvanceWaypoint(int next) {
+    if (next < current_waypoint_id && next < 3) {
+        laps++;
+    }
 
-    b2Vec2 pos = body->GetPosition();
-    float angle = body->GetAngle() * RAD_TO_DEG;
-
-    Rectangle source = { 0, 0, width, height };
-    float camX = App->renderer->camera_x;
-    float camY = App->renderer->camera_y;
-
-    Rectangle dest = { (float)METERS_TO_PIXELS(pos.x) + camX, (float)METERS_TO_PIXELS(pos.y) + camY, width, height };
-    Vector2 origin = { width / 2.0f, height / 2.0f };
-
-    Color color = WHITE;
-    if (debug) {
-        // Colors according to state and behavior for debugging
-        if (is_maneuvering) color = RED;
-        else if (behavior_mode == 1) color = { 255, 100, 100, 255 }; // Reddish (Aggressive)
-        else if (behavior_mode == 2) color = { 100, 100, 255, 255 }; // Bluish (Fearful)
-        else if (wall_detected_center && !is_car_center && dist_fraction_center < 0.3f) color = ORANGE;
+    current_waypoint_id = next;
+    waypoint_timer = 0.0f;
+    target_valid = false;
+}
+
+// Every lookup is an array access, the car only walks its index along the line
+void AIVehicle::FollowLine(const RacingLine& line, b2Vec2 position, float speed, b2Vec2 pull, b2Vec2& target, float& target_speed) {
+    line_index = line.Track(position, line_index);
+
+    // Past the waypoint we were heading to
+    if (line.GetWaypoint(line_index) == current_waypoint_id) {
+        AdvanceWaypoint(line.GetNextWaypoint(line_index));
     }
 
-    DrawTexturePro(texture, source, dest, origin, angle, color);
+    // Heading of the line a bit ahead, where the car will be once the steering
+    // turned it, so it follows the curve instead of cutting to a far point
+    float preview = params.line_lookahead + speed * params.line_lookahead_time;
+    int ahead = line.Ahead(line_index, preview);
+    b2Vec2 heading = line.GetPoint(ahead + 1) - line.GetPoint(ahead - 1);
+    heading.Normalize();
+
+    // Back towards the line, harder the further off and the slower. The pull
+    // of the other cars only moves the car sideways inside the wall margin
+    b2Vec2 tangent = line.GetPoint(line_index + 1) - line.GetPoint(line_index - 1);
+    tangent.Normalize();
+    b2Vec2 normal(-tangent.y, tangent.x);
+    float lane = b2Clamp(b2Dot(pull, normal), -1.0f, 1.0f) * AI_LINE_LANE;
+    float offset = b2Dot(position - line.GetPoint(line_index), normal) - lane;
+    b2Vec2 dir = heading - (params.line_correction * offset / std::max(speed, 1.0f)) * normal;
+    dir.Normalize();
+
+    target = position + std::max(preview, 1.0f) * dir;
+    target_valid = false;
+    target_speed = line.GetSpeed(line.Ahead(line_index, speed * params.line_brake_time)) * params.line_speed_factor;
+    currentTarget = target;
+}
 
-    if (debug) {
-        DrawLine((int)(METERS_TO_PIXELS(pos.x) + camX), (int)(METERS_TO_PIXELS(pos.y) + camY),
-            (int)(METERS_TO_PIXELS(currentTarget.x) + camX), (int)(METERS_TO_PIXELS(currentTarget.y) + camY), BLUE);
+float AIVehicle::FollowSpeed(const VehicleGrid& grid, b2Vec2 position, float min_speed) const {
+    int nearby[AI_FOLLOW_CARS];
+    int count = grid.Query(position, AI_FOLLOW_DISTANCE, vehicle_id, nearby, AI_FOLLOW_CARS);
 
-        DrawCircleLines((int)(METERS_TO_PIXELS(currentTarget.x) + camX), (int)(METERS_TO_PIXELS(currentTarget.y) + camY), 5.0f, BLUE);
+    b2Vec2 forward = vehicles->GetForward(vehicle_id);
+    float follow = FLT_MAX;
+    for (int i = 0; i < count; ++i) {
+        b2Vec2 diff = vehicles->GetPosition(nearby[i]) - position;
+        float along = b2Dot(diff, forward);
+        if (along <= 0.0f || fabsf(b2Cross(forward, diff)) > AI_FOLLOW_WIDTH) continue;
 
-        b2Vec2 forward = body->GetWorldVector(b2Vec2(0.0f, -1.0f));
-        b2Vec2 right = body->GetWorldVector(b2Vec2(1.0f, 0.0f));
+        float ahead_speed = b2Dot(vehicles->GetVelocity(nearby[i]), forward);
+        if (ahead_speed < min_speed) continue;
+        follow = std::min(follow, std::max(0.0f, ahead_speed + AI_FOLLOW_GAIN * (along - AI_FOLLOW_GAP)));
+    }
+    return follow;
+}
+
+bool AIVehicle::Overlaps() const {
+    const b2Fixture* fixture = body->GetFixtureList();
+    if (!fixture) return false;
 
-        b2Vec2 p1 = pos;
-        b2Vec2 p2_center = p1 + sensor_length * forward;
-        b2Vec2 p2_left = p1 + (sensor_length * 0.8f) * (forward - 0.5f * right);
-        b2Vec2 p2_right = p1 + (sensor_length * 0.8f) * (forward + 0.5f * right);
+    b2Filter filter = fixture->GetFilterData();
+    if (lod) filter.maskBits = lod_mask_bits;
 
-        Color cColor = GREEN;
-        if (wall_detected_center) cColor = is_car_center ? YELLOW : RED;
-        DrawLine((int)(METERS_TO_PIXELS(p1.x) + camX), (int)(METERS_TO_PIXELS(p1.y) + camY),
-            (int)(METERS_TO_PIXELS(p2_center.x) + camX), (int)(METERS_TO_PIXELS(p2_center.y) + camY), cColor);
+    b2AABB aabb;
+    fixture->GetShape()->ComputeAABB(&aabb, body->GetTransform(), 0);
+    OverlapCallback callback(fixture, filter, body->GetTransform());
+    body->GetWorld()->QueryAABB(&callback, aabb);
+    return callback.overlap;
+}
 
-        DrawLine((int)(METERS_TO_PIXELS(p1.x) + camX), (int)(METERS_TO_PIXELS(p1.y) + camY),
-            (int)(METERS_TO_PIXELS(p2_left.x) + camX), (int)(METERS_TO_PIXELS(p2_left.y) + camY), wall_detected_left ? RED : GREEN);
+bool AIVehicle::SetLod(bool enabled, const RacingLine* line) {
+    if (!body || enabled == lod) return true;
+
+    // Nothing pushes a car out of a wall or another car it came back inside,
+    // look for a free spot ahead on the line
+    if (!enabled && Overlaps()) {
+        bool free = false;
+        if (line) {
+            b2Transform start = body->GetTransform();
+            int index = line->Locate(body->GetPosition());
+            for (int i = 1; i <= AI_LOD_SLIDE_TRIES && !free; ++i) {
+                int slide = line->Ahead(index, i * AI_LOD_SLIDE_STEP);
+                b2Vec2 dir = line->GetPoint(slide + 1) - line->GetPoint(slide);
+                if (dir.Normalize() < b2_epsilon) continue;
+                body->SetTransform(line->GetPoint(slide), atan2f(dir.y, dir.x) + (b2_pi / 2.0f));
+                free = !Overlaps();
+            }
+            if (free) body->SetLinearVelocity(body->GetLinearVelocity().Length() * b2Vec2(body->GetTransform().q.s, -body->GetTransform().q.c));
+            else body->SetTransform(start.p, start.q.GetAngle());
+        }
+        if (!free) {
+            // Parked, UpdateLod moves it on while the race goes on
+            body->SetLinearVelocity(b2Vec2(0.0f, 0.0f));
+            body->SetAngularVelocity(0.0f);
+            return false;
+        }
+    }
+
+    SwitchLod(enabled);
+    return true;
+}
+
+void AIVehicle::SwitchLod(bool enabled) {
+    if (!body || enabled == lod) return;
+
+    lod = enabled;
+    b2Fixture* fixture = body->GetFixtureList();
+
+    // Fresh sensors on the first frame back
+    perception.timer = 0.0f;
+    perception.sense = true;
+
+    if (lod) {
+        // Kinematic and without collisions, the car only follows the waypoints
+        lod_speed = body->GetLinearVelocity().Length();
+        body->SetType(b2_kinematicBody);
+        if (fixture) {
+            b2Filter filter = fixture->GetFilterData();
+            lod_mask_bits = filter.maskBits;
+            filter.maskBits = 0;
+            fixture->SetFilterData(filter);
+        }
+    }
+    else {
+        // Velocity is kept, so the car goes on at the speed it was following
+        body->SetType(b2_dynamicBody);
+        body->SetAngularVelocity(0.0f);
+        if (fixture) {
+            b2Filter filter = fixture->GetFilterData();
+            filter.maskBits = lod_mask_bits;
+            fixture->SetFilterData(filter);
+        }
+    }
+}
 
-        DrawLine((int)(METERS_TO_PIXELS(p1.x) + camX), (int)(METERS_TO_PIXELS(p1.y) + camY),
-            (int)(METERS_TO_PIXELS(p2_right.x) + camX), (int)(METERS_TO_PIXELS(p2_right.y) + camY), wall_detected_right ? RED : GREEN);
+void AIVehicle::UpdateLod(const AISenseContext& context) {
+    if (!active || !body) return;
 
-        // Debug text over the car
-        const char* behaviorText = "N";
-        if (behavior_mode == 1) behaviorText = "AGR";
-        if (behavior_mode == 2) behaviorText = "FEAR";
-        DrawText(behaviorText, (int)(METERS_TO_PIXELS(pos.x) + camX), (int)(METERS_TO_PIXELS(pos.y) + camY), 10, WHITE);
+    float dt = context.dt;
+    drive_time += dt;
+    b2Vec2 position = body->GetPosition();
 
-        // Debug laps
-        DrawText(TextFormat("L:%d", laps), (int)(METERS_TO_PIXELS(pos.x) + camX), (int)(METERS_TO_PIXELS(pos.y) + camY) - 10, 10, YELLOW);
+    // Predicted speed: what the car had when it left the screen, easing to
+    // the speed profile or the cruise speed
+    b2Vec2 targetPos(0, 0);
+    float targetSpeed = AI_LOD_CRUISE_SPEED;
+    if (context.racing_line) {
+        FollowLine(*context.racing_line, position, lod_speed, b2Vec2(0.0f, 0.0f), targetPos, targetSpeed);
     }
-}
\ No newline at end of file
+    else {
+        if (!FindTarget(*context.waypoints, targetPos)) {
+            body->SetLinearVelocity(b2Vec2(0.0f, 0.0f));
+            body->SetAngularVelocity(0.0f);
+            return;
+        }
+        UpdateWaypoint(dt, *context.waypoints, position, targetPos);
+    }
+
+    lod_speed += (targetSpeed - lod_speed) * std::min(dt, 1.0f);
+
+    // Without collisions nothing else keeps the cars apart, queue behind
+    // whatever is ahead, even a car that is stopped
+    if (context.grid) lod_speed = std::min(lod_speed, FollowSpeed(*context.grid, position, 0.0f));
+
+    b2Vec2 dir = targetPos - position;
+    if (dir.Normalize() < b2_epsilon) return;
+    body->SetLinearVelocity(lod_speed * dir);
+
+    float desiredAngle = atan2f(dir.y, dir.x) + (b2_pi / 2.0f);
+    float angleDiff = desiredAngle - body->GetAngle();
+    while (angleDiff <= -b2_pi) angleDiff += 2 * b2_pi;
+    while (angleDiff > b2_pi) angleDiff -= 2 * b2_pi;
+    body->SetAngularVelocity(5.0f * angleDiff);
+}
@@ -9,18 +9,150 @@
 #include "box2d/box2d.h"
 #pragma warning(pop)
 
-struct Waypoint;
+#include "RacingLine.h"
+#include "RandomStream.h"
+#include "TextureAtlas.h"
+#include "VehicleGrid.h"
+#include "VehicleSystem.h"
+
+// Map waypoint, the AI heads to one of next_ids once it gets close
+struct Waypoint {
+    int id;
+    b2Vec2 position;
+    std::vector<int> next_ids;
+
+    Waypoint() : id(-1), position(0, 0) {}
+};
+
+// Perception schedule of a car, owned by the PerceptionScheduler
+struct AIPerception {
+    bool sense = true;      // refresh the sensors this frame
+    bool staggered = false;
+    float timer = 0.0f;     // time left until the next sense
+    float interval = 0.0f;
+    float cost_us = 0.0f;   // sensing cost of the last Think
+};
+
+// Frame-stable inputs of the AI think phase, read by every car
+struct AISenseContext {
+    float dt = 0.0f;
+    const std::vector<Waypoint>* waypoints = nullptr;
+    const RacingLine* racing_line = nullptr; // null when the track has none
+    const VehicleGrid* grid = nullptr; // every car, for neighbour queries
+};
+
+// Off-screen physics LOD: cars far from the camera become kinematic and follow
+// the waypoints at a predicted speed, without sensors or collisions
+#define AI_LOD_ENTER_DISTANCE 35.0f // meters from the view center
+#define AI_LOD_EXIT_DISTANCE 25.0f // below the enter distance, the screen corners are ~15 m away
+#define AI_LOD_CRUISE_SPEED 8.0f
+#define AI_LOD_SLIDE_STEP 1.0f // meters along the line a car coming back inside something is moved per try
+#define AI_LOD_SLIDE_TRIES 16
+
+// Racing line following
+#define AI_LINE_LOOKAHEAD 1.0f // meters ahead of the car the line heading is read, plus the speed term
+#define AI_LINE_LOOKAHEAD_TIME 0.2f // the time the steering takes to turn the car, 1 / AI turn_speed
+#define AI_LINE_CORRECTION 2.0f // steering back to the line per meter off, over the speed
+#define AI_LINE_BRAKE_TIME 0.4f // target speed read this far ahead, to brake in time
+#define AI_LINE_OFF_DISTANCE 1.5f // further from the line than this, the wall sensors steer again
+#define AI_LINE_TURN_SPEED 4.0f // facing away from the line, slow enough to turn back onto it
+#define AI_LINE_LANE 0.5f // meters aggressive and fearful cars move off the line, inside the off distance
+
+// Seconds pushing against something without moving before backing off
+#define AI_STUCK_TIME 1.0f
+
+// Cars on the line keep behind a slower car ahead instead of driving into it
+#define AI_FOLLOW_DISTANCE 8.0f // meters ahead that are looked at
+#define AI_FOLLOW_WIDTH 1.6f // sideways, about a car width from center to center
+#define AI_FOLLOW_GAP 3.5f // center to center distance kept, a car length and room to brake
+#define AI_FOLLOW_GAIN 1.5f // m/s allowed over the car ahead per meter of gap
+#define AI_FOLLOW_CARS 4 // nearest cars read
+#define AI_FOLLOW_MIN_SPEED 3.0f // slower cars ahead are driven around with the sensors, not queued behind
+
+// Aggressive and fearful cars react to the closest car in this radius
+#define AI_INTERACTION_RADIUS 15.0f
+
+// Cars per batch of the parallel think phase
+#define AI_THINK_BATCH 8
+
+// Driving parameters of an AI car. The defaults are the hand tuned values,
+// Benchmarks/AITuner searches better sets for a track headless.
+struct AIParams {
+    float acceleration = 6.0f; // engine, m/s2, see DefaultTuning
+    float cruise_speed = 9.0f; // speed limit without a racing line
+    float chase_speed = 10.5f; // aggressive cars chasing someone, without a racing line
+    float chase_line_factor = 1.15f; // same, over the speed profile of the line
+    float line_speed_factor = 1.0f; // scales the speed profile of the line
+    float sensor_length = 3.0f; // meters, center ray
+    float waypoint_reach = 8.0f; // meters to a waypoint to head to the next one
+    float line_lookahead = AI_LINE_LOOKAHEAD;
+    float line_lookahead_time = AI_LINE_LOOKAHEAD_TIME;
+    float line_correction = AI_LINE_CORRECTION;
+    float line_brake_time = AI_LINE_BRAKE_TIME;
+    float line_off_distance = AI_LINE_OFF_DISTANCE;
+
+    // Personality drawn at Init, the rest of the cars are neutral
+    float aggressive_chance = 0.3f;
+    float fearful_chance = 0.2f;
+    float aggression = 0.6f; // pull towards the closest car
+    float panic = 0.8f; // push away from it
+};
+
+// Controller state of an AI car, restored together with a WorldSnapshot
+struct AIVehicleState {
+    bool active;
+    int current_waypoint_id;
+    int behavior_mode;
+    int laps;
+    bool is_maneuvering;
+    float maneuver_timer;
+    float turn_direction;
+    float stuck_timer;
+    float waypoint_timer;
+    b2Vec2 waypoint_offset;
+    b2Vec2 currentTarget;
+    float drive_time;
+    bool lod;
+    float lod_speed;
+    RandomStream random;
+};
 
 class AIVehicle {
 public:
     AIVehicle();
     ~AIVehicle();
 
-    void Init(b2World* world, b2Vec2 position, Texture2D tex, int start_waypoint_id, float rotation_degrees = 0.0f);
-    void Update(float dt, const std::vector<Waypoint>& waypoints);
+    // Drive model used by every AI car
+    static VehicleTuning DefaultTuning(const AIParams& params = AIParams());
+
+    // The car's own stream draws its personality, offsets, route choices and maneuvers
+    void Init(b2World* world, VehicleSystem* vehicles, int tuning_profile, const AIParams& params, const RandomStream& random,
+        b2Vec2 position, const AtlasSprite& car_sprite, int start_waypoint_id, float rotation_degrees = 0.0f);
+    // Drives a car that already exists in the world, a replay rebuilds the bodies itself
+    void Attach(VehicleSystem* vehicles, int vehicle_id, b2Body* body, const AIParams& params, const AIVehicleState& state);
+    // Sense and think: reads the world, only writes this car's state and command
+    void Think(const AISenseContext& context);
+    // Hands the command to the vehicle system, serial
+    void Act();
+    // Submits the car sprite to the renderer batch
     void Draw(bool debug);
+    void DrawDebug() const;
+
+    // Cheap mode for off-screen cars. Leaving it is refused while the car
+    // would come back inside a wall or another car: with a line the car is
+    // moved ahead along it to a free spot, otherwise it stops and stays in
+    // LOD until a later call. Returns whether the car is in the asked mode
+    bool SetLod(bool enabled, const RacingLine* line = nullptr);
+    bool IsLod() const { return lod; }
+    void UpdateLod(const AISenseContext& context);
+
+    AIVehicleState SaveState() const;
+    void RestoreState(const AIVehicleState& state);
 
     b2Body* body;
+    AIPerception perception;
+    VehicleSystem* vehicles;
+    int vehicle_id;
     bool active;
     int current_waypoint_id;
     int behavior_mode;
@@ -28,8 +160,22 @@ public:
 
 private:
     void RaycastSensors();
+    bool FindTarget(const std::vector<Waypoint>& waypoints, b2Vec2& target);
+    void UpdateWaypoint(float dt, const std::vector<Waypoint>& waypoints, b2Vec2 position, b2Vec2 target);
+    void AdvanceWaypoint(int next);
+    // Target point and speed from the racing line, also moves the waypoint progress along.
+    // pull moves the car to one side of the line
+    void FollowLine(const RacingLine& line, b2Vec2 position, float speed, b2Vec2 pull, b2Vec2& target, float& target_speed);
+    // Highest speed that keeps the gap to the cars ahead, FLT_MAX with none.
+    // Cars ahead slower than min_speed are left to the sensors
+    float FollowSpeed(const VehicleGrid& grid, b2Vec2 position, float min_speed = AI_FOLLOW_MIN_SPEED) const;
+    // Whether the car, with its collisions back on, would touch anything
+    bool Overlaps() const;
+    // Body type and collisions of the LOD mode, no checks
+    void SwitchLod(bool enabled);
 
-    Texture2D texture;
+    AIParams params;
+    AtlasSprite sprite;
     float width, height;
 
     // Sensors
@@ -48,6 +194,7 @@ private:
     bool is_maneuvering;
     float maneuver_timer;
     float turn_direction;
+    float stuck_timer; // throttle on and no speed
 
     // Navigation
     float waypoint_timer;
@@ -56,4 +203,15 @@ private:
 
     // Driving time to avoid panic at the start
     float drive_time;
+
+    // Output of Think
+    VehicleControls command;
+    RandomStream random;
+    bool target_valid;
+    int line_index;
+
+    // Physics LOD
+    bool lod;
+    float lod_speed;
+    uint16 lod_mask_bits;
 };
\ No newline at end of file
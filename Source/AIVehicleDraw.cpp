@@ -0,0 +1,64 @@
+#include "AIVehicle.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "ModulePhysics.h"
+
+// Kept apart from the driving logic so AIVehicle.cpp builds without the
+// renderer, the headless tools link it on its own
+void AIVehicle::Draw(bool debug) {
+    if (!active || !body || lod) return;
+
+    b2Vec2 pos = body->GetPosition();
+    float angle = body->GetAngle() * RAD_TO_DEG;
+
+    Rectangle dest = { (float)METERS_TO_PIXELS(pos.x), (float)METERS_TO_PIXELS(pos.y), width, height };
+    Vector2 origin = { width / 2.0f, height / 2.0f };
+
+    Color color = WHITE;
+    if (debug) {
+        // Colors according to state and behavior for debugging
+        if (is_maneuvering) color = RED;
+        else if (behavior_mode == 1) color = { 255, 100, 100, 255 }; // Reddish (Aggressive)
+        else if (behavior_mode == 2) color = { 100, 100, 255, 255 }; // Bluish (Fearful)
+        else if (wall_detected_center && !is_car_center && dist_fraction_center < 0.3f) color = ORANGE;
+    }
+
+    App->renderer->DrawSprite(RenderLayer::VEHICLES, sprite.texture, sprite.source, dest, origin, angle, color);
+}
+
+// Sensors and state over the car, drawn from the DEBUG layer in world pixels
+void AIVehicle::DrawDebug() const {
+    if (!active || !body || lod) return;
+
+    b2Vec2 pos = body->GetPosition();
+    float x = (float)METERS_TO_PIXELS(pos.x);
+    float y = (float)METERS_TO_PIXELS(pos.y);
+    float reach = (float)METERS_TO_PIXELS(sensor_length);
+    if (!App->renderer->IsVisible({ x - reach, y - reach, 2.0f * reach, 2.0f * reach })) return;
+
+    Vector2 target = { (float)METERS_TO_PIXELS(currentTarget.x), (float)METERS_TO_PIXELS(currentTarget.y) };
+    DrawLineV({ x, y }, target, BLUE);
+    DrawCircleLinesV(target, 5.0f, BLUE);
+
+    b2Vec2 forward = body->GetWorldVector(b2Vec2(0.0f, -1.0f));
+    b2Vec2 right = body->GetWorldVector(b2Vec2(1.0f, 0.0f));
+
+    b2Vec2 p2_center = pos + sensor_length * forward;
+    b2Vec2 p2_left = pos + (sensor_length * 0.8f) * (forward - 0.5f * right);
+    b2Vec2 p2_right = pos + (sensor_length * 0.8f) * (forward + 0.5f * right);
+
+    Color cColor = GREEN;
+    if (wall_detected_center) cColor = is_car_center ? YELLOW : RED;
+    DrawLineV({ x, y }, { (float)METERS_TO_PIXELS(p2_center.x), (float)METERS_TO_PIXELS(p2_center.y) }, cColor);
+    DrawLineV({ x, y }, { (float)METERS_TO_PIXELS(p2_left.x), (float)METERS_TO_PIXELS(p2_left.y) }, wall_detected_left ? RED : GREEN);
+    DrawLineV({ x, y }, { (float)METERS_TO_PIXELS(p2_right.x), (float)METERS_TO_PIXELS(p2_right.y) }, wall_detected_right ? RED : GREEN);
+
+    // Debug text over the car
+    const char* behaviorText = "N";
+    if (behavior_mode == 1) behaviorText = "AGR";
+    if (behavior_mode == 2) behaviorText = "FEAR";
+    DrawText(behaviorText, (int)x, (int)y, 10, WHITE);
+
+    // Debug laps
+    DrawText(TextFormat("L:%d", laps), (int)x, (int)y - 10, 10, YELLOW);
+}
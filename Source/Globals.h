@@ -1,8 +1,9 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdint.h>
 
-#define LOG(format, ...) log(__FILE__, __LINE__, format, __VA_ARGS__);
+#define LOG(format, ...) log(__FILE__, __LINE__, format, ##__VA_ARGS__);
 
 void log(const char file[], int line, const char* format, ...);
 
@@ -12,8 +13,8 @@ void log(const char file[], int line, const char* format, ...);
 #define RADTODEG 57.295779513082320876f
 
 typedef unsigned int uint;
-typedef unsigned __int32 uint32;
-typedef unsigned __int64 uint64;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
 typedef unsigned char uchar;
 
 enum update_status
@@ -0,0 +1,205 @@
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "HudCanvas.h"
+#include "rlgl.h"
+
+#include <math.h>
+#include <string.h>
+
+static bool Overlaps(Rectangle a, Rectangle b)
+{
+	return a.width > 0.0f && b.width > 0.0f && a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static bool SameColor(Color a, Color b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+void HudWidget::SetVisible(bool show)
+{
+	if (visible == show) return;
+	visible = show;
+	dirty = true;
+}
+
+void HudWidget::SetBounds(Rectangle rect)
+{
+	if (rect.x == bounds.x && rect.y == bounds.y && rect.width == bounds.width && rect.height == bounds.height) return;
+	bounds = rect;
+	dirty = true;
+}
+
+HudText::HudText() : x(0), y(0), font_size(20), color(WHITE), centered(false)
+{
+	text[0] = '\0';
+}
+
+void HudText::SetPosition(int pos_x, int pos_y, bool center)
+{
+	if (x == pos_x && y == pos_y && centered == center) return;
+	x = pos_x;
+	y = pos_y;
+	centered = center;
+	UpdateBounds();
+}
+
+void HudText::Set(const char* new_text, int size, Color new_color)
+{
+	if (strncmp(text, new_text, HUD_TEXT_MAX - 1) == 0 && font_size == size && SameColor(color, new_color)) return;
+	strncpy(text, new_text, HUD_TEXT_MAX - 1);
+	text[HUD_TEXT_MAX - 1] = '\0';
+	font_size = size;
+	color = new_color;
+	UpdateBounds();
+	Invalidate();
+}
+
+void HudText::Redraw() const
+{
+	DrawText(text, (int)GetBounds().x, y, font_size, color);
+}
+
+void HudText::UpdateBounds()
+{
+	int width = MeasureText(text, font_size);
+	SetBounds({ (float)(centered ? x - width / 2 : x), (float)y, (float)width, (float)font_size });
+}
+
+void HudRect::Set(Rectangle rect, Color fill)
+{
+	SetBounds(rect);
+	if (SameColor(color, fill)) return;
+	color = fill;
+	Invalidate();
+}
+
+void HudRect::Redraw() const
+{
+	DrawRectangleRec(GetBounds(), color);
+}
+
+HudCanvas::HudCanvas() : target({ 0 }), redrawn(0)
+{
+}
+
+bool HudCanvas::Init(int width, int height)
+{
+	target = LoadRenderTexture(width, height);
+	if (target.id == 0)
+	{
+		LOG("HudCanvas: Could not create a %dx%d render texture", width, height);
+		return false;
+	}
+
+	BeginTextureMode(target);
+	ClearBackground(BLANK);
+	EndTextureMode();
+	return true;
+}
+
+void HudCanvas::CleanUp()
+{
+	if (target.id != 0) UnloadRenderTexture(target);
+	target = { 0 };
+	widgets.clear();
+}
+
+void HudCanvas::Add(HudWidget* widget)
+{
+	widget->dirty = true;
+	widgets.push_back(widget);
+}
+
+void HudCanvas::Remove(HudWidget* widget)
+{
+	for (size_t i = 0; i < widgets.size(); ++i)
+	{
+		if (widgets[i] != widget) continue;
+		widgets.erase(widgets.begin() + i);
+		break;
+	}
+}
+
+void HudCanvas::Update()
+{
+	redrawn = 0;
+	if (target.id == 0) return;
+
+	cleared.clear();
+	for (HudWidget* widget : widgets)
+	{
+		if (!widget->dirty) continue;
+		if (widget->drawn_bounds.width > 0.0f) cleared.push_back(widget->drawn_bounds);
+		if (widget->visible) cleared.push_back(widget->bounds);
+	}
+	if (cleared.empty()) return;
+
+	// What is under a cleared area has to be drawn again, and that clears more
+	bool grown = true;
+	while (grown)
+	{
+		grown = false;
+		for (HudWidget* widget : widgets)
+		{
+			if (widget->dirty || widget->drawn_bounds.width <= 0.0f) continue;
+			for (size_t i = 0; i < cleared.size(); ++i)
+			{
+				if (!Overlaps(widget->drawn_bounds, cleared[i])) continue;
+				widget->dirty = true;
+				cleared.push_back(widget->drawn_bounds);
+				grown = true;
+				break;
+			}
+		}
+	}
+
+	BeginTextureMode(target);
+	for (const Rectangle& rect : cleared)
+	{
+		int x = (int)floorf(rect.x);
+		int y = (int)floorf(rect.y);
+		BeginScissorMode(x, y, (int)ceilf(rect.x + rect.width) - x, (int)ceilf(rect.y + rect.height) - y);
+		ClearBackground(BLANK);
+		EndScissorMode();
+	}
+
+	// Premultiplied, the alpha of what is under adds up like on screen
+	rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA, RL_FUNC_ADD, RL_FUNC_ADD);
+	BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+	for (HudWidget* widget : widgets)
+	{
+		if (!widget->dirty) continue;
+		widget->dirty = false;
+		widget->drawn_bounds = { 0, 0, 0, 0 };
+		if (!widget->visible) continue;
+
+		widget->Redraw();
+		widget->drawn_bounds = widget->bounds;
+		redrawn++;
+	}
+	EndBlendMode();
+	EndTextureMode();
+}
+
+void HudCanvas::Submit()
+{
+	for (const HudWidget* widget : widgets)
+	{
+		if (widget->visible)
+		{
+			App->renderer->DrawDeferred(RenderLayer::HUD, [this]() { Draw(); }, HUD_CANVAS_DEPTH);
+			return;
+		}
+	}
+}
+
+void HudCanvas::Draw() const
+{
+	// Render textures are upside down
+	Rectangle source = { 0.0f, 0.0f, (float)target.texture.width, -(float)target.texture.height };
+	BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+	DrawTextureRec(target.texture, source, { 0.0f, 0.0f }, WHITE);
+	EndBlendMode();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <vector>
+
+#define HUD_TEXT_MAX 64
+#define HUD_CANVAS_DEPTH -1		// first of the HUD layer, the debug text goes over it
+
+// Piece of the HUD kept in the canvas. Redraw only runs when the widget was
+// invalidated, so a widget checks its values every frame and calls Invalidate
+// when something it shows is different.
+class HudWidget
+{
+public:
+	HudWidget() : bounds({ 0, 0, 0, 0 }), visible(true), dirty(true) {}
+	virtual ~HudWidget() {}
+
+	void SetVisible(bool show);
+	bool IsVisible() const { return visible; }
+	void Invalidate() { dirty = true; }
+	// Screen pixels Redraw stays in, the canvas clears them before
+	void SetBounds(Rectangle rect);
+	Rectangle GetBounds() const { return bounds; }
+
+protected:
+	// Immediate mode drawing in screen pixels, into the canvas
+	virtual void Redraw() const = 0;
+
+private:
+	friend class HudCanvas;
+
+	Rectangle bounds;
+	Rectangle drawn_bounds = { 0, 0, 0, 0 };	// what the canvas holds of it
+	bool visible;
+	bool dirty;
+};
+
+// Text at a fixed place, measured when it changes
+class HudText : public HudWidget
+{
+public:
+	HudText();
+
+	// centered puts x in the middle of the text
+	void SetPosition(int x, int y, bool centered = false);
+	void Set(const char* text, int font_size, Color color);
+
+protected:
+	void Redraw() const override;
+
+private:
+	void UpdateBounds();
+
+	char text[HUD_TEXT_MAX];
+	int x;
+	int y;
+	int font_size;
+	Color color;
+	bool centered;
+};
+
+// Flat rectangle, for shades behind overlays
+class HudRect : public HudWidget
+{
+public:
+	HudRect() : color(BLANK) {}
+
+	void Set(Rectangle rect, Color fill);
+
+protected:
+	void Redraw() const override;
+
+private:
+	Color color;
+};
+
+// Screen sized render texture the HUD widgets live in. Every frame Update
+// clears and redraws only the widgets that changed, and the ones overlapping
+// them, then the whole HUD is one textured quad. The canvas keeps premultiplied
+// alpha so the translucent panels look the same as drawn straight on screen.
+// Widgets are owned by whoever adds them and have to outlive the canvas use.
+class HudCanvas
+{
+public:
+	HudCanvas();
+
+	// Needs the GL context
+	bool Init(int width, int height);
+	void CleanUp();
+
+	void Add(HudWidget* widget);
+	void Remove(HudWidget* widget);
+
+	// Redraws what changed, outside of any other texture mode
+	void Update();
+	// Submits the canvas to the HUD layer when a widget is visible
+	void Submit();
+
+	int GetWidgetCount() const { return (int)widgets.size(); }
+	int GetRedrawn() const { return redrawn; }
+
+private:
+	void Draw() const;
+
+	RenderTexture2D target;
+	std::vector<HudWidget*> widgets;
+	std::vector<Rectangle> cleared;
+	int redrawn;
+};
@@ -0,0 +1,115 @@
+#include "JobSystem.h"
+#include "Globals.h"
+
+#define MAX_JOB_WORKERS 15
+
+JobSystem::JobSystem() : next_index(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Init(int worker_count)
+{
+	Shutdown();
+
+	if (worker_count <= 0)
+	{
+		int hardware = (int)std::thread::hardware_concurrency();
+		worker_count = hardware > 1 ? hardware - 1 : 0;
+	}
+	if (worker_count > MAX_JOB_WORKERS) worker_count = MAX_JOB_WORKERS;
+
+	quit = false;
+	for (int i = 0; i < worker_count; ++i)
+	{
+		workers.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+
+	LOG("JobSystem: %d fils de treball", worker_count);
+}
+
+void JobSystem::Shutdown()
+{
+	if (workers.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void JobSystem::ParallelFor(int count, int batch_size, const std::function<void(int, int)>& fn)
+{
+	if (count <= 0) return;
+	if (batch_size < 1) batch_size = 1;
+
+	// Not worth waking anyone
+	if (workers.empty() || count <= batch_size)
+	{
+		fn(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &fn;
+		job_count = count;
+		job_batch = batch_size;
+		next_index.store(0);
+		busy_workers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	RunBatches();
+
+	// fn lives on the caller's stack, every worker has to be out of it
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy_workers == 0; });
+	job = nullptr;
+}
+
+void JobSystem::RunBatches()
+{
+	for (;;)
+	{
+		int begin = next_index.fetch_add(job_batch);
+		if (begin >= job_count) break;
+
+		int end = begin + job_batch < job_count ? begin + job_batch : job_count;
+		(*job)(begin, end);
+	}
+}
+
+void JobSystem::WorkerLoop()
+{
+	unsigned int seen = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this, seen] { return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+		}
+
+		RunBatches();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy_workers == 0) done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small pool of worker threads for data parallel loops. ParallelFor hands out
+// batches of indices to the workers and the calling thread, and returns once
+// every batch is done.
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// 0 workers picks one per hardware thread, minus the calling one
+	void Init(int worker_count = 0);
+	void Shutdown();
+
+	// Calls fn(begin, end) for consecutive ranges of [0, count)
+	void ParallelFor(int count, int batch_size, const std::function<void(int, int)>& fn);
+
+	int GetThreadCount() const { return (int)workers.size() + 1; }
+
+private:
+	void WorkerLoop();
+	void RunBatches();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Current job, valid while ParallelFor runs
+	const std::function<void(int, int)>* job = nullptr;
+	std::atomic<int> next_index;
+	int job_count = 0;
+	int job_batch = 1;
+
+	unsigned int generation = 0;
+	int busy_workers = 0;
+	bool quit = false;
+};
@@ -1,35 +1,74 @@
 #include "Leaderboard.h"
+#include "Application.h"
+#include "ModuleRender.h"
 #include "ModulePhysics.h"
 #include <cmath>
+#include <cfloat>
 
 Leaderboard::Leaderboard()
-    : background_texture({ 0 }), is_visible(true),
-    board_x(20), board_y(20), board_width(250), board_height(400) {
+    : board_x(20), board_y(20), board_width(250), board_height(400) {
+    SetBounds({ (float)board_x, (float)board_y, (float)board_width, (float)board_height });
 }
 
 Leaderboard::~Leaderboard() {
 }
 
 void Leaderboard::Init() {
-    background_texture = LoadTexture("Assets/Textures/UI/tablero_fondo.png");
+    background = App->renderer->atlas.Get("Assets/Textures/UI/tablero_fondo.png");
 
-    if (background_texture.id == 0) {
+    if (!background.IsValid()) {
         LOG("WARNING: No se pudo cargar tablero_fondo.png, usando fondo por defecto");
     }
     else {
-        board_width = background_texture.width;
-        board_height = background_texture.height;
+        board_width = background.GetWidth();
+        board_height = background.GetHeight();
     }
+    SetBounds({ (float)board_x, (float)board_y, (float)board_width, (float)board_height });
 
-    sorted_racers.clear();
+    ClearRacers();
 }
 
 void Leaderboard::CleanUp() {
-    if (background_texture.id != 0) {
-        UnloadTexture(background_texture);
-        background_texture = { 0 };
+    background = AtlasSprite();
+    ClearRacers();
+}
+
+void Leaderboard::ClearRacers() {
+    names.clear();
+    racers.clear();
+    order.clear();
+    changes.clear();
+    Invalidate();
+}
+
+int Leaderboard::AddRacer(const char* name, bool is_player) {
+    RacerInfo racer;
+    racer.name = InternName(name);
+    racer.is_player = is_player;
+
+    racers.push_back(racer);
+    order.push_back((int)racers.size() - 1);
+    changes.reserve(racers.size());
+    return (int)racers.size() - 1;
+}
+
+void Leaderboard::SetActive(int racer, bool active) {
+    if (racer < 0 || racer >= (int)racers.size()) return;
+    racers[racer].active = active;
+}
+
+void Leaderboard::SetProgress(int racer, int current_waypoint, float distance_to_next_waypoint) {
+    if (racer < 0 || racer >= (int)racers.size()) return;
+    racers[racer].current_waypoint = current_waypoint;
+    racers[racer].distance_to_next_waypoint = distance_to_next_waypoint;
+}
+
+int Leaderboard::InternName(const char* name) {
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (names[i] == name) return (int)i;
     }
-    sorted_racers.clear();
+    names.push_back(name);
+    return (int)names.size() - 1;
 }
 
 float Leaderboard::CalculateTotalProgress(const RacerInfo& racer) {
@@ -43,26 +82,39 @@ float Leaderboard::CalculateTotalProgress(const RacerInfo& racer) {
     return progress;
 }
 
-void Leaderboard::UpdatePositions(const std::vector<RacerInfo>& racers) {
-    sorted_racers = racers;
+void Leaderboard::UpdatePositions() {
+    for (RacerInfo& racer : racers) {
+        racer.total_progress = racer.active ? CalculateTotalProgress(racer) : -FLT_MAX;
+    }
 
-    for (auto& racer : sorted_racers) {
-        racer.total_progress = CalculateTotalProgress(racer);
+    // Insertion sort from the last order, ties keep their places
+    for (size_t i = 1; i < order.size(); ++i) {
+        int racer = order[i];
+        float progress = racers[racer].total_progress;
+        size_t j = i;
+        while (j > 0 && racers[order[j - 1]].total_progress < progress) {
+            order[j] = order[j - 1];
+            --j;
+        }
+        order[j] = racer;
     }
-    std::sort(sorted_racers.begin(), sorted_racers.end(),
-        [](const RacerInfo& a, const RacerInfo& b) {
-            return a.total_progress > b.total_progress;
-        });
-    for (size_t i = 0; i < sorted_racers.size(); ++i) {
-        sorted_racers[i].position = (int)i + 1;
+
+    // The panel only shows the order, progress alone changes nothing on it
+    changes.clear();
+    for (size_t i = 0; i < order.size(); ++i) {
+        RacerInfo& racer = racers[order[i]];
+        int position = racer.active ? (int)i + 1 : 0;
+        if (position == racer.position) continue;
+
+        changes.push_back({ order[i], racer.position, position });
+        if ((racer.position > 0 && racer.position <= LEADERBOARD_ROWS) || (position > 0 && position <= LEADERBOARD_ROWS)) Invalidate();
+        racer.position = position;
     }
 }
 
-void Leaderboard::Draw() {
-    if (!is_visible) return;
-
-    if (background_texture.id != 0) {
-        DrawTexture(background_texture, board_x, board_y, WHITE);
+void Leaderboard::Redraw() const {
+    if (background.IsValid()) {
+        DrawTextureRec(background.texture, background.source, { (float)board_x, (float)board_y }, WHITE);
     }
 
     DrawLineEx({ (float)board_x + 10, (float)board_y + 50 },
@@ -72,8 +124,9 @@ void Leaderboard::Draw() {
     int start_y = board_y + 65;
     int line_height = 35;
 
-    for (size_t i = 0; i < sorted_racers.size() && i < 10; ++i) {
-        const RacerInfo& racer = sorted_racers[i];
+    for (size_t i = 0; i < order.size() && i < LEADERBOARD_ROWS; ++i) {
+        const RacerInfo& racer = racers[order[i]];
+        if (!racer.active) break;
         int y_pos = start_y + (int)i * line_height;
 
         Color position_color = WHITE;
@@ -94,10 +147,10 @@ void Leaderboard::Draw() {
         }
 
         char pos_text[8];
-        sprintf_s(pos_text, "%d.", racer.position);
+        snprintf(pos_text, sizeof(pos_text), "%d.", racer.position);
         DrawText(pos_text, board_x + 20, y_pos, 22, position_color);
 
-        const char* name_display = racer.name.c_str();
+        const char* name_display = names[racer.name].c_str();
         DrawText(name_display, board_x + 60, y_pos, 20, name_color);
 
         if (racer.is_player) {
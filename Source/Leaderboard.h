@@ -2,26 +2,37 @@
 
 #include "Globals.h"
 #include "raylib.h"
+#include "TextureAtlas.h"
+#include "HudCanvas.h"
 #include <vector>
 #include <string>
 #include <algorithm>
 
-#pragma warning(push)
-#pragma warning(disable : 26495)
-#include "box2d/box2d.h"
-#pragma warning(pop)
+#define LEADERBOARD_ROWS 10
 
+// Standings slot of a racer, added once per race
 struct RacerInfo {
-    std::string name = "";
+    int name = -1;          // in the interned names of the leaderboard
     bool is_player = false;
-    int position = 0;
-    b2Body* body = nullptr;
+    bool active = false;    // off the standings while false
+    int position = 0;       // 1 is the leader, 0 is not ranked
     int current_waypoint = 0;
     float distance_to_next_waypoint = 0.0f;
     float total_progress = 0.0f;
 };
 
-class Leaderboard {
+// A racer that moved in the standings during the last UpdatePositions
+struct PositionChange {
+    int racer;
+    int old_position;   // 0 when it was not ranked
+    int new_position;   // 0 when it left the standings
+};
+
+// Standings panel, a HUD widget redrawn when the order changes. Racers keep
+// their slot for the whole race and the order of the last frame is sorted
+// again in place; cars only pass a few others per frame, so the insertion
+// sort is close to one pass and nothing is allocated after the racers are in.
+class Leaderboard : public HudWidget {
 public:
     Leaderboard();
     ~Leaderboard();
@@ -29,18 +40,29 @@ public:
     void Init();
     void CleanUp();
 
-    void UpdatePositions(const std::vector<RacerInfo>& racers);
+    // Racers of the next race, equal names share one string
+    void ClearRacers();
+    int AddRacer(const char* name, bool is_player);
+    void SetActive(int racer, bool active);
+    void SetProgress(int racer, int current_waypoint, float distance_to_next_waypoint);
+
+    void UpdatePositions();
+    const std::vector<PositionChange>& GetPositionChanges() const { return changes; }
 
-    // Draw leaderboard on screen
-    void Draw();
+    int GetRacerCount() const { return (int)racers.size(); }
+    const RacerInfo& GetRacer(int racer) const { return racers[racer]; }
+    const char* GetName(int racer) const { return names[racers[racer].name].c_str(); }
 
-    void SetVisible(bool visible) { is_visible = visible; }
-    bool IsVisible() const { return is_visible; }
+protected:
+    // Draw leaderboard into the HUD canvas
+    void Redraw() const override;
 
 private:
-    Texture2D background_texture;
-    std::vector<RacerInfo> sorted_racers;
-    bool is_visible;
+    AtlasSprite background;
+    std::vector<std::string> names;
+    std::vector<RacerInfo> racers;
+    std::vector<int> order;     // racers, the leader first and the inactive ones last
+    std::vector<PositionChange> changes;
 
     // Position leaderboard on screen
     int board_x;
@@ -49,4 +71,5 @@ private:
     int board_height;
 
     float CalculateTotalProgress(const RacerInfo& racer);
+    int InternName(const char* name);
 };
\ No newline at end of file
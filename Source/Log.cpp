@@ -14,10 +14,10 @@ void log(const char file[], int line, const char* format, ...)
 	static va_list ap;
 
 	va_start(ap, format);
-	vsprintf_s(tmp_string, 4096, format, ap);
+	vsnprintf(tmp_string, 4096, format, ap);
 	va_end(ap);
 
-	sprintf_s(tmp_string2, 4096, "\n%s(%d) : %s", file, line, tmp_string);
+	snprintf(tmp_string2, 4096, "\n%s(%d) : %s", file, line, tmp_string);
 
 #ifdef _WIN32
 	OutputDebugStringA(tmp_string2);
@@ -24,7 +24,7 @@ ModuleGame::ModuleGame(Application* app, bool start_enabled) : Module(app, start
 	menu_state = MenuState::INTRO_ANIMATION;
 	start_menu_texture = { 0 };
 	level_select_texture = { 0 };
-	selected_player_car = { 0 };
+	selected_player_car = AtlasSprite();
 
 	// Initialize music structures
 	menu_music = { 0 };
@@ -48,7 +48,7 @@ ModuleGame::ModuleGame(Application* app, bool start_enabled) : Module(app, start
 	intro_frame_height = 720;
 
 	//Traffic lights
-	traffic_light_spritesheet = { 0 };
+	traffic_light_sheet = AtlasSprite();
 	traffic_light_current_frame = 0;
 	traffic_light_total_frames = 6;
 	traffic_light_timer = 0.0f;
@@ -96,11 +96,15 @@ bool ModuleGame::Start()
 
 	LOG("ModuleGame: Loading map resources...");
 
+	// Drive model shared by all the AI cars
+	ai_tuning = App->physics->vehicles.AddTuning(AIVehicle::DefaultTuning(ai_params));
+	ai_jobs.Init();
+
 	// Load intro texture
 	intro_spritesheet = LoadTexture("Assets/Textures/UI/IntroAnimation.png");
 
 	//Load traffic lights
-	traffic_light_spritesheet = LoadTexture("Assets/Textures/UI/trafficlight.png");
+	traffic_light_sheet = App->renderer->atlas.Get("Assets/Textures/UI/trafficlight.png");
 
 	// Load start menu texture
 	start_menu_texture = LoadTexture("Assets/Textures/UI/StartMenu.png");
@@ -134,10 +138,26 @@ bool ModuleGame::Start()
 		return false;
 	}
 
+	particles.Init();
+
 	if (leaderboard) {
 		leaderboard->Init();
+		App->renderer->hud.Add(leaderboard);
 	}
 
+	menu_hint.SetPosition(10, SCREEN_HEIGHT - 30);
+	menu_hint.Set("[M] Back to Level Select", 20, WHITE);
+	result_shade.Set({ 0, 0, (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT }, Fade(BLACK, 0.7f));
+	result_title.SetPosition(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 50, true);
+	result_hint.SetPosition(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 60, true);
+	result_hint.Set("Press [ENTER] to continue", 30, LIGHTGRAY);
+	position_flash.SetPosition(SCREEN_WIDTH / 2, 40, true);
+	App->renderer->hud.Add(&menu_hint);
+	App->renderer->hud.Add(&result_shade);
+	App->renderer->hud.Add(&result_title);
+	App->renderer->hud.Add(&result_hint);
+	App->renderer->hud.Add(&position_flash);
+
 	if (character_select) {
 		character_select->Init();
 	}
@@ -145,10 +165,10 @@ bool ModuleGame::Start()
 	// Load AI car textures
 	char path[256];
 	for (int i = 2; i <= 8; ++i) {
-		sprintf_s(path, "Assets/Textures/Cars/car%d.png", i);
-		Texture2D tex = LoadTexture(path);
-		if (tex.id != 0) {
-			ai_car_textures.push_back(tex);
+		snprintf(path, sizeof(path), "Assets/Textures/Cars/car%d.png", i);
+		AtlasSprite sprite = App->renderer->atlas.Get(path);
+		if (sprite.IsValid()) {
+			ai_car_sprites.push_back(sprite);
 		}
 	}
 
@@ -199,20 +219,24 @@ bool ModuleGame::CleanUp()
 	if (leaderboard) leaderboard->CleanUp();
 	if (character_select) character_select->CleanUp();
 	if (intro_spritesheet.id != 0) UnloadTexture(intro_spritesheet);
-	if (traffic_light_spritesheet.id != 0) UnloadTexture(traffic_light_spritesheet);
+	background.Close();
 	if (background_image.id != 0) UnloadTexture(background_image);
 
-	for (auto& tex : ai_car_textures) UnloadTexture(tex);
-	ai_car_textures.clear();
+	// The car sprites and the traffic light belong to the renderer atlas
+	ai_car_sprites.clear();
 
-	for (auto* vehicle : ai_vehicles) delete vehicle;
 	ai_vehicles.clear();
+	ai_jobs.Shutdown();
+	particles.CleanUp();
 
 	waypoints.clear();
 	spawn_points.clear();
 	map_data.clear();
 	collision_objects.clear();
 	collision_bodies.clear();
+	race_start.world.Clear();
+	race_start.ai.clear();
+	loaded_map_path.clear();
 	return true;
 }
 
@@ -224,6 +248,9 @@ update_status ModuleGame::Update()
 		UpdateMusicStream(current_music);
 	}
 
+	// Full rate physics only while racing
+	App->physics->SetStepRate(menu_state == MenuState::PLAYING ? RACE_STEP_RATE : MENU_STEP_RATE);
+
 	float dtt = GetFrameTime();
 	if (menu_state == MenuState::INTRO_ANIMATION)
 	{
@@ -255,8 +282,7 @@ update_status ModuleGame::Update()
 	// Show initial menu and wait for SPACE
 	if (menu_state == MenuState::START_MENU)
 	{
-		App->renderer->camera_x = 0;
-		App->renderer->camera_y = 0;
+		App->renderer->CenterCameraOn(SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f);
 		ClearBackground(BLACK);
 
 		if (start_menu_texture.id != 0)
@@ -293,8 +319,7 @@ update_status ModuleGame::Update()
 
 	if (menu_state == MenuState::CHARACTER_SELECT)
 	{
-		App->renderer->camera_x = 0;
-		App->renderer->camera_y = 0;
+		App->renderer->CenterCameraOn(SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f);
 		float dt = GetFrameTime();
 
 		if (character_select) {
@@ -302,7 +327,7 @@ update_status ModuleGame::Update()
 			character_select->Draw();
 
 			if (character_select->IsConfirmed()) {
-				selected_player_car = character_select->GetSelectedCarTexture();
+				selected_player_car = character_select->GetSelectedCar();
 				menu_state = MenuState::LEVEL_SELECT;
 			}
 		}
@@ -312,8 +337,7 @@ update_status ModuleGame::Update()
 
 	if (menu_state == MenuState::LEVEL_SELECT)
 	{
-		App->renderer->camera_x = 0;
-		App->renderer->camera_y = 0;
+		App->renderer->CenterCameraOn(SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f);
 		ClearBackground(BLACK);
 
 		if (level_select_texture.id != 0)
@@ -348,6 +372,24 @@ update_status ModuleGame::Update()
 
 	if (!game_started) return UPDATE_CONTINUE;
 
+	if (IsKeyPressed(KEY_F5))
+	{
+		record_races = !record_races;
+		LOG("Race recording %s", record_races ? "ON, from the next start" : "OFF");
+	}
+
+	if (IsKeyPressed(KEY_G))
+	{
+		ghost_visible = !ghost_visible;
+	}
+
+	// Mouse wheel zooms out to see more of the track
+	float wheel = GetMouseWheelMove();
+	if (wheel != 0.0f)
+	{
+		App->renderer->SetCameraZoom(App->renderer->GetCamera().zoom * (1.0f + CAMERA_ZOOM_STEP * wheel));
+	}
+
 	if (IsKeyPressed(KEY_M))
 	{
 		ResetGame();
@@ -370,20 +412,34 @@ update_status ModuleGame::Update()
 		}
 	}
 
-	if (background_image.id != 0) {
-		float camX = App->renderer->camera_x;
-		float camY = App->renderer->camera_y;
+	if (background.IsOpen()) {
+		Vector2 velocity = { 0.0f, 0.0f };
+		if (App->physics->vehicles.IsValid(App->player->vehicle_id)) {
+			const b2Vec2& player_velocity = App->physics->vehicles.GetVelocity(App->player->vehicle_id);
+			velocity = { player_velocity.x * PIXELS_PER_METER, player_velocity.y * PIXELS_PER_METER };
+		}
+		background.Update(App->renderer->GetViewRect(), velocity, App->renderer->GetCamera().zoom);
+		background.Draw();
+	}
+	else if (background_image.id != 0) {
 		Rectangle source = { 0, 0, (float)background_image.width, (float)background_image.height };
-		Rectangle dest = { camX, camY, (float)background_image.width, (float)background_image.height };
-		DrawTexturePro(background_image, source, dest, { 0, 0 }, 0, WHITE);
+		Rectangle dest = { 0, 0, (float)background_image.width, (float)background_image.height };
+		App->renderer->DrawSprite(RenderLayer::BACKGROUND, background_image, source, dest);
 	}
 
 	int tile_size = 128;
 	int columns = 18;
 
-	for (int y = 0; y < map_height; ++y)
+	// Only the tiles under the view, one more around for the camera still moving this frame
+	Rectangle view = App->renderer->GetViewRect();
+	int first_x = std::max(0, (int)floorf(view.x / tile_size) - 1);
+	int first_y = std::max(0, (int)floorf(view.y / tile_size) - 1);
+	int last_x = std::min(map_width - 1, (int)floorf((view.x + view.width) / tile_size) + 1);
+	int last_y = std::min(map_height - 1, (int)floorf((view.y + view.height) / tile_size) + 1);
+
+	for (int y = first_y; y <= last_y; ++y)
 	{
-		for (int x = 0; x < map_width; ++x)
+		for (int x = first_x; x <= last_x; ++x)
 		{
 			int id = map_data[y * map_width + x];
 			if (id > 0)
@@ -392,7 +448,7 @@ update_status ModuleGame::Update()
 				int tx = gid % columns;
 				int ty = gid / columns;
 				Rectangle source = { (float)tx * tile_size, (float)ty * tile_size, (float)tile_size, (float)tile_size };
-				App->renderer->Draw(tile_set, x * tile_size, y * tile_size, &source);
+				App->renderer->Draw(tile_set, x * tile_size, y * tile_size, &source, 0, 0, 0, WHITE, RenderLayer::TRACK);
 			}
 		}
 	}
@@ -426,155 +482,165 @@ update_status ModuleGame::Update()
 			App->player->vehicle->body->SetAngularVelocity(0);
 		}
 
-		for (auto& ai : ai_vehicles)
+		for (AIVehicle& ai : ai_vehicles)
 		{
-			if (ai && ai->body)
+			if (ai.body)
 			{
-				ai->body->SetLinearVelocity(b2Vec2(0, 0));
-				ai->body->SetAngularVelocity(0);
+				ai.body->SetLinearVelocity(b2Vec2(0, 0));
+				ai.body->SetAngularVelocity(0);
 			}
 		}
-	}
 
-	// Draw map tiles
-	for (int y = 0; y < map_height; ++y)
-	{
-		for (int x = 0; x < map_width; ++x)
+		if (race_can_start)
 		{
-			int id = map_data[y * map_width + x];
-			if (id > 0)
-			{
-				int gid = id - 1;
-				int tx = gid % columns;
-				int ty = gid / columns;
-				Rectangle source = { (float)tx * tile_size, (float)ty * tile_size, (float)tile_size, (float)tile_size };
-				App->renderer->Draw(tile_set, x * tile_size, y * tile_size, &source);
-			}
+			BeginTelemetry();
+			if (record_races) BeginRecording();
 		}
 	}
 
 	if (menu_state == MenuState::PLAYING && game_started && !race_finished) {
 
 		if (IsKeyPressed(KEY_TAB)) {
-			leaderboard->SetVisible(!leaderboard->IsVisible());
+			leaderboard_shown = !leaderboard_shown;
 		}
 
 		UpdatePlayerWaypoint();
 
-		std::vector<RacerInfo> racers;
-
-		if (App->player->vehicle && App->player->vehicle->body) {
-			RacerInfo player_info;
-			player_info.name = "PLAYER";
-			player_info.is_player = true;
-			player_info.body = App->player->vehicle->body;
-
-			player_info.current_waypoint = player_current_waypoint;
-			player_info.distance_to_next_waypoint = player_distance_to_waypoint;
-			racers.push_back(player_info);
+		bool player_in = App->player->vehicle && App->player->vehicle->body;
+		leaderboard->SetActive(player_racer, player_in);
+		if (player_in) {
+			leaderboard->SetProgress(player_racer, player_current_waypoint, player_distance_to_waypoint);
 		}
 
+		for (size_t i = 0; i < ai_vehicles.size() && i < ai_racers.size(); ++i) {
+			const AIVehicle* ai = &ai_vehicles[i];
+			bool ai_in = ai->active && ai->body;
+			leaderboard->SetActive(ai_racers[i], ai_in);
+			if (!ai_in) continue;
 
-		for (size_t i = 0; i < ai_vehicles.size(); ++i) {
-			AIVehicle* ai = ai_vehicles[i];
-			if (ai && ai->active && ai->body) {
-				RacerInfo ai_info;
-
-				char name_buffer[32];
-				sprintf_s(name_buffer, "AI CAR %d", (int)i + 1);
-				ai_info.name = name_buffer;
-
-				ai_info.is_player = false;
-				ai_info.body = ai->body;
-				ai_info.current_waypoint = ai->current_waypoint_id;
+			b2Vec2 ai_pos = ai->body->GetPosition();
+			float distance_to_waypoint = 999.0f;
 
-				b2Vec2 ai_pos = ai->body->GetPosition();
-				bool found_waypoint = false;
-
-				for (const auto& wp : waypoints) {
-					if (wp.id == ai->current_waypoint_id) {
-						b2Vec2 diff = wp.position - ai_pos;
-						ai_info.distance_to_next_waypoint = diff.Length();
-						found_waypoint = true;
-						break;
-					}
-				}
-
-				if (!found_waypoint) {
-					ai_info.distance_to_next_waypoint = 999.0f;
+			for (const auto& wp : waypoints) {
+				if (wp.id == ai->current_waypoint_id) {
+					b2Vec2 diff = wp.position - ai_pos;
+					distance_to_waypoint = diff.Length();
+					break;
 				}
-
-				racers.push_back(ai_info);
 			}
+
+			leaderboard->SetProgress(ai_racers[i], ai->current_waypoint_id, distance_to_waypoint);
 		}
 
-		leaderboard->UpdatePositions(racers);
-		leaderboard->Draw();
+		leaderboard->UpdatePositions();
+
+		// The player passing someone or being passed flashes the new position
+		for (const PositionChange& change : leaderboard->GetPositionChanges()) {
+			if (change.racer != player_racer || change.old_position == 0 || change.new_position == 0) continue;
+			position_flash.Set(TextFormat("P%d", change.new_position), 60, change.new_position < change.old_position ? GREEN : RED);
+			position_flash_timer = POSITION_FLASH_TIME;
+		}
+		position_flash_timer = std::max(0.0f, position_flash_timer - dtt);
 	}
 
 	// Update AI vehicles
 	float dt = GetFrameTime();
 	if (!race_finished) {
 		if (race_can_start) {
-			for (auto* vehicle : ai_vehicles) {
-				vehicle->Update(dt, waypoints);
-				vehicle->Draw(App->physics->debug);
+			// The LOD follows the camera, a recorded race keeps every car simulated
+			if (!recording_race) UpdateAiLod();
+			UpdateAi(dt);
+			UpdateTelemetry();
+			DrawGhost();
+			for (AIVehicle& vehicle : ai_vehicles) {
+				vehicle.Draw(App->physics->debug);
 			}
 		}
 		else {
-			for (auto* vehicle : ai_vehicles) {
-				vehicle->Draw(App->physics->debug);
+			for (AIVehicle& vehicle : ai_vehicles) {
+				vehicle.SetLod(false, racing_line.IsValid() ? &racing_line : nullptr);
+				if (vehicle.body) App->physics->vehicles.SetControls(vehicle.vehicle_id, VehicleControls());
+				vehicle.Draw(App->physics->debug);
 			}
 		}
 	}
 	else {
-		for (auto* vehicle : ai_vehicles) {
-			vehicle->Draw(App->physics->debug);
+		// Nothing thinks any more, the last controls would keep the cars driving
+		for (AIVehicle& vehicle : ai_vehicles) {
+			vehicle.SetLod(false, racing_line.IsValid() ? &racing_line : nullptr);
+			if (vehicle.body) App->physics->vehicles.SetControls(vehicle.vehicle_id, VehicleControls());
+			vehicle.Draw(App->physics->debug);
 		}
 	}
 
-	if (traffic_light_active && traffic_light_spritesheet.id != 0)
+	UpdateEffects(dt);
+
+	if (App->physics->debug) {
+		App->renderer->DrawDeferred(RenderLayer::DEBUG, [this]() {
+			for (const AIVehicle& vehicle : ai_vehicles) {
+				vehicle.DrawDebug();
+			}
+			DrawRacingLine();
+		});
+	}
+
+	if (traffic_light_active && traffic_light_sheet.IsValid())
 	{
 		int frame = traffic_light_current_frame;
 		Rectangle source = { (float)(frame * traffic_light_frame_width), 0.0f, (float)traffic_light_frame_width, (float)traffic_light_frame_height };
 		Rectangle dest = { (SCREEN_WIDTH - traffic_light_frame_width) / 2.0f,100.0f,(float)traffic_light_frame_width,(float)traffic_light_frame_height };
-		DrawTexturePro(traffic_light_spritesheet, source, dest, { 0, 0 }, 0, WHITE);
+		App->renderer->DrawSprite(RenderLayer::HUD, traffic_light_sheet.texture, traffic_light_sheet.GetSection(source), dest);
 	}
 
-	// Draw UI hint for returning to menu
-	DrawText("[M] Back to Level Select", 10, SCREEN_HEIGHT - 30, 20, WHITE);
+	if (App->physics->debug) {
+		App->renderer->DrawDeferred(RenderLayer::HUD, [this]() { DrawHud(); });
+	}
 
-	// Draw lap interface
-	if (game_started && menu_state == MenuState::PLAYING)
-	{
-		// Checkpoint debug if F1 is pressed (debug physics)
-		if (App->physics->debug) {
-			DrawText(halfway_point_reached ? "CHECKPOINT: OK" : "CHECKPOINT: NO", 40, 70, 20, halfway_point_reached ? GREEN : RED);
-			DrawText(TextFormat("WP: %d", player_current_waypoint), 40, 90, 20, YELLOW);
-		}
+	return UPDATE_CONTINUE;
+}
 
-		if (race_finished)
-		{
-			DrawRectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, Fade(BLACK, 0.7f));
-			if (player_has_won) {
-				const char* text = "YOU WIN!";
-				int textW = MeasureText(text, 100);
-				DrawText(text, (SCREEN_WIDTH - textW) / 2, SCREEN_HEIGHT / 2 - 50, 100, GOLD);
-			}
-			else {
-				const char* text = "YOU LOSE";
-				int textW = MeasureText(text, 100);
-				DrawText(text, (SCREEN_WIDTH - textW) / 2, SCREEN_HEIGHT / 2 - 50, 100, RED);
-			}
-			const char* subtext = "Press [ENTER] to continue";
-			int subW = MeasureText(subtext, 30);
-			DrawText(subtext, (SCREEN_WIDTH - subW) / 2, SCREEN_HEIGHT / 2 + 60, 30, LIGHTGRAY);
-		}
+// HUD state once the frame changed everything it changes, the widgets only
+// redraw when what they show is different
+update_status ModuleGame::PostUpdate()
+{
+	bool racing = game_started && menu_state == MenuState::PLAYING;
+	if (leaderboard) leaderboard->SetVisible(leaderboard_shown && racing && !race_finished);
+	menu_hint.SetVisible(racing);
+
+	bool show_result = racing && race_finished;
+	result_shade.SetVisible(show_result);
+	result_title.SetVisible(show_result);
+	result_hint.SetVisible(show_result);
+	position_flash.SetVisible(racing && !race_finished && position_flash_timer > 0.0f);
+	if (show_result) {
+		if (player_has_won) result_title.Set("YOU WIN!", 100, GOLD);
+		else result_title.Set("YOU LOSE", 100, RED);
 	}
 
 	return UPDATE_CONTINUE;
 }
 
+// Debug text of the race, it changes every frame so it is drawn as it comes
+void ModuleGame::DrawHud()
+{
+	if (!game_started || menu_state != MenuState::PLAYING) return;
+
+	DrawText(halfway_point_reached ? "CHECKPOINT: OK" : "CHECKPOINT: NO", 40, 70, 20, halfway_point_reached ? GREEN : RED);
+	DrawText(TextFormat("WP: %d", player_current_waypoint), 40, 90, 20, YELLOW);
+	DrawText(TextFormat("AI LOD: %d / %d kinematic", ai_lod_count, (int)ai_vehicles.size()), 40, 110, 20, YELLOW);
+	DrawText(TextFormat("AI think: %.2f ms, %d threads", ai_think_ms, ai_jobs.GetThreadCount()), 40, 130, 20, YELLOW);
+	DrawText(TextFormat("AI sensing: %d / %d cars, %.0f / %.0f us, %.1f Hz, x%.2f", perception.sensed_cars, perception.scheduled_cars,
+		perception.used_us, AI_SENSE_BUDGET_US, perception.sense_rate, perception.scale), 40, 150, 20, YELLOW);
+	DrawText(TextFormat("Particles: %d / %d, %d dropped", particles.GetCount(), PARTICLE_CAPACITY, particles.GetDropped()), 40, 190, 20, YELLOW);
+	if (background.IsOpen()) {
+		DrawText(TextFormat("Background: level %d, %d tiles in (%.1f MB), %d queued", background.GetLevel(), background.GetResidentCount(),
+			background.GetResidentMB(), background.GetQueuedCount()), 40, 210, 20, YELLOW);
+	}
+	if (racing_line.IsValid()) {
+		DrawText(TextFormat("Racing line: %.0f m, lap %.1f s", racing_line.GetLength(), racing_line.GetLapTime()), 40, 170, 20, YELLOW);
+	}
+}
+
 void ModuleGame::StartGame(const char* map_path)
 {
 	LOG("Starting game with map: %s", map_path);
@@ -586,26 +652,52 @@ void ModuleGame::StartGame(const char* map_path)
 	traffic_light_timer = 0.0f;
 	race_can_start = false;
 
-	if (strstr(map_path, "RaceTrack.tmx") != nullptr) {
-		current_map_spawn_rotation = -90.0f;
-		background_image = LoadTexture("Assets/Map/background1.png");
-
+	// Same track as the last race: the walls, cars and textures are still loaded.
+	// The snapshot holds the random streams too, so it is the same session.
+	bool same_seed = next_session_seed == 0 || next_session_seed == session_seed;
+	bool restart = loaded_map_path == map_path && race_start.world.IsValid() && same_seed;
+	if (restart)
+	{
+		RestoreRace(race_start);
+		LOG("Race restarted from snapshot (%d bodies)", (int)race_start.world.bodies.size());
 	}
-	else if (strstr(map_path, "RaceTrack2.tmx") != nullptr) {
-		current_map_spawn_rotation = 180.0f;
-		background_image = LoadTexture("Assets/Map/background2.png");
+	else
+	{
+		UnloadTrack();
 
-	}
-	else if (strstr(map_path, "RaceTrack3.tmx") != nullptr) {
-		current_map_spawn_rotation = -90.0f;
-		background_image = LoadTexture("Assets/Map/background3.png");
-	}
+		// The only non deterministic draw, everything else comes from this seed
+		if (next_session_seed != 0) session_seed = next_session_seed;
+		else
+		{
+			std::random_device rd;
+			session_seed = ((uint64)rd() << 32) | rd();
+		}
+		next_session_seed = 0;
+		LOG("Race seed: %llu", (unsigned long long)session_seed);
+
+		if (strstr(map_path, "RaceTrack.tmx") != nullptr) {
+			current_map_spawn_rotation = -90.0f;
+			LoadBackground("Assets/Map/background1.png");
+
+		}
+		else if (strstr(map_path, "RaceTrack2.tmx") != nullptr) {
+			current_map_spawn_rotation = 180.0f;
+			LoadBackground("Assets/Map/background2.png");
+
+		}
+		else if (strstr(map_path, "RaceTrack3.tmx") != nullptr) {
+			current_map_spawn_rotation = -90.0f;
+			LoadBackground("Assets/Map/background3.png");
+		}
 
-	LoadMap(map_path);
-	LoadCollisions(map_path);
-	LoadMapObjects(map_path);
-	CreateCollisionBodies();
-	CreateEnemiesAndPlayer();
+		LoadMap(map_path);
+		LoadCollisions(map_path);
+		LoadMapObjects(map_path);
+		LoadRacingLine(map_path);
+		CreateCollisionBodies();
+		CreateEnemiesAndPlayer();
+		loaded_map_path = map_path;
+	}
 
 	player_current_waypoint = -1;
 	player_distance_to_waypoint = 999.0f;
@@ -641,32 +733,100 @@ void ModuleGame::StartGame(const char* map_path)
 	player_has_won = false;
 	halfway_point_reached = false;
 
-	for (auto* ai : ai_vehicles) {
-		ai->laps = 1;
+	for (AIVehicle& ai : ai_vehicles) {
+		ai.laps = 1;
+	}
+
+	if (!restart)
+	{
+		SaveRace(race_start);
 	}
 
+	RegisterRacers();
+	AttachEffects();
 	game_started = true;
 }
 
+void ModuleGame::RegisterRacers()
+{
+	if (!leaderboard) return;
+
+	leaderboard->ClearRacers();
+	position_flash_timer = 0.0f;
+	player_racer = leaderboard->AddRacer("PLAYER", true);
+	ai_racers.clear();
+	for (size_t i = 0; i < ai_vehicles.size(); ++i) {
+		ai_racers.push_back(leaderboard->AddRacer(TextFormat("AI CAR %d", (int)i + 1), false));
+	}
+}
+
+void ModuleGame::SaveRace(RaceSnapshot& snapshot) const
+{
+	App->physics->SaveSnapshot(snapshot.world);
+
+	snapshot.ai.clear();
+	for (const AIVehicle& ai : ai_vehicles) {
+		snapshot.ai.push_back(ai.SaveState());
+	}
+
+	snapshot.player = App->player->SaveState();
+}
+
+void ModuleGame::RestoreRace(const RaceSnapshot& snapshot)
+{
+	App->physics->RestoreSnapshot(snapshot.world);
+
+	for (size_t i = 0; i < ai_vehicles.size() && i < snapshot.ai.size(); ++i) {
+		ai_vehicles[i].RestoreState(snapshot.ai[i]);
+	}
+
+	App->player->RestoreState(snapshot.player);
+
+	// The car may have been changed in the menu since the snapshot was taken
+	if (selected_player_car.IsValid()) {
+		App->player->vehicle_sprite = selected_player_car;
+	}
+}
+
+// Leaving a race keeps the track loaded, so picking it again is a snapshot restore
 void ModuleGame::ResetGame()
 {
-	for (auto* vehicle : ai_vehicles) {
-		if (vehicle && vehicle->body) {
-			App->physics->GetWorld()->DestroyBody(vehicle->body);
-			vehicle->body = nullptr;
+	EndRecording();
+	EndTelemetry();
+
+	player_current_waypoint = -1;
+	player_distance_to_waypoint = 999.0f;
+
+	if (App->player)
+	{
+		App->player->ResetNitro();
+	}
+
+	particles.Clear();
+	player_nitro_emitter = -1;
+}
+
+void ModuleGame::UnloadTrack()
+{
+	race_start.world.Clear();
+	race_start.ai.clear();
+	loaded_map_path.clear();
+
+	for (AIVehicle& vehicle : ai_vehicles) {
+		if (vehicle.body) {
+			App->physics->vehicles.RemoveVehicle(vehicle.vehicle_id);
+			App->physics->GetWorld()->DestroyBody(vehicle.body);
+			vehicle.body = nullptr;
 		}
-		delete vehicle;
 	}
 	ai_vehicles.clear();
 
-	for (auto* pbody : collision_bodies) {
-		if (pbody && pbody->body) {
-			App->physics->GetWorld()->DestroyBody(pbody->body);
-			pbody->body = nullptr;
-		}
+	for (const PhysBodyHandle& handle : collision_bodies) {
+		App->physics->DestroyBody(handle);
 	}
 	collision_bodies.clear();
 
+	background.Close();
 	if (background_image.id != 0) {
 		UnloadTexture(background_image);
 		background_image = { 0 };
@@ -677,109 +837,45 @@ void ModuleGame::ResetGame()
 
 	waypoints.clear();
 	spawn_points.clear();
+	racing_line.Clear();
 	map_data.clear();
 	collision_objects.clear();
-
-	if (App->player)
-	{
-		App->player->ResetNitro();
-	}
 }
 
-std::vector<std::string> SplitString(const std::string& s, char delimiter) {
-	std::vector<std::string> tokens;
-	std::string token;
-	std::istringstream tokenStream(s);
-	while (std::getline(tokenStream, token, delimiter)) {
-		token.erase(remove(token.begin(), token.end(), ' '), token.end());
-		if (!token.empty()) tokens.push_back(token);
-	}
-	return tokens;
+// The tiles are cut offline next to the image (Benchmarks/BackgroundTiler)
+void ModuleGame::LoadBackground(const char* image_path)
+{
+	if (background.Open(TiledBackground::GetTilesPath(image_path).c_str())) return;
+
+	LOG("No background tiles for %s, loading the whole image", image_path);
+	background_image = LoadTexture(image_path);
 }
 
 void ModuleGame::LoadMapObjects(const char* map_path)
 {
-	std::ifstream file(map_path);
-	if (!file.is_open()) return;
-
-	std::string line;
-	bool in_spawns = false;
-	bool in_waypoints = false;
-	bool in_object = false;
-
-	b2Vec2 tempPos(0, 0);
-	int tempId = -1;
-	std::vector<int> tempNextIds;
+	ReadMapObjects(map_path, METERS_PER_PIXEL, spawn_points, waypoints);
+}
 
-	while (std::getline(file, line))
+// The racing line is compiled offline next to the map (Benchmarks/RacingLineCompiler),
+// a map without one gets it built here and saved for the next time
+void ModuleGame::LoadRacingLine(const char* map_path)
+{
+	std::string line_path = RacingLine::GetLinePath(map_path);
+	if (racing_line.Load(line_path.c_str()))
 	{
-		if (line.find("name=\"SpawnPoints\"") != std::string::npos) in_spawns = true;
-		if (line.find("name=\"AI_Waypoints\"") != std::string::npos) in_waypoints = true;
-
-		if (line.find("</objectgroup>") != std::string::npos) {
-			in_spawns = false;
-			in_waypoints = false;
-		}
-
-		if (!in_spawns && !in_waypoints) continue;
-
-		if (line.find("<object") != std::string::npos) {
-			in_object = true;
-			tempPos.SetZero();
-			tempId = -1;
-			tempNextIds.clear();
-
-			size_t x_pos = line.find("x=\"");
-			if (x_pos != std::string::npos) {
-				size_t start = x_pos + 3;
-				tempPos.x = std::stof(line.substr(start, line.find("\"", start) - start));
-			}
-			size_t y_pos = line.find("y=\"");
-			if (y_pos != std::string::npos) {
-				size_t start = y_pos + 3;
-				tempPos.y = std::stof(line.substr(start, line.find("\"", start) - start));
-			}
-		}
-
-		if (in_object && line.find("<property") != std::string::npos) {
-			if (line.find("name=\"checkpoint_id\"") != std::string::npos || line.find("name=\"spawn_id\"") != std::string::npos || line.find("name=\"id\"") != std::string::npos) {
-				size_t val_pos = line.find("value=\"");
-				if (val_pos != std::string::npos) {
-					size_t start = val_pos + 7;
-					try { tempId = std::stoi(line.substr(start, line.find("\"", start) - start)); }
-					catch (...) {}
-				}
-			}
-			if (line.find("name=\"next_ids\"") != std::string::npos) {
-				size_t val_pos = line.find("value=\"");
-				if (val_pos != std::string::npos) {
-					size_t start = val_pos + 7;
-					std::string raw = line.substr(start, line.find("\"", start) - start);
-					auto tokens = SplitString(raw, ',');
-					for (const auto& t : tokens) {
-						try { tempNextIds.push_back(std::stoi(t)); }
-						catch (...) {}
-					}
-				}
-			}
-		}
-
-		if (in_object && line.find("</object>") != std::string::npos) {
-			in_object = false;
+		LOG("Racing line: %d samples, %.0f m, %.1f s estimated lap", racing_line.GetCount(), racing_line.GetLength(), racing_line.GetLapTime());
+		return;
+	}
 
-			if (in_spawns) {
-				spawn_points.push_back(tempPos);
-			}
-			if (in_waypoints && tempId != -1) {
-				Waypoint wp;
-				wp.id = tempId;
-				wp.position = b2Vec2(PIXELS_TO_METERS(tempPos.x), PIXELS_TO_METERS(tempPos.y));
-				wp.next_ids = tempNextIds;
-				waypoints.push_back(wp);
-			}
-		}
+	if (racing_line.Compile(map_path, PIXELS_PER_METER))
+	{
+		racing_line.Save(line_path.c_str());
+		LOG("Racing line compiled: %d samples, %.0f m, %.1f s estimated lap", racing_line.GetCount(), racing_line.GetLength(), racing_line.GetLapTime());
+	}
+	else
+	{
+		LOG("Racing line: could not compile %s, the AI follows the waypoints", map_path);
 	}
-	file.close();
 }
 
 void ModuleGame::CreateEnemiesAndPlayer()
@@ -789,19 +885,16 @@ void ModuleGame::CreateEnemiesAndPlayer()
 		return;
 	}
 
-	std::random_device rd;
-	std::mt19937 g(rd());
-	std::shuffle(spawn_points.begin(), spawn_points.end(), g);
+	RandomStream spawn_random(session_seed, RANDOM_STREAM_SPAWNS);
+	spawn_random.Shuffle(spawn_points);
+
+	if (App->player != nullptr) {
+		App->player->random = RandomStream(session_seed, RANDOM_STREAM_PLAYER);
+	}
 
 	if (App->player != nullptr && App->player->vehicle != nullptr) {
-		if (selected_player_car.id != 0) {
-			if (App->player->vehicle_texture.id != selected_player_car.id)
-			{
-				if (App->player->vehicle_texture.id != 0) {
-					UnloadTexture(App->player->vehicle_texture);
-				}
-				App->player->vehicle_texture = selected_player_car;
-			}
+		if (selected_player_car.IsValid()) {
+			App->player->vehicle_sprite = selected_player_car;
 		}
 		App->player->SetPosition(spawn_points[0].x, spawn_points[0].y, current_map_spawn_rotation);
 	}
@@ -826,24 +919,24 @@ void ModuleGame::CreateEnemiesAndPlayer()
 	}
 
 	std::vector<int> available_car_indices;
-	int num_textures = (int)ai_car_textures.size();
+	int num_textures = (int)ai_car_sprites.size();
 
 	for (int i = 0; i < num_textures; ++i) {
 		available_car_indices.push_back(i);
 	}
 
-	std::shuffle(available_car_indices.begin(), available_car_indices.end(), g);
+	spawn_random.Shuffle(available_car_indices);
 
 	int car_index = 0;
 	int num_spawns = (int)spawn_points.size();
 
 	for (int i = 1; i < num_spawns; ++i) {
-		AIVehicle* newAI = new AIVehicle();
+		AIVehicle newAI;
 
-		Texture2D tex;
-		if (!ai_car_textures.empty() && car_index < num_textures) {
+		AtlasSprite sprite;
+		if (!ai_car_sprites.empty() && car_index < num_textures) {
 			int texture_idx = available_car_indices[car_index];
-			tex = ai_car_textures[texture_idx];
+			sprite = ai_car_sprites[texture_idx];
 			car_index++;
 
 			if (car_index >= num_textures) {
@@ -851,231 +944,321 @@ void ModuleGame::CreateEnemiesAndPlayer()
 			}
 		}
 		else {
-			tex = App->player->vehicle_texture;
+			sprite = App->player->vehicle_sprite;
 		}
 
-		int startWP = rand() % 4;
+		int startWP = spawn_random.Range(4);
 
 		b2Vec2 spawnPosMeters(PIXELS_TO_METERS(spawn_points[i].x), PIXELS_TO_METERS(spawn_points[i].y));
 
-		newAI->Init(App->physics->GetWorld(), spawnPosMeters, tex, startWP, current_map_spawn_rotation);
+		newAI.Init(App->physics->GetWorld(), &App->physics->vehicles, ai_tuning, ai_params, RandomStream(session_seed, RANDOM_STREAM_AI + i), spawnPosMeters, sprite, startWP, current_map_spawn_rotation);
 		ai_vehicles.push_back(newAI);
 	}
 }
 
 void ModuleGame::LoadMap(const char* map_path)
 {
-	std::ifstream file(map_path);
-	if (file.is_open())
+	map_width = 60;
+	map_height = 50;
+	ReadMapTiles(map_path, map_data);
+}
+
+void ModuleGame::LoadCollisions(const char* map_path)
+{
+	ReadMapCollisions(map_path, collision_objects);
+}
+
+void ModuleGame::CreateCollisionBodies()
+{
+	std::vector<int> points_array;
+	for (const auto& collision : collision_objects)
 	{
-		std::string line;
-		bool data_found = false;
-		map_width = 60;
-		map_height = 50;
-		while (std::getline(file, line))
-		{
-			if (line.find("<data encoding=\"csv\">") != std::string::npos)
-			{
-				data_found = true;
-				continue;
-			}
-			if (line.find("</data>") != std::string::npos) break;
+		if (!GetCollisionChain(collision, points_array)) continue;
 
-			if (data_found)
-			{
-				std::stringstream ss(line);
-				std::string value;
-				while (std::getline(ss, value, ','))
-				{
-					if (!value.empty() && value != "\n" && value != "\r")
-					{
-						try { map_data.push_back(std::stoi(value)); }
-						catch (...) {}
-					}
-				}
-			}
-		}
-		file.close();
+		PhysBody* body = App->physics->CreateChain(0, 0, points_array.data(), (int)points_array.size(), PhysBodyType::STATIC);
+		if (body != nullptr) collision_bodies.push_back(App->physics->GetHandle(body));
 	}
+
+	// Walls never move, build their tree once for the whole track
+	App->physics->RebuildStaticTree();
 }
 
-void ModuleGame::LoadCollisions(const char* map_path)
+// Every car smokes when it slides, the player also gets the nitro flame
+void ModuleGame::AttachEffects()
 {
-	std::ifstream file(map_path);
-	if (!file.is_open()) return;
+	particles.Clear();
+	particles.SetRandom(RandomStream(session_seed, RANDOM_STREAM_PARTICLES));
+	player_nitro_emitter = -1;
 
-	std::string line;
-	bool in_collisions_layer = false;
-	bool in_object = false;
-	CollisionObject current_object;
+	if (App->player->vehicle != nullptr)
+	{
+		player_nitro_emitter = particles.AddEmitter(ParticleEffect::NITRO, App->player->vehicle_id);
+		particles.AddEmitter(ParticleEffect::DRIFT_SMOKE, App->player->vehicle_id);
+	}
 
-	while (std::getline(file, line))
+	for (const AIVehicle& ai : ai_vehicles)
 	{
-		if (line.find("name=\"Collisions\"") != std::string::npos)
-		{
-			in_collisions_layer = true;
-			continue;
-		}
-		if (in_collisions_layer && line.find("</objectgroup>") != std::string::npos)
-		{
-			in_collisions_layer = false;
-			break;
-		}
-		if (!in_collisions_layer) continue;
+		if (ai.body) particles.AddEmitter(ParticleEffect::DRIFT_SMOKE, ai.vehicle_id);
+	}
+}
 
-		if (line.find("<object") != std::string::npos)
-		{
-			in_object = true;
-			current_object = CollisionObject();
-			size_t name_pos = line.find("name=\"");
-			if (name_pos != std::string::npos)
-			{
-				size_t name_start = name_pos + 6;
-				size_t name_end = line.find("\"", name_start);
-				current_object.name = line.substr(name_start, name_end - name_start);
-			}
-			size_t x_pos = line.find("x=\"");
-			if (x_pos != std::string::npos)
-			{
-				size_t x_start = x_pos + 3;
-				size_t x_end = line.find("\"", x_start);
-				try { current_object.offset_x = (int)std::stof(line.substr(x_start, x_end - x_start)); }
-				catch (...) {}
-			}
-			size_t y_pos = line.find("y=\"");
-			if (y_pos != std::string::npos)
-			{
-				size_t y_start = y_pos + 3;
-				size_t y_end = line.find("\"", y_start);
-				try { current_object.offset_y = (int)std::stof(line.substr(y_start, y_end - y_start)); }
-				catch (...) {}
-			}
-		}
+void ModuleGame::UpdateEffects(float dt)
+{
+	particles.SetIntensity(player_nitro_emitter, App->player->nitro.active ? 1.0f : 0.0f);
 
-		if (in_object && line.find("<property") != std::string::npos)
-		{
-			size_t name_pos = line.find("name=\"");
-			size_t value_pos = line.find("value=\"");
-			if (name_pos != std::string::npos && value_pos != std::string::npos)
-			{
-				size_t name_start = name_pos + 6;
-				size_t name_end = line.find("\"", name_start);
-				std::string prop_name = line.substr(name_start, name_end - name_start);
-				size_t value_start = value_pos + 7;
-				size_t value_end = line.find("\"", value_start);
-				std::string prop_value = line.substr(value_start, value_end - value_start);
-				if (prop_name == "collision_type") current_object.collision_type = prop_value;
-				else if (prop_name == "type") current_object.type = prop_value;
-			}
-		}
+	// Sparks at every hard hit of a car, player or AI, cars are the only dynamic bodies
+	for (const ContactImpact& impact : App->physics->GetImpacts())
+	{
+		bool car_a = impact.body_a->GetType() == b2_dynamicBody;
+		if (!car_a && impact.body_b->GetType() != b2_dynamicBody) continue;
+
+		// Thrown back towards the car that hit
+		float strength = fminf(impact.speed / 8.0f, 1.0f);
+		Vector2 center = { impact.point.x * PIXELS_PER_METER, impact.point.y * PIXELS_PER_METER };
+		Vector2 direction = car_a ? Vector2{ -impact.normal.x, -impact.normal.y } : Vector2{ impact.normal.x, impact.normal.y };
+		particles.Burst(ParticleEffect::CRASH_SPARKS, center, direction, (int)(fmaxf(strength, 0.2f) * CRASH_SPARKS_MAX));
+	}
+	particles.Update(dt, App->physics->vehicles);
 
-		if (in_object && line.find("<polygon") != std::string::npos)
-		{
-			size_t points_pos = line.find("points=\"");
-			if (points_pos != std::string::npos)
-			{
-				size_t points_start = points_pos + 8;
-				size_t points_end = line.find("\"", points_start);
-				std::string points_str = line.substr(points_start, points_end - points_start);
-				std::stringstream ss(points_str);
-				std::string pair;
-				while (std::getline(ss, pair, ' '))
-				{
-					size_t comma_pos = pair.find(',');
-					if (comma_pos != std::string::npos)
-					{
-						try {
-							float x = std::stof(pair.substr(0, comma_pos));
-							float y = std::stof(pair.substr(comma_pos + 1));
-							current_object.points.push_back(vec2i((int)x, (int)y));
-						}
-						catch (...) {}
-					}
-				}
-			}
-		}
+	if (particles.GetCount() > 0)
+	{
+		App->renderer->DrawDeferred(RenderLayer::EFFECTS, [this]() { particles.Draw(App->renderer->GetViewRect()); });
+	}
+}
 
-		if (in_object && line.find("</object>") != std::string::npos)
-		{
-			in_object = false;
-			if (!current_object.points.empty() && current_object.type == "wall_chain")
-			{
-				collision_objects.push_back(current_object);
-			}
-		}
+void ModuleGame::PlayBackgroundMusic(Music music)
+{
+	StopCurrentMusic();
+	if (IsMusicReady(music)) {
+		current_music = music;
+		PlayMusicStream(current_music);
+		SetMusicVolume(current_music, 1.0f);
 	}
-	file.close();
 }
 
-void ModuleGame::CreateCollisionBodies()
+void ModuleGame::StopCurrentMusic()
 {
-	const float MIN_DISTANCE_SQ = 1.0f;
-	for (const auto& collision : collision_objects)
+	if (IsMusicReady(current_music) && IsMusicStreamPlaying(current_music)) {
+		StopMusicStream(current_music);
+	}
+}
+
+// Center of the screen in world meters
+b2Vec2 ModuleGame::GetViewCenter() const
+{
+	const Camera2D& camera = App->renderer->GetCamera();
+	return b2Vec2(PIXELS_TO_METERS(camera.target.x), PIXELS_TO_METERS(camera.target.y));
+}
+
+// Sense/think runs in parallel against the world as the last physics step left
+// it, then the commands are applied serially
+void ModuleGame::UpdateAi(float dt)
+{
+	AISenseContext context;
+	context.dt = dt;
+	context.waypoints = &waypoints;
+	context.racing_line = racing_line.IsValid() ? &racing_line : nullptr;
+	context.grid = &App->physics->vehicle_grid;
+
+	b2Vec2 view_center = GetViewCenter();
+	perception.Schedule(ai_vehicles, App->physics->vehicle_grid, view_center, dt);
+
+	double start = GetTime();
+	ai_jobs.ParallelFor((int)ai_vehicles.size(), AI_THINK_BATCH, [this, &context](int begin, int end)
 	{
-		if (collision.points.size() < 2) continue;
-		std::vector<vec2i> absolute_points;
-		absolute_points.reserve(collision.points.size());
-		for (size_t i = 0; i < collision.points.size(); ++i)
+		for (int i = begin; i < end; ++i)
 		{
-			vec2i absolute_point(0, 0);
-			absolute_point.x = collision.points[i].x + collision.offset_x;
-			absolute_point.y = collision.points[i].y + collision.offset_y;
-			absolute_points.push_back(absolute_point);
+			if (!ai_vehicles[i].IsLod()) ai_vehicles[i].Think(context);
 		}
-		if (collision.name == "Exterior") std::reverse(absolute_points.begin(), absolute_points.end());
+	});
+	ai_think_ms = (float)((GetTime() - start) * 1000.0);
+	perception.EndFrame(ai_vehicles);
 
-		std::vector<vec2i> filtered_points;
-		filtered_points.push_back(absolute_points[0]);
+	for (AIVehicle& vehicle : ai_vehicles)
+	{
+		if (vehicle.IsLod()) vehicle.UpdateLod(context);
+		else vehicle.Act();
+	}
+}
 
-		for (size_t i = 1; i < absolute_points.size(); ++i)
-		{
-			const vec2i& current = absolute_points[i];
-			const vec2i& last_added = filtered_points.back();
-			int dx = current.x - last_added.x;
-			int dy = current.y - last_added.y;
-			float dist_sq = (float)(dx * dx + dy * dy);
-			if (dist_sq >= MIN_DISTANCE_SQ) filtered_points.push_back(current);
-		}
+// Starts on the frame the lights go green, after the cars are stopped and
+// before anything thinks, so the replay begins from the same state
+void ModuleGame::BeginRecording()
+{
+	ModulePhysics* physics = App->physics;
+	// The contacts and the broadphase of this world come from every race and
+	// track before, the replay builds a new one
+	physics->ResetContacts();
+	physics->vehicles.Gather();
+	physics->vehicle_grid.Build(physics->vehicles);
+
+	// Through their saved state, that is all a replay can give them
+	for (AIVehicle& ai : ai_vehicles) ai.RestoreState(ai.SaveState());
+	perception.Reset();
+	perception.deterministic = true;
+
+	race_recording.Clear();
+	race_recording.seed = session_seed;
+	race_recording.map_path = loaded_map_path;
+	race_recording.fixed_step = physics->GetFixedStep();
+	race_recording.ai_params = ai_params;
+	race_recording.waypoints = waypoints;
+	race_recording.Capture(physics->GetWorld(), physics->vehicles);
+	for (const AIVehicle& ai : ai_vehicles)
+	{
+		RecordedAI recorded;
+		recorded.vehicle_id = ai.vehicle_id;
+		recorded.state = ai.SaveState();
+		race_recording.ai.push_back(recorded);
+	}
+	race_recording.player_vehicle_id = App->player->vehicle_id;
+	race_recording.player_nitro = App->player->nitro;
 
-		if (filtered_points.size() > 1)
-		{
-			const vec2i& first = filtered_points.front();
-			const vec2i& last = filtered_points.back();
-			int dx = first.x - last.x;
-			int dy = first.y - last.y;
-			float dist_sq = (float)(dx * dx + dy * dy);
-			if (dist_sq < MIN_DISTANCE_SQ) filtered_points.pop_back();
-		}
+	recording_race = true;
+	LOG("Recording race, seed %llu", (unsigned long long)session_seed);
+}
+
+void ModuleGame::EndRecording()
+{
+	if (!recording_race) return;
+
+	recording_race = false;
+	perception.deterministic = false;
+
+	const char* path = TextFormat("race_%llu.rrec", (unsigned long long)session_seed);
+	if (race_recording.Save(path))
+	{
+		LOG("Race recording saved to %s (%d frames)", path, (int)race_recording.frames.size());
+	}
+	else
+	{
+		LOG("Race recording: could not write %s", path);
+	}
+	race_recording.Clear();
+}
 
-		if (filtered_points.size() < 3) continue;
+std::string ModuleGame::GetTelemetryPath(const char* suffix) const
+{
+	std::string track = loaded_map_path;
+	size_t slash = track.find_last_of("/\\");
+	if (slash != std::string::npos) track = track.substr(slash + 1);
+	size_t dot = track.find_last_of('.');
+	if (dot != std::string::npos) track = track.substr(0, dot);
+	return "telemetry_" + track + "_" + suffix + ".tlm";
+}
 
-		std::vector<int> points_array;
-		points_array.reserve(filtered_points.size() * 2);
-		for (size_t i = 0; i < filtered_points.size(); ++i)
+void ModuleGame::BeginTelemetry()
+{
+	ModulePhysics* physics = App->physics;
+	std::string path = GetTelemetryPath("last");
+	if (!physics->telemetry.Begin(path.c_str(), physics->GetStepRate(), physics->vehicles, App->player->vehicle_id))
+	{
+		LOG("Telemetry: could not write %s", path.c_str());
+	}
+	lap_start_tick = 0;
+
+	ghost_valid = ghost.Open(GetTelemetryPath("best").c_str()) && ghost.GetBestLap(ghost_lap, ghost.GetPlayerCar());
+	if (ghost_valid) LOG("Ghost lap: %.2f s", ghost_lap.GetTicks() / ghost.GetTickRate());
+}
+
+void ModuleGame::UpdateTelemetry()
+{
+	TelemetryRecorder& telemetry = App->physics->telemetry;
+	if (!telemetry.IsRecording()) return;
+
+	telemetry.SetProgress(App->player->vehicle_id, current_lap, player_current_waypoint);
+	for (const AIVehicle& ai : ai_vehicles)
+	{
+		telemetry.SetProgress(ai.vehicle_id, ai.laps, ai.current_waypoint_id);
+	}
+}
+
+// The race with a faster player lap than the ghost becomes the new ghost
+void ModuleGame::EndTelemetry()
+{
+	TelemetryRecorder& telemetry = App->physics->telemetry;
+	if (!telemetry.IsRecording()) return;
+
+	// The lap that just ended is only seen by the next progress update
+	UpdateTelemetry();
+	TelemetryLap best;
+	bool has_lap = telemetry.GetBestLap(best, telemetry.GetPlayerCar());
+	float tick_rate = App->physics->GetStepRate();
+	telemetry.End();
+
+	bool improved = has_lap && (!ghost_valid || best.GetTicks() < ghost_lap.GetTicks());
+	ghost.Close();
+	ghost_valid = false;
+
+	if (improved)
+	{
+		std::string best_path = GetTelemetryPath("best");
+		remove(best_path.c_str());
+		if (rename(GetTelemetryPath("last").c_str(), best_path.c_str()) == 0)
 		{
-			points_array.push_back(filtered_points[i].x);
-			points_array.push_back(filtered_points[i].y);
+			LOG("New ghost lap: %.2f s", best.GetTicks() / tick_rate);
 		}
-
-		PhysBody* body = App->physics->CreateChain(0, 0, points_array.data(), (int)points_array.size(), PhysBodyType::STATIC);
-		if (body != nullptr) collision_bodies.push_back(body);
 	}
 }
 
-void ModuleGame::PlayBackgroundMusic(Music music)
+void ModuleGame::DrawGhost()
 {
-	StopCurrentMusic();
-	if (IsMusicReady(music)) {
-		current_music = music;
-		PlayMusicStream(current_music);
-		SetMusicVolume(current_music, 1.0f);
+	if (!ghost_valid || !ghost_visible) return;
+
+	// Same time into the lap as the player, gone once the ghost lap is over
+	int tick = ghost_lap.start_tick + App->physics->telemetry.GetTick() - lap_start_tick;
+	if (tick >= ghost_lap.end_tick) return;
+
+	TelemetrySample sample;
+	if (!ghost.GetSample(ghost_lap.car, tick, sample)) return;
+
+	const AtlasSprite& sprite = App->player->vehicle_sprite;
+	b2Vec2 position = sample.GetPosition();
+	App->renderer->Draw(sprite.texture, METERS_TO_PIXELS(position.x), METERS_TO_PIXELS(position.y), &sprite.source, sample.GetAngle() * RAD_TO_DEG,
+		sprite.GetWidth() / 2, sprite.GetHeight() / 2, Fade(WHITE, 0.4f), RenderLayer::VEHICLES, -1);
+}
+
+// Racing line colored by target speed, red is the slowest, in world pixels
+void ModuleGame::DrawRacingLine()
+{
+	if (!racing_line.IsValid()) return;
+
+	const float top_speed = RacingLineParams().zone_speed[(int)SpeedZone::FAST];
+	for (int i = 0; i < racing_line.GetCount(); ++i)
+	{
+		const b2Vec2& a = racing_line.GetPoint(i);
+		const b2Vec2& b = racing_line.GetPoint(i + 1);
+		Vector2 start = { (float)METERS_TO_PIXELS(a.x), (float)METERS_TO_PIXELS(a.y) };
+		Vector2 end = { (float)METERS_TO_PIXELS(b.x), (float)METERS_TO_PIXELS(b.y) };
+		Rectangle bounds = { fminf(start.x, end.x), fminf(start.y, end.y), fabsf(end.x - start.x), fabsf(end.y - start.y) };
+		if (!App->renderer->IsVisible(bounds)) continue;
+
+		float t = b2Clamp(racing_line.GetSpeed(i) / top_speed, 0.0f, 1.0f);
+		Color color = { (unsigned char)(255 * (1.0f - t)), (unsigned char)(255 * t), 0, 255 };
+		DrawLineV(start, end, color);
 	}
 }
 
-void ModuleGame::StopCurrentMusic()
+// Cars far from the view go kinematic, and come back before they can be seen or touched
+void ModuleGame::UpdateAiLod()
 {
-	if (IsMusicReady(current_music) && IsMusicStreamPlaying(current_music)) {
-		StopMusicStream(current_music);
+	b2Vec2 view_center = GetViewCenter();
+
+	// Zoomed out the screen reaches further, the distances grow with it
+	float view_scale = fmaxf(1.0f, 1.0f / App->renderer->GetCamera().zoom);
+	const float enter_sqr = AI_LOD_ENTER_DISTANCE * AI_LOD_ENTER_DISTANCE * view_scale * view_scale;
+	const float exit_sqr = AI_LOD_EXIT_DISTANCE * AI_LOD_EXIT_DISTANCE * view_scale * view_scale;
+
+	ai_lod_count = 0;
+	for (AIVehicle& vehicle : ai_vehicles)
+	{
+		if (!vehicle.active || !vehicle.body) continue;
+
+		float dist_sqr = b2DistanceSquared(vehicle.body->GetPosition(), view_center);
+		if (!vehicle.IsLod() && dist_sqr > enter_sqr) vehicle.SetLod(true);
+		else if (vehicle.IsLod() && dist_sqr < exit_sqr) vehicle.SetLod(false, racing_line.IsValid() ? &racing_line : nullptr);
+
+		if (vehicle.IsLod()) ai_lod_count++;
 	}
 }
 
@@ -1123,18 +1306,21 @@ void ModuleGame::UpdatePlayerWaypoint()
 	if (previous_waypoint > (max_id * 0.8) && player_current_waypoint < (max_id * 0.2)) {
 		if (halfway_point_reached) {
 			current_lap++;
+			lap_start_tick = App->physics->telemetry.GetTick();
 			halfway_point_reached = false; 
 
 			// Race finish
 			if (current_lap > TOTAL_LAPS) {
 				race_finished = true;
+				EndRecording();
+				EndTelemetry();
 
 				// Victory logic
 				player_has_won = true;
 
 				// Check if any AI won before
-				for (auto* ai : ai_vehicles) {
-					if (ai->laps > TOTAL_LAPS) {
+				for (const AIVehicle& ai : ai_vehicles) {
+					if (ai.laps > TOTAL_LAPS) {
 						player_has_won = false;
 						break;
 					}
@@ -15,27 +15,33 @@
 #pragma warning(pop)
 
 #include "AIVehicle.h"
+#include "JobSystem.h"
+#include "PerceptionScheduler.h"
+#include "RaceRecording.h"
+#include "RacingLine.h"
+#include "TrackMap.h"
+#include "ParticleSystem.h"
+#include "TiledBackground.h"
+#include "HudCanvas.h"
+#include "ModulePhysics.h"
+#include "Player.h"
 
-class PhysBody;
 class PhysicEntity;
 
-struct CollisionObject
-{
-	std::vector<vec2i> points;
-	std::string type;
-	std::string collision_type;
-	std::string name;
-	int offset_x = 0;
-	int offset_y = 0;
-};
+// Random streams of a race, all seeded with ModuleGame::session_seed
+#define RANDOM_STREAM_SPAWNS 1
+#define RANDOM_STREAM_PLAYER 2
+#define RANDOM_STREAM_PARTICLES 3
+#define RANDOM_STREAM_AI 100 // + car index
 
-// Struct for map waypoints
-struct Waypoint {
-	int id;
-	b2Vec2 position;
-	std::vector<int> next_ids;
+// Seconds the player's new position stays up after passing or being passed
+#define POSITION_FLASH_TIME 1.5f
 
-	Waypoint() : id(-1), position(0, 0) {}
+// Everything a race restart needs, the track itself stays loaded
+struct RaceSnapshot {
+	WorldSnapshot world;
+	std::vector<AIVehicleState> ai;
+	ModulePlayer::ControllerState player;
 };
 
 enum class MenuState {
@@ -54,6 +60,7 @@ public:
 
 	bool Start();
 	update_status Update();
+	update_status PostUpdate();
 	bool CleanUp();
 
 	// Start Menu
@@ -79,24 +86,46 @@ public:
 	int map_height;
 
 	std::vector<CollisionObject> collision_objects;
-	std::vector<PhysBody*> collision_bodies;
+	std::vector<PhysBodyHandle> collision_bodies;
 
 	// IA & Game data
 	std::vector<Waypoint> waypoints;
 	std::vector<b2Vec2> spawn_points;
+	RacingLine racing_line;
 
 	// Vector IA Vehicles
-	std::vector<AIVehicle*> ai_vehicles;
-	std::vector<Texture2D> ai_car_textures;
+	std::vector<AIVehicle> ai_vehicles;
+	AIParams ai_params;
+	int ai_tuning = -1;
+	int ai_lod_count = 0;
+	JobSystem ai_jobs;
+	float ai_think_ms = 0.0f;
+	PerceptionScheduler perception;
+	std::vector<AtlasSprite> ai_car_sprites;
 
 	bool game_started;
 
+	// Smoke of every car, the player's nitro and crash sparks
+	ParticleSystem particles;
+	int player_nitro_emitter = -1;
+
 	//Leaderboard
 	Leaderboard* leaderboard;
+	bool leaderboard_shown = true;	// [TAB]
+	int player_racer = -1;			// leaderboard slots, made at the race start
+	std::vector<int> ai_racers;
+
+	// Race HUD, widgets of the renderer's HUD canvas
+	HudText menu_hint;
+	HudRect result_shade;
+	HudText result_title;
+	HudText result_hint;
+	HudText position_flash;
+	float position_flash_timer = 0.0f;
 
 	//System Select Characters
 	CharacterSelect* character_select;
-	Texture2D selected_player_car;
+	AtlasSprite selected_player_car;
 
 	//Intro
 	Texture2D intro_spritesheet;
@@ -109,7 +138,7 @@ public:
 	int intro_frame_height;
 
 	//Traffic Lights
-	Texture2D traffic_light_spritesheet;
+	AtlasSprite traffic_light_sheet;
 	int traffic_light_current_frame;
 	int traffic_light_total_frames;
 	float traffic_light_timer;
@@ -124,7 +153,8 @@ public:
 
 	float current_map_spawn_rotation;
 
-	//Background
+	//Background, streamed in tiles, the whole image when the tiles are missing
+	TiledBackground background;
 	Texture2D background_image;
 
 	const int TOTAL_LAPS = 1;
@@ -133,15 +163,61 @@ public:
 	bool player_has_won;
 	bool halfway_point_reached;
 
+	// Loaded track and its state at the start line
+	std::string loaded_map_path;
+	RaceSnapshot race_start;
+
+	// Seed of the current race, the same seed and inputs give the same race.
+	// Set next_session_seed to replay one, 0 draws a new seed.
+	uint64 session_seed = 0;
+	uint64 next_session_seed = 0;
+
+	// Race recording, F5 toggles it for the next races. The recording starts at
+	// the green light and is saved as race_<seed>.rrec when the race ends, the
+	// player sends it a frame with every input sample.
+	bool record_races = false;
+	bool recording_race = false;
+	RaceRecording race_recording;
+
+	// Telemetry of every race goes to telemetry_<track>_last.tlm, the race with
+	// the best player lap so far is kept as telemetry_<track>_best.tlm and its
+	// best lap drives along as a ghost car (G toggles it)
+	TelemetryReader ghost;
+	TelemetryLap ghost_lap;
+	bool ghost_valid = false;
+	bool ghost_visible = true;
+	int lap_start_tick = 0; // telemetry tick the current player lap started on
+
+	void SaveRace(RaceSnapshot& snapshot) const;
+	void RestoreRace(const RaceSnapshot& snapshot);
+
 private:
 	void LoadMap(const char* map_path);
 	void LoadCollisions(const char* map_path);
 	void LoadMapObjects(const char* map_path);
+	void LoadRacingLine(const char* map_path);
 	void CreateCollisionBodies();
 	void CreateEnemiesAndPlayer();
 	void StartGame(const char* map_path);
 	void ResetGame();
+	void UnloadTrack();
+	void LoadBackground(const char* image_path);
 	void UpdatePlayerWaypoint();
+	void BeginRecording();
+	void EndRecording();
+	std::string GetTelemetryPath(const char* suffix) const;
+	void BeginTelemetry();
+	void UpdateTelemetry();
+	void EndTelemetry();
+	void DrawGhost();
+	b2Vec2 GetViewCenter() const;
+	void UpdateAi(float dt);
+	void UpdateAiLod();
+	void DrawRacingLine();
+	void DrawHud();
+	void RegisterRacers();
+	void AttachEffects();
+	void UpdateEffects(float dt);
 	void PlayBackgroundMusic(Music music);
 	void StopCurrentMusic();
 
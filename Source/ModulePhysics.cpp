@@ -77,11 +77,18 @@ bool ModulePhysics::Start()
 	world = new b2World(gravity);
 	world->SetContactListener(this);
 
+	// Forces applied during a frame act on every step of the next one
+	world->SetAutoClearForces(false);
+
+	// SIMD contact solver, the instruction set is picked from the CPU at startup
+	world->SetWideContactSolver(true);
+
 	b2BodyDef bd;
 	ground = world->CreateBody(&bd);
 
 	LOG("ModulePhysics: Mon de fisica creat correctament");
 	LOG("ModulePhysics: Gravetat configurada a X=%.2f Y=%.2f", GRAVITY_X, GRAVITY_Y);
+	LOG("ModulePhysics: Solver de contactes %s", GetContactSolverName());
 	LOG("ModulePhysics: Prem F1 per activar mode debug");
 
 	return true;
@@ -93,18 +100,59 @@ update_status ModulePhysics::PreUpdate()
 	float frameTime = GetFrameTime();
 
 	// Avoid big jumps if freezed
-	if (frameTime > 0.25f) frameTime = 0.25f;
+	if (frameTime > MAX_FRAME_TIME) frameTime = MAX_FRAME_TIME;
 
 	accumulator += frameTime;
+	impacts.clear();
+
+	// Don't ask for more steps than fit in the budget, a slow frame followed by
+	// even more steps is how a hitch turns into a spiral
+	int max_steps = max_steps_per_frame;
+	if (step_stats.step_ms_avg > 0.0f)
+	{
+		int budget_steps = (int)(STEP_BUDGET_MS / step_stats.step_ms_avg);
+		if (budget_steps < max_steps) max_steps = budget_steps > 1 ? budget_steps : 1;
+	}
+
+	// Controls act on every step, so a car drives the same whatever the number
+	// of steps of a frame
+	int steps = 0;
+	while (accumulator >= fixed_step && steps < max_steps)
+	{
+		if (steps == 0 && telemetry.IsRecording()) telemetry.SetControls(vehicles);
 
-	const float FIXED_STEP = 1.0f / 60.0f;
+		double step_start = GetTime();
+		vehicles.Apply(fixed_step);
+		world->Step(fixed_step, 8, 3);
+		float step_ms = (float)((GetTime() - step_start) * 1000.0);
+		if (telemetry.IsRecording()) telemetry.Sample(vehicles);
 
-	while (accumulator >= FIXED_STEP)
+		step_stats.step_ms_last = step_ms;
+		step_stats.step_ms_avg = step_stats.step_ms_avg > 0.0f ? step_stats.step_ms_avg * 0.9f + step_ms * 0.1f : step_ms;
+
+		accumulator -= fixed_step;
+		++steps;
+	}
+	if (steps > 0) world->ClearForces();
+	vehicles.Gather();
+	vehicle_grid.Build(vehicles);
+
+	// Cap hit: drop the whole steps left and keep the remainder, the game slows
+	// down for this frame instead of catching up later
+	float dropped = 0.0f;
+	if (accumulator >= fixed_step)
 	{
-		world->Step(FIXED_STEP, 8, 3);
-		accumulator -= FIXED_STEP;
+		dropped = accumulator - fmodf(accumulator, fixed_step);
+		accumulator -= dropped;
+		step_stats.capped_frames++;
 	}
 
+	step_stats.steps_last_frame = steps;
+	step_stats.max_steps_last_frame = max_steps;
+	step_stats.dropped_last_frame = dropped;
+	step_stats.dropped_total += dropped;
+	step_stats.time_scale = frameTime > 0.0f ? (frameTime - dropped) / frameTime : 1.0f;
+
 	// Process collisions
 	for (b2Contact* c = world->GetContactList(); c; c = c->GetNext())
 	{
@@ -140,96 +188,30 @@ update_status ModulePhysics::PostUpdate()
 
 	if (!debug) return UPDATE_CONTINUE;
 
-	int shapes_drawn = 0;
-	float cam_x = App->renderer->camera_x;
-	float cam_y = App->renderer->camera_y;
-
-	// Draw physics bodies
-	for (b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+	if (IsKeyPressed(KEY_F2))
 	{
-		for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
-		{
-			switch (f->GetType())
-			{
-			case b2Shape::e_circle:
-			{
-				b2CircleShape* shape = (b2CircleShape*)f->GetShape();
-				b2Vec2 pos = f->GetBody()->GetPosition();
-				DrawCircleLines(
-					(int)(METERS_TO_PIXELS(pos.x) + cam_x),
-					(int)(METERS_TO_PIXELS(pos.y) + cam_y),
-					(float)METERS_TO_PIXELS(shape->m_radius),
-					RED);
-				shapes_drawn++;
-			}
-			break;
-
-			case b2Shape::e_polygon:
-			{
-				b2PolygonShape* shape = (b2PolygonShape*)f->GetShape();
-				int count = shape->m_count;
-				b2Vec2 prev = b->GetWorldPoint(shape->m_vertices[count - 1]);
-
-				for (int j = 0; j < count; ++j)
-				{
-					b2Vec2 v = b->GetWorldPoint(shape->m_vertices[j]);
-					DrawLine(
-						(int)(METERS_TO_PIXELS(prev.x) + cam_x),
-						(int)(METERS_TO_PIXELS(prev.y) + cam_y),
-						(int)(METERS_TO_PIXELS(v.x) + cam_x),
-						(int)(METERS_TO_PIXELS(v.y) + cam_y),
-						RED);
-					prev = v;
-				}
-				shapes_drawn++;
-			}
-			break;
-
-			case b2Shape::e_chain:
-			{
-				b2ChainShape* shape = (b2ChainShape*)f->GetShape();
-				int count = shape->m_count;
-
-				for (int j = 0; j < count - 1; ++j)
-				{
-					b2Vec2 v1 = b->GetWorldPoint(shape->m_vertices[j]);
-					b2Vec2 v2 = b->GetWorldPoint(shape->m_vertices[j + 1]);
-
-					DrawLineEx(
-						Vector2{ (float)(METERS_TO_PIXELS(v1.x) + cam_x), (float)(METERS_TO_PIXELS(v1.y) + cam_y) },
-						Vector2{ (float)(METERS_TO_PIXELS(v2.x) + cam_x), (float)(METERS_TO_PIXELS(v2.y) + cam_y) },
-						3.0f,
-						GREEN);
-				}
-
-				// Close the loop if necessary
-				if (count > 0)
-				{
-					b2Vec2 v_last = b->GetWorldPoint(shape->m_vertices[count - 1]);
-					b2Vec2 v_first = b->GetWorldPoint(shape->m_vertices[0]);
-
-					DrawLineEx(
-						Vector2{ (float)(METERS_TO_PIXELS(v_last.x) + cam_x), (float)(METERS_TO_PIXELS(v_last.y) + cam_y) },
-						Vector2{ (float)(METERS_TO_PIXELS(v_first.x) + cam_x), (float)(METERS_TO_PIXELS(v_first.y) + cam_y) },
-						3.0f,
-						GREEN);
-				}
-				shapes_drawn++;
-			}
-			break;
+		world->SetWideContactSolver(!world->GetWideContactSolver());
+		LOG("ModulePhysics: Solver de contactes %s", GetContactSolverName());
+	}
 
-			default: break;
-			}
-		}
+	if (IsKeyPressed(KEY_F3))
+	{
+		world->SetSoftStepCount(world->GetSoftStepCount() > 0 ? 0 : SOFT_STEP_COUNT);
+		LOG("ModulePhysics: Solver de contactes %s", GetContactSolverName());
 	}
 
+	// Draw physics bodies on screen, over the sprites of the frame
+	App->renderer->DrawDeferred(RenderLayer::DEBUG, [this]()
+	{
+		debug_draw.DrawWorld(world, App->renderer->GetViewRect());
+		debug_draw.Flush();
+	});
+
 	// Mouse joint (debug)
 	if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
 	{
-		Vector2 mouse_pos = GetMousePosition();
-		float world_x = mouse_pos.x - cam_x;
-		float world_y = mouse_pos.y - cam_y;
-		b2Vec2 p = b2Vec2(PIXELS_TO_METERS(world_x), PIXELS_TO_METERS(world_y));
+		Vector2 mouse_pos = App->renderer->ScreenToWorld(GetMousePosition());
+		b2Vec2 p = b2Vec2(PIXELS_TO_METERS(mouse_pos.x), PIXELS_TO_METERS(mouse_pos.y));
 
 		if (mouse_joint == nullptr)
 		{
@@ -262,19 +244,16 @@ update_status ModulePhysics::PostUpdate()
 
 	if (mouse_joint && IsMouseButtonDown(MOUSE_LEFT_BUTTON))
 	{
-		Vector2 mouse_pos = GetMousePosition();
-		float world_x = mouse_pos.x - cam_x;
-		float world_y = mouse_pos.y - cam_y;
-		b2Vec2 mouse_position = b2Vec2(PIXELS_TO_METERS(world_x), PIXELS_TO_METERS(world_y));
+		Vector2 mouse_pos = App->renderer->ScreenToWorld(GetMousePosition());
+		b2Vec2 mouse_position = b2Vec2(PIXELS_TO_METERS(mouse_pos.x), PIXELS_TO_METERS(mouse_pos.y));
 
 		mouse_joint->SetTarget(mouse_position);
 
 		b2Vec2 anchor = mouse_joint->GetAnchorB();
-		DrawLine(
-			(int)(METERS_TO_PIXELS(anchor.x) + cam_x),
-			(int)(METERS_TO_PIXELS(anchor.y) + cam_y),
-			(int)mouse_pos.x, (int)mouse_pos.y,
-			RED);
+		App->renderer->DrawDeferred(RenderLayer::DEBUG, [anchor, mouse_pos]()
+		{
+			DrawLineV({ (float)METERS_TO_PIXELS(anchor.x), (float)METERS_TO_PIXELS(anchor.y) }, mouse_pos, RED);
+		});
 	}
 	else if (mouse_joint && IsMouseButtonReleased(MOUSE_LEFT_BUTTON))
 	{
@@ -289,11 +268,17 @@ update_status ModulePhysics::PostUpdate()
 bool ModulePhysics::CleanUp()
 {
 	LOG("ModulePhysics: Destruint mon de fisica");
-	for (size_t i = 0; i < bodies.size(); ++i)
+	for (size_t i = 0; i < body_chunks.size(); ++i)
 	{
-		delete bodies[i];
+		delete[] body_chunks[i];
 	}
-	bodies.clear();
+	body_chunks.clear();
+	free_body = -1;
+	live_bodies = 0;
+
+	telemetry.End();
+	vehicles.Clear();
+	vehicle_grid.Clear();
 
 	if (world)
 	{
@@ -304,8 +289,183 @@ bool ModulePhysics::CleanUp()
 	return true;
 }
 
+const char* ModulePhysics::GetContactSolverName() const
+{
+	if (world == nullptr) return "scalar";
+	if (world->GetSoftStepCount() > 0) return TextFormat("soft %d sub-steps", world->GetSoftStepCount());
+	if (!world->GetWideContactSolver()) return "scalar";
+
+	switch (b2GetSimdLevel())
+	{
+	case b2_simdAVX2: return "wide AVX2 x8";
+	case b2_simdSSE2: return "wide SSE2 x4";
+	default: return "wide scalar x4";
+	}
+}
+
+void ModulePhysics::SetStepRate(float hz)
+{
+	float step = 1.0f / hz;
+	if (step == fixed_step) return;
+
+	// Keep the pending time, it is real time and not a number of steps
+	fixed_step = step;
+	step_stats.step_ms_avg = 0.0f;
+	LOG("ModulePhysics: Freq. de fisica %.0f Hz", hz);
+}
+
+void ModulePhysics::RebuildStaticTree()
+{
+	world->RebuildStaticTree();
+	LOG("ModulePhysics: Arbre estatic reconstruit, %d proxies, alcada %d",
+		world->GetContactManager().m_broadPhase.GetStaticProxyCount(), world->GetStaticTreeHeight());
+}
+
+void ModulePhysics::ResetContacts()
+{
+	world->ResetContacts();
+	world->RebuildStaticTree();
+}
+
+PhysBody* ModulePhysics::GetSlot(int index) const
+{
+	return &body_chunks[index / PHYS_BODY_CHUNK][index % PHYS_BODY_CHUNK];
+}
+
+PhysBody* ModulePhysics::AllocBody()
+{
+	if (free_body == -1)
+	{
+		// Add a chunk and thread its slots onto the free list in order
+		int first = (int)body_chunks.size() * PHYS_BODY_CHUNK;
+		PhysBody* chunk = new PhysBody[PHYS_BODY_CHUNK];
+		for (int i = 0; i < PHYS_BODY_CHUNK; ++i)
+		{
+			chunk[i].pool_index = first + i;
+			chunk[i].next_free = (i + 1 < PHYS_BODY_CHUNK) ? first + i + 1 : -1;
+		}
+		body_chunks.push_back(chunk);
+		free_body = first;
+	}
+
+	PhysBody* pbody = GetSlot(free_body);
+	free_body = pbody->next_free;
+
+	pbody->width = 0;
+	pbody->height = 0;
+	pbody->body = nullptr;
+	pbody->listener = nullptr;
+	pbody->next_free = -1;
+	pbody->in_use = true;
+	++live_bodies;
+
+	return pbody;
+}
+
+void ModulePhysics::DestroyBody(PhysBody* pbody)
+{
+	if (pbody == nullptr || !pbody->in_use) return;
+
+	if (pbody->body != nullptr)
+	{
+		if (mouse_joint != nullptr && mouse_joint->GetBodyB() == pbody->body)
+		{
+			// Box2D destroys the joint with the body
+			mouse_joint = nullptr;
+		}
+		world->DestroyBody(pbody->body);
+		pbody->body = nullptr;
+	}
+
+	// Bump the generation so old handles stop resolving
+	pbody->listener = nullptr;
+	pbody->in_use = false;
+	++pbody->generation;
+	pbody->next_free = free_body;
+	free_body = pbody->pool_index;
+	--live_bodies;
+}
+
+void ModulePhysics::DestroyBody(PhysBodyHandle handle)
+{
+	DestroyBody(GetBody(handle));
+}
+
+PhysBodyHandle ModulePhysics::GetHandle(const PhysBody* pbody) const
+{
+	PhysBodyHandle handle;
+	if (pbody != nullptr && pbody->in_use)
+	{
+		handle.index = pbody->pool_index;
+		handle.generation = pbody->generation;
+	}
+	return handle;
+}
+
+PhysBody* ModulePhysics::GetBody(PhysBodyHandle handle) const
+{
+	if (handle.index < 0 || handle.index >= GetBodyCapacity()) return nullptr;
+
+	PhysBody* pbody = GetSlot(handle.index);
+	if (!pbody->in_use || pbody->generation != handle.generation) return nullptr;
+
+	return pbody;
+}
+
+void ModulePhysics::SaveSnapshot(WorldSnapshot& snapshot) const
+{
+	snapshot.bodies.clear();
+	for (b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+	{
+		if (b->GetType() == b2_staticBody) continue;
+
+		BodySnapshot state;
+		state.body = b;
+		state.position = b->GetPosition();
+		state.angle = b->GetAngle();
+		state.linear_velocity = b->GetLinearVelocity();
+		state.angular_velocity = b->GetAngularVelocity();
+		state.awake = b->IsAwake();
+		state.enabled = b->IsEnabled();
+		snapshot.bodies.push_back(state);
+	}
+}
+
+void ModulePhysics::RestoreSnapshot(const WorldSnapshot& snapshot)
+{
+	for (const BodySnapshot& state : snapshot.bodies)
+	{
+		b2Body* b = state.body;
+		b->SetEnabled(state.enabled);
+		b->SetTransform(state.position, state.angle);
+		b->SetLinearVelocity(state.linear_velocity);
+		b->SetAngularVelocity(state.angular_velocity);
+		b->SetAwake(state.awake);
+	}
+
+	// Forces and leftover time belong to the state we are leaving
+	world->ClearForces();
+	accumulator = 0.0f;
+}
+
 void ModulePhysics::BeginContact(b2Contact* contact)
 {
+	// Velocities are still the ones before the impact, the solver runs after
+	if (!contact->GetFixtureA()->IsSensor() && !contact->GetFixtureB()->IsSensor())
+	{
+		b2WorldManifold manifold;
+		contact->GetWorldManifold(&manifold);
+		int points = contact->GetManifold()->pointCount;
+		if (points > 0)
+		{
+			b2Body* a = contact->GetFixtureA()->GetBody();
+			b2Body* b = contact->GetFixtureB()->GetBody();
+			b2Vec2 point = points > 1 ? 0.5f * (manifold.points[0] + manifold.points[1]) : manifold.points[0];
+			float speed = b2Dot(a->GetLinearVelocityFromWorldPoint(point) - b->GetLinearVelocityFromWorldPoint(point), manifold.normal);
+			if (speed > IMPACT_MIN_SPEED) impacts.push_back({ a, b, point, manifold.normal, speed });
+		}
+	}
+
 	PhysBody* physA = reinterpret_cast<PhysBody*>(contact->GetFixtureA()->GetBody()->GetUserData().pointer);
 	PhysBody* physB = reinterpret_cast<PhysBody*>(contact->GetFixtureB()->GetBody()->GetUserData().pointer);
 
@@ -339,13 +499,12 @@ PhysBody* ModulePhysics::CreateCircle(int x, int y, int radius, PhysBodyType typ
 
 	body->CreateFixture(&fixture_def);
 
-	PhysBody* pbody = new PhysBody();
+	PhysBody* pbody = AllocBody();
 	pbody->body = body;
 	body->GetUserData().pointer = reinterpret_cast<uintptr_t>(pbody);
 	pbody->width = radius * 2;
 	pbody->height = radius * 2;
 
-	bodies.push_back(pbody);
 	LOG("ModulePhysics: Cercle creat a (%d %d) amb radi %d", x, y, radius);
 	return pbody;
 }
@@ -373,13 +532,12 @@ PhysBody* ModulePhysics::CreateRectangle(int x, int y, int width, int height, Ph
 
 	body->CreateFixture(&fixture_def);
 
-	PhysBody* pbody = new PhysBody();
+	PhysBody* pbody = AllocBody();
 	pbody->body = body;
 	body->GetUserData().pointer = reinterpret_cast<uintptr_t>(pbody);
 	pbody->width = width;
 	pbody->height = height;
 
-	bodies.push_back(pbody);
 	LOG("ModulePhysics: Rectangle creat a (%d %d) amb dimensions %dx%d", x, y, width, height);
 	return pbody;
 }
@@ -402,13 +560,12 @@ PhysBody* ModulePhysics::CreateRectangleSensor(int x, int y, int width, int heig
 
 	body->CreateFixture(&fixture_def);
 
-	PhysBody* pbody = new PhysBody();
+	PhysBody* pbody = AllocBody();
 	pbody->body = body;
 	body->GetUserData().pointer = reinterpret_cast<uintptr_t>(pbody);
 	pbody->width = width;
 	pbody->height = height;
 
-	bodies.push_back(pbody);
 	LOG("ModulePhysics: Sensor rectangle creat a (%d %d) amb dimensions %dx%d", x, y, width, height);
 	return pbody;
 }
@@ -454,11 +611,10 @@ PhysBody* ModulePhysics::CreateChain(int x, int y, const int* points, int size,
 
 	delete[] p;
 
-	PhysBody* pbody = new PhysBody();
+	PhysBody* pbody = AllocBody();
 	pbody->body = body;
 	body->GetUserData().pointer = reinterpret_cast<uintptr_t>(pbody);
 
-	bodies.push_back(pbody);
 	LOG("ModulePhysics: Cadena creada a (%d %d) amb %d punts", x, y, num_vertices);
 	return pbody;
 }
\ No newline at end of file
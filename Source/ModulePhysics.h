@@ -8,6 +8,11 @@
 #include "box2d/box2d.h"
 #pragma warning(pop)
 
+#include "PhysicsDebugDraw.h"
+#include "Telemetry.h"
+#include "VehicleGrid.h"
+#include "VehicleSystem.h"
+
 #include <vector>
 
 #define GRAVITY_X 0.0f
@@ -22,6 +27,44 @@
 #define RAD_TO_DEG 57.29577951308232f
 #define DEG_TO_RAD 0.01745329251994f
 
+// PhysBody slots are allocated in chunks that never move, so pointers stay valid
+#define PHYS_BODY_CHUNK 128
+
+// Sub-steps used by the soft contact solver when it is enabled (F3 in debug)
+#define SOFT_STEP_COUNT 4
+
+// Fixed step scheduler. When a frame needs more steps than allowed the rest of
+// the frame time is dropped and the simulation runs slower than real time.
+#define RACE_STEP_RATE 120.0f
+#define MENU_STEP_RATE 30.0f
+#define MAX_STEPS_PER_FRAME 8
+#define STEP_BUDGET_MS 8.0f // physics time allowed per frame, limits the steps with the average step cost
+#define MAX_FRAME_TIME 0.25f
+
+struct StepStats
+{
+	int steps_last_frame = 0;
+	int max_steps_last_frame = 0; // cap applied last frame, after the budget
+	float step_ms_last = 0.0f;
+	float step_ms_avg = 0.0f;
+	float dropped_last_frame = 0.0f; // seconds of sim time not simulated
+	float dropped_total = 0.0f;
+	float time_scale = 1.0f; // sim time / real time of the last frame
+	int capped_frames = 0;
+};
+
+// A touch that began during the steps of the last frame, for the effects.
+// Only the ones closing faster than IMPACT_MIN_SPEED are kept
+#define IMPACT_MIN_SPEED 2.0f // m/s along the normal
+struct ContactImpact
+{
+	b2Body* body_a;
+	b2Body* body_b;
+	b2Vec2 point;		// meters
+	b2Vec2 normal;		// from A to B
+	float speed;		// closing speed along the normal
+};
+
 enum class PhysBodyType
 {
 	STATIC,
@@ -29,8 +72,39 @@ enum class PhysBodyType
 	KINEMATIC
 };
 
+// Generation checked reference to a pooled PhysBody. Stale handles resolve to nullptr.
+struct PhysBodyHandle
+{
+	int index = -1;
+	unsigned int generation = 0;
+};
+
+// Dynamic state of one body. Plain data, a snapshot restores in a single pass.
+struct BodySnapshot
+{
+	b2Body* body = nullptr;
+	b2Vec2 position = { 0.0f, 0.0f };
+	float angle = 0.0f;
+	b2Vec2 linear_velocity = { 0.0f, 0.0f };
+	float angular_velocity = 0.0f;
+	bool awake = false;
+	bool enabled = false;
+};
+
+// Every non-static body of the world. Static bodies are left alone, they are
+// cached with the track.
+struct WorldSnapshot
+{
+	std::vector<BodySnapshot> bodies;
+
+	bool IsValid() const { return !bodies.empty(); }
+	void Clear() { bodies.clear(); }
+};
+
 class PhysBody
 {
+	friend class ModulePhysics;
+
 public:
 	PhysBody();
 	~PhysBody();
@@ -45,6 +119,12 @@ public:
 	int height = 0;
 	b2Body* body = nullptr;
 	Module* listener = nullptr;
+
+private:
+	int pool_index = -1;
+	int next_free = -1;
+	unsigned int generation = 0;
+	bool in_use = false;
 };
 
 class ModulePhysics : public Module, public b2ContactListener
@@ -63,11 +143,48 @@ public:
 	PhysBody* CreateRectangleSensor(int x, int y, int width, int height);
 	PhysBody* CreateChain(int x, int y, const int* points, int size, PhysBodyType type = PhysBodyType::STATIC);
 
+	// Destroys the b2Body and returns the slot to the pool
+	void DestroyBody(PhysBody* pbody);
+	void DestroyBody(PhysBodyHandle handle);
+
+	PhysBodyHandle GetHandle(const PhysBody* pbody) const;
+	PhysBody* GetBody(PhysBodyHandle handle) const;
+
+	// Snapshots hold b2Body pointers, destroying a body invalidates them
+	void SaveSnapshot(WorldSnapshot& snapshot) const;
+	void RestoreSnapshot(const WorldSnapshot& snapshot);
+
+	int GetLiveBodyCount() const { return live_bodies; }
+	int GetBodyCapacity() const { return (int)body_chunks.size() * PHYS_BODY_CHUNK; }
+
 	void BeginContact(b2Contact* contact) override;
 
 	b2World* GetWorld() const { return world; }
+	const char* GetContactSolverName() const;
+
+	// Bulk build of the static broadphase tree, call once the track walls exist
+	void RebuildStaticTree();
+	// Contacts and broadphase of a new world with the same bodies, what a
+	// RaceRecording replay starts from (RaceRecording::CreateWorld)
+	void ResetContacts();
+
+	// Fixed step scheduler
+	void SetStepRate(float hz);
+	float GetStepRate() const { return 1.0f / fixed_step; }
+	float GetFixedStep() const { return fixed_step; }
+	void SetMaxStepsPerFrame(int steps) { max_steps_per_frame = steps > 0 ? steps : 1; }
+	const StepStats& GetStepStats() const { return step_stats; }
+	const std::vector<ContactImpact>& GetImpacts() const { return impacts; }
 
 	bool debug;
+	PhysicsDebugDraw debug_draw;
+
+	// Drive model of every car, applied before every step
+	VehicleSystem vehicles;
+	// Neighbour queries between cars, rebuilt after stepping
+	VehicleGrid vehicle_grid;
+	// Every car at every step while a race records it
+	TelemetryRecorder telemetry;
 
 private:
 	b2World* world = nullptr;
@@ -75,8 +192,17 @@ private:
 	b2MouseJoint* mouse_joint = nullptr;
 	b2Body* mouse_body = nullptr;
 
-	std::vector<PhysBody*> bodies;
+	PhysBody* AllocBody();
+	PhysBody* GetSlot(int index) const;
+
+	// PhysBody pool
+	std::vector<PhysBody*> body_chunks;
+	int free_body = -1;
+	int live_bodies = 0;
 
 	float accumulator;
-	const float FIXED_TIMESTEP = 1.0f / 60.0f; // 60 actualizaciones de fisica por segundo siempre
+	float fixed_step = 1.0f / RACE_STEP_RATE;
+	int max_steps_per_frame = MAX_STEPS_PER_FRAME;
+	StepStats step_stats;
+	std::vector<ContactImpact> impacts;
 };
\ No newline at end of file
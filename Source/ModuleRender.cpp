@@ -3,13 +3,25 @@
 #include "ModuleWindow.h"
 #include "ModuleRender.h"
 #include "ModulePhysics.h"
+#include <algorithm>
 #include <math.h>
 
+#define RENDER_INDEX_BITS 24	// submission order, the sprites of a frame
+#define RENDER_TEXTURE_BITS 20
+#define RENDER_DEPTH_BITS 16
+
+// Which layers sort by texture and which are drawn through the camera, by RenderLayer
+static const bool layer_sorted[(int)RenderLayer::COUNT] = { true, true, true, true, false, false };
+static const bool layer_world[(int)RenderLayer::COUNT] = { true, true, true, true, true, false };
+
 ModuleRender::ModuleRender(Application* app, bool start_enabled) : Module(app, start_enabled)
 {
 	background = RAYWHITE;
-	camera_x = 0.0f;
-	camera_y = 0.0f;
+	camera = { 0 };
+	camera.offset = { SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f };
+	camera.target = camera.offset;
+	camera.zoom = 1.0f;
+	UpdateView();
 }
 
 ModuleRender::~ModuleRender()
@@ -19,23 +31,39 @@ ModuleRender::~ModuleRender()
 bool ModuleRender::Init()
 {
 	LOG("ModuleRender: Creant context de render");
+
+	// Everything that draws in the race and the menus next to each other, the
+	// full screen images stay textures of their own
+	atlas.AddFolder("Assets/Textures/Cars");
+	atlas.AddFolder("Assets/Textures/Characters");
+	atlas.Add("Assets/Textures/UI/tablero_fondo.png");
+	atlas.Add("Assets/Textures/UI/trafficlight.png");
+	atlas.Build();
+
+	hud.Init(SCREEN_WIDTH, SCREEN_HEIGHT);
+
 	return true;
 }
 
+// Last of the PreUpdates, so everything drawn during Update lands on the cleared frame
 update_status ModuleRender::PreUpdate()
 {
+	BeginDrawing();
+	ClearBackground(background);
 	return UPDATE_CONTINUE;
 }
 
 update_status ModuleRender::Update()
 {
-	ClearBackground(background);
-	BeginDrawing();
 	return UPDATE_CONTINUE;
 }
 
 update_status ModuleRender::PostUpdate()
 {
+	hud.Update();
+	hud.Submit();
+	FlushSprites();
+
 	DrawFPS(10, 10);
 
 	if (App->physics->debug)
@@ -43,7 +71,23 @@ update_status ModuleRender::PostUpdate()
 		DrawText("DEBUG MODE ACTIVATED", 10, 40, 20, RED);
 		DrawText("Click to drag objects!", 10, 65, 16, DARKGRAY);
 		DrawText("Press F1 to disable Debug Mode", 10, 85, 16, DARKGRAY);
-		DrawText(TextFormat("Camera: (%.0f, %.0f)", camera_x, camera_y), 10, 110, 16, BLUE);
+		DrawText(TextFormat("Camera: (%.0f, %.0f) zoom %.2f, rotation %.0f", camera.target.x, camera.target.y, camera.zoom, camera.rotation),
+			10, 110, 16, BLUE);
+		DrawText(TextFormat("Contact solver: %s (F2 wide, F3 soft)", App->physics->GetContactSolverName()), 10, 130, 16, BLUE);
+
+		const b2BroadPhase& broad_phase = App->physics->GetWorld()->GetContactManager().m_broadPhase;
+		DrawText(TextFormat("Broadphase height: dynamic %d, static %d", broad_phase.GetTreeHeight(), broad_phase.GetStaticTreeHeight()), 10, 150, 16, BLUE);
+		DrawText(TextFormat("Pair queries: %d dynamic, %d static", broad_phase.GetDynamicQueryCount(), broad_phase.GetStaticQueryCount()), 10, 170, 16, BLUE);
+		DrawText(TextFormat("PhysBody pool: %d / %d", App->physics->GetLiveBodyCount(), App->physics->GetBodyCapacity()), 10, 190, 16, BLUE);
+
+		const StepStats& step_stats = App->physics->GetStepStats();
+		DrawText(TextFormat("Physics %.0f Hz: %d/%d steps, %.2f ms/step, x%.2f", App->physics->GetStepRate(), step_stats.steps_last_frame,
+			step_stats.max_steps_last_frame, step_stats.step_ms_avg, step_stats.time_scale), 10, 210, 16, BLUE);
+		DrawText(TextFormat("Dropped sim time: %.2f s in %d frames", step_stats.dropped_total, step_stats.capped_frames), 10, 230, 16, BLUE);
+		DrawText(TextFormat("Debug draw: %d fixtures, %d lines", App->physics->debug_draw.fixtures_drawn, App->physics->debug_draw.lines_drawn), 10, 250, 16, BLUE);
+		DrawText(TextFormat("Sprites: %d + %d deferred, %d culled, draw calls %d -> %d sorted", stats.sprites, stats.deferred, stats.culled,
+			stats.submitted_draw_calls, stats.draw_calls), 10, 270, 16, BLUE);
+		DrawText(TextFormat("HUD: %d widgets, %d redrawn", hud.GetWidgetCount(), hud.GetRedrawn()), 10, 290, 16, BLUE);
 	}
 	else
 	{
@@ -58,6 +102,8 @@ update_status ModuleRender::PostUpdate()
 bool ModuleRender::CleanUp()
 {
 	LOG("ModuleRender: Netejant render");
+	hud.CleanUp();
+	atlas.Unload();
 	return true;
 }
 
@@ -66,28 +112,67 @@ void ModuleRender::SetBackgroundColor(Color color)
 	background = color;
 }
 
-void ModuleRender::SetCameraPosition(float x, float y)
+void ModuleRender::CenterCameraOn(float x, float y)
 {
-	camera_x = x;
-	camera_y = y;
+	camera.target = { x, y };
+	UpdateView();
 }
 
-void ModuleRender::CenterCameraOn(float x, float y)
+void ModuleRender::UpdateCamera(float target_x, float target_y, float smoothness)
 {
-	camera_x = (SCREEN_WIDTH / 2.0f) - x;
-	camera_y = (SCREEN_HEIGHT / 2.0f) - y;
+	camera.target.x += (target_x - camera.target.x) * smoothness;
+	camera.target.y += (target_y - camera.target.y) * smoothness;
+	UpdateView();
 }
 
-void ModuleRender::UpdateCamera(float target_x, float target_y, float smoothness)
+void ModuleRender::SetCameraZoom(float zoom)
 {
-	float desired_x = (SCREEN_WIDTH / 2.0f) - target_x;
-	float desired_y = (SCREEN_HEIGHT / 2.0f) - target_y;
+	camera.zoom = std::min(std::max(zoom, CAMERA_ZOOM_MIN), CAMERA_ZOOM_MAX);
+	UpdateView();
+}
 
-	camera_x += (desired_x - camera_x) * smoothness;
-	camera_y += (desired_y - camera_y) * smoothness;
+void ModuleRender::SetCameraRotation(float degrees)
+{
+	camera.rotation = degrees;
+	UpdateView();
+}
+
+bool ModuleRender::IsVisible(Rectangle bounds) const
+{
+	return bounds.x < view.x + view.width + CAMERA_CULL_MARGIN && bounds.x + bounds.width > view.x - CAMERA_CULL_MARGIN &&
+		bounds.y < view.y + view.height + CAMERA_CULL_MARGIN && bounds.y + bounds.height > view.y - CAMERA_CULL_MARGIN;
+}
+
+Vector2 ModuleRender::ScreenToWorld(Vector2 position) const
+{
+	return GetScreenToWorld2D(position, camera);
+}
+
+// Bounding box of the four screen corners in the world
+void ModuleRender::UpdateView()
+{
+	Vector2 corners[4] =
+	{
+		GetScreenToWorld2D({ 0.0f, 0.0f }, camera),
+		GetScreenToWorld2D({ (float)SCREEN_WIDTH, 0.0f }, camera),
+		GetScreenToWorld2D({ 0.0f, (float)SCREEN_HEIGHT }, camera),
+		GetScreenToWorld2D({ (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT }, camera)
+	};
+
+	Vector2 min = corners[0];
+	Vector2 max = corners[0];
+	for (int i = 1; i < 4; ++i)
+	{
+		min.x = std::min(min.x, corners[i].x);
+		min.y = std::min(min.y, corners[i].y);
+		max.x = std::max(max.x, corners[i].x);
+		max.y = std::max(max.y, corners[i].y);
+	}
+	view = { min.x, min.y, max.x - min.x, max.y - min.y };
 }
 
-bool ModuleRender::Draw(Texture2D texture, int x, int y, const Rectangle* section, double angle, int pivot_x, int pivot_y) const
+bool ModuleRender::Draw(Texture2D texture, int x, int y, const Rectangle* section, double angle, int pivot_x, int pivot_y, Color tint,
+	RenderLayer layer, int depth)
 {
 	if (texture.id == 0)
 	{
@@ -104,22 +189,126 @@ bool ModuleRender::Draw(Texture2D texture, int x, int y, const Rectangle* sectio
 		source_rect = { 0.0f, 0.0f, (float)texture.width, (float)texture.height };
 	}
 
-	// Calculate screen position with camera
-	Vector2 screen_pos;
-	screen_pos.x = (float)x + camera_x;
-	screen_pos.y = (float)y + camera_y;
-
-	// Rotation origin
+	Rectangle dest_rect = { (float)x, (float)y, source_rect.width, source_rect.height };
 	Vector2 origin = { (float)pivot_x, (float)pivot_y };
+	DrawSprite(layer, texture, source_rect, dest_rect, origin, (float)angle, tint, depth);
 
-	Rectangle dest_rect;
-	dest_rect.x = screen_pos.x;
-	dest_rect.y = screen_pos.y;
-	dest_rect.width = source_rect.width;
-	dest_rect.height = source_rect.height;
+	return true;
+}
 
-	// Rotate texture
-	DrawTexturePro(texture, source_rect, dest_rect, origin, (float)angle, WHITE);
+void ModuleRender::DrawSprite(RenderLayer layer, Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint, int depth)
+{
+	if (texture.id == 0) return;
 
-	return true;
-}
\ No newline at end of file
+	if (layer_world[(int)layer])
+	{
+		// Rotated sprites get the circle the corners turn on
+		Rectangle bounds = { dest.x - origin.x, dest.y - origin.y, dest.width, dest.height };
+		if (rotation != 0.0f)
+		{
+			float reach_x = std::max(origin.x, dest.width - origin.x);
+			float reach_y = std::max(origin.y, dest.height - origin.y);
+			float radius = sqrtf(reach_x * reach_x + reach_y * reach_y);
+			bounds = { dest.x - radius, dest.y - radius, 2.0f * radius, 2.0f * radius };
+		}
+		if (!IsVisible(bounds))
+		{
+			culled++;
+			return;
+		}
+	}
+
+	Sprite sprite = { texture, source, dest, origin, rotation, tint, -1 };
+	Submit(layer, depth, sprite);
+}
+
+void ModuleRender::DrawDeferred(RenderLayer layer, const std::function<void()>& draw, int depth)
+{
+	Sprite sprite = {};
+	sprite.deferred = (int)deferred_draws.size();
+	deferred_draws.push_back(draw);
+	Submit(layer, depth, sprite);
+}
+
+// Key: layer, depth, texture on the sorted layers, submission index
+void ModuleRender::Submit(RenderLayer layer, int depth, const Sprite& sprite)
+{
+	uint64_t index = sprites.size();
+	if (index >= (1u << RENDER_INDEX_BITS)) return;
+
+	uint64_t depth_key = (uint64_t)std::min(std::max(depth + (1 << (RENDER_DEPTH_BITS - 1)), 0), (1 << RENDER_DEPTH_BITS) - 1);
+	uint64_t texture_key = 0;
+	if (layer_sorted[(int)layer] && sprite.deferred < 0)
+	{
+		texture_key = std::min(sprite.texture.id, (1u << RENDER_TEXTURE_BITS) - 1);
+	}
+
+	uint64_t key = (uint64_t)layer << (RENDER_DEPTH_BITS + RENDER_TEXTURE_BITS + RENDER_INDEX_BITS);
+	key |= depth_key << (RENDER_TEXTURE_BITS + RENDER_INDEX_BITS);
+	key |= texture_key << RENDER_INDEX_BITS;
+	key |= index;
+
+	sprites.push_back(sprite);
+	sort_keys.push_back(key);
+}
+
+// rlgl starts a new draw call on every texture change, deferred drawing is
+// counted as one and breaks the run
+int ModuleRender::CountDrawCalls(bool sorted) const
+{
+	int calls = 0;
+	unsigned int texture = 0;
+	for (size_t i = 0; i < sprites.size(); ++i)
+	{
+		const Sprite& sprite = sorted ? sprites[sort_keys[i] & ((1u << RENDER_INDEX_BITS) - 1)] : sprites[i];
+		if (sprite.deferred >= 0)
+		{
+			calls++;
+			texture = 0;
+		}
+		else if (sprite.texture.id != texture)
+		{
+			calls++;
+			texture = sprite.texture.id;
+		}
+	}
+	return calls;
+}
+
+void ModuleRender::FlushSprites()
+{
+	stats.sprites = (int)(sprites.size() - deferred_draws.size());
+	stats.deferred = (int)deferred_draws.size();
+	stats.culled = culled;
+	stats.submitted_draw_calls = CountDrawCalls(false);
+
+	std::sort(sort_keys.begin(), sort_keys.end());
+	stats.draw_calls = CountDrawCalls(true);
+
+	// The world layers come first, one BeginMode2D covers all of them
+	bool in_world = false;
+	for (uint64_t key : sort_keys)
+	{
+		int layer = (int)(key >> (RENDER_DEPTH_BITS + RENDER_TEXTURE_BITS + RENDER_INDEX_BITS));
+		if (layer_world[layer] != in_world)
+		{
+			if (layer_world[layer]) BeginMode2D(camera);
+			else EndMode2D();
+			in_world = layer_world[layer];
+		}
+
+		const Sprite& sprite = sprites[key & ((1u << RENDER_INDEX_BITS) - 1)];
+		if (sprite.deferred >= 0)
+		{
+			deferred_draws[sprite.deferred]();
+			continue;
+		}
+		DrawTexturePro(sprite.texture, sprite.source, sprite.dest, sprite.origin, sprite.rotation, sprite.tint);
+	}
+	if (in_world) EndMode2D();
+
+	culled = 0;
+	sprites.clear();
+	sort_keys.clear();
+	deferred_draws.clear();
+}
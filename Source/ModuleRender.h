@@ -3,8 +3,43 @@
 #include "Globals.h"
 
 #include "raylib.h"
+#include "TextureAtlas.h"
+#include "HudCanvas.h"
 
+#include <functional>
 #include <limits.h>
+#include <stdint.h>
+#include <vector>
+
+#define CAMERA_ZOOM_MIN 0.25f
+#define CAMERA_ZOOM_MAX 2.0f
+#define CAMERA_ZOOM_STEP 0.1f	// per mouse wheel notch
+#define CAMERA_CULL_MARGIN 64.0f	// world pixels, the camera still follows the player after the sprites are in
+
+// Layers of the sprite batch, flushed in this order. The world layers are drawn
+// inside BeginMode2D with the camera, HUD is in screen pixels. BACKGROUND to EFFECTS
+// are sorted by depth and then by texture so every texture of a layer is one
+// draw call; DEBUG and HUD keep the order things were submitted in.
+enum class RenderLayer
+{
+	BACKGROUND,
+	TRACK,
+	VEHICLES,
+	EFFECTS,
+	DEBUG,
+	HUD,
+	COUNT
+};
+
+// Sprite batch of the last frame
+struct RenderStats
+{
+	int sprites = 0;
+	int deferred = 0;
+	int submitted_draw_calls = 0;	// texture changes in the order they were submitted, what drawing them right away costs
+	int draw_calls = 0;				// after sorting
+	int culled = 0;					// world sprites outside the view, never queued
+};
 
 class ModuleRender : public Module
 {
@@ -19,15 +54,62 @@ public:
 	bool CleanUp();
 
 	void SetBackgroundColor(Color color);
-	bool Draw(Texture2D texture, int x, int y, const Rectangle* section = NULL, double angle = 0, int pivot_x = 0, int pivot_y = 0) const;
+	// Sprites are queued during Update and drawn in PostUpdate, x and y are
+	// world pixels (screen pixels on the HUD layer)
+	bool Draw(Texture2D texture, int x, int y, const Rectangle* section = NULL, double angle = 0, int pivot_x = 0, int pivot_y = 0, Color tint = WHITE,
+		RenderLayer layer = RenderLayer::VEHICLES, int depth = 0);
+	// Same with a destination rectangle, for scaled sprites
+	void DrawSprite(RenderLayer layer, Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin = { 0, 0 }, float rotation = 0.0f,
+		Color tint = WHITE, int depth = 0);
+	// Immediate mode drawing (text, shapes) run in its place of the layer order
+	void DrawDeferred(RenderLayer layer, const std::function<void()>& draw, int depth = 0);
+
+	const RenderStats& GetStats() const { return stats; }
 
-	void SetCameraPosition(float x, float y);
+	// The camera looks at a world point in the middle of the screen
 	void CenterCameraOn(float x, float y);
 	void UpdateCamera(float target_x, float target_y, float smoothness = 0.1f);
+	void SetCameraZoom(float zoom);
+	void SetCameraRotation(float degrees);
+	const Camera2D& GetCamera() const { return camera; }
+	// World pixels on screen, the bounding box of the view when it is rotated.
+	// World drawing tests against it before anything is submitted.
+	Rectangle GetViewRect() const { return view; }
+	bool IsVisible(Rectangle bounds) const;
+	Vector2 ScreenToWorld(Vector2 position) const;
 
 public:
 
 	Color background;
-	float camera_x;
-	float camera_y;
+
+	// Cars, portraits and the small UI textures, packed when the renderer starts
+	TextureAtlas atlas;
+	// Race HUD widgets, drawn again only when they change
+	HudCanvas hud;
+
+private:
+	struct Sprite
+	{
+		Texture2D texture;
+		Rectangle source;
+		Rectangle dest;
+		Vector2 origin;
+		float rotation;
+		Color tint;
+		int deferred;	// index in deferred_draws, -1 for a sprite
+	};
+
+	void UpdateView();
+	void Submit(RenderLayer layer, int depth, const Sprite& sprite);
+	void FlushSprites();
+	int CountDrawCalls(bool sorted) const;
+
+	std::vector<Sprite> sprites;
+	std::vector<uint64_t> sort_keys;
+	std::vector<std::function<void()>> deferred_draws;
+	RenderStats stats;
+	int culled = 0;
+
+	Camera2D camera;
+	Rectangle view;
 };
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "Globals.h"
+#include "ParticleSystem.h"
+#include "rlgl.h"
+
+#include <math.h>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "ModulePhysics.h"
+#pragma warning(pop)
+
+static const ParticleEffectParams effect_params[(int)ParticleEffect::COUNT] =
+{
+	// NITRO: blue flame out of the exhaust
+	{ 150.0f, 40.0f, 5.0f, 100.0f, 150.0f, 0.2f, 0.5f, 1.0f, 8.0f, 24.0f, 0.5f, 0.0f, 0.0f,
+		Color{ 0, 150, 255, 255 }, Color{ 255, 255, 255, 255 } },
+	// DRIFT_SMOKE: tires sliding sideways
+	{ 60.0f, 30.0f, 12.0f, 10.0f, 40.0f, 1.2f, 0.6f, 1.2f, 10.0f, 36.0f, 2.0f, 3.0f, 7.0f,
+		Color{ 200, 200, 200, 110 }, Color{ 240, 240, 240, 70 } },
+	// CRASH_SPARKS: burst at the impact
+	{ 0.0f, 0.0f, 4.0f, 150.0f, 320.0f, 1.2f, 0.2f, 0.4f, 4.0f, 1.0f, 4.0f, 0.0f, 0.0f,
+		Color{ 255, 220, 60, 255 }, Color{ 255, 120, 20, 255 } },
+};
+
+static unsigned char Lerp(unsigned char a, unsigned char b, float t)
+{
+	return (unsigned char)(a + (b - a) * t);
+}
+
+ParticleSystem::ParticleSystem() : count(0), dropped(0), random(), texture({ 0 })
+{
+}
+
+bool ParticleSystem::Init()
+{
+	// Soft round dot, white so the particle color is the vertex color
+	Image image = GenImageGradientRadial(PARTICLE_TEXTURE_SIZE, PARTICLE_TEXTURE_SIZE, 0.0f, WHITE, BLANK);
+	texture = LoadTextureFromImage(image);
+	UnloadImage(image);
+
+	if (texture.id == 0)
+	{
+		LOG("ParticleSystem: Could not create the particle texture");
+		return false;
+	}
+	SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+	return true;
+}
+
+void ParticleSystem::CleanUp()
+{
+	Clear();
+	if (texture.id != 0) UnloadTexture(texture);
+	texture = { 0 };
+}
+
+int ParticleSystem::AddEmitter(ParticleEffect effect, int vehicle_id)
+{
+	Emitter emitter = { effect, vehicle_id, 0.0f, 0.0f };
+	emitters.push_back(emitter);
+	return (int)emitters.size() - 1;
+}
+
+void ParticleSystem::SetIntensity(int emitter, float intensity)
+{
+	if (emitter < 0 || emitter >= (int)emitters.size()) return;
+	emitters[emitter].intensity = intensity;
+}
+
+void ParticleSystem::Clear()
+{
+	emitters.clear();
+	count = 0;
+	dropped = 0;
+}
+
+void ParticleSystem::Burst(ParticleEffect effect, Vector2 position, Vector2 direction, int amount)
+{
+	Emit(effect, position.x, position.y, direction.x, direction.y, amount);
+}
+
+void ParticleSystem::Update(float dt, const VehicleSystem& vehicles)
+{
+	for (Emitter& emitter : emitters)
+	{
+		if (!vehicles.IsValid(emitter.vehicle_id)) continue;
+
+		const ParticleEffectParams& params = effect_params[(int)emitter.effect];
+		const b2Vec2& forward = vehicles.GetForward(emitter.vehicle_id);
+		if (params.slip_full > 0.0f)
+		{
+			float slip = fabsf(b2Cross(forward, vehicles.GetVelocity(emitter.vehicle_id)));
+			emitter.intensity = b2Clamp((slip - params.slip_start) / (params.slip_full - params.slip_start), 0.0f, 1.0f);
+		}
+		if (emitter.intensity <= 0.0f)
+		{
+			emitter.accumulator = 0.0f;
+			continue;
+		}
+
+		emitter.accumulator += params.rate * emitter.intensity * dt;
+		int amount = (int)emitter.accumulator;
+		if (amount == 0) continue;
+		emitter.accumulator -= amount;
+
+		const b2Vec2& position = vehicles.GetPosition(emitter.vehicle_id);
+		float x = position.x * PIXELS_PER_METER - forward.x * params.offset;
+		float y = position.y * PIXELS_PER_METER - forward.y * params.offset;
+		Emit(emitter.effect, x, y, -forward.x, -forward.y, amount);
+	}
+
+	// Integrate, no branches so it vectorizes
+	for (int i = 0; i < count; ++i)
+	{
+		float damping = fmaxf(0.0f, 1.0f - drag[i] * dt);
+		vel_x[i] *= damping;
+		vel_y[i] *= damping;
+		pos_x[i] += vel_x[i] * dt;
+		pos_y[i] += vel_y[i] * dt;
+		age[i] += age_rate[i] * dt;
+	}
+
+	// Back to front, the particle moved into a slot was already checked
+	for (int i = count - 1; i >= 0; --i)
+	{
+		if (age[i] >= 1.0f)
+		{
+			count--;
+			if (i != count) Move(count, i);
+		}
+	}
+}
+
+void ParticleSystem::Draw(Rectangle view) const
+{
+	if (count == 0) return;
+
+	rlSetTexture(texture.id != 0 ? texture.id : rlGetTextureIdDefault());
+	rlBegin(RL_QUADS);
+	rlNormal3f(0.0f, 0.0f, 1.0f);
+	for (int i = 0; i < count; ++i)
+	{
+		float t = age[i];
+		float size = size_start[i] + size_delta[i] * t;
+		float x = pos_x[i];
+		float y = pos_y[i];
+		if (x + size < view.x || x - size > view.x + view.width || y + size < view.y || y - size > view.y + view.height) continue;
+
+		Color c = color[i];
+		rlColor4ub(c.r, c.g, c.b, (unsigned char)(c.a * (1.0f - t)));
+
+		// Same winding as DrawTexturePro
+		rlTexCoord2f(0.0f, 0.0f);
+		rlVertex2f(x - size, y - size);
+		rlTexCoord2f(0.0f, 1.0f);
+		rlVertex2f(x - size, y + size);
+		rlTexCoord2f(1.0f, 1.0f);
+		rlVertex2f(x + size, y + size);
+		rlTexCoord2f(1.0f, 0.0f);
+		rlVertex2f(x + size, y - size);
+	}
+	rlEnd();
+	rlSetTexture(0);
+}
+
+void ParticleSystem::Emit(ParticleEffect effect, float x, float y, float dir_x, float dir_y, int amount)
+{
+	const ParticleEffectParams& params = effect_params[(int)effect];
+	float direction = atan2f(dir_y, dir_x);
+	for (int n = 0; n < amount; ++n)
+	{
+		if (count == PARTICLE_CAPACITY)
+		{
+			dropped += amount - n;
+			return;
+		}
+
+		int i = count++;
+		float angle = direction + random.Float(-params.spread, params.spread);
+		float speed = random.Float(params.speed_min, params.speed_max);
+		pos_x[i] = x + random.Float(-params.jitter, params.jitter);
+		pos_y[i] = y + random.Float(-params.jitter, params.jitter);
+		vel_x[i] = cosf(angle) * speed;
+		vel_y[i] = sinf(angle) * speed;
+		age[i] = 0.0f;
+		age_rate[i] = 1.0f / random.Float(params.life_min, params.life_max);
+		drag[i] = params.drag;
+		size_start[i] = params.size_start;
+		size_delta[i] = params.size_end - params.size_start;
+
+		float blend = random.Float();
+		color[i] = Color{ Lerp(params.color_a.r, params.color_b.r, blend), Lerp(params.color_a.g, params.color_b.g, blend),
+			Lerp(params.color_a.b, params.color_b.b, blend), Lerp(params.color_a.a, params.color_b.a, blend) };
+	}
+}
+
+void ParticleSystem::Move(int from, int to)
+{
+	pos_x[to] = pos_x[from];
+	pos_y[to] = pos_y[from];
+	vel_x[to] = vel_x[from];
+	vel_y[to] = vel_y[from];
+	age[to] = age[from];
+	age_rate[to] = age_rate[from];
+	drag[to] = drag[from];
+	size_start[to] = size_start[from];
+	size_delta[to] = size_delta[from];
+	color[to] = color[from];
+}
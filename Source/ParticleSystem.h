@@ -0,0 +1,95 @@
+#pragma once
+
+#include "raylib.h"
+#include "RandomStream.h"
+#include "VehicleSystem.h"
+
+#include <vector>
+
+#define PARTICLE_CAPACITY 2048		// nitro, smoke and sparks of every car together
+#define PARTICLE_TEXTURE_SIZE 32
+#define CRASH_SPARKS_MAX 24			// sparks of the hardest crash
+
+enum class ParticleEffect
+{
+	NITRO,
+	DRIFT_SMOKE,
+	CRASH_SPARKS,
+	COUNT
+};
+
+// Look and motion of the particles of an effect, pixels and seconds
+struct ParticleEffectParams
+{
+	float rate;						// per second at intensity 1
+	float offset;					// behind the car center
+	float jitter;					// random placement around the emitter
+	float speed_min, speed_max;		// away from the emitter, along its direction
+	float spread;					// radians either side of the direction
+	float life_min, life_max;
+	float size_start, size_end;		// radius
+	float drag;						// fraction of the velocity lost per second
+	float slip_start, slip_full;	// m/s of sideways speed, > 0 drives the intensity from the car
+	Color color_a, color_b;			// every particle picks a color in between, alpha fades out
+};
+
+// Car effects in one fixed pool. Particles are structure-of-arrays so the
+// integration is a plain loop over floats the compiler can vectorize, and a
+// dead particle is replaced by the last one, nothing moves but that one.
+// Emitters follow a car of the VehicleSystem by id; the sliding ones read the
+// car's sideways speed, the rest get their intensity from their owner. What
+// does not fit the pool is dropped and counted. Everything is drawn as
+// textured quads with one texture, one draw call.
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+
+	// Needs the GL context, the texture is generated
+	bool Init();
+	void CleanUp();
+
+	int AddEmitter(ParticleEffect effect, int vehicle_id);
+	void SetIntensity(int emitter, float intensity);
+	// Emitters and particles of the last race
+	void Clear();
+	// A stream of the race seed, so a replay throws the same particles
+	void SetRandom(const RandomStream& stream) { random = stream; }
+
+	void Burst(ParticleEffect effect, Vector2 position, Vector2 direction, int count);
+	void Update(float dt, const VehicleSystem& vehicles);
+	// In world pixels under the camera, particles outside view are skipped
+	void Draw(Rectangle view) const;
+
+	int GetCount() const { return count; }
+	int GetDropped() const { return dropped; }
+
+private:
+	struct Emitter
+	{
+		ParticleEffect effect;
+		int vehicle_id;
+		float intensity;
+		float accumulator;
+	};
+
+	void Emit(ParticleEffect effect, float x, float y, float dir_x, float dir_y, int amount);
+	void Move(int from, int to);
+
+	alignas(16) float pos_x[PARTICLE_CAPACITY];
+	alignas(16) float pos_y[PARTICLE_CAPACITY];
+	alignas(16) float vel_x[PARTICLE_CAPACITY];
+	alignas(16) float vel_y[PARTICLE_CAPACITY];
+	alignas(16) float age[PARTICLE_CAPACITY];		// 0 born, 1 dead
+	alignas(16) float age_rate[PARTICLE_CAPACITY];	// 1 / lifetime
+	alignas(16) float drag[PARTICLE_CAPACITY];
+	alignas(16) float size_start[PARTICLE_CAPACITY];
+	alignas(16) float size_delta[PARTICLE_CAPACITY];
+	Color color[PARTICLE_CAPACITY];
+	int count;
+	int dropped;
+
+	std::vector<Emitter> emitters;
+	RandomStream random;	// visual only, never part of a snapshot or a hash
+	Texture2D texture;
+};
@@ -0,0 +1,117 @@
+#include "PerceptionScheduler.h"
+
+void PerceptionScheduler::Schedule(std::vector<AIVehicle>& cars, const VehicleGrid& grid, const b2Vec2& view_center, float dt)
+{
+	int count = (int)cars.size();
+
+	// Cars that fit in the budget at the current average cost
+	int max_sensors = count;
+	if (avg_sense_us > 0.0f && !deterministic)
+	{
+		max_sensors = (int)(AI_SENSE_BUDGET_US / avg_sense_us);
+		if (max_sensors < 1) max_sensors = 1;
+	}
+
+	const float far_sqr = AI_SENSE_FAR_VIEW * AI_SENSE_FAR_VIEW;
+
+	sensed_cars = 0;
+	scheduled_cars = 0;
+	float rate_sum = 0.0f;
+	int first_deferred = -1;
+
+	// Start where the last frame ran out of budget so nobody starves
+	for (int k = 0; k < count; ++k)
+	{
+		int index = (first_car + k) % count;
+		AIVehicle& car = cars[index];
+		AIPerception& p = car.perception;
+		p.sense = false;
+
+		if (!car.active || !car.body || car.IsLod()) continue;
+		scheduled_cars++;
+
+		b2Vec2 position = car.body->GetPosition();
+		float speed = car.vehicles->GetSpeed(car.vehicle_id);
+
+		// Faster cars see further ahead per second, they need fresher sensors
+		float t = speed / AI_SENSE_CRUISE_SPEED;
+		if (t > 1.0f) t = 1.0f;
+		float interval = AI_SENSE_SLOW_INTERVAL + (AI_SENSE_FAST_INTERVAL - AI_SENSE_SLOW_INTERVAL) * t;
+
+		// Other cars around, sense every frame
+		int nearby[1];
+		if (grid.Query(position, AI_SENSE_NEAR_CAR, car.vehicle_id, nearby, 1) > 0) interval = 0.0f;
+
+		if (!deterministic && b2DistanceSquared(position, view_center) > far_sqr) interval *= 2.0f;
+		interval *= scale;
+		p.interval = interval;
+
+		// Spread the first sense of every car over one interval
+		if (!p.staggered)
+		{
+			p.timer = interval * (float)k / (float)count;
+			p.staggered = true;
+		}
+
+		p.timer -= dt;
+		if (p.timer <= 0.0f)
+		{
+			if (sensed_cars < max_sensors)
+			{
+				p.sense = true;
+				sensed_cars++;
+				p.timer += interval;
+				if (p.timer < 0.0f) p.timer = 0.0f;
+			}
+			else if (first_deferred < 0)
+			{
+				first_deferred = index;
+			}
+		}
+
+		rate_sum += 1.0f / (interval > dt ? interval : dt);
+	}
+
+	if (first_deferred >= 0) first_car = first_deferred;
+	sense_rate = scheduled_cars > 0 ? rate_sum / scheduled_cars : 0.0f;
+}
+
+void PerceptionScheduler::EndFrame(const std::vector<AIVehicle>& cars)
+{
+	used_us = 0.0f;
+	for (const AIVehicle& car : cars)
+	{
+		if (car.perception.sense) used_us += car.perception.cost_us;
+	}
+
+	if (sensed_cars > 0)
+	{
+		float cost = used_us / sensed_cars;
+		avg_sense_us = avg_sense_us > 0.0f ? avg_sense_us * 0.9f + cost * 0.1f : cost;
+	}
+
+	if (deterministic) return;
+
+	// Stretch the intervals while over budget, relax them slowly once well under it
+	if (used_us > AI_SENSE_BUDGET_US)
+	{
+		scale *= 1.25f;
+		if (scale > AI_SENSE_MAX_SCALE) scale = AI_SENSE_MAX_SCALE;
+	}
+	else if (used_us < 0.5f * AI_SENSE_BUDGET_US)
+	{
+		scale *= 0.95f;
+		if (scale < 1.0f) scale = 1.0f;
+	}
+}
+
+void PerceptionScheduler::Reset()
+{
+	sensed_cars = 0;
+	scheduled_cars = 0;
+	used_us = 0.0f;
+	avg_sense_us = 0.0f;
+	sense_rate = 0.0f;
+	scale = 1.0f;
+	first_car = 0;
+}
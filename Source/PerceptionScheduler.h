@@ -0,0 +1,43 @@
+#pragma once
+
+#include "AIVehicle.h"
+#include <vector>
+
+#define AI_SENSE_BUDGET_US 1000.0f		// sensing time allowed per frame, all threads
+#define AI_SENSE_FAST_INTERVAL 0.033f	// interval at cruise speed
+#define AI_SENSE_SLOW_INTERVAL 0.25f	// interval when stopped
+#define AI_SENSE_CRUISE_SPEED 9.0f
+#define AI_SENSE_NEAR_CAR 6.0f			// closer than this to another car senses every frame
+#define AI_SENSE_FAR_VIEW 20.0f			// further than this from the view senses half as often
+#define AI_SENSE_MAX_SCALE 8.0f
+
+// Decides which AI cars refresh their sensors each frame. Every car gets an
+// interval from its speed, its distance to other cars and to the view, and
+// the cars are staggered so only a slice of them sense in the same frame.
+// When sensing goes over the budget the intervals stretch and due cars are
+// deferred to the next frame.
+class PerceptionScheduler
+{
+public:
+	// Sets perception.sense on every car, call before the think phase
+	void Schedule(std::vector<AIVehicle>& cars, const VehicleGrid& grid, const b2Vec2& view_center, float dt);
+	// Reads the sensing cost of the think phase
+	void EndFrame(const std::vector<AIVehicle>& cars);
+	// Back to the first frame state
+	void Reset();
+
+	// Schedule from the simulation state only, no time budget and no view
+	// distance, so a recorded race senses the same way when it is replayed
+	bool deterministic = false;
+
+	// Stats of the last frame
+	int sensed_cars = 0;
+	int scheduled_cars = 0;
+	float used_us = 0.0f;
+	float avg_sense_us = 0.0f;
+	float sense_rate = 0.0f; // average sensing frequency per car, Hz
+	float scale = 1.0f;
+
+private:
+	int first_car = 0;
+};
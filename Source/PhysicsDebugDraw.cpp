@@ -0,0 +1,209 @@
+#include "PhysicsDebugDraw.h"
+#include "ModulePhysics.h"
+
+#include "rlgl.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define DEBUG_CIRCLE_SEGMENTS 16
+#define DEBUG_CHAIN_WIDTH 3.0f
+
+static Color ToColor(const b2Color& color)
+{
+	return Color{ (unsigned char)(color.r * 255.0f), (unsigned char)(color.g * 255.0f), (unsigned char)(color.b * 255.0f), (unsigned char)(color.a * 255.0f) };
+}
+
+PhysicsDebugDraw::PhysicsDebugDraw()
+{
+	SetFlags(e_shapeBit);
+}
+
+void PhysicsDebugDraw::DrawWorld(b2World* world, Rectangle view_rect)
+{
+	// View in meters
+	view.lowerBound.Set(PIXELS_TO_METERS(view_rect.x), PIXELS_TO_METERS(view_rect.y));
+	view.upperBound.Set(PIXELS_TO_METERS(view_rect.x + view_rect.width), PIXELS_TO_METERS(view_rect.y + view_rect.height));
+
+	// Chains have one proxy per segment, so the same fixture can be reported many times
+	visible.clear();
+	world->QueryAABB(this, view);
+	std::sort(visible.begin(), visible.end());
+	visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+
+	fixtures_drawn = 0;
+	lines_drawn = 0;
+
+	for (b2Fixture* fixture : visible)
+	{
+		DrawFixture(fixture);
+	}
+
+	fixtures_drawn = (int)visible.size();
+}
+
+bool PhysicsDebugDraw::ReportFixture(b2Fixture* fixture)
+{
+	visible.push_back(fixture);
+	return true;
+}
+
+void PhysicsDebugDraw::DrawFixture(b2Fixture* fixture)
+{
+	const b2Transform& xf = fixture->GetBody()->GetTransform();
+	b2Color red(0.9f, 0.16f, 0.22f);
+
+	switch (fixture->GetType())
+	{
+	case b2Shape::e_circle:
+	{
+		b2CircleShape* shape = (b2CircleShape*)fixture->GetShape();
+		DrawCircle(b2Mul(xf, shape->m_p), shape->m_radius, red);
+	}
+	break;
+
+	case b2Shape::e_polygon:
+	{
+		b2PolygonShape* shape = (b2PolygonShape*)fixture->GetShape();
+		b2Vec2 world_vertices[b2_maxPolygonVertices];
+		for (int i = 0; i < shape->m_count; ++i)
+		{
+			world_vertices[i] = b2Mul(xf, shape->m_vertices[i]);
+		}
+		DrawPolygon(world_vertices, shape->m_count, red);
+	}
+	break;
+
+	case b2Shape::e_edge:
+	{
+		b2EdgeShape* shape = (b2EdgeShape*)fixture->GetShape();
+		DrawSegment(b2Mul(xf, shape->m_vertex1), b2Mul(xf, shape->m_vertex2), red);
+	}
+	break;
+
+	case b2Shape::e_chain:
+	{
+		// Track walls are long loops, only the segments on screen are drawn
+		b2ChainShape* shape = (b2ChainShape*)fixture->GetShape();
+		b2Color green(0.0f, 0.89f, 0.19f);
+		int count = shape->m_count;
+
+		// Loops repeat the first vertex at the end, so this closes them too
+		for (int i = 0; i < count - 1; ++i)
+		{
+			b2Vec2 v1 = b2Mul(xf, shape->m_vertices[i]);
+			b2Vec2 v2 = b2Mul(xf, shape->m_vertices[i + 1]);
+
+			b2AABB segment;
+			segment.lowerBound = b2Min(v1, v2);
+			segment.upperBound = b2Max(v1, v2);
+			if (!b2TestOverlap(segment, view)) continue;
+
+			AddLine(v1, v2, green, DEBUG_CHAIN_WIDTH);
+		}
+	}
+	break;
+
+	default: break;
+	}
+}
+
+void PhysicsDebugDraw::AddLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width)
+{
+	float x1 = PIXELS_PER_METER * p1.x;
+	float y1 = PIXELS_PER_METER * p1.y;
+	float x2 = PIXELS_PER_METER * p2.x;
+	float y2 = PIXELS_PER_METER * p2.y;
+
+	float dx = x2 - x1;
+	float dy = y2 - y1;
+	float length = sqrtf(dx * dx + dy * dy);
+	if (length < 0.0001f) return;
+
+	// Half width normal
+	float nx = -dy / length * width * 0.5f;
+	float ny = dx / length * width * 0.5f;
+
+	Color c = ToColor(color);
+	LineVertex a = { x1 + nx, y1 + ny, c };
+	LineVertex b = { x1 - nx, y1 - ny, c };
+	LineVertex d = { x2 + nx, y2 + ny, c };
+	LineVertex e = { x2 - nx, y2 - ny, c };
+
+	// Counter-clockwise on screen, raylib culls the other winding
+	vertices.push_back(a);
+	vertices.push_back(d);
+	vertices.push_back(b);
+	vertices.push_back(d);
+	vertices.push_back(e);
+	vertices.push_back(b);
+
+	lines_drawn++;
+}
+
+void PhysicsDebugDraw::Flush()
+{
+	if (vertices.empty()) return;
+
+	rlBegin(RL_TRIANGLES);
+	for (const LineVertex& v : vertices)
+	{
+		rlColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
+		rlVertex2f(v.x, v.y);
+	}
+	rlEnd();
+
+	vertices.clear();
+}
+
+void PhysicsDebugDraw::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+	b2Vec2 prev = vertices[vertexCount - 1];
+	for (int32 i = 0; i < vertexCount; ++i)
+	{
+		AddLine(prev, vertices[i], color, line_width);
+		prev = vertices[i];
+	}
+}
+
+void PhysicsDebugDraw::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+	DrawPolygon(vertices, vertexCount, color);
+}
+
+void PhysicsDebugDraw::DrawCircle(const b2Vec2& center, float radius, const b2Color& color)
+{
+	const float increment = 2.0f * b2_pi / DEBUG_CIRCLE_SEGMENTS;
+	b2Vec2 prev = center + radius * b2Vec2(1.0f, 0.0f);
+	for (int i = 1; i <= DEBUG_CIRCLE_SEGMENTS; ++i)
+	{
+		float angle = increment * i;
+		b2Vec2 v = center + radius * b2Vec2(cosf(angle), sinf(angle));
+		AddLine(prev, v, color, line_width);
+		prev = v;
+	}
+}
+
+void PhysicsDebugDraw::DrawSolidCircle(const b2Vec2& center, float radius, const b2Vec2& axis, const b2Color& color)
+{
+	DrawCircle(center, radius, color);
+	AddLine(center, center + radius * axis, color, line_width);
+}
+
+void PhysicsDebugDraw::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
+{
+	AddLine(p1, p2, color, line_width);
+}
+
+void PhysicsDebugDraw::DrawTransform(const b2Transform& xf)
+{
+	const float axis_scale = 0.4f;
+	AddLine(xf.p, xf.p + axis_scale * xf.q.GetXAxis(), b2Color(1.0f, 0.0f, 0.0f), line_width);
+	AddLine(xf.p, xf.p + axis_scale * xf.q.GetYAxis(), b2Color(0.0f, 1.0f, 0.0f), line_width);
+}
+
+void PhysicsDebugDraw::DrawPoint(const b2Vec2& p, float size, const b2Color& color)
+{
+	float half = PIXELS_TO_METERS(size) * 0.5f;
+	AddLine(p - b2Vec2(half, 0.0f), p + b2Vec2(half, 0.0f), color, size);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "raylib.h"
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+// Box2D debug renderer. Only the fixtures that overlap the camera are drawn,
+// and every line is expanded to a quad in one vertex list that is submitted
+// as a single triangle batch at the end of the frame.
+class PhysicsDebugDraw : public b2Draw, public b2QueryCallback
+{
+public:
+	PhysicsDebugDraw();
+
+	// Draws the fixtures overlapping the view, world pixels under the camera
+	void DrawWorld(b2World* world, Rectangle view_rect);
+
+	// Queues a line in meters, for extra debug lines drawn with the same batch
+	void AddLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color, float width);
+
+	// Submits and clears the queued lines
+	void Flush();
+
+	// b2Draw
+	void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
+	void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
+	void DrawCircle(const b2Vec2& center, float radius, const b2Color& color) override;
+	void DrawSolidCircle(const b2Vec2& center, float radius, const b2Vec2& axis, const b2Color& color) override;
+	void DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color) override;
+	void DrawTransform(const b2Transform& xf) override;
+	void DrawPoint(const b2Vec2& p, float size, const b2Color& color) override;
+
+	// b2QueryCallback
+	bool ReportFixture(b2Fixture* fixture) override;
+
+	// Stats of the last DrawWorld
+	int fixtures_drawn = 0;
+	int lines_drawn = 0;
+
+	float line_width = 1.0f;
+
+private:
+	struct LineVertex
+	{
+		float x, y;
+		Color color;
+	};
+
+	void DrawFixture(b2Fixture* fixture);
+
+	std::vector<b2Fixture*> visible;
+	std::vector<LineVertex> vertices;
+	b2AABB view;
+};
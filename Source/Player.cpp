@@ -12,17 +12,19 @@
 #include "ModulePhysics.h"
 #pragma warning(pop)
 
+#define PLAYER_DEPTH 1	// over the AI cars in the VEHICLES layer
+
+#define NITRO_BAR_X (SCREEN_WIDTH - 250)
+#define NITRO_BAR_Y 30
+#define NITRO_BAR_WIDTH 200
+#define NITRO_BAR_HEIGHT 30
+#define NITRO_BAR_BORDER 3
+
 ModulePlayer::ModulePlayer(Application* app, bool start_enabled) : Module(app, start_enabled)
 {
 	vehicle = nullptr;
-	vehicle_texture = { 0 };
-
-	nitro_active = false;
-	nitro_duration = NITRO_MAX_DURATION;
-	nitro_timer = 0.0f;
-	nitro_cooldown = NITRO_COOLDOWN_TIME;
-	nitro_cooldown_timer = 0.0f;
-	nitro_particle_timer = 0.0f;
+	vehicle_id = -1;
+	vehicle_sprite = AtlasSprite();
 
 	// Initialize sound IDs
 	sfx_engine = 0;
@@ -39,9 +41,10 @@ bool ModulePlayer::Start()
 {
 	LOG("ModulePlayer: Starting...");
 
-	vehicle_texture = LoadTexture("Assets/Textures/Cars/car1.png");
+	vehicle_sprite = App->renderer->atlas.Get("Assets/Textures/Cars/car1.png");
+	App->renderer->hud.Add(&nitro_gauge);
 
-	if (vehicle_texture.id == 0)
+	if (!vehicle_sprite.IsValid())
 	{
 		LOG("ERROR loading vehicle texture");
 		return false;
@@ -52,8 +55,8 @@ bool ModulePlayer::Start()
 	int start_y = 0;
 
 	vehicle = App->physics->CreateRectangle(start_x, start_y,
-		vehicle_texture.width,
-		vehicle_texture.height,
+		vehicle_sprite.GetWidth(),
+		vehicle_sprite.GetHeight(),
 		PhysBodyType::DYNAMIC);
 
 	if (vehicle == nullptr || vehicle->body == nullptr)
@@ -76,6 +79,26 @@ bool ModulePlayer::Start()
 		vehicle->body->ResetMassData();
 	}
 
+	// Drive model, the controls are filled in Update
+	VehicleTuning tuning;
+	tuning.engine_accel = 25.0f / vehicle->body->GetMass();
+	tuning.max_speed_forward = 15.0f;
+	tuning.max_speed_reverse = 4.5f;
+	tuning.turn_speed = 3.0f;
+	tuning.steer_full_speed = 0.5f;
+	tuning.turn_falloff = 0.5f;
+	tuning.turn_min = 0.4f;
+	tuning.steer_release = 6.3f;	// 90% kept every 1/60 s
+	tuning.lateral_grip = 72.0f;	// 30% kept every 1/60 s
+	tuning.brake_strength = 8.0f;
+	tuning.handbrake_strength = 5.0f;
+	tuning.drift_grip = 21.4f;	// 70% kept every 1/60 s
+	tuning.drift_brake = 2.0f;
+	tuning.drift_torque = 25.0f;
+	tuning.boost_accel = 2.5f;
+	tuning.boost_speed = 1.8f;
+	vehicle_id = App->physics->vehicles.AddVehicle(vehicle->body, App->physics->vehicles.AddTuning(tuning));
+
 	// Assign listener for collisions
 	vehicle->listener = this;
 
@@ -105,108 +128,111 @@ void ModulePlayer::SetPosition(float x, float y, float rotation_degrees)
 // Reset nitro system to initial state (fully charged)
 void ModulePlayer::ResetNitro()
 {
-	nitro_active = false;
-	nitro_duration = NITRO_MAX_DURATION;
-	nitro_timer = 0.0f;
-	nitro_cooldown_timer = 0.0f;
-	nitro_particle_timer = 0.0f;
-	nitro_particles.clear();
+	nitro = NitroState();
 
 	LOG("ModulePlayer: Nitro system reset to full charge");
 }
 
+ModulePlayer::ControllerState ModulePlayer::SaveState() const
+{
+	ControllerState state;
+	state.nitro = nitro;
+	state.random = random;
+	return state;
+}
+
+void ModulePlayer::RestoreState(const ControllerState& state)
+{
+	nitro = state.nitro;
+	random = state.random;
+}
+
 bool ModulePlayer::CleanUp()
 {
-	UnloadTexture(vehicle_texture);
-	nitro_particles.clear();
+	vehicle_sprite = AtlasSprite();
 	return true;
 }
 
-void ModulePlayer::UpdateNitro(float dt)
+uint8_t ModulePlayer::SampleInput() const
 {
-	// Handle cooldown period
-	if (nitro_cooldown_timer > 0.0f)
-	{
-		nitro_cooldown_timer -= dt;
-		if (nitro_cooldown_timer < 0.0f)
-		{
-			nitro_cooldown_timer = 0.0f;
-			nitro_duration = NITRO_MAX_DURATION;
-		}
-		else
-		{
-			// Gradually refill the bar during cooldown
-			nitro_duration = NITRO_MAX_DURATION * (1.0f - (nitro_cooldown_timer / NITRO_COOLDOWN_TIME));
-		}
-	}
+	uint8_t buttons = 0;
+	if (IsKeyDown(KEY_W) || IsKeyDown(KEY_UP)) buttons |= INPUT_THROTTLE;
+	if (IsKeyDown(KEY_S) || IsKeyDown(KEY_DOWN)) buttons |= INPUT_BRAKE;
+	if (IsKeyDown(KEY_A) || IsKeyDown(KEY_LEFT)) buttons |= INPUT_LEFT;
+	if (IsKeyDown(KEY_D) || IsKeyDown(KEY_RIGHT)) buttons |= INPUT_RIGHT;
+	if (IsKeyDown(KEY_SPACE)) buttons |= INPUT_HANDBRAKE;
+	if (IsKeyPressed(KEY_N)) buttons |= INPUT_NITRO;
+	return buttons;
+}
 
+void ModulePlayer::UpdateNitro(float dt, uint8_t buttons)
+{
 	// Activate nitro when N is pressed
-	// CORRECCIN: Aadimos "!nitro_active" para evitar reactivarlo mientras se usa
-	if (IsKeyPressed(KEY_N) && !nitro_active && nitro_duration >= NITRO_MAX_DURATION && nitro_cooldown_timer <= 0.0f)
+	if (nitro.Update(dt, (buttons & INPUT_NITRO) != 0))
 	{
-		nitro_active = true;
-		nitro_timer = 0.0f;
-
 		// Play nitro sound
 		App->audio->PlayFx(sfx_nitro);
 	}
+}
+
+NitroGauge::NitroGauge() : state(State::READY), fill_width(0), cooldown_tenths(0)
+{
+	// The glow around the bar and the hint under it
+	SetBounds({ NITRO_BAR_X - 2.0f, NITRO_BAR_Y - 2.0f, NITRO_BAR_WIDTH + 4.0f, NITRO_BAR_HEIGHT + 23.0f });
+}
 
-	// Update nitro timer and deactivate when duration is reached
-	if (nitro_active)
+void NitroGauge::Set(const NitroState& nitro)
+{
+	State new_state = State::READY;
+	float fill_percentage = 1.0f;
+
+	// Determine bar state
+	if (nitro.active)
 	{
-		nitro_timer += dt;
-		if (nitro_timer >= NITRO_MAX_DURATION)
-		{
-			nitro_active = false;
-			nitro_timer = 0.0f;
-			nitro_duration = 0.0f;
-			nitro_cooldown_timer = NITRO_COOLDOWN_TIME;
-		}
+		new_state = State::ACTIVE;
+		fill_percentage = 1.0f - (nitro.timer / NITRO_MAX_DURATION);
 	}
+	else if (nitro.cooldown_timer > 0.0f)
+	{
+		new_state = State::COOLDOWN;
+		fill_percentage = nitro.duration / NITRO_MAX_DURATION;
+	}
+
+	int new_fill = (int)((NITRO_BAR_WIDTH - NITRO_BAR_BORDER * 2) * fill_percentage);
+	int new_tenths = new_state == State::COOLDOWN ? (int)ceilf(nitro.cooldown_timer * 10.0f) : 0;
+	if (new_state == state && new_fill == fill_width && new_tenths == cooldown_tenths) return;
+
+	state = new_state;
+	fill_width = new_fill;
+	cooldown_tenths = new_tenths;
+	Invalidate();
 }
 
-void ModulePlayer::DrawNitroBar()
+void NitroGauge::Redraw() const
 {
-	int bar_x = SCREEN_WIDTH - 250;
-	int bar_y = 30;
-	int bar_width = 200;
-	int bar_height = 30;
-	int border_thickness = 3;
+	int bar_x = NITRO_BAR_X;
+	int bar_y = NITRO_BAR_Y;
+	int bar_width = NITRO_BAR_WIDTH;
+	int bar_height = NITRO_BAR_HEIGHT;
+	int border_thickness = NITRO_BAR_BORDER;
 
 	// Draw bar background
 	DrawRectangle(bar_x, bar_y, bar_width, bar_height, ColorAlpha(BLACK, 0.6f));
 	DrawRectangleLinesEx({ (float)bar_x, (float)bar_y, (float)bar_width, (float)bar_height },
 		(float)border_thickness, WHITE);
 
-	float fill_percentage = 0.0f;
-	Color fill_color;
-
-	// Determine bar state and color
-	if (nitro_active)
-	{
-		fill_percentage = 1.0f - (nitro_timer / NITRO_MAX_DURATION);
-		fill_color = Color{ 0, 150, 255, 255 };
-	}
-	else if (nitro_cooldown_timer > 0.0f)
-	{
-		fill_percentage = nitro_duration / NITRO_MAX_DURATION;
-		fill_color = Color{ 100, 100, 150, 255 };
-	}
-	else
-	{
-		fill_percentage = 1.0f;
-		fill_color = Color{ 0, 200, 255, 255 };
-	}
+	Color fill_color = Color{ 0, 200, 255, 255 };
+	if (state == State::ACTIVE) fill_color = Color{ 0, 150, 255, 255 };
+	else if (state == State::COOLDOWN) fill_color = Color{ 100, 100, 150, 255 };
 
 	// Draw fill bar
-	int fill_width = (int)((bar_width - border_thickness * 2) * fill_percentage);
 	if (fill_width > 0)
 	{
 		DrawRectangle(bar_x + border_thickness, bar_y + border_thickness,
 			fill_width, bar_height - border_thickness * 2, fill_color);
 
 		// Draw glow effect when ready
-		if (fill_percentage >= 1.0f && !nitro_active)
+		if (fill_width >= bar_width - border_thickness * 2 && state != State::ACTIVE)
 		{
 			DrawRectangleLinesEx({ (float)bar_x - 2, (float)bar_y - 2,
 				(float)bar_width + 4, (float)bar_height + 4 }, 2.0f,
@@ -217,123 +243,40 @@ void ModulePlayer::DrawNitroBar()
 	// Draw text labels
 	DrawText("NITRO", bar_x + 10, bar_y + 7, 16, WHITE);
 
-	if (nitro_active)
+	if (state == State::ACTIVE)
 	{
 		DrawText("BOOST!", bar_x + bar_width - 70, bar_y + 7, 16, YELLOW);
 	}
-	else if (nitro_cooldown_timer > 0.0f)
+	else if (state == State::COOLDOWN)
 	{
-		char cooldown_text[32];
-		sprintf_s(cooldown_text, "%.1fs", nitro_cooldown_timer);
-		DrawText(cooldown_text, bar_x + bar_width - 50, bar_y + 7, 16, LIGHTGRAY);
+		DrawText(TextFormat("%.1fs", cooldown_tenths / 10.0f), bar_x + bar_width - 50, bar_y + 7, 16, LIGHTGRAY);
 	}
 	else
 	{
 		DrawText("READY", bar_x + bar_width - 60, bar_y + 7, 16, GREEN);
-	}
-
-	// Draw instruction text
-	if (!nitro_active && nitro_cooldown_timer <= 0.0f)
-	{
+		// Draw instruction text
 		DrawText("Press [N]", bar_x + 50, bar_y + bar_height + 5, 14, LIGHTGRAY);
 	}
 }
 
-void ModulePlayer::DrawNitroEffects()
-{
-	if (!nitro_active) return;
-
-	int x, y;
-	vehicle->GetPosition(x, y);
-	float rotation = vehicle->GetRotation() * DEG_TO_RAD;
-
-	// Calculate rear position for particle emission
-	float rear_offset = vehicle_texture.height * 0.4f;
-	float rear_x = x - sinf(rotation) * rear_offset;
-	float rear_y = y + cosf(rotation) * rear_offset;
-
-	// Generate new particles
-	nitro_particle_timer += GetFrameTime();
-	if (nitro_particle_timer >= 0.02f)
-	{
-		nitro_particle_timer = 0.0f;
-
-		for (int i = 0; i < 3; i++)
-		{
-			NitroParticle particle;
-			float offset_x = ((rand() % 20) - 10) * 0.5f;
-			float offset_y = ((rand() % 20) - 10) * 0.5f;
-
-			particle.position.x = rear_x + offset_x;
-			particle.position.y = rear_y + offset_y;
-
-			float speed = 100.0f + (rand() % 50);
-			particle.velocity.x = sinf(rotation) * speed + ((rand() % 40) - 20);
-			particle.velocity.y = -cosf(rotation) * speed + ((rand() % 40) - 20);
-
-			particle.max_lifetime = 0.5f + (rand() % 100) / 200.0f;
-			particle.lifetime = particle.max_lifetime;
-
-			// Random color variants
-			int color_variant = rand() % 3;
-			if (color_variant == 0) particle.color = Color{ 0, 150, 255, 255 };
-			else if (color_variant == 1) particle.color = Color{ 100, 200, 255, 255 };
-			else particle.color = Color{ 255, 255, 255, 255 };
-
-			nitro_particles.push_back(particle);
-		}
-	}
-
-	// Update and draw particles
-	float dt = GetFrameTime();
-	for (size_t i = 0; i < nitro_particles.size(); )
-	{
-		NitroParticle& p = nitro_particles[i];
-		p.lifetime -= dt;
-
-		if (p.lifetime <= 0.0f)
-		{
-			nitro_particles.erase(nitro_particles.begin() + i);
-			continue;
-		}
-
-		// Update particle position
-		p.position.x += p.velocity.x * dt;
-		p.position.y += p.velocity.y * dt;
-
-		// Calculate alpha based on lifetime
-		float alpha = p.lifetime / p.max_lifetime;
-		Color draw_color = p.color;
-		draw_color.a = (unsigned char)(255 * alpha);
-
-		// Draw particle with growing size
-		float size = 8.0f * (1.0f + (1.0f - alpha) * 2.0f);
-		float screen_x = p.position.x + App->renderer->camera_x;
-		float screen_y = p.position.y + App->renderer->camera_y;
-
-		DrawCircle((int)screen_x, (int)screen_y, size + 4, ColorAlpha(draw_color, alpha * 0.3f));
-		DrawCircle((int)screen_x, (int)screen_y, size, draw_color);
-
-		i++;
-	}
-
-	// Draw main nitro glow at vehicle rear
-	DrawCircle((int)(rear_x + App->renderer->camera_x),
-		(int)(rear_y + App->renderer->camera_y),
-		15.0f, ColorAlpha(Color{ 0, 150, 255, 255 }, 0.6f));
-	DrawCircle((int)(rear_x + App->renderer->camera_x),
-		(int)(rear_y + App->renderer->camera_y),
-		10.0f, ColorAlpha(Color{ 100, 200, 255, 255 }, 0.8f));
-}
-
 update_status ModulePlayer::Update()
 {
+	nitro_gauge.SetVisible(vehicle != nullptr && vehicle->body != nullptr && !App->scene_intro->show_menu);
 	if (vehicle == nullptr || vehicle->body == nullptr) return UPDATE_CONTINUE;
 
+	float dt = GetFrameTime();
+
 	// Check if menu is shown, if so, don't update player
 	if (App->scene_intro->show_menu)
 	{
-		// Keep vehicle stopped while in menu
+		// The race goes on behind the menu, a recording needs these frames too
+		if (App->scene_intro->recording_race)
+		{
+			App->scene_intro->race_recording.AddFrame(dt, App->physics->GetStepStats().steps_last_frame, RECORDED_PLAYER_HELD, App->physics->vehicles.Hash());
+		}
+
+		// Keep vehicle stopped while in menu, the controls of the last frame would still drive it
+		App->physics->vehicles.SetControls(vehicle_id, VehicleControls());
 		vehicle->body->SetLinearVelocity(b2Vec2(0, 0));
 		vehicle->body->SetAngularVelocity(0);
 		// Stop engine sound if inside menu
@@ -343,27 +286,19 @@ update_status ModulePlayer::Update()
 		return UPDATE_CONTINUE;
 	}
 
-	float dt = GetFrameTime();
-	UpdateNitro(dt);
-
-	// Vehicle physics parameters
-	float acceleration = 25.0f;
-	float max_speed_forward = 15.0f;
-	float max_speed_reverse = 4.5f;
-	float base_turn_speed = 3.0f;
-	float drift_factor = 0.7f;
-	float brake_strength = 8.0f;
-	float handbrake_drift_force = 25.0f;
-
-	// Apply nitro boost
-	if (nitro_active)
+	uint8_t buttons = SampleInput();
+	UpdateNitro(dt, buttons);
+	nitro_gauge.Set(nitro);
+
+	// A recorded race keeps the buttons of every frame and a hash of the cars they were read on
+	if (App->scene_intro->recording_race)
 	{
-		acceleration *= 2.5f;
-		max_speed_forward *= 1.8f;
+		App->scene_intro->race_recording.AddFrame(dt, App->physics->GetStepStats().steps_last_frame, buttons, App->physics->vehicles.Hash());
 	}
 
-	b2Vec2 velocity = vehicle->body->GetLinearVelocity();
-	float speed = velocity.Length();
+	VehicleSystem& vehicles = App->physics->vehicles;
+	float speed = vehicles.GetSpeed(vehicle_id);
+	bool is_stopped = speed < 0.1f;
 
 	if (!App->audio->IsFxPlaying(sfx_engine)) {
 		App->audio->PlayFx(sfx_engine, -1);
@@ -375,129 +310,12 @@ update_status ModulePlayer::Update()
 	App->audio->SetFxPitch(sfx_engine, pitch);
 	App->audio->SetFxVolume(sfx_engine, 0.5f);
 
+	// Fill the controls, the vehicle system applies them before the next step
+	VehicleControls controls = PlayerControls(buttons, speed, vehicles.GetForwardSpeed(vehicle_id), nitro.active);
+	bool is_turning = (buttons & (INPUT_LEFT | INPUT_RIGHT)) != 0;
+	bool handbrake_active = (buttons & INPUT_HANDBRAKE) != 0;
 
-	b2Vec2 forward_vector = vehicle->body->GetWorldVector(b2Vec2(0.0f, -1.0f));
-	float forward_velocity = b2Dot(forward_vector, velocity);
-	bool moving_forward = forward_velocity > 0.1f;
-	bool moving_backward = forward_velocity < -0.1f;
-	bool is_stopped = speed < 0.1f;
-
-	// Forward acceleration
-	if (IsKeyDown(KEY_W) || IsKeyDown(KEY_UP))
-	{
-		b2Vec2 forward = vehicle->body->GetWorldVector(b2Vec2(0.0f, -1.0f));
-		forward.x *= acceleration;
-		forward.y *= acceleration;
-		vehicle->body->ApplyForceToCenter(forward, true);
-	}
-
-	// Reverse / Brake
-	if (IsKeyDown(KEY_S) || IsKeyDown(KEY_DOWN))
-	{
-		if (moving_forward && speed > 1.0f)
-		{
-			// Apply braking force
-			b2Vec2 brake_force;
-			brake_force.x = -velocity.x * vehicle->body->GetMass() * brake_strength;
-			brake_force.y = -velocity.y * vehicle->body->GetMass() * brake_strength;
-			vehicle->body->ApplyForceToCenter(brake_force, true);
-		}
-		else
-		{
-			// Apply reverse force
-			b2Vec2 backward = vehicle->body->GetWorldVector(b2Vec2(0.0f, 1.0f));
-			backward.x *= acceleration;
-			backward.y *= acceleration;
-			vehicle->body->ApplyForceToCenter(backward, true);
-		}
-	}
-
-	bool turning_left = IsKeyDown(KEY_A) || IsKeyDown(KEY_LEFT);
-	bool turning_right = IsKeyDown(KEY_D) || IsKeyDown(KEY_RIGHT);
-	bool is_turning = turning_left || turning_right;
-	bool handbrake_active = IsKeyDown(KEY_SPACE);
-
-	// Handbrake / Drift system
-	if (handbrake_active)
-	{
-		if (is_turning && !is_stopped)
-		{
-			// Apply drift physics
-			b2Vec2 right_vector = vehicle->body->GetWorldVector(b2Vec2(1.0f, 0.0f));
-			float lateral_velocity = b2Dot(right_vector, velocity);
-
-			b2Vec2 drift_impulse;
-			drift_impulse.x = -lateral_velocity * 0.3f * vehicle->body->GetMass() * right_vector.x;
-			drift_impulse.y = -lateral_velocity * 0.3f * vehicle->body->GetMass() * right_vector.y;
-			vehicle->body->ApplyLinearImpulseToCenter(drift_impulse, true);
-
-			// Apply drift torque
-			float drift_torque = 0.0f;
-			if (turning_left) drift_torque = -handbrake_drift_force * (speed / max_speed_forward);
-			else if (turning_right) drift_torque = handbrake_drift_force * (speed / max_speed_forward);
-
-			vehicle->body->ApplyTorque(drift_torque, true);
-
-			// Apply drift brake
-			b2Vec2 drift_brake;
-			drift_brake.x = -velocity.x * vehicle->body->GetMass() * 2.0f;
-			drift_brake.y = -velocity.y * vehicle->body->GetMass() * 2.0f;
-			vehicle->body->ApplyForceToCenter(drift_brake, true);
-		}
-		else
-		{
-			// Simple handbrake when not turning
-			b2Vec2 brake_force;
-			brake_force.x = -velocity.x * vehicle->body->GetMass() * 5.0f;
-			brake_force.y = -velocity.y * vehicle->body->GetMass() * 5.0f;
-			vehicle->body->ApplyForceToCenter(brake_force, true);
-		}
-	}
-	else
-	{
-		// Normal steering
-		if (speed > 0.5f && is_turning)
-		{
-			float speed_ratio = moving_forward ? (speed / max_speed_forward) : (speed / max_speed_reverse);
-			float turn_reduction = 1.0f - (speed_ratio * 0.5f);
-			turn_reduction = fmaxf(turn_reduction, 0.4f);
-
-			float dynamic_turn_speed = base_turn_speed * turn_reduction;
-
-			if (turning_left) vehicle->body->SetAngularVelocity(-dynamic_turn_speed);
-			else if (turning_right) vehicle->body->SetAngularVelocity(dynamic_turn_speed);
-		}
-		else if (!is_turning)
-		{
-			vehicle->body->SetAngularVelocity(vehicle->body->GetAngularVelocity() * 0.9f);
-		}
-
-		// Apply lateral friction for realistic car physics
-		b2Vec2 right_vector = vehicle->body->GetWorldVector(b2Vec2(1.0f, 0.0f));
-		float lateral_velocity = b2Dot(right_vector, velocity);
-
-		b2Vec2 impulse;
-		impulse.x = -lateral_velocity * drift_factor * vehicle->body->GetMass() * right_vector.x;
-		impulse.y = -lateral_velocity * drift_factor * vehicle->body->GetMass() * right_vector.y;
-		vehicle->body->ApplyLinearImpulseToCenter(impulse, true);
-	}
-
-	// Limit forward speed
-	if (moving_forward && speed > max_speed_forward)
-	{
-		velocity.Normalize();
-		velocity.x *= max_speed_forward;
-		velocity.y *= max_speed_forward;
-		vehicle->body->SetLinearVelocity(velocity);
-	}
-	// Limit reverse speed
-	else if (moving_backward && speed > max_speed_reverse)
-	{
-		velocity.Normalize();
-		velocity.x *= max_speed_reverse;
-		velocity.y *= max_speed_reverse;
-		vehicle->body->SetLinearVelocity(velocity);
-	}
+	vehicles.SetControls(vehicle_id, controls);
 
 	// Drift sound logic
 	bool is_drifting = handbrake_active && is_turning && !is_stopped;
@@ -524,26 +342,22 @@ update_status ModulePlayer::Update()
 
 	App->renderer->UpdateCamera((float)x, (float)y, 0.1f);
 
-	// Draw nitro effects
-	DrawNitroEffects();
+	// Over the AI cars, the nitro flame comes from ModuleGame's particles
+	App->renderer->Draw(vehicle_sprite.texture, x, y, &vehicle_sprite.source, rotation,
+		vehicle_sprite.GetWidth() / 2, vehicle_sprite.GetHeight() / 2, WHITE, RenderLayer::VEHICLES, PLAYER_DEPTH);
 
-	// Draw vehicle
-	Rectangle source = { 0, 0, (float)vehicle_texture.width, (float)vehicle_texture.height };
-	App->renderer->Draw(vehicle_texture, x, y, &source, rotation,
-		(int)(vehicle_texture.width / 2.0f), (int)(vehicle_texture.height / 2.0f));
-
-	// Draw UI
-	DrawNitroBar();
-
-	// Debug info
+	// Debug info, the nitro bar is a widget of the HUD canvas
 	if (App->physics->debug)
 	{
-		DrawText(TextFormat("Speed: %.1f", speed), 10, 135, 16, GREEN);
-		DrawText(TextFormat("Position: (%d, %d)", x, y), 10, 155, 16, GREEN);
+		App->renderer->DrawDeferred(RenderLayer::HUD, [this, speed, x, y, is_turning, handbrake_active]()
+		{
+			DrawText(TextFormat("Speed: %.1f", speed), 10, 135, 16, GREEN);
+			DrawText(TextFormat("Position: (%d, %d)", x, y), 10, 155, 16, GREEN);
 
-		if (nitro_active) DrawText("*** NITRO ACTIVE ***", 10, 195, 20, SKYBLUE);
-		else if (handbrake_active && is_turning) DrawText("*** DRIFT MODE ***", 10, 195, 20, ORANGE);
-		else if (handbrake_active) DrawText("BRAKING", 10, 195, 16, RED);
+			if (nitro.active) DrawText("*** NITRO ACTIVE ***", 10, 195, 20, SKYBLUE);
+			else if (handbrake_active && is_turning) DrawText("*** DRIFT MODE ***", 10, 195, 20, ORANGE);
+			else if (handbrake_active) DrawText("BRAKING", 10, 195, 16, RED);
+		});
 	}
 
 	return UPDATE_CONTINUE;
@@ -564,7 +378,7 @@ void ModulePlayer::OnCollision(PhysBody* bodyA, PhysBody* bodyB)
 			if (volume < 0.2f) volume = 0.2f;
 
 			App->audio->SetFxVolume(sfx_crash, volume);
-			App->audio->SetFxPitch(sfx_crash, 0.8f + ((rand() % 40) / 100.0f));
+			App->audio->SetFxPitch(sfx_crash, 0.8f + (random.Range(40) / 100.0f));
 			App->audio->PlayFx(sfx_crash);
 		}
 	}
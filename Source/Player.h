@@ -3,6 +3,10 @@
 #include "Globals.h"
 #include "p2Point.h"
 #include "raylib.h"
+#include "PlayerInput.h"
+#include "RandomStream.h"
+#include "TextureAtlas.h"
+#include "HudCanvas.h"
 #include <vector>
 
 #pragma warning(push)
@@ -10,6 +14,26 @@
 #include "ModulePhysics.h"
 #pragma warning(pop)
 
+// Nitro bar of the HUD. It keeps only what it shows, the fill in pixels, the
+// state and the countdown in tenths, so it redraws a few times a second.
+class NitroGauge : public HudWidget
+{
+public:
+	NitroGauge();
+
+	void Set(const NitroState& nitro);
+
+protected:
+	void Redraw() const override;
+
+private:
+	enum class State { READY, ACTIVE, COOLDOWN };
+
+	State state;
+	int fill_width;
+	int cooldown_tenths;
+};
+
 class ModulePlayer : public Module
 {
 public:
@@ -25,36 +49,33 @@ public:
 	// Reset nitro to full charge (called when changing levels)
 	void ResetNitro();
 
+	// Controller state, restored together with a WorldSnapshot
+	struct ControllerState
+	{
+		NitroState nitro;
+		RandomStream random;
+	};
+	ControllerState SaveState() const;
+	void RestoreState(const ControllerState& state);
+
+	// Keyboard state of this frame, the only place the simulation reads keys
+	uint8_t SampleInput() const;
+
 	// Nitro system methods
-	void UpdateNitro(float dt);
-	void DrawNitroBar();
-	void DrawNitroEffects();
+	void UpdateNitro(float dt, uint8_t buttons);
 	void OnCollision(PhysBody* bodyA, PhysBody* bodyB) override;
 
 public:
 	PhysBody* vehicle;
-	Texture2D vehicle_texture;
+	int vehicle_id;
+	AtlasSprite vehicle_sprite;
 
 	// Nitro system variables
-	bool nitro_active;
-	float nitro_duration;
-	float nitro_timer;
-	float nitro_cooldown;
-	float nitro_cooldown_timer;
-	const float NITRO_MAX_DURATION = 5.0f;
-	const float NITRO_COOLDOWN_TIME = 10.0f;
-
-	// Visual effects for nitro
-	float nitro_particle_timer;
-	struct NitroParticle
-	{
-		vec2f position = { 0.0f, 0.0f };
-		vec2f velocity = { 0.0f, 0.0f };
-		float lifetime = 0.0f;
-		float max_lifetime = 0.0f;
-		Color color = WHITE;
-	};
-	std::vector<NitroParticle> nitro_particles;
+	NitroState nitro;
+	NitroGauge nitro_gauge;
+
+	// Sound variations, seeded by ModuleGame for every race
+	RandomStream random;
 
 	unsigned int sfx_engine;
 	unsigned int sfx_crash;
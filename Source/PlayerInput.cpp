@@ -0,0 +1,70 @@
+#include "PlayerInput.h"
+
+bool NitroState::Update(float dt, bool pressed)
+{
+	// Handle cooldown period
+	if (cooldown_timer > 0.0f)
+	{
+		cooldown_timer -= dt;
+		if (cooldown_timer < 0.0f)
+		{
+			cooldown_timer = 0.0f;
+			duration = NITRO_MAX_DURATION;
+		}
+		else
+		{
+			// Gradually refill the bar during cooldown
+			duration = NITRO_MAX_DURATION * (1.0f - (cooldown_timer / NITRO_COOLDOWN_TIME));
+		}
+	}
+
+	// Not while it is already boosting
+	bool fired = false;
+	if (pressed && !active && duration >= NITRO_MAX_DURATION && cooldown_timer <= 0.0f)
+	{
+		active = true;
+		timer = 0.0f;
+		fired = true;
+	}
+
+	// Update nitro timer and deactivate when duration is reached
+	if (active)
+	{
+		timer += dt;
+		if (timer >= NITRO_MAX_DURATION)
+		{
+			active = false;
+			timer = 0.0f;
+			duration = 0.0f;
+			cooldown_timer = NITRO_COOLDOWN_TIME;
+		}
+	}
+
+	return fired;
+}
+
+VehicleControls PlayerControls(uint8_t buttons, float speed, float forward_speed, bool boost)
+{
+	VehicleControls controls;
+	controls.boost = boost;
+
+	// Forward acceleration
+	if (buttons & INPUT_THROTTLE)
+	{
+		controls.throttle += 1.0f;
+	}
+
+	// Reverse / Brake
+	if (buttons & INPUT_BRAKE)
+	{
+		bool moving_forward = forward_speed > 0.1f;
+		if (moving_forward && speed > 1.0f) controls.brake = 1.0f;
+		else controls.throttle -= 1.0f;
+	}
+
+	if (buttons & INPUT_LEFT) controls.steer = -1.0f;
+	else if (buttons & INPUT_RIGHT) controls.steer = 1.0f;
+	controls.handbrake = (buttons & INPUT_HANDBRAKE) != 0;
+
+	return controls;
+}
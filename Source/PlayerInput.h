@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "VehicleSystem.h"
+
+// Buttons of the player for one frame. Everything the simulation reads from
+// the keyboard goes through these bits, so a race can be recorded and
+// replayed without a window.
+#define INPUT_THROTTLE 0x01
+#define INPUT_BRAKE 0x02		// brakes when going forward, reverses otherwise
+#define INPUT_LEFT 0x04
+#define INPUT_RIGHT 0x08
+#define INPUT_HANDBRAKE 0x10
+#define INPUT_NITRO 0x20		// pressed this frame
+
+#define NITRO_MAX_DURATION 5.0f
+#define NITRO_COOLDOWN_TIME 10.0f
+
+// Nitro charge of the player
+struct NitroState
+{
+	bool active = false;
+	float duration = NITRO_MAX_DURATION;	// charge, refills during the cooldown
+	float timer = 0.0f;						// time boosting
+	float cooldown_timer = 0.0f;
+
+	// Returns true when the nitro fires this frame
+	bool Update(float dt, bool pressed);
+};
+
+// Player drive logic, buttons to vehicle controls
+VehicleControls PlayerControls(uint8_t buttons, float speed, float forward_speed, bool boost);
@@ -0,0 +1,398 @@
+#include "RaceRecording.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#define RACE_RECORDING_VERSION 2
+
+namespace
+{
+	template<typename T>
+	void WriteArray(std::ofstream& file, const std::vector<T>& items)
+	{
+		int count = (int)items.size();
+		file.write((const char*)&count, sizeof(count));
+		file.write((const char*)items.data(), items.size() * sizeof(T));
+	}
+
+	template<typename T>
+	bool ReadArray(std::ifstream& file, std::vector<T>& items)
+	{
+		int count = 0;
+		file.read((char*)&count, sizeof(count));
+		if (!file || count < 0) return false;
+		items.resize(count);
+		file.read((char*)items.data(), items.size() * sizeof(T));
+		return (bool)file;
+	}
+}
+
+void RaceRecording::Clear()
+{
+	seed = 0;
+	map_path.clear();
+	waypoints.clear();
+	ai.clear();
+	player_vehicle_id = -1;
+	player_nitro = NitroState();
+	frames.clear();
+	bodies.clear();
+	fixtures.clear();
+	vertices.clear();
+	tunings.clear();
+	cars.clear();
+}
+
+void RaceRecording::Capture(const b2World* world, const VehicleSystem& vehicles)
+{
+	bodies.clear();
+	fixtures.clear();
+	vertices.clear();
+	tunings.clear();
+	cars.clear();
+	frames.clear();
+
+	wide_solver = world->GetWideContactSolver();
+	soft_steps = world->GetSoftStepCount();
+	gravity = world->GetGravity();
+
+	// Bodies and fixtures are listed newest first, record them the way they were created
+	std::vector<const b2Body*> order;
+	for (const b2Body* body = world->GetBodyList(); body; body = body->GetNext()) order.push_back(body);
+	std::reverse(order.begin(), order.end());
+
+	for (const b2Body* body : order)
+	{
+		RecordedBody rb;
+		rb.type = (int)body->GetType();
+		rb.position = body->GetPosition();
+		rb.angle = body->GetAngle();
+		rb.linear_velocity = body->GetLinearVelocity();
+		rb.angular_velocity = body->GetAngularVelocity();
+		rb.linear_damping = body->GetLinearDamping();
+		rb.angular_damping = body->GetAngularDamping();
+		rb.gravity_scale = body->GetGravityScale();
+		rb.awake = body->IsAwake();
+		rb.allow_sleep = body->IsSleepingAllowed();
+		rb.fixed_rotation = body->IsFixedRotation();
+		rb.bullet = body->IsBullet();
+		rb.enabled = body->IsEnabled();
+		rb.first_fixture = (int)fixtures.size();
+
+		std::vector<const b2Fixture*> body_fixtures;
+		for (const b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext()) body_fixtures.push_back(fixture);
+		std::reverse(body_fixtures.begin(), body_fixtures.end());
+
+		for (const b2Fixture* fixture : body_fixtures)
+		{
+			const b2Shape* shape = fixture->GetShape();
+			RecordedFixture rf;
+			rf.shape = (int)shape->GetType();
+			rf.radius = shape->m_radius;
+			rf.first_vertex = (int)vertices.size();
+
+			switch (shape->GetType())
+			{
+			case b2Shape::e_circle:
+				rf.center = ((const b2CircleShape*)shape)->m_p;
+				break;
+			case b2Shape::e_edge:
+			{
+				const b2EdgeShape* edge = (const b2EdgeShape*)shape;
+				vertices.push_back(edge->m_vertex1);
+				vertices.push_back(edge->m_vertex2);
+				rf.prev = edge->m_vertex0;
+				rf.next = edge->m_vertex3;
+				rf.one_sided = edge->m_oneSided;
+				break;
+			}
+			case b2Shape::e_polygon:
+			{
+				const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+				// Normals after the vertices, recomputing them can be off by an ulp from SetAsBox
+				vertices.insert(vertices.end(), polygon->m_vertices, polygon->m_vertices + polygon->m_count);
+				vertices.insert(vertices.end(), polygon->m_normals, polygon->m_normals + polygon->m_count);
+				rf.center = polygon->m_centroid;
+				break;
+			}
+			case b2Shape::e_chain:
+			{
+				const b2ChainShape* chain = (const b2ChainShape*)shape;
+				vertices.insert(vertices.end(), chain->m_vertices, chain->m_vertices + chain->m_count);
+				rf.prev = chain->m_prevVertex;
+				rf.next = chain->m_nextVertex;
+				break;
+			}
+			default:
+				break;
+			}
+			rf.vertex_count = (int)vertices.size() - rf.first_vertex;
+
+			rf.sensor = fixture->IsSensor();
+			rf.density = fixture->GetDensity();
+			rf.friction = fixture->GetFriction();
+			rf.restitution = fixture->GetRestitution();
+			rf.restitution_threshold = fixture->GetRestitutionThreshold();
+			const b2Filter& filter = fixture->GetFilterData();
+			rf.category_bits = filter.categoryBits;
+			rf.mask_bits = filter.maskBits;
+			rf.group_index = filter.groupIndex;
+			fixtures.push_back(rf);
+		}
+
+		rb.fixture_count = (int)fixtures.size() - rb.first_fixture;
+		bodies.push_back(rb);
+	}
+
+	for (int i = 0; i < vehicles.GetTuningCount(); ++i) tunings.push_back(vehicles.GetTuning(i));
+
+	// Cars in id order, the replay adds them the same way
+	for (int id = 0; id < vehicles.GetIdCount(); ++id)
+	{
+		if (!vehicles.IsValid(id)) continue;
+
+		RecordedVehicle car;
+		car.id = id;
+		car.profile = vehicles.GetProfile(id);
+		car.body = (int)(std::find(order.begin(), order.end(), vehicles.GetBody(id)) - order.begin());
+		cars.push_back(car);
+	}
+}
+
+void RaceRecording::AddFrame(float dt, int steps, uint8_t buttons, uint32_t hash)
+{
+	RecordedFrame frame;
+	frame.dt = dt;
+	// The first frame starts from the captured state, whatever ran before belongs to the countdown
+	frame.steps = frames.empty() ? 0 : (uint8_t)std::min(steps, 255);
+	frame.buttons = buttons;
+	frame.hash = hash;
+	frames.push_back(frame);
+}
+
+b2World* RaceRecording::CreateWorld(std::vector<b2Body*>& created) const
+{
+	b2World* world = new b2World(gravity);
+	world->SetAutoClearForces(false);
+	world->SetWideContactSolver(wide_solver);
+	world->SetSoftStepCount(soft_steps);
+
+	created.clear();
+	for (const RecordedBody& rb : bodies)
+	{
+		b2BodyDef def;
+		def.type = (b2BodyType)rb.type;
+		def.position = rb.position;
+		def.angle = rb.angle;
+		def.linearVelocity = rb.linear_velocity;
+		def.angularVelocity = rb.angular_velocity;
+		def.linearDamping = rb.linear_damping;
+		def.angularDamping = rb.angular_damping;
+		def.gravityScale = rb.gravity_scale;
+		def.awake = rb.awake != 0;
+		def.allowSleep = rb.allow_sleep != 0;
+		def.fixedRotation = rb.fixed_rotation != 0;
+		def.bullet = rb.bullet != 0;
+		def.enabled = rb.enabled != 0;
+		b2Body* body = world->CreateBody(&def);
+
+		for (int f = rb.first_fixture; f < rb.first_fixture + rb.fixture_count; ++f)
+		{
+			const RecordedFixture& rf = fixtures[f];
+			const b2Vec2* points = vertices.data() + rf.first_vertex;
+
+			b2CircleShape circle;
+			b2EdgeShape edge;
+			b2PolygonShape polygon;
+			b2ChainShape chain;
+
+			b2Shape* shape = nullptr;
+			switch ((b2Shape::Type)rf.shape)
+			{
+			case b2Shape::e_circle:
+				circle.m_p = rf.center;
+				shape = &circle;
+				break;
+			case b2Shape::e_edge:
+				edge.m_vertex0 = rf.prev;
+				edge.m_vertex1 = points[0];
+				edge.m_vertex2 = points[1];
+				edge.m_vertex3 = rf.next;
+				edge.m_oneSided = rf.one_sided != 0;
+				shape = &edge;
+				break;
+			case b2Shape::e_polygon:
+				// Set would recompute the hull and may start it on another vertex, copy it as it is
+				polygon.m_count = rf.vertex_count / 2;
+				memcpy(polygon.m_vertices, points, polygon.m_count * sizeof(b2Vec2));
+				memcpy(polygon.m_normals, points + polygon.m_count, polygon.m_count * sizeof(b2Vec2));
+				polygon.m_centroid = rf.center;
+				shape = &polygon;
+				break;
+			case b2Shape::e_chain:
+				// CreateChain checks the vertex spacing again, the track already passed it
+				chain.m_count = rf.vertex_count;
+				chain.m_vertices = (b2Vec2*)b2Alloc(rf.vertex_count * sizeof(b2Vec2));
+				memcpy(chain.m_vertices, points, rf.vertex_count * sizeof(b2Vec2));
+				chain.m_prevVertex = rf.prev;
+				chain.m_nextVertex = rf.next;
+				shape = &chain;
+				break;
+			default:
+				continue;
+			}
+			shape->m_radius = rf.radius;
+
+			b2FixtureDef fd;
+			fd.shape = shape;
+			fd.isSensor = rf.sensor != 0;
+			fd.density = rf.density;
+			fd.friction = rf.friction;
+			fd.restitution = rf.restitution;
+			fd.restitutionThreshold = rf.restitution_threshold;
+			fd.filter.categoryBits = rf.category_bits;
+			fd.filter.maskBits = rf.mask_bits;
+			fd.filter.groupIndex = (int16)rf.group_index;
+			body->CreateFixture(&fd);
+		}
+
+		created.push_back(body);
+	}
+
+	// The game builds the tree of the walls in bulk, ModulePhysics::ResetContacts
+	world->RebuildStaticTree();
+	return world;
+}
+
+void RaceRecording::CreateVehicles(VehicleSystem& vehicles, const std::vector<b2Body*>& created, std::vector<int>& ids) const
+{
+	vehicles.Clear();
+	for (const VehicleTuning& tuning : tunings) vehicles.AddTuning(tuning);
+
+	ids.clear();
+	for (const RecordedVehicle& car : cars)
+	{
+		if (car.id >= (int)ids.size()) ids.resize(car.id + 1, -1);
+		ids[car.id] = vehicles.AddVehicle(created[car.body], car.profile);
+	}
+}
+
+bool RaceRecording::Save(const char* path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	int header[4] = { RACE_RECORDING_VERSION, soft_steps, wide_solver ? 1 : 0, player_vehicle_id };
+	int path_length = (int)map_path.size();
+	file.write("RREC", 4);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)&seed, sizeof(seed));
+	file.write((const char*)&fixed_step, sizeof(fixed_step));
+	file.write((const char*)&gravity, sizeof(gravity));
+	file.write((const char*)&path_length, sizeof(path_length));
+	file.write(map_path.data(), path_length);
+
+	WriteArray(file, bodies);
+	WriteArray(file, fixtures);
+	WriteArray(file, vertices);
+	WriteArray(file, tunings);
+	WriteArray(file, cars);
+
+	int waypoint_count = (int)waypoints.size();
+	file.write((const char*)&waypoint_count, sizeof(waypoint_count));
+	for (const Waypoint& wp : waypoints)
+	{
+		file.write((const char*)&wp.id, sizeof(wp.id));
+		file.write((const char*)&wp.position, sizeof(wp.position));
+		WriteArray(file, wp.next_ids);
+	}
+
+	file.write((const char*)&ai_params, sizeof(ai_params));
+	WriteArray(file, ai);
+	file.write((const char*)&player_nitro, sizeof(player_nitro));
+
+	int frame_count = (int)frames.size();
+	file.write((const char*)&frame_count, sizeof(frame_count));
+	for (const RecordedFrame& frame : frames)
+	{
+		file.write((const char*)&frame.dt, sizeof(frame.dt));
+		file.write((const char*)&frame.steps, sizeof(frame.steps));
+		file.write((const char*)&frame.buttons, sizeof(frame.buttons));
+		file.write((const char*)&frame.hash, sizeof(frame.hash));
+	}
+	return file.good();
+}
+
+bool RaceRecording::Load(const char* path)
+{
+	Clear();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int header[4];
+	int path_length = 0;
+	file.read(magic, 4);
+	file.read((char*)header, sizeof(header));
+	file.read((char*)&seed, sizeof(seed));
+	file.read((char*)&fixed_step, sizeof(fixed_step));
+	file.read((char*)&gravity, sizeof(gravity));
+	file.read((char*)&path_length, sizeof(path_length));
+	if (!file || std::string(magic, 4) != "RREC" || header[0] != RACE_RECORDING_VERSION || path_length < 0) return false;
+
+	soft_steps = header[1];
+	wide_solver = header[2] != 0;
+	player_vehicle_id = header[3];
+	map_path.resize(path_length);
+	file.read(&map_path[0], path_length);
+
+	bool valid = ReadArray(file, bodies) && ReadArray(file, fixtures) && ReadArray(file, vertices) && ReadArray(file, tunings) && ReadArray(file, cars);
+
+	int waypoint_count = 0;
+	file.read((char*)&waypoint_count, sizeof(waypoint_count));
+	valid = valid && file && waypoint_count >= 0;
+	for (int i = 0; valid && i < waypoint_count; ++i)
+	{
+		Waypoint wp;
+		file.read((char*)&wp.id, sizeof(wp.id));
+		file.read((char*)&wp.position, sizeof(wp.position));
+		valid = ReadArray(file, wp.next_ids);
+		waypoints.push_back(wp);
+	}
+
+	file.read((char*)&ai_params, sizeof(ai_params));
+	valid = valid && ReadArray(file, ai);
+	file.read((char*)&player_nitro, sizeof(player_nitro));
+
+	int frame_count = 0;
+	file.read((char*)&frame_count, sizeof(frame_count));
+	valid = valid && file && frame_count >= 0;
+	if (valid) frames.resize(frame_count);
+	for (RecordedFrame& frame : frames)
+	{
+		file.read((char*)&frame.dt, sizeof(frame.dt));
+		file.read((char*)&frame.steps, sizeof(frame.steps));
+		file.read((char*)&frame.buttons, sizeof(frame.buttons));
+		file.read((char*)&frame.hash, sizeof(frame.hash));
+	}
+	valid = valid && (bool)file;
+
+	// Indices into the arrays must hold before anything is built from them
+	for (const RecordedBody& rb : bodies) valid = valid && rb.first_fixture >= 0 && rb.fixture_count >= 0 && rb.first_fixture + rb.fixture_count <= (int)fixtures.size();
+	for (const RecordedFixture& rf : fixtures)
+	{
+		valid = valid && rf.first_vertex >= 0 && rf.vertex_count >= 0 && rf.first_vertex + rf.vertex_count <= (int)vertices.size();
+		if (rf.shape == (int)b2Shape::e_edge) valid = valid && rf.vertex_count == 2;
+		if (rf.shape == (int)b2Shape::e_polygon) valid = valid && rf.vertex_count % 2 == 0 && rf.vertex_count >= 6 && rf.vertex_count <= 2 * b2_maxPolygonVertices;
+		if (rf.shape == (int)b2Shape::e_chain) valid = valid && rf.vertex_count >= 2;
+	}
+	for (const RecordedVehicle& car : cars) valid = valid && car.id >= 0 && car.body >= 0 && car.body < (int)bodies.size() && car.profile >= 0 && car.profile < (int)tunings.size();
+	if (!valid)
+	{
+		Clear();
+		return false;
+	}
+	return true;
+}
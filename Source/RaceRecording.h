@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+#include "AIVehicle.h"
+#include "PlayerInput.h"
+#include "VehicleSystem.h"
+
+// Bit of RecordedFrame::buttons next to the INPUT_* ones: the menu was open,
+// the player's car was held still and its buttons were not read
+#define RECORDED_PLAYER_HELD 0x80
+
+// One frame of a recorded race, 10 bytes on disk
+struct RecordedFrame
+{
+	float dt = 0.0f;		// frame time seen by the AI and the player
+	uint8_t steps = 0;		// physics steps run before this frame's think
+	uint8_t buttons = 0;	// INPUT_* bits of the player
+	uint32_t hash = 0;		// VehicleSystem::Hash after the steps
+};
+
+// Body of the world at the start line, rebuilt as it was created
+struct RecordedBody
+{
+	int type = 0;
+	b2Vec2 position = { 0.0f, 0.0f };
+	float angle = 0.0f;
+	b2Vec2 linear_velocity = { 0.0f, 0.0f };
+	float angular_velocity = 0.0f;
+	float linear_damping = 0.0f;
+	float angular_damping = 0.0f;
+	float gravity_scale = 1.0f;
+	int awake = 1;
+	int allow_sleep = 1;
+	int fixed_rotation = 0;
+	int bullet = 0;
+	int enabled = 1;
+	int first_fixture = 0;
+	int fixture_count = 0;
+};
+
+struct RecordedFixture
+{
+	int shape = 0;			// b2Shape::Type
+	float radius = 0.0f;
+	b2Vec2 center = { 0.0f, 0.0f };	// circle position, polygon centroid
+	b2Vec2 prev = { 0.0f, 0.0f };	// chain and edge ghost vertices
+	b2Vec2 next = { 0.0f, 0.0f };
+	int first_vertex = 0;
+	int vertex_count = 0;
+	int one_sided = 0;
+	int sensor = 0;
+	float density = 0.0f;
+	float friction = 0.0f;
+	float restitution = 0.0f;
+	float restitution_threshold = 0.0f;
+	uint16_t category_bits = 0;
+	uint16_t mask_bits = 0;
+	int group_index = 0;
+};
+
+struct RecordedVehicle
+{
+	int id = -1;
+	int body = -1;			// index in creation order
+	int profile = 0;
+};
+
+struct RecordedAI
+{
+	int vehicle_id = -1;
+	AIVehicleState state;
+};
+
+// A race from the start line: the seed, the whole world as it stood when the
+// lights went green, the car controllers and then the player buttons of every
+// frame. Everything else the race does follows from those, so it can be run
+// again without a window and the per-frame hashes compared.
+class RaceRecording
+{
+public:
+	// World, cars and controllers at the start line
+	void Capture(const b2World* world, const VehicleSystem& vehicles);
+	void AddFrame(float dt, int steps, uint8_t buttons, uint32_t hash);
+	void Clear();
+
+	// New world with the recorded bodies and settings, in creation order
+	b2World* CreateWorld(std::vector<b2Body*>& bodies) const;
+	// Tunings and cars into an empty system, recorded vehicle ids map to the returned ones
+	void CreateVehicles(VehicleSystem& vehicles, const std::vector<b2Body*>& bodies, std::vector<int>& ids) const;
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+
+	uint64_t seed = 0;
+	std::string map_path;
+	float fixed_step = 0.0f;
+	bool wide_solver = false;
+	int soft_steps = 0;
+	b2Vec2 gravity = { 0.0f, 0.0f };
+
+	AIParams ai_params;
+	std::vector<Waypoint> waypoints;
+	std::vector<RecordedAI> ai;
+	int player_vehicle_id = -1;
+	NitroState player_nitro;
+
+	std::vector<RecordedFrame> frames;
+
+private:
+	std::vector<RecordedBody> bodies;
+	std::vector<RecordedFixture> fixtures;
+	std::vector<b2Vec2> vertices;
+	std::vector<VehicleTuning> tunings;
+	std::vector<RecordedVehicle> cars;
+};
@@ -0,0 +1,531 @@
+#include "RacingLine.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#define RACING_LINE_FILE_VERSION 1
+#define RACING_LINE_GRID_CELL 0.25f	// meters, clearance grid used while optimizing
+
+namespace
+{
+	bool ReadAttribute(const std::string& line, const char* name, std::string& value)
+	{
+		std::string key = std::string(name) + "=\"";
+		size_t pos = line.find(key);
+		if (pos == std::string::npos) return false;
+
+		size_t start = pos + key.size();
+		value = line.substr(start, line.find('"', start) - start);
+		return true;
+	}
+
+	float ReadFloat(const std::string& line, const char* name)
+	{
+		std::string value;
+		if (!ReadAttribute(line, name, value)) return 0.0f;
+		try { return std::stof(value); }
+		catch (...) { return 0.0f; }
+	}
+
+	float DistanceToSegment(const b2Vec2& a, const b2Vec2& b, const b2Vec2& p)
+	{
+		b2Vec2 e = b - a;
+		float len_sqr = e.LengthSquared();
+		float t = len_sqr > 0.0f ? b2Clamp(b2Dot(p - a, e) / len_sqr, 0.0f, 1.0f) : 0.0f;
+		return b2Distance(p, a + t * e);
+	}
+
+	// Distance to the closest wall, sampled on a grid over the track.
+	// Bilinear lookups, 0 outside the grid.
+	class ClearanceGrid
+	{
+	public:
+		void Build(const std::vector<std::vector<b2Vec2>>& walls, float cell_size)
+		{
+			cell = cell_size;
+			b2Vec2 lower(FLT_MAX, FLT_MAX), upper(-FLT_MAX, -FLT_MAX);
+			for (const std::vector<b2Vec2>& wall : walls)
+			{
+				for (const b2Vec2& p : wall)
+				{
+					lower = b2Min(lower, p);
+					upper = b2Max(upper, p);
+				}
+			}
+
+			origin = lower;
+			width = (int)((upper.x - lower.x) / cell) + 2;
+			height = (int)((upper.y - lower.y) / cell) + 2;
+			values.assign(width * height, 0.0f);
+
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					b2Vec2 p = origin + b2Vec2(x * cell, y * cell);
+					float best = FLT_MAX;
+					for (const std::vector<b2Vec2>& wall : walls)
+					{
+						for (size_t i = 0; i < wall.size(); ++i)
+						{
+							best = b2Min(best, DistanceToSegment(wall[i], wall[(i + 1) % wall.size()], p));
+						}
+					}
+					values[y * width + x] = best;
+				}
+			}
+		}
+
+		float Sample(const b2Vec2& p) const
+		{
+			float fx = (p.x - origin.x) / cell;
+			float fy = (p.y - origin.y) / cell;
+			int x = (int)std::floor(fx);
+			int y = (int)std::floor(fy);
+			if (x < 0 || y < 0 || x >= width - 1 || y >= height - 1) return 0.0f;
+
+			float tx = fx - x;
+			float ty = fy - y;
+			const float* row = &values[y * width + x];
+			float top = row[0] + (row[1] - row[0]) * tx;
+			float bottom = row[width] + (row[width + 1] - row[width]) * tx;
+			return top + (bottom - top) * ty;
+		}
+
+		b2Vec2 Gradient(const b2Vec2& p) const
+		{
+			b2Vec2 dx(0.5f * cell, 0.0f), dy(0.0f, 0.5f * cell);
+			return b2Vec2(Sample(p + dx) - Sample(p - dx), Sample(p + dy) - Sample(p - dy));
+		}
+
+	private:
+		b2Vec2 origin = b2Vec2(0.0f, 0.0f);
+		float cell = 1.0f;
+		int width = 0;
+		int height = 0;
+		std::vector<float> values;
+	};
+
+	// Radius of the circle through three points, FLT_MAX when they are aligned
+	float CircleRadius(const b2Vec2& a, const b2Vec2& b, const b2Vec2& c)
+	{
+		float area2 = std::fabs(b2Cross(b - a, c - a));
+		if (area2 < b2_epsilon) return FLT_MAX;
+		return b2Distance(a, b) * b2Distance(b, c) * b2Distance(c, a) / (2.0f * area2);
+	}
+
+	// Closed polyline resampled at a fixed spacing. The segment of every sample
+	// is the one of the source point it was taken after.
+	void Resample(const std::vector<b2Vec2>& in, const std::vector<int>& in_segments, float spacing,
+		std::vector<b2Vec2>& out, std::vector<int>& out_segments, float& out_spacing)
+	{
+		int count = (int)in.size();
+		float length = 0.0f;
+		for (int i = 0; i < count; ++i) length += b2Distance(in[i], in[(i + 1) % count]);
+
+		int samples = b2Max((int)(length / spacing + 0.5f), 3);
+		out_spacing = length / samples;
+		out.clear();
+		out_segments.clear();
+
+		int i = 0;
+		float walked = 0.0f;	// length up to in[i]
+		for (int k = 0; k < samples; ++k)
+		{
+			float s = k * out_spacing;
+			float seg_length = b2Distance(in[i], in[(i + 1) % count]);
+			while (walked + seg_length < s && i < count - 1)
+			{
+				walked += seg_length;
+				i++;
+				seg_length = b2Distance(in[i], in[(i + 1) % count]);
+			}
+
+			float t = seg_length > 0.0f ? (s - walked) / seg_length : 0.0f;
+			out.push_back(in[i] + t * (in[(i + 1) % count] - in[i]));
+			out_segments.push_back(in_segments[i]);
+		}
+	}
+}
+
+std::string RacingLine::GetLinePath(const char* tmx_path)
+{
+	std::string path = tmx_path;
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos) path.erase(dot);
+	return path + ".line";
+}
+
+bool RacingLine::Compile(const char* tmx_path, float pixels_per_meter, const RacingLineParams& params)
+{
+	std::vector<RacingLineWaypoint> waypoints;
+	std::vector<std::vector<b2Vec2>> walls;
+	if (!ReadTrack(tmx_path, pixels_per_meter, waypoints, walls)) return false;
+
+	Build(waypoints, walls, params);
+	return IsValid();
+}
+
+bool RacingLine::ReadTrack(const char* tmx_path, float pixels_per_meter, std::vector<RacingLineWaypoint>& waypoints, std::vector<std::vector<b2Vec2>>& walls)
+{
+	std::ifstream file(tmx_path);
+	if (!file.is_open()) return false;
+
+	waypoints.clear();
+	walls.clear();
+
+	std::string line;
+	std::string value;
+	bool in_waypoints = false;
+	bool in_object = false;
+	bool is_wall = false;
+	b2Vec2 object_pos(0.0f, 0.0f);
+	std::vector<b2Vec2> object_points;
+	RacingLineWaypoint wp;
+
+	while (std::getline(file, line))
+	{
+		if (line.find("<objectgroup") != std::string::npos) in_waypoints = line.find("name=\"AI_Waypoints\"") != std::string::npos;
+		if (line.find("</objectgroup>") != std::string::npos) in_waypoints = false;
+
+		if (line.find("<object ") != std::string::npos)
+		{
+			in_object = true;
+			is_wall = false;
+			object_points.clear();
+			object_pos.Set(ReadFloat(line, " x"), ReadFloat(line, " y"));
+			wp = RacingLineWaypoint();
+			wp.position.Set(object_pos.x / pixels_per_meter, object_pos.y / pixels_per_meter);
+		}
+		if (!in_object) continue;
+
+		if (line.find("<property") != std::string::npos && ReadAttribute(line, "value", value))
+		{
+			if (line.find("name=\"type\"") != std::string::npos) is_wall = value == "wall_chain";
+			else if (line.find("name=\"checkpoint_id\"") != std::string::npos)
+			{
+				try { wp.id = std::stoi(value); }
+				catch (...) {}
+			}
+			else if (line.find("name=\"racing_line\"") != std::string::npos)
+			{
+				if (value == "inner") wp.line = RacingLineHint::INNER;
+				else if (value == "outer") wp.line = RacingLineHint::OUTER;
+				else wp.line = RacingLineHint::CENTER;
+			}
+			else if (line.find("name=\"speed_zone\"") != std::string::npos)
+			{
+				if (value == "slow") wp.zone = SpeedZone::SLOW;
+				else if (value == "fast") wp.zone = SpeedZone::FAST;
+				else wp.zone = SpeedZone::NORMAL;
+			}
+		}
+
+		if ((line.find("<polygon") != std::string::npos || line.find("<polyline") != std::string::npos) && ReadAttribute(line, "points", value))
+		{
+			std::stringstream ss(value);
+			std::string pair;
+			while (std::getline(ss, pair, ' '))
+			{
+				size_t comma = pair.find(',');
+				if (comma == std::string::npos) continue;
+				try
+				{
+					float x = object_pos.x + std::stof(pair.substr(0, comma));
+					float y = object_pos.y + std::stof(pair.substr(comma + 1));
+					object_points.push_back(b2Vec2(x / pixels_per_meter, y / pixels_per_meter));
+				}
+				catch (...) {}
+			}
+		}
+
+		if (line.find("</object>") != std::string::npos)
+		{
+			in_object = false;
+			if (is_wall && object_points.size() > 1) walls.push_back(object_points);
+			if (in_waypoints && wp.id != -1) waypoints.push_back(wp);
+		}
+	}
+
+	return waypoints.size() >= 3 && !walls.empty();
+}
+
+void RacingLine::Build(const std::vector<RacingLineWaypoint>& waypoints, const std::vector<std::vector<b2Vec2>>& walls, const RacingLineParams& params)
+{
+	Clear();
+	if (waypoints.size() < 3) return;
+
+	// Main loop of the track: the waypoints in id order
+	std::vector<RacingLineWaypoint> loop = waypoints;
+	std::sort(loop.begin(), loop.end(), [](const RacingLineWaypoint& a, const RacingLineWaypoint& b) { return a.id < b.id; });
+
+	std::vector<b2Vec2> loop_points;
+	std::vector<int> loop_segments;
+	for (int i = 0; i < (int)loop.size(); ++i)
+	{
+		order.push_back(loop[i].id);
+		loop_points.push_back(loop[i].position);
+		loop_segments.push_back(i);
+	}
+
+	std::vector<b2Vec2> center;
+	std::vector<int> center_segments;
+	float center_spacing;
+	Resample(loop_points, loop_segments, params.spacing, center, center_segments, center_spacing);
+	int count = (int)center.size();
+	waypoint_length = center_spacing * count;
+
+	ClearanceGrid grid;
+	grid.Build(walls, RACING_LINE_GRID_CELL);
+
+	// Some waypoints sit close to a wall, climb the clearance until the
+	// reference line keeps the margin
+	for (b2Vec2& p : center)
+	{
+		for (int step = 0; step < 50 && grid.Sample(p) < params.wall_margin; ++step)
+		{
+			b2Vec2 gradient = grid.Gradient(p);
+			if (gradient.Normalize() < b2_epsilon) break;
+			p += 0.1f * gradient;
+		}
+	}
+
+	// Round the corners of the waypoint polygon
+	for (int pass = 0; pass < 20; ++pass)
+	{
+		std::vector<b2Vec2> smooth(count);
+		for (int i = 0; i < count; ++i)
+		{
+			smooth[i] = 0.25f * center[(i + count - 1) % count] + 0.5f * center[i] + 0.25f * center[(i + 1) % count];
+		}
+		center.swap(smooth);
+	}
+
+	// Hint limits of every sample, around its place on the reference line
+	std::vector<float> band(count, FLT_MAX);
+	std::vector<b2Vec2> inside(count, b2Vec2_zero);
+	const int turn_span = b2Max((int)(5.0f / center_spacing + 0.5f), 1);
+
+	for (int i = 0; i < count; ++i)
+	{
+		const RacingLineWaypoint& hint = loop[center_segments[i]];
+		if (hint.line == RacingLineHint::CENTER)
+		{
+			band[i] = b2Max(params.center_band * 2.0f * grid.Sample(center[i]), 0.5f);
+		}
+		else if (hint.line == RacingLineHint::OUTER)
+		{
+			inside[i] = center[(i + turn_span) % count] + center[(i + count - turn_span) % count] - 2.0f * center[i];
+			inside[i].Normalize();
+		}
+	}
+
+	// Clearance of a sample and of the chord from the previous one, which
+	// can get long around a hairpin
+	std::vector<b2Vec2> line = center;
+	auto clearance_at = [&](int i, const b2Vec2& p)
+	{
+		const b2Vec2& prev = line[(i + count - 1) % count];
+		return b2Min(grid.Sample(p), grid.Sample(0.5f * (p + prev)));
+	};
+
+	// Pull every sample towards the middle of its neighbours. This shortens
+	// the line until it runs into the walls, so it cuts to the apex of every
+	// corner where the hints allow it. A move that gets closer to a wall than
+	// the margin is cut short.
+	for (int pass = 0; pass < params.iterations; ++pass)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			b2Vec2 current = line[i];
+			b2Vec2 wanted = 0.5f * (line[(i + count - 1) % count] + line[(i + 1) % count]);
+
+			b2Vec2 from_center = wanted - center[i];
+			if (from_center.Length() > band[i]) wanted = center[i] + (band[i] / from_center.Length()) * from_center;
+			float into_turn = b2Dot(wanted - center[i], inside[i]);
+			if (into_turn > 0.0f) wanted -= into_turn * inside[i];
+
+			float needed = b2Min(params.wall_margin, clearance_at(i, current));
+			if (clearance_at(i, wanted) < needed)
+			{
+				b2Vec2 good = current;
+				for (int step = 0; step < 4; ++step)
+				{
+					b2Vec2 half = 0.5f * (good + wanted);
+					if (clearance_at(i, half) < needed) wanted = half;
+					else good = half;
+				}
+				wanted = good;
+			}
+			line[i] = wanted;
+		}
+	}
+
+	// The optimized line is shorter on the inside of corners, resample it so
+	// the samples are evenly spaced again and distance lookups stay O(1)
+	Resample(line, center_segments, params.spacing, points, segments, spacing);
+	count = (int)points.size();
+
+	// Curvature from the circle through samples a few meters apart, averaged
+	// so single kinks at the apexes don't stall the car
+	const int k = b2Max((int)(3.0f / spacing + 0.5f), 1);
+	std::vector<float> curvature(count);
+	for (int i = 0; i < count; ++i)
+	{
+		curvature[i] = 1.0f / CircleRadius(points[(i + count - k) % count], points[i], points[(i + k) % count]);
+	}
+
+	speeds.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		float kappa = 0.0f;
+		for (int j = -2; j <= 2; ++j) kappa += curvature[(i + j + count) % count];
+		kappa /= 5.0f;
+
+		float cap = params.zone_speed[(int)loop[segments[i]].zone];
+		speeds[i] = kappa > 0.0f ? b2Min(cap, std::sqrt(params.lateral_accel / kappa)) : cap;
+	}
+
+	// Acceleration and braking limits, twice around so the loop closes
+	for (int pass = 0; pass < 2 * count; ++pass)
+	{
+		int i = pass % count;
+		int prev = (i + count - 1) % count;
+		speeds[i] = b2Min(speeds[i], std::sqrt(speeds[prev] * speeds[prev] + 2.0f * params.accel * spacing));
+	}
+	for (int pass = 2 * count - 1; pass >= 0; --pass)
+	{
+		int i = pass % count;
+		int next = (i + 1) % count;
+		speeds[i] = b2Min(speeds[i], std::sqrt(speeds[next] * speeds[next] + 2.0f * params.brake * spacing));
+	}
+
+	lap_time = 0.0f;
+	min_clearance = FLT_MAX;
+	for (int i = 0; i < count; ++i)
+	{
+		float v = 0.5f * (speeds[i] + speeds[(i + 1) % count]);
+		lap_time += spacing / b2Max(v, 0.1f);
+		min_clearance = b2Min(min_clearance, grid.Sample(points[i]));
+	}
+}
+
+void RacingLine::Clear()
+{
+	points.clear();
+	speeds.clear();
+	segments.clear();
+	order.clear();
+	spacing = 1.0f;
+	lap_time = 0.0f;
+	min_clearance = 0.0f;
+	waypoint_length = 0.0f;
+}
+
+bool RacingLine::Save(const char* path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	int header[3] = { RACING_LINE_FILE_VERSION, (int)points.size(), (int)order.size() };
+	float values[4] = { spacing, lap_time, min_clearance, waypoint_length };
+	file.write("RLIN", 4);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)values, sizeof(values));
+	file.write((const char*)order.data(), order.size() * sizeof(int));
+	file.write((const char*)points.data(), points.size() * sizeof(b2Vec2));
+	file.write((const char*)speeds.data(), speeds.size() * sizeof(float));
+	file.write((const char*)segments.data(), segments.size() * sizeof(int));
+	return file.good();
+}
+
+bool RacingLine::Load(const char* path)
+{
+	Clear();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int header[3];
+	float values[4];
+	file.read(magic, 4);
+	file.read((char*)header, sizeof(header));
+	file.read((char*)values, sizeof(values));
+	if (!file || std::string(magic, 4) != "RLIN" || header[0] != RACING_LINE_FILE_VERSION || header[1] < 3 || header[2] < 1) return false;
+
+	order.resize(header[2]);
+	points.resize(header[1]);
+	speeds.resize(header[1]);
+	segments.resize(header[1]);
+	file.read((char*)order.data(), order.size() * sizeof(int));
+	file.read((char*)points.data(), points.size() * sizeof(b2Vec2));
+	file.read((char*)speeds.data(), speeds.size() * sizeof(float));
+	file.read((char*)segments.data(), segments.size() * sizeof(int));
+
+	bool valid = (bool)file;
+	for (int segment : segments) valid = valid && segment >= 0 && segment < (int)order.size();
+	if (!valid)
+	{
+		Clear();
+		return false;
+	}
+
+	spacing = values[0];
+	lap_time = values[1];
+	min_clearance = values[2];
+	waypoint_length = values[3];
+	return true;
+}
+
+int RacingLine::Locate(const b2Vec2& position) const
+{
+	int best = 0;
+	float best_sqr = FLT_MAX;
+	for (int i = 0; i < (int)points.size(); ++i)
+	{
+		float d = b2DistanceSquared(points[i], position);
+		if (d < best_sqr)
+		{
+			best_sqr = d;
+			best = i;
+		}
+	}
+	return best;
+}
+
+int RacingLine::Track(const b2Vec2& position, int index) const
+{
+	if (index < 0) return Locate(position);
+
+	index = Wrap(index);
+	float best_sqr = b2DistanceSquared(points[index], position);
+
+	// Forward first, cars rarely go back
+	int start = index;
+	for (int step = 0; step < RACING_LINE_TRACK_STEPS; ++step)
+	{
+		int next = Wrap(index + 1);
+		float d = b2DistanceSquared(points[next], position);
+		if (d > best_sqr) break;
+		best_sqr = d;
+		index = next;
+	}
+	if (index == start)
+	{
+		for (int step = 0; step < RACING_LINE_TRACK_STEPS; ++step)
+		{
+			int prev = Wrap(index - 1);
+			float d = b2DistanceSquared(points[prev], position);
+			if (d > best_sqr) break;
+			best_sqr = d;
+			index = prev;
+		}
+	}
+
+	if (best_sqr > RACING_LINE_LOST_DISTANCE * RACING_LINE_LOST_DISTANCE) return Locate(position);
+	return index;
+}
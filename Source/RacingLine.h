@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+#define RACING_LINE_TRACK_STEPS 16		// samples a car may move along the line per lookup
+#define RACING_LINE_LOST_DISTANCE 8.0f	// further than this from the line searches it again
+
+// Hints of the AI_Waypoints objects of a track
+enum class RacingLineHint { CENTER, INNER, OUTER };
+enum class SpeedZone { SLOW, NORMAL, FAST };
+
+struct RacingLineWaypoint
+{
+	int id = -1;
+	b2Vec2 position = b2Vec2(0.0f, 0.0f);	// meters
+	RacingLineHint line = RacingLineHint::CENTER;
+	SpeedZone zone = SpeedZone::NORMAL;
+};
+
+// Optimizer settings, speeds in m/s and accelerations in m/s2
+struct RacingLineParams
+{
+	float spacing = 1.0f;			// meters between samples
+	float wall_margin = 2.5f;		// clearance kept from the walls, room for a car alongside
+	float center_band = 0.2f;		// fraction of the width a "center" hint may use on each side
+	int iterations = 3000;			// smoothing passes
+	float lateral_accel = 12.0f;
+	float accel = 5.0f;
+	float brake = 6.0f;
+	float zone_speed[3] = { 9.0f, 10.5f, 12.0f };	// cap of slow, normal and fast zones
+};
+
+// Precomputed racing line of a track: a closed loop of samples at a fixed
+// spacing, each with its target speed and the waypoint segment it belongs to.
+// The line is built offline from the waypoints, their hints and the walls,
+// and saved as a .line file next to the .tmx. At runtime a car keeps its
+// sample index and every lookup is an array access.
+class RacingLine
+{
+public:
+	// Offline: read the waypoints and walls of a .tmx and optimize the line
+	bool Compile(const char* tmx_path, float pixels_per_meter, const RacingLineParams& params = RacingLineParams());
+	void Build(const std::vector<RacingLineWaypoint>& waypoints, const std::vector<std::vector<b2Vec2>>& walls, const RacingLineParams& params = RacingLineParams());
+	// Waypoints and wall chains of a .tmx in meters, also used by the headless tools
+	static bool ReadTrack(const char* tmx_path, float pixels_per_meter, std::vector<RacingLineWaypoint>& waypoints, std::vector<std::vector<b2Vec2>>& walls);
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+	void Clear();
+
+	// "Assets/Map/RaceTrack.tmx" -> "Assets/Map/RaceTrack.line"
+	static std::string GetLinePath(const char* tmx_path);
+
+	bool IsValid() const { return !points.empty(); }
+	int GetCount() const { return (int)points.size(); }
+	float GetSpacing() const { return spacing; }
+	float GetLength() const { return spacing * points.size(); }
+	float GetLapTime() const { return lap_time; }
+	float GetMinClearance() const { return min_clearance; }
+	float GetWaypointLength() const { return waypoint_length; }	// the polygon the reactive AI drove
+
+	// Closest sample, O(n). Only for cars that have no index yet or got lost.
+	int Locate(const b2Vec2& position) const;
+	// Follows a car from its last index, a few steps per frame at most
+	int Track(const b2Vec2& position, int index) const;
+	// Sample the given distance ahead along the line
+	int Ahead(int index, float distance) const { return Wrap(index + (int)(distance / spacing)); }
+
+	const b2Vec2& GetPoint(int index) const { return points[Wrap(index)]; }
+	float GetSpeed(int index) const { return speeds[Wrap(index)]; }
+	// Waypoint the sample comes from and the one it leads to
+	int GetWaypoint(int index) const { return order[segments[Wrap(index)]]; }
+	int GetNextWaypoint(int index) const { return order[(segments[Wrap(index)] + 1) % order.size()]; }
+
+private:
+	int Wrap(int index) const
+	{
+		int count = (int)points.size();
+		index %= count;
+		return index < 0 ? index + count : index;
+	}
+
+	std::vector<b2Vec2> points;
+	std::vector<float> speeds;
+	std::vector<int> segments;	// index in order
+	std::vector<int> order;		// waypoint ids around the loop
+	float spacing = 1.0f;
+	float lap_time = 0.0f;
+	float min_clearance = 0.0f;
+	float waypoint_length = 0.0f;
+};
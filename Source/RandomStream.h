@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// PCG32 generator (O'Neill, pcg-random.org): 64 bit state, 32 bit output and a
+// stream selector, so every entity gets its own sequence out of the same race
+// seed. Nothing is shared, a stream is only touched by its owner, and it is
+// small enough to be copied into the snapshots.
+class RandomStream
+{
+public:
+	RandomStream() { Seed(0, 0); }
+	RandomStream(uint64_t seed, uint64_t stream) { Seed(seed, stream); }
+
+	void Seed(uint64_t seed, uint64_t stream)
+	{
+		state = 0u;
+		increment = (stream << 1u) | 1u;
+		Next();
+		state += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + increment;
+		uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+		uint32_t rot = (uint32_t)(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+	}
+
+	// [0, range), multiply instead of modulo
+	int Range(int range) { return (int)(((uint64_t)Next() * (uint32_t)range) >> 32); }
+	// [0, 1)
+	float Float() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+	float Float(float min, float max) { return min + (max - min) * Float(); }
+
+	// Fisher-Yates, the same order on every platform unlike std::shuffle
+	template<typename T>
+	void Shuffle(std::vector<T>& items)
+	{
+		for (int i = (int)items.size() - 1; i > 0; --i)
+		{
+			int j = Range(i + 1);
+			T item = items[i];
+			items[i] = items[j];
+			items[j] = item;
+		}
+	}
+
+private:
+	uint64_t state;
+	uint64_t increment;
+};
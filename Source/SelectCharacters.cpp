@@ -1,4 +1,6 @@
 #include "SelectCharacters.h"
+#include "Application.h"
+#include "ModuleRender.h"
 #include <cmath>
 
 CharacterSelect::CharacterSelect()
@@ -50,12 +52,12 @@ void CharacterSelect::LoadCharacters() {
 
         
         char char_path[256];
-        sprintf_s(char_path, "Assets/Textures/Characters/%s.png", character_data[i].name);
-        character.texture = LoadTexture(char_path);
+        snprintf(char_path, sizeof(char_path), "Assets/Textures/Characters/%s.png", character_data[i].name);
+        character.portrait = App->renderer->atlas.Get(char_path);
 
         char car_path[256];
-        sprintf_s(car_path, "Assets/Textures/Cars/car%d.png", character_data[i].car_id);
-        character.car_texture = LoadTexture(car_path);
+        snprintf(car_path, sizeof(car_path), "Assets/Textures/Cars/car%d.png", character_data[i].car_id);
+        character.car = App->renderer->atlas.Get(car_path);
 
         character.current_offset_y = 0.0f;
         character.target_offset_y = 0.0f;
@@ -70,15 +72,7 @@ void CharacterSelect::CleanUp() {
         background_texture = { 0 };
     }
 
-    for (auto& character : characters) {
-        if (character.texture.id != 0) {
-            UnloadTexture(character.texture);
-        }
-        if (character.car_texture.id != 0) {
-            UnloadTexture(character.car_texture);
-        }
-    }
-
+    // Portraits and cars belong to the atlas
     characters.clear();
 }
 
@@ -202,7 +196,7 @@ void CharacterSelect::Draw() {
 }
 
 void CharacterSelect::DrawCharacter(const Character& character, int index) {
-    if (character.texture.id == 0) return;
+    if (!character.portrait.IsValid()) return;
 
     int row = index / characters_per_row;
     int col = index % characters_per_row;
@@ -212,13 +206,12 @@ void CharacterSelect::DrawCharacter(const Character& character, int index) {
 
     int final_y = base_y + (int)character.current_offset_y;
 
-    int char_width = (int)(character.texture.width * scale_factor);
-    int char_height = (int)(character.texture.height * scale_factor);
+    int char_width = (int)(character.portrait.GetWidth() * scale_factor);
+    int char_height = (int)(character.portrait.GetHeight() * scale_factor);
 
     int draw_x = base_x + (spacing_x - char_width) / 2;
     int draw_y = final_y;
 
-    Rectangle source = { 0, 0, (float)character.texture.width, (float)character.texture.height };
     Rectangle dest = { (float)draw_x, (float)draw_y, (float)char_width, (float)char_height };
     Vector2 origin = { 0, 0 };
 
@@ -229,7 +222,7 @@ void CharacterSelect::DrawCharacter(const Character& character, int index) {
             ColorAlpha(BLACK, 0.5f));
     }
 
-    DrawTexturePro(character.texture, source, dest, origin, 0.0f, tint);
+    DrawTexturePro(character.portrait.texture, character.portrait.source, dest, origin, 0.0f, tint);
 
     const char* name = character.name.c_str();
     int name_width = MeasureText(name, 20);
@@ -248,8 +241,8 @@ void CharacterSelect::DrawSelectionFrame(int index) {
     int base_y = start_y + row * spacing_y;
     int final_y = base_y + (int)characters[index].current_offset_y;
 
-    int char_width = (int)(characters[index].texture.width * scale_factor);
-    int char_height = (int)(characters[index].texture.height * scale_factor);
+    int char_width = (int)(characters[index].portrait.GetWidth() * scale_factor);
+    int char_height = (int)(characters[index].portrait.GetHeight() * scale_factor);
 
     int draw_x = base_x + (spacing_x - char_width) / 2;
 
@@ -291,11 +284,11 @@ void CharacterSelect::DrawSelectionFrame(int index) {
         { frame.x + frame.width, frame.y + frame.height }, (float)border_thickness, GOLD);
 }
 
-Texture2D CharacterSelect::GetSelectedCarTexture() const {
+AtlasSprite CharacterSelect::GetSelectedCar() const {
     if (selected_index >= 0 && selected_index < (int)characters.size()) {
-        return characters[selected_index].car_texture;
+        return characters[selected_index].car;
     }
-    return { 0 };
+    return AtlasSprite();
 }
 
 void CharacterSelect::Reset() {
@@ -2,13 +2,14 @@
 
 #include "Globals.h"
 #include "raylib.h"
+#include "TextureAtlas.h"
 #include <vector>
 #include <string>
 
 struct Character {
     std::string name;
-    Texture2D texture;
-    Texture2D car_texture;
+    AtlasSprite portrait;
+    AtlasSprite car;
     float current_offset_y;  
     float target_offset_y;  
 };
@@ -24,7 +25,7 @@ public:
     void Draw();
 
     int GetSelectedCharacterIndex() const { return selected_index; }
-    Texture2D GetSelectedCarTexture() const;
+    AtlasSprite GetSelectedCar() const;
     bool IsConfirmed() const { return confirmed; }
     void Reset();
 
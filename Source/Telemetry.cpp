@@ -0,0 +1,540 @@
+#include "Telemetry.h"
+
+#include <cmath>
+#include <cstring>
+
+#define TELEMETRY_FILE_VERSION 1
+#define TELEMETRY_FIELDS 10
+#define TELEMETRY_PREDICTED_FIELDS 4	// x, y, angle and speed use the constant velocity prediction
+#define TELEMETRY_LAP_TABLE -1			// tick count of the closing chunk
+#define TELEMETRY_SMALL_TICKS 81		// 3^4 codes, x, y, angle and speed each off the prediction by -1, 0 or 1
+#define TELEMETRY_ESCAPE 0x7F			// anything else, a change mask and the residuals follow
+
+namespace
+{
+	void ToFields(const TelemetrySample& s, int32_t fields[TELEMETRY_FIELDS])
+	{
+		fields[0] = s.x;
+		fields[1] = s.y;
+		fields[2] = s.angle;
+		fields[3] = s.speed;
+		fields[4] = s.throttle;
+		fields[5] = s.steer;
+		fields[6] = s.brake;
+		fields[7] = s.flags;
+		fields[8] = s.lap;
+		fields[9] = s.waypoint;
+	}
+
+	void FromFields(const int32_t fields[TELEMETRY_FIELDS], TelemetrySample& s)
+	{
+		s.x = fields[0];
+		s.y = fields[1];
+		s.angle = fields[2];
+		s.speed = fields[3];
+		s.throttle = fields[4];
+		s.steer = fields[5];
+		s.brake = fields[6];
+		s.flags = fields[7];
+		s.lap = fields[8];
+		s.waypoint = fields[9];
+	}
+
+	// Small magnitudes of either sign take one byte
+	void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+
+	void WriteSigned(std::vector<uint8_t>& out, int32_t value)
+	{
+		WriteVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+	}
+
+	bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 35 && data < end; shift += 7)
+		{
+			uint8_t byte = *data++;
+			value |= (uint32_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+		return false;
+	}
+
+	bool ReadSigned(const uint8_t*& data, const uint8_t* end, int32_t& value)
+	{
+		uint32_t raw;
+		if (!ReadVarint(data, end, raw)) return false;
+		value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+		return true;
+	}
+
+	int32_t Quantize(float value, float scale)
+	{
+		return (int32_t)lroundf(value * scale);
+	}
+
+	// Prediction of every field from the two previous ticks of the chunk
+	void Predict(const int32_t prev[TELEMETRY_FIELDS], const int32_t prev2[TELEMETRY_FIELDS], bool has_prev2, int32_t predicted[TELEMETRY_FIELDS])
+	{
+		for (int f = 0; f < TELEMETRY_FIELDS; ++f)
+		{
+			predicted[f] = (has_prev2 && f < TELEMETRY_PREDICTED_FIELDS) ? 2 * prev[f] - prev2[f] : prev[f];
+		}
+	}
+}
+
+// Recorder
+
+TelemetryRecorder::TelemetryRecorder()
+{
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+	End();
+	for (Chunk* c : pool) delete c;
+	pool.clear();
+}
+
+bool TelemetryRecorder::Begin(const char* path, float tick_rate, const VehicleSystem& vehicles, int player_vehicle_id)
+{
+	End();
+
+	file = fopen(path, "wb");
+	if (!file) return false;
+
+	car_ids.clear();
+	car_of_id.assign(vehicles.GetIdCount(), -1);
+	for (int id = 0; id < vehicles.GetIdCount(); ++id)
+	{
+		if (!vehicles.IsValid(id)) continue;
+		car_of_id[id] = (int)car_ids.size();
+		car_ids.push_back(id);
+	}
+	car_count = (int)car_ids.size();
+	current.assign(car_count, TelemetrySample());
+	lap_start.assign(car_count, 0);
+	laps.clear();
+	tick = 0;
+
+	player_car = (player_vehicle_id >= 0 && player_vehicle_id < (int)car_of_id.size()) ? car_of_id[player_vehicle_id] : -1;
+	int header[3] = { TELEMETRY_FILE_VERSION, car_count, player_car };
+	fwrite("TLMY", 1, 4, file);
+	fwrite(header, sizeof(header), 1, file);
+	fwrite(&tick_rate, sizeof(tick_rate), 1, file);
+
+	// Two spare chunks, one being filled and one being written is the steady state
+	while (pool.size() < 2) pool.push_back(new Chunk());
+	for (Chunk* c : pool) c->samples.resize((size_t)car_count * TELEMETRY_CHUNK_TICKS);
+
+	chunk = pool.back();
+	pool.pop_back();
+	chunk->first_tick = 0;
+	chunk->tick_count = 0;
+
+	quit = false;
+	writer = std::thread(&TelemetryRecorder::WriterLoop, this);
+	return true;
+}
+
+void TelemetryRecorder::End()
+{
+	if (!file) return;
+
+	if (chunk && chunk->tick_count > 0) Submit();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pool.push_back(chunk);
+		chunk = nullptr;
+		quit = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+	WriteLaps();
+	fclose(file);
+	file = nullptr;
+}
+
+void TelemetryRecorder::SetControls(const VehicleSystem& vehicles)
+{
+	for (int c = 0; c < car_count; ++c)
+	{
+		int id = car_ids[c];
+		if (!vehicles.IsValid(id)) continue;
+
+		VehicleControls controls = vehicles.GetControls(id);
+		TelemetrySample& s = current[c];
+		s.throttle = Quantize(b2Clamp(controls.throttle, -1.0f, 1.0f), 127.0f);
+		s.steer = Quantize(b2Clamp(controls.steer, -1.0f, 1.0f), 127.0f);
+		s.brake = Quantize(b2Clamp(controls.brake, 0.0f, 1.0f), 255.0f);
+		s.flags = (controls.handbrake ? TELEMETRY_HANDBRAKE : 0) | (controls.boost ? TELEMETRY_BOOST : 0);
+	}
+}
+
+void TelemetryRecorder::SetProgress(int vehicle_id, int lap, int waypoint)
+{
+	if (!file || vehicle_id < 0 || vehicle_id >= (int)car_of_id.size() || car_of_id[vehicle_id] < 0) return;
+
+	int c = car_of_id[vehicle_id];
+	TelemetrySample& s = current[c];
+	if (lap > s.lap && s.lap > 0)
+	{
+		TelemetryLap done;
+		done.car = c;
+		done.lap = s.lap;
+		done.start_tick = lap_start[c];
+		done.end_tick = tick;
+		laps.push_back(done);
+		lap_start[c] = tick;
+	}
+	s.lap = lap;
+	s.waypoint = waypoint;
+}
+
+void TelemetryRecorder::Sample(const VehicleSystem& vehicles)
+{
+	if (!chunk) return;
+
+	int t = chunk->tick_count;
+	for (int c = 0; c < car_count; ++c)
+	{
+		TelemetrySample& s = current[c];
+		int id = car_ids[c];
+		if (vehicles.IsValid(id))
+		{
+			const b2Body* body = vehicles.GetBody(id);
+			const b2Vec2& position = body->GetPosition();
+			s.x = Quantize(position.x, TELEMETRY_POSITION_SCALE);
+			s.y = Quantize(position.y, TELEMETRY_POSITION_SCALE);
+			s.angle = Quantize(body->GetAngle(), TELEMETRY_ANGLE_SCALE);
+			s.speed = Quantize(body->GetLinearVelocity().Length(), TELEMETRY_SPEED_SCALE);
+		}
+		chunk->samples[(size_t)c * TELEMETRY_CHUNK_TICKS + t] = s;
+	}
+
+	chunk->tick_count++;
+	tick++;
+	if (chunk->tick_count == TELEMETRY_CHUNK_TICKS) Submit();
+}
+
+bool TelemetryRecorder::GetBestLap(TelemetryLap& best, int car) const
+{
+	bool found = false;
+	for (const TelemetryLap& lap : laps)
+	{
+		if (car >= 0 && lap.car != car) continue;
+		if (!found || lap.GetTicks() < best.GetTicks())
+		{
+			best = lap;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void TelemetryRecorder::Submit()
+{
+	Chunk* next = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(chunk);
+		if (!pool.empty())
+		{
+			next = pool.back();
+			pool.pop_back();
+		}
+	}
+	wake.notify_one();
+
+	// Only when the writer falls two chunks behind
+	if (!next)
+	{
+		next = new Chunk();
+		next->samples.resize((size_t)car_count * TELEMETRY_CHUNK_TICKS);
+	}
+
+	next->first_tick = tick;
+	next->tick_count = 0;
+	chunk = next;
+}
+
+void TelemetryRecorder::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this] { return quit || !queue.empty(); });
+		if (queue.empty()) break;
+
+		Chunk* c = queue.front();
+		queue.erase(queue.begin());
+
+		lock.unlock();
+		WriteChunk(*c);
+		lock.lock();
+
+		pool.push_back(c);
+	}
+}
+
+void TelemetryRecorder::WriteChunk(const Chunk& c)
+{
+	encoded.clear();
+	car_sizes.assign(car_count, 0);
+
+	int32_t fields[TELEMETRY_FIELDS];
+	int32_t prev[TELEMETRY_FIELDS];
+	int32_t prev2[TELEMETRY_FIELDS];
+	int32_t predicted[TELEMETRY_FIELDS];
+
+	for (int car = 0; car < car_count; ++car)
+	{
+		size_t start = encoded.size();
+		const TelemetrySample* samples = c.samples.data() + (size_t)car * TELEMETRY_CHUNK_TICKS;
+
+		for (int t = 0; t < c.tick_count; ++t)
+		{
+			ToFields(samples[t], fields);
+			if (t == 0)
+			{
+				for (int f = 0; f < TELEMETRY_FIELDS; ++f) WriteSigned(encoded, fields[f]);
+			}
+			else
+			{
+				Predict(prev, prev2, t > 1, predicted);
+				uint32_t mask = 0;
+				bool small = true;
+				int code = 0;
+				for (int f = TELEMETRY_FIELDS - 1; f >= 0; --f)
+				{
+					int32_t residual = fields[f] - predicted[f];
+					if (residual != 0) mask |= 1u << f;
+					if (f < TELEMETRY_PREDICTED_FIELDS) code = code * 3 + residual + 1;
+					small = small && (f < TELEMETRY_PREDICTED_FIELDS ? residual >= -1 && residual <= 1 : residual == 0);
+				}
+
+				// Most ticks are a car moving on with the same inputs, one byte
+				if (small)
+				{
+					encoded.push_back((uint8_t)code);
+				}
+				else
+				{
+					encoded.push_back(TELEMETRY_ESCAPE);
+					WriteVarint(encoded, mask);
+					for (int f = 0; f < TELEMETRY_FIELDS; ++f)
+					{
+						if (mask & (1u << f)) WriteSigned(encoded, fields[f] - predicted[f]);
+					}
+				}
+			}
+			memcpy(prev2, prev, sizeof(prev));
+			memcpy(prev, fields, sizeof(fields));
+		}
+		car_sizes[car] = (uint32_t)(encoded.size() - start);
+	}
+
+	uint32_t payload_size = (uint32_t)encoded.size();
+	int header[2] = { c.first_tick, c.tick_count };
+	fwrite(&payload_size, sizeof(payload_size), 1, file);
+	fwrite(header, sizeof(header), 1, file);
+	fwrite(car_sizes.data(), sizeof(uint32_t), car_sizes.size(), file);
+	fwrite(encoded.data(), 1, encoded.size(), file);
+}
+
+void TelemetryRecorder::WriteLaps()
+{
+	uint32_t payload_size = (uint32_t)(laps.size() * sizeof(TelemetryLap));
+	int header[2] = { tick, TELEMETRY_LAP_TABLE };
+	fwrite(&payload_size, sizeof(payload_size), 1, file);
+	fwrite(header, sizeof(header), 1, file);
+	fwrite(laps.data(), sizeof(TelemetryLap), laps.size(), file);
+}
+
+// Reader
+
+TelemetryReader::~TelemetryReader()
+{
+	Close();
+}
+
+bool TelemetryReader::Open(const char* path)
+{
+	Close();
+
+	file = fopen(path, "rb");
+	if (!file) return false;
+
+	char magic[4];
+	int header[3];
+	bool valid = fread(magic, 1, 4, file) == 4 && fread(header, sizeof(header), 1, file) == 1 && fread(&tick_rate, sizeof(tick_rate), 1, file) == 1
+		&& memcmp(magic, "TLMY", 4) == 0 && header[0] == TELEMETRY_FILE_VERSION && header[1] > 0 && tick_rate > 0.0f;
+	if (valid)
+	{
+		car_count = header[1];
+		player_car = header[2];
+	}
+
+	// Hop over the chunk headers, the payloads stay on disk
+	bool closed = false;
+	while (valid && !closed)
+	{
+		uint32_t payload_size;
+		int chunk_header[2];
+		if (fread(&payload_size, sizeof(payload_size), 1, file) != 1 || fread(chunk_header, sizeof(chunk_header), 1, file) != 1) break;
+
+		if (chunk_header[1] == TELEMETRY_LAP_TABLE)
+		{
+			tick_count = chunk_header[0];
+			laps.resize(payload_size / sizeof(TelemetryLap));
+			valid = fread(laps.data(), sizeof(TelemetryLap), laps.size(), file) == laps.size();
+			closed = true;
+			break;
+		}
+
+		ChunkInfo info;
+		info.first_tick = chunk_header[0];
+		info.tick_count = chunk_header[1];
+		info.car_sizes.resize(car_count);
+		valid = info.tick_count > 0 && fread(info.car_sizes.data(), sizeof(uint32_t), car_count, file) == (size_t)car_count;
+		info.payload = ftell(file);
+		valid = valid && fseek(file, (long)payload_size, SEEK_CUR) == 0;
+		if (valid) chunks.push_back(info);
+	}
+
+	// A race that did not end cleanly keeps its chunks, only the lap table is missing
+	if (valid && !closed && !chunks.empty()) tick_count = chunks.back().first_tick + chunks.back().tick_count;
+
+	if (!valid || chunks.empty())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void TelemetryReader::Close()
+{
+	if (file) fclose(file);
+	file = nullptr;
+	tick_rate = 0.0f;
+	car_count = 0;
+	player_car = -1;
+	tick_count = 0;
+	chunks.clear();
+	laps.clear();
+	decoded_chunk = -1;
+	decoded_car = -1;
+}
+
+bool TelemetryReader::GetBestLap(TelemetryLap& best, int car) const
+{
+	bool found = false;
+	for (const TelemetryLap& lap : laps)
+	{
+		if (car >= 0 && lap.car != car) continue;
+		if (!found || lap.GetTicks() < best.GetTicks())
+		{
+			best = lap;
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool TelemetryReader::GetSample(int car, int tick, TelemetrySample& sample)
+{
+	if (!file || car < 0 || car >= car_count || tick < 0 || tick >= tick_count) return false;
+
+	// Chunks are in tick order and all but the last one are full
+	int index = tick / TELEMETRY_CHUNK_TICKS;
+	if (index >= (int)chunks.size()) index = (int)chunks.size() - 1;
+	while (index > 0 && chunks[index].first_tick > tick) --index;
+	while (index + 1 < (int)chunks.size() && chunks[index + 1].first_tick <= tick) ++index;
+
+	if ((index != decoded_chunk || car != decoded_car) && !Decode(index, car)) return false;
+
+	int t = tick - chunks[index].first_tick;
+	if (t >= (int)decoded.size()) return false;
+	sample = decoded[t];
+	return true;
+}
+
+bool TelemetryReader::Decode(int chunk_index, int car)
+{
+	decoded_chunk = -1;
+	decoded.clear();
+
+	const ChunkInfo& info = chunks[chunk_index];
+	long offset = info.payload;
+	for (int c = 0; c < car; ++c) offset += (long)info.car_sizes[c];
+
+	payload.resize(info.car_sizes[car]);
+	if (fseek(file, offset, SEEK_SET) != 0 || fread(payload.data(), 1, payload.size(), file) != payload.size()) return false;
+
+	const uint8_t* data = payload.data();
+	const uint8_t* end = data + payload.size();
+	int32_t fields[TELEMETRY_FIELDS];
+	int32_t prev[TELEMETRY_FIELDS];
+	int32_t prev2[TELEMETRY_FIELDS];
+	int32_t predicted[TELEMETRY_FIELDS];
+
+	decoded.resize(info.tick_count);
+	for (int t = 0; t < info.tick_count; ++t)
+	{
+		if (t == 0)
+		{
+			for (int f = 0; f < TELEMETRY_FIELDS; ++f)
+			{
+				if (!ReadSigned(data, end, fields[f])) return false;
+			}
+		}
+		else
+		{
+			if (data >= end) return false;
+			uint8_t code = *data++;
+			Predict(prev, prev2, t > 1, predicted);
+			if (code < TELEMETRY_SMALL_TICKS)
+			{
+				for (int f = 0; f < TELEMETRY_FIELDS; ++f)
+				{
+					int32_t residual = 0;
+					if (f < TELEMETRY_PREDICTED_FIELDS)
+					{
+						residual = code % 3 - 1;
+						code /= 3;
+					}
+					fields[f] = predicted[f] + residual;
+				}
+			}
+			else
+			{
+				uint32_t mask;
+				if (code != TELEMETRY_ESCAPE || !ReadVarint(data, end, mask)) return false;
+				for (int f = 0; f < TELEMETRY_FIELDS; ++f)
+				{
+					int32_t residual = 0;
+					if ((mask & (1u << f)) && !ReadSigned(data, end, residual)) return false;
+					fields[f] = predicted[f] + residual;
+				}
+			}
+		}
+		FromFields(fields, decoded[t]);
+		memcpy(prev2, prev, sizeof(prev));
+		memcpy(prev, fields, sizeof(fields));
+	}
+
+	decoded_chunk = chunk_index;
+	decoded_car = car;
+	return true;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "VehicleSystem.h"
+
+#define TELEMETRY_CHUNK_TICKS 240		// 2 s at the race step rate, every chunk starts with a key sample
+#define TELEMETRY_POSITION_SCALE 64.0f	// units per meter, ~1.5 cm, under a pixel on screen
+#define TELEMETRY_ANGLE_SCALE 512.0f	// units per radian, ~0.1 degrees
+#define TELEMETRY_SPEED_SCALE 16.0f		// units per m/s
+
+#define TELEMETRY_HANDBRAKE 0x01
+#define TELEMETRY_BOOST 0x02
+
+// Quantized state of one car at one physics tick
+struct TelemetrySample
+{
+	int32_t x = 0;
+	int32_t y = 0;
+	int32_t angle = 0;		// not wrapped, the body angle keeps counting turns
+	int32_t speed = 0;
+	int32_t throttle = 0;	// -127..127
+	int32_t steer = 0;		// -127..127
+	int32_t brake = 0;		// 0..255
+	int32_t flags = 0;		// TELEMETRY_HANDBRAKE | TELEMETRY_BOOST
+	int32_t lap = 0;
+	int32_t waypoint = -1;
+
+	b2Vec2 GetPosition() const { return b2Vec2(x / TELEMETRY_POSITION_SCALE, y / TELEMETRY_POSITION_SCALE); }
+	float GetAngle() const { return angle / TELEMETRY_ANGLE_SCALE; }
+	float GetSpeed() const { return speed / TELEMETRY_SPEED_SCALE; }
+};
+
+// Completed lap of a car, in ticks from the start of the recording
+struct TelemetryLap
+{
+	int car = -1;
+	int lap = 0;
+	int start_tick = 0;
+	int end_tick = 0;
+
+	int GetTicks() const { return end_tick - start_tick; }
+};
+
+// Every car of a race at the physics tick rate. The simulation side only
+// quantizes into a chunk buffer; full chunks go to a writer thread that
+// delta and varint encodes them and appends them to the file, so a frame
+// never waits on the disk.
+//
+// File: "TLMY" header, then chunks of up to TELEMETRY_CHUNK_TICKS ticks:
+//   payload size, first tick, tick count, payload size of every car, payloads
+// A car payload starts with a key sample, then every tick is residuals:
+// position, angle and speed against a constant velocity prediction, the rest
+// against the previous tick. A tick where only the first four are off by one
+// at most is a single byte, any other tick is an escape byte, a change mask
+// and zigzag varints. The file ends with the lap table, a chunk with a tick
+// count of -1.
+class TelemetryRecorder
+{
+public:
+	TelemetryRecorder();
+	~TelemetryRecorder();
+
+	// Cars are the vehicles valid at this point, in id order
+	bool Begin(const char* path, float tick_rate, const VehicleSystem& vehicles, int player_vehicle_id);
+	// Hands the last chunk and the lap table to the writer and waits for it
+	void End();
+	bool IsRecording() const { return file != nullptr; }
+
+	// Controls of the frame, read before the first step of the frame
+	void SetControls(const VehicleSystem& vehicles);
+	// Lap and waypoint of a car, from the race rules
+	void SetProgress(int vehicle_id, int lap, int waypoint);
+	// One physics tick of every car, reads the bodies
+	void Sample(const VehicleSystem& vehicles);
+
+	int GetTick() const { return tick; }
+	int GetPlayerCar() const { return player_car; }
+	// Shortest completed lap of a car, of any car with -1. False with none.
+	bool GetBestLap(TelemetryLap& best, int car = -1) const;
+
+private:
+	struct Chunk
+	{
+		int first_tick = 0;
+		int tick_count = 0;
+		std::vector<TelemetrySample> samples;	// car major, TELEMETRY_CHUNK_TICKS per car
+	};
+
+	void Submit();
+	void WriterLoop();
+	void WriteChunk(const Chunk& chunk);
+	void WriteLaps();
+
+	FILE* file = nullptr;
+	int car_count = 0;
+	int player_car = -1;
+	int tick = 0;
+	std::vector<int> car_ids;			// vehicle id of every car
+	std::vector<int> car_of_id;			// and back, -1 for vehicles added later
+	std::vector<TelemetrySample> current;	// inputs and progress of every car
+	std::vector<int> lap_start;			// tick the current lap of every car started
+	std::vector<TelemetryLap> laps;
+
+	// Simulation side
+	Chunk* chunk = nullptr;
+
+	// Writer side, the queue and the pool are shared
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<Chunk*> queue;
+	std::vector<Chunk*> pool;
+	bool quit = false;
+	std::vector<uint8_t> encoded;		// writer only
+	std::vector<uint32_t> car_sizes;	// writer only
+};
+
+// Reads a telemetry file a chunk at a time. Only the chunk index and the lap
+// table stay in memory, a sample decodes the payload of its car in its chunk
+// the first time that chunk is asked for.
+class TelemetryReader
+{
+public:
+	~TelemetryReader();
+
+	bool Open(const char* path);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+	float GetTickRate() const { return tick_rate; }
+	int GetCarCount() const { return car_count; }
+	int GetPlayerCar() const { return player_car; }
+	int GetTickCount() const { return tick_count; }
+	const std::vector<TelemetryLap>& GetLaps() const { return laps; }
+	bool GetBestLap(TelemetryLap& best, int car = -1) const;
+
+	bool GetSample(int car, int tick, TelemetrySample& sample);
+
+private:
+	struct ChunkInfo
+	{
+		long payload = 0;	// file offset of the first car payload
+		int first_tick = 0;
+		int tick_count = 0;
+		std::vector<uint32_t> car_sizes;
+	};
+
+	bool Decode(int chunk_index, int car);
+
+	FILE* file = nullptr;
+	float tick_rate = 0.0f;
+	int car_count = 0;
+	int player_car = -1;
+	int tick_count = 0;
+	std::vector<ChunkInfo> chunks;
+	std::vector<TelemetryLap> laps;
+
+	// Decoded payload of one car in one chunk
+	int decoded_chunk = -1;
+	int decoded_car = -1;
+	std::vector<uint8_t> payload;
+	std::vector<TelemetrySample> decoded;
+};
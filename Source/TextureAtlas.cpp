@@ -0,0 +1,283 @@
+#include "Globals.h"
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+// Top edge of the packed area over [x, x + width)
+struct SkylineNode
+{
+	int x;
+	int y;
+	int width;
+};
+
+struct AtlasPage
+{
+	std::vector<SkylineNode> skyline;
+	int used_width = 0;
+	int used_height = 0;
+};
+
+static std::string NormalizePath(const char* path)
+{
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	return normalized;
+}
+
+// Lowest place on the skyline where a width x height rectangle fits, leftmost on a tie
+static bool FindSkylineSpot(const std::vector<SkylineNode>& skyline, int page_size, int width, int height, int& best_index, int& best_x, int& best_y)
+{
+	int best_top = INT_MAX;
+	best_index = -1;
+	for (size_t i = 0; i < skyline.size(); ++i)
+	{
+		int x = skyline[i].x;
+		if (x + width > page_size) break;
+
+		// The skyline spans the whole page, so the nodes under the rectangle are all there
+		int y = 0;
+		int remaining = width;
+		for (size_t j = i; remaining > 0; ++j)
+		{
+			y = std::max(y, skyline[j].y);
+			remaining -= skyline[j].width;
+		}
+		if (y + height > page_size) continue;
+
+		if (y + height < best_top)
+		{
+			best_top = y + height;
+			best_index = (int)i;
+			best_x = x;
+			best_y = y;
+		}
+	}
+	return best_index >= 0;
+}
+
+// Raises the skyline over a placed rectangle
+static void AddSkylineLevel(std::vector<SkylineNode>& skyline, int index, int x, int y, int width, int height)
+{
+	skyline.insert(skyline.begin() + index, { x, y + height, width });
+
+	int right = x + width;
+	for (size_t i = index + 1; i < skyline.size(); )
+	{
+		SkylineNode& node = skyline[i];
+		if (node.x >= right) break;
+
+		int covered = right - node.x;
+		if (covered >= node.width)
+		{
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+		node.x += covered;
+		node.width -= covered;
+		break;
+	}
+
+	for (size_t i = 0; i + 1 < skyline.size(); )
+	{
+		if (skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+static bool PlaceOnPage(AtlasPage& page, int page_size, int width, int height, int& x, int& y)
+{
+	int index;
+	if (!FindSkylineSpot(page.skyline, page_size, width, height, index, x, y)) return false;
+
+	AddSkylineLevel(page.skyline, index, x, y, width, height);
+	page.used_width = std::max(page.used_width, x + width);
+	page.used_height = std::max(page.used_height, y + height);
+	return true;
+}
+
+bool TextureAtlas::Add(const char* path)
+{
+	if (Find(path) != nullptr) return true;
+
+	Image image = LoadImage(path);
+	if (image.data == nullptr)
+	{
+		LOG("TextureAtlas: Could not load %s", path);
+		return false;
+	}
+
+	Entry entry;
+	entry.path = NormalizePath(path);
+	entry.image = image;
+	entries.push_back(entry);
+	return true;
+}
+
+int TextureAtlas::AddFolder(const char* folder)
+{
+	int added = 0;
+	FilePathList files = LoadDirectoryFilesEx(folder, ".png", false);
+	for (unsigned int i = 0; i < files.count; ++i)
+	{
+		if (Add(files.paths[i])) added++;
+	}
+	UnloadDirectoryFiles(files);
+	return added;
+}
+
+bool TextureAtlas::Build(int max_page_size)
+{
+	// Tallest first, then widest, fills the shelves of the skyline evenly
+	std::vector<Entry*> order;
+	for (Entry& entry : entries)
+	{
+		if (entry.image.data != nullptr) order.push_back(&entry);
+	}
+	std::sort(order.begin(), order.end(), [](const Entry* a, const Entry* b)
+	{
+		if (a->image.height != b->image.height) return a->image.height > b->image.height;
+		return a->image.width > b->image.width;
+	});
+
+	std::vector<AtlasPage> packing;
+	for (Entry* entry : order)
+	{
+		int width = entry->image.width + 2 * ATLAS_PADDING;
+		int height = entry->image.height + 2 * ATLAS_PADDING;
+		if (width > max_page_size || height > max_page_size) continue;
+
+		int x = 0, y = 0;
+		size_t page = 0;
+		while (page < packing.size() && !PlaceOnPage(packing[page], max_page_size, width, height, x, y)) page++;
+		if (page == packing.size())
+		{
+			AtlasPage new_page;
+			new_page.skyline.push_back({ 0, 0, max_page_size });
+			packing.push_back(new_page);
+			PlaceOnPage(packing[page], max_page_size, width, height, x, y);
+		}
+
+		entry->page = (int)(pages.size() + page);
+		entry->x = x + ATLAS_PADDING;
+		entry->y = y + ATLAS_PADDING;
+	}
+
+	bool ret = true;
+	size_t first_page = pages.size();
+	for (size_t p = 0; p < packing.size(); ++p)
+	{
+		Image page_image = GenImageColor(packing[p].used_width, packing[p].used_height, BLANK);
+		unsigned char* pixels = (unsigned char*)page_image.data;
+		for (Entry* entry : order)
+		{
+			if (entry->page != (int)(first_page + p)) continue;
+
+			ImageFormat(&entry->image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+			const unsigned char* source = (const unsigned char*)entry->image.data;
+			for (int row = 0; row < entry->image.height; ++row)
+			{
+				memcpy(pixels + ((size_t)(entry->y + row) * page_image.width + entry->x) * 4, source + (size_t)row * entry->image.width * 4,
+					(size_t)entry->image.width * 4);
+			}
+		}
+
+		Texture2D texture = LoadTextureFromImage(page_image);
+		UnloadImage(page_image);
+		if (texture.id == 0)
+		{
+			LOG("TextureAtlas: Could not upload a %dx%d page", packing[p].used_width, packing[p].used_height);
+			ret = false;
+		}
+		pages.push_back(texture);
+	}
+
+	// Packed images point into their page, the rest become textures of their own
+	for (Entry* entry : order)
+	{
+		if (entry->page >= 0 && pages[entry->page].id != 0)
+		{
+			entry->sprite.texture = pages[entry->page];
+			entry->sprite.source = { (float)entry->x, (float)entry->y, (float)entry->image.width, (float)entry->image.height };
+			packed_count++;
+		}
+		else
+		{
+			Texture2D texture = LoadTextureFromImage(entry->image);
+			if (texture.id != 0) loose.push_back(texture);
+			entry->sprite = AtlasSprite(texture);
+		}
+		UnloadImage(entry->image);
+		entry->image = { 0 };
+	}
+
+	LOG("TextureAtlas: %d images packed in %d pages, %d loose", packed_count, (int)pages.size(), (int)loose.size());
+	return ret;
+}
+
+AtlasSprite TextureAtlas::Get(const char* path)
+{
+	Entry* entry = Find(path);
+	if (entry != nullptr && entry->sprite.IsValid()) return entry->sprite;
+
+	Texture2D texture = { 0 };
+	if (entry != nullptr && entry->image.data != nullptr)
+	{
+		// Added but not built yet
+		texture = LoadTextureFromImage(entry->image);
+		UnloadImage(entry->image);
+		entry->image = { 0 };
+	}
+	else
+	{
+		texture = LoadTexture(path);
+	}
+	if (texture.id == 0) return AtlasSprite();
+
+	loose.push_back(texture);
+	if (entry == nullptr)
+	{
+		entries.push_back(Entry());
+		entry = &entries.back();
+		entry->path = NormalizePath(path);
+	}
+	entry->sprite = AtlasSprite(texture);
+	return entry->sprite;
+}
+
+void TextureAtlas::Unload()
+{
+	for (Entry& entry : entries)
+	{
+		if (entry.image.data != nullptr) UnloadImage(entry.image);
+	}
+	for (Texture2D& texture : pages)
+	{
+		if (texture.id != 0) UnloadTexture(texture);
+	}
+	for (Texture2D& texture : loose) UnloadTexture(texture);
+
+	entries.clear();
+	pages.clear();
+	loose.clear();
+	packed_count = 0;
+}
+
+TextureAtlas::Entry* TextureAtlas::Find(const char* path)
+{
+	std::string normalized = NormalizePath(path);
+	for (Entry& entry : entries)
+	{
+		if (entry.path == normalized) return &entry;
+	}
+	return nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <string>
+#include <vector>
+
+#define ATLAS_MAX_PAGE_SIZE 4096	// pages are cropped to what they use, this is only the limit
+#define ATLAS_PADDING 2				// empty pixels around every image, so neighbours never bleed in
+
+// Part of a texture, what ModuleRender::Draw and DrawTexturePro take. A loose
+// texture is a sprite covering all of it.
+struct AtlasSprite
+{
+	Texture2D texture = {};
+	Rectangle source = { 0, 0, 0, 0 };
+
+	AtlasSprite() {}
+	explicit AtlasSprite(Texture2D texture) : texture(texture), source{ 0, 0, (float)texture.width, (float)texture.height } {}
+
+	bool IsValid() const { return texture.id != 0; }
+	int GetWidth() const { return (int)source.width; }
+	int GetHeight() const { return (int)source.height; }
+	// A section given in the coordinates of the original image, like a frame of a sheet
+	Rectangle GetSection(Rectangle section) const { return { source.x + section.x, source.y + section.y, section.width, section.height }; }
+};
+
+// Packs small images into shared pages at load time, so sprites that used to
+// be a texture each can be drawn in one batch. Images are queued with Add and
+// packed by Build with a skyline packer, tallest first; what does not fit a
+// page opens the next one. Get hands out the sprite of a file by its path and
+// loads a file that was never added as a texture of its own, so callers don't
+// care what got packed. The atlas owns every texture it hands out.
+class TextureAtlas
+{
+public:
+	// Queued until Build, after Build the file is loaded loose
+	bool Add(const char* path);
+	// Every .png of a folder, not recursive
+	int AddFolder(const char* folder);
+	bool Build(int max_page_size = ATLAS_MAX_PAGE_SIZE);
+	AtlasSprite Get(const char* path);
+	// Needs the GL context, call it before the window closes
+	void Unload();
+
+	int GetPageCount() const { return (int)pages.size(); }
+	int GetPackedCount() const { return packed_count; }
+
+private:
+	struct Entry
+	{
+		std::string path;
+		Image image = {};
+		AtlasSprite sprite;
+		int page = -1;
+		int x = 0;
+		int y = 0;
+	};
+
+	Entry* Find(const char* path);
+
+	std::vector<Entry> entries;
+	std::vector<Texture2D> pages;
+	std::vector<Texture2D> loose;
+	int packed_count = 0;
+};
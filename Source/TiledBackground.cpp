@@ -0,0 +1,357 @@
+#include "Globals.h"
+#include "Application.h"
+#include "ModuleRender.h"
+#include "TiledBackground.h"
+
+#include <algorithm>
+#include <math.h>
+
+TiledBackground::TiledBackground() : width(0), height(0), draw_level(0), draw_view({ 0, 0, 0, 0 }), frame(0), resident_count(0), queued_count(0),
+	loading(-1), quit(false)
+{
+}
+
+TiledBackground::~TiledBackground()
+{
+	StopLoader();
+}
+
+bool TiledBackground::Open(const char* file_path)
+{
+	Close();
+
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	char magic[4];
+	int header[5];
+	file.read(magic, 4);
+	file.read((char*)header, sizeof(header));
+	if (!file || std::string(magic, 4) != "BGTL" || header[0] != BACKGROUND_FILE_VERSION || header[1] <= 0 || header[2] <= 0 ||
+		header[3] != BACKGROUND_TILE_SIZE || header[4] < 1)
+	{
+		LOG("TiledBackground: %s is not a version %d tile file, run BackgroundTiler again", file_path, BACKGROUND_FILE_VERSION);
+		return false;
+	}
+
+	std::vector<int> sizes(header[4] * 2);
+	file.read((char*)sizes.data(), sizes.size() * sizeof(int));
+
+	int tile_count = 0;
+	for (int i = 0; i < header[4]; ++i)
+	{
+		Level level;
+		level.width = sizes[i * 2];
+		level.height = sizes[i * 2 + 1];
+		level.columns = (level.width + BACKGROUND_TILE_SIZE - 1) / BACKGROUND_TILE_SIZE;
+		level.rows = (level.height + BACKGROUND_TILE_SIZE - 1) / BACKGROUND_TILE_SIZE;
+		level.first_tile = tile_count;
+		level.scale = (float)header[1] / std::max(1, level.width);
+		tile_count += level.columns * level.rows;
+		levels.push_back(level);
+	}
+
+	entries.resize(tile_count * 2);
+	file.read((char*)entries.data(), entries.size() * sizeof(int));
+	if (!file || levels.back().columns != 1 || levels.back().rows != 1)
+	{
+		LOG("TiledBackground: %s is truncated", file_path);
+		levels.clear();
+		entries.clear();
+		return false;
+	}
+
+	tiles.resize(tile_count);
+	for (int i = 0; i < tile_count; ++i)
+	{
+		tiles[i].size = entries[i * 2 + 1];
+		tiles[i].texture = { 0 };
+		tiles[i].last_used = 0;
+	}
+
+	path = file_path;
+	width = header[1];
+	height = header[2];
+
+	// The last level is the fallback of every tile, it is in before the first frame
+	int last_tile = levels.back().first_tile;
+	if (tiles[last_tile].size > 0) Upload(last_tile, ReadTile(file, last_tile));
+
+	quit = false;
+	loader = std::thread(&TiledBackground::LoaderLoop, this);
+
+	LOG("TiledBackground: %s, %dx%d in %d levels of %d tiles", file_path, width, height, (int)levels.size(), tile_count);
+	return true;
+}
+
+void TiledBackground::Close()
+{
+	StopLoader();
+
+	for (Tile& tile : tiles)
+	{
+		if (tile.texture.id != 0) UnloadTexture(tile.texture);
+	}
+	for (DecodedTile& tile : decoded)
+	{
+		if (tile.image.data != nullptr) UnloadImage(tile.image);
+	}
+
+	tiles.clear();
+	levels.clear();
+	entries.clear();
+	pending.clear();
+	decoded.clear();
+	path.clear();
+	width = 0;
+	height = 0;
+	draw_level = 0;
+	resident_count = 0;
+	queued_count = 0;
+}
+
+void TiledBackground::Update(Rectangle view, Vector2 velocity, float zoom)
+{
+	if (!IsOpen()) return;
+	frame++;
+
+	// Coarsest level that still has a pixel per screen pixel
+	draw_level = 0;
+	while (draw_level + 1 < (int)levels.size() && levels[draw_level + 1].scale * zoom <= 1.0f) draw_level++;
+	// The camera still moves after the tiles are submitted
+	draw_view = { view.x - CAMERA_CULL_MARGIN, view.y - CAMERA_CULL_MARGIN, view.width + 2.0f * CAMERA_CULL_MARGIN,
+		view.height + 2.0f * CAMERA_CULL_MARGIN };
+
+	// Under the view first, then where the player will be
+	std::vector<int> wanted;
+	Request(draw_level, draw_view, wanted);
+	Rectangle ahead = draw_view;
+	ahead.x += velocity.x * BACKGROUND_PREFETCH_TIME;
+	ahead.y += velocity.y * BACKGROUND_PREFETCH_TIME;
+	Request(draw_level, ahead, wanted);
+
+	// What is drawn this frame, the fallbacks too, is the last to go
+	int first_column, first_row, last_column, last_row;
+	GetTileRange(draw_level, draw_view, first_column, first_row, last_column, last_row);
+	for (int row = first_row; row <= last_row; ++row)
+	{
+		for (int column = first_column; column <= last_column; ++column)
+		{
+			int found_level;
+			int tile = FindResident(draw_level, column, row, found_level);
+			if (tile >= 0) tiles[tile].last_used = frame;
+		}
+	}
+
+	std::vector<DecodedTile> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		int count = std::min((int)decoded.size(), BACKGROUND_UPLOADS_PER_FRAME);
+		ready.assign(decoded.begin(), decoded.begin() + count);
+		decoded.erase(decoded.begin(), decoded.begin() + count);
+
+		pending.clear();
+		for (int tile : wanted)
+		{
+			bool in_flight = tile == loading;
+			for (const DecodedTile& done : decoded) in_flight = in_flight || done.tile == tile;
+			for (const DecodedTile& done : ready) in_flight = in_flight || done.tile == tile;
+			if (!in_flight) pending.push_back(tile);
+		}
+		queued_count = (int)pending.size();
+	}
+	if (queued_count > 0) wake.notify_one();
+
+	for (const DecodedTile& done : ready) Upload(done.tile, done.image);
+	Evict();
+}
+
+void TiledBackground::Draw() const
+{
+	if (!IsOpen()) return;
+
+	int first_column, first_row, last_column, last_row;
+	GetTileRange(draw_level, draw_view, first_column, first_row, last_column, last_row);
+	for (int row = first_row; row <= last_row; ++row)
+	{
+		for (int column = first_column; column <= last_column; ++column)
+		{
+			int found_level;
+			int tile = FindResident(draw_level, column, row, found_level);
+			if (tile < 0) continue;
+
+			// A coarser tile draws the part of it under this one
+			Rectangle dest = GetTileRect(draw_level, column, row);
+			const Level& level = levels[found_level];
+			int index = tile - level.first_tile;
+			Rectangle source = { dest.x / level.scale - (index % level.columns) * BACKGROUND_TILE_SIZE,
+				dest.y / level.scale - (index / level.columns) * BACKGROUND_TILE_SIZE, dest.width / level.scale, dest.height / level.scale };
+			App->renderer->DrawSprite(RenderLayer::BACKGROUND, tiles[tile].texture, source, dest);
+		}
+	}
+}
+
+float TiledBackground::GetResidentMB() const
+{
+	double bytes = 0.0;
+	for (const Tile& tile : tiles)
+	{
+		if (tile.texture.id != 0) bytes += tile.texture.width * tile.texture.height * 4.0;
+	}
+	return (float)(bytes / (1024.0 * 1024.0));
+}
+
+std::string TiledBackground::GetTilesPath(const char* image_path)
+{
+	std::string tiles_path = image_path;
+	size_t dot = tiles_path.find_last_of('.');
+	size_t slash = tiles_path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return tiles_path + ".bgt";
+	return tiles_path.substr(0, dot) + ".bgt";
+}
+
+void TiledBackground::StopLoader()
+{
+	if (!loader.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	loader.join();
+}
+
+// Reads and decodes, nothing of raylib that needs the GL context
+void TiledBackground::LoaderLoop()
+{
+	std::ifstream file(path, std::ios::binary);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this]() { return quit || !pending.empty(); });
+		if (quit) break;
+
+		int tile = pending.front();
+		pending.erase(pending.begin());
+		loading = tile;
+
+		lock.unlock();
+		Image image = ReadTile(file, tile);
+		lock.lock();
+
+		loading = -1;
+		decoded.push_back({ tile, image });
+	}
+}
+
+Image TiledBackground::ReadTile(std::ifstream& file, int tile) const
+{
+	Image image = { 0 };
+	std::vector<unsigned char> data(entries[tile * 2 + 1]);
+	file.clear();
+	file.seekg(entries[tile * 2]);
+	file.read((char*)data.data(), data.size());
+	if (file) image = LoadImageFromMemory(".qoi", data.data(), (int)data.size());
+	return image;
+}
+
+void TiledBackground::Upload(int tile, Image image)
+{
+	if (image.data == nullptr)
+	{
+		// Never asked for again, the loader keeps its own entries
+		LOG("TiledBackground: Could not read tile %d of %s", tile, path.c_str());
+		tiles[tile].size = 0;
+		return;
+	}
+
+	if (tiles[tile].texture.id == 0)
+	{
+		tiles[tile].texture = LoadTextureFromImage(image);
+		tiles[tile].last_used = frame;
+		if (tiles[tile].texture.id != 0) resident_count++;
+	}
+	UnloadImage(image);
+}
+
+// Least recently drawn first, never what this frame draws or the last level
+void TiledBackground::Evict()
+{
+	int last_tile = levels.back().first_tile;
+	while (resident_count > BACKGROUND_CACHE_TILES)
+	{
+		int oldest = -1;
+		for (int i = 0; i < last_tile; ++i)
+		{
+			if (tiles[i].texture.id == 0 || tiles[i].last_used == frame) continue;
+			if (oldest < 0 || tiles[i].last_used < tiles[oldest].last_used) oldest = i;
+		}
+		if (oldest < 0) break;
+
+		UnloadTexture(tiles[oldest].texture);
+		tiles[oldest].texture = { 0 };
+		resident_count--;
+	}
+}
+
+void TiledBackground::GetTileRange(int level, Rectangle area, int& first_column, int& first_row, int& last_column, int& last_row) const
+{
+	const Level& mip = levels[level];
+	float tile_world = BACKGROUND_TILE_SIZE * mip.scale;
+	first_column = std::max(0, (int)floorf(area.x / tile_world));
+	first_row = std::max(0, (int)floorf(area.y / tile_world));
+	last_column = std::min(mip.columns - 1, (int)floorf((area.x + area.width) / tile_world));
+	last_row = std::min(mip.rows - 1, (int)floorf((area.y + area.height) / tile_world));
+}
+
+void TiledBackground::Request(int level, Rectangle area, std::vector<int>& wanted) const
+{
+	const Level& mip = levels[level];
+	size_t first = wanted.size();
+
+	int first_column, first_row, last_column, last_row;
+	GetTileRange(level, area, first_column, first_row, last_column, last_row);
+	for (int row = first_row; row <= last_row; ++row)
+	{
+		for (int column = first_column; column <= last_column; ++column)
+		{
+			int tile = mip.first_tile + row * mip.columns + column;
+			if (tiles[tile].size == 0 || tiles[tile].texture.id != 0) continue;
+			if (std::find(wanted.begin(), wanted.end(), tile) != wanted.end()) continue;
+			wanted.push_back(tile);
+		}
+	}
+
+	float center_x = (area.x + area.width / 2.0f) / (BACKGROUND_TILE_SIZE * mip.scale) - 0.5f;
+	float center_y = (area.y + area.height / 2.0f) / (BACKGROUND_TILE_SIZE * mip.scale) - 0.5f;
+	std::sort(wanted.begin() + first, wanted.end(), [&mip, center_x, center_y](int a, int b)
+	{
+		float ax = (a - mip.first_tile) % mip.columns - center_x, ay = (a - mip.first_tile) / mip.columns - center_y;
+		float bx = (b - mip.first_tile) % mip.columns - center_x, by = (b - mip.first_tile) / mip.columns - center_y;
+		return ax * ax + ay * ay < bx * bx + by * by;
+	});
+}
+
+int TiledBackground::FindResident(int level, int column, int row, int& found_level) const
+{
+	for (found_level = level; found_level < (int)levels.size(); ++found_level)
+	{
+		int shift = found_level - level;
+		const Level& mip = levels[found_level];
+		int tile = mip.first_tile + std::min(row >> shift, mip.rows - 1) * mip.columns + std::min(column >> shift, mip.columns - 1);
+		if (tiles[tile].size == 0) return -1;
+		if (tiles[tile].texture.id != 0) return tile;
+	}
+	return -1;
+}
+
+Rectangle TiledBackground::GetTileRect(int level, int column, int row) const
+{
+	const Level& mip = levels[level];
+	int x = column * BACKGROUND_TILE_SIZE;
+	int y = row * BACKGROUND_TILE_SIZE;
+	int tile_width = std::min(BACKGROUND_TILE_SIZE, mip.width - x);
+	int tile_height = std::min(BACKGROUND_TILE_SIZE, mip.height - y);
+	return { x * mip.scale, y * mip.scale, tile_width * mip.scale, tile_height * mip.scale };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "raylib.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BACKGROUND_FILE_VERSION 1
+#define BACKGROUND_TILE_SIZE 512			// pixels, of every mip level
+#define BACKGROUND_CACHE_TILES 40			// resident textures, ~40 MB, more than two screens at any zoom
+#define BACKGROUND_UPLOADS_PER_FRAME 2		// decoded tiles turned into textures per frame
+#define BACKGROUND_PREFETCH_TIME 0.75f		// seconds of travel ahead of the view that are requested too
+
+// Track background streamed from a .bgt file, written offline by
+// Benchmarks/BackgroundTiler: the image and its mip levels cut into tiles.
+// Every frame Update picks the level that matches the zoom, keeps the tiles
+// under the view and the ones the player is heading to requested, and a loader
+// thread reads and decodes them in that order. Decoded tiles become textures
+// a few per frame; past BACKGROUND_CACHE_TILES the least recently drawn one is
+// unloaded. The last level is one tile, it is loaded with the file and stays,
+// so a tile that is not in yet is drawn from the closest coarser level.
+class TiledBackground
+{
+public:
+	TiledBackground();
+	~TiledBackground();
+
+	bool Open(const char* path);
+	// Needs the GL context, the textures are unloaded
+	void Close();
+	bool IsOpen() const { return !levels.empty(); }
+
+	// view in world pixels, velocity in world pixels per second
+	void Update(Rectangle view, Vector2 velocity, float zoom);
+	// Submits the tiles under the view to the BACKGROUND layer
+	void Draw() const;
+
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetResidentCount() const { return resident_count; }
+	int GetQueuedCount() const { return queued_count; }
+	int GetLevel() const { return draw_level; }
+	float GetResidentMB() const;
+
+	// background.png -> background.bgt
+	static std::string GetTilesPath(const char* image_path);
+
+private:
+	struct Level
+	{
+		int width;
+		int height;
+		int columns;
+		int rows;
+		int first_tile;
+		float scale;	// world pixels per pixel of the level
+	};
+
+	struct Tile
+	{
+		int size;		// 0 is fully transparent or failed, never loaded
+		Texture2D texture;
+		unsigned int last_used;
+	};
+
+	struct DecodedTile
+	{
+		int tile;
+		Image image;
+	};
+
+	void StopLoader();
+	void LoaderLoop();
+	// Only reads entries, the loader thread calls it
+	Image ReadTile(std::ifstream& file, int tile) const;
+	void Upload(int tile, Image image);
+	void Evict();
+	// Tiles of a level under a world rectangle
+	void GetTileRange(int level, Rectangle area, int& first_column, int& first_row, int& last_column, int& last_row) const;
+	// Wanted tiles of a level under area that are not in, closest to the center first
+	void Request(int level, Rectangle area, std::vector<int>& wanted) const;
+	// The tile drawn for level, column, row: itself or the coarser tile over it
+	int FindResident(int level, int column, int row, int& found_level) const;
+	Rectangle GetTileRect(int level, int column, int row) const;
+
+	std::string path;
+	int width;
+	int height;
+	std::vector<Level> levels;
+	std::vector<Tile> tiles;
+	std::vector<int> entries;			// offset and size of every tile in the file, not written while the loader runs
+
+	int draw_level;
+	Rectangle draw_view;
+	unsigned int frame;
+	int resident_count;
+	int queued_count;
+
+	// Shared with the loader thread
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<int> pending;			// most wanted first
+	std::vector<DecodedTile> decoded;
+	int loading;
+	bool quit;
+};
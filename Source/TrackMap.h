@@ -0,0 +1,37 @@
+#pragma once
+
+#include "p2Point.h"
+#include <string>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+#include "AIVehicle.h"
+
+struct CollisionObject
+{
+	std::vector<vec2i> points;
+	std::string type;
+	std::string collision_type;
+	std::string name;
+	int offset_x = 0;
+	int offset_y = 0;
+};
+
+// Reading of the Tiled .tmx tracks, line by line the way the maps are saved.
+// It needs no App, so the headless benchmarks load tracks with the same code
+// as the game. Everything read is appended to the vectors.
+
+// Spawn points in pixels and AI waypoints in meters
+bool ReadMapObjects(const char* map_path, float meters_per_pixel, std::vector<b2Vec2>& spawn_points, std::vector<Waypoint>& waypoints);
+// Tile layer, row major, 0 where there is no tile
+bool ReadMapTiles(const char* map_path, std::vector<int>& tiles);
+// wall_chain polygons of the Collisions layer, in pixels
+bool ReadMapCollisions(const char* map_path, std::vector<CollisionObject>& objects);
+
+// Chain loop of a collision polygon in absolute pixels as x, y pairs, points
+// closer than a pixel merged. False if less than a triangle is left.
+bool GetCollisionChain(const CollisionObject& object, std::vector<int>& points);
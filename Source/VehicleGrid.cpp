@@ -0,0 +1,113 @@
+#include "VehicleGrid.h"
+#include "VehicleSystem.h"
+
+void VehicleGrid::Build(const VehicleSystem& vehicles)
+{
+	int count = vehicles.GetCount();
+
+	// Twice as many buckets as cars, power of two
+	unsigned int buckets = 16;
+	while (buckets < 2u * (unsigned int)count) buckets <<= 1;
+	bucket_mask = buckets - 1;
+
+	bucket_start.assign(buckets + 1, 0);
+	ids.resize(count);
+	positions.resize(count);
+	car_bucket.resize(count);
+
+	// Count the cars of every bucket
+	for (int i = 0; i < count; ++i)
+	{
+		const b2Vec2& p = vehicles.GetPosition(vehicles.GetId(i));
+		int bucket = BucketOf(CellOf(p.x), CellOf(p.y));
+		car_bucket[i] = bucket;
+		bucket_start[bucket + 1]++;
+	}
+
+	for (unsigned int b = 0; b < buckets; ++b)
+	{
+		bucket_start[b + 1] += bucket_start[b];
+	}
+
+	// And put each one in its slot
+	fill.assign(bucket_start.begin(), bucket_start.end() - 1);
+	for (int i = 0; i < count; ++i)
+	{
+		int slot = fill[car_bucket[i]]++;
+		ids[slot] = vehicles.GetId(i);
+		positions[slot] = vehicles.GetPosition(ids[slot]);
+	}
+}
+
+void VehicleGrid::Clear()
+{
+	bucket_start.clear();
+	ids.clear();
+	positions.clear();
+	bucket_mask = 0;
+}
+
+int VehicleGrid::Query(const b2Vec2& position, float radius, int exclude_id, int* results, int max_results) const
+{
+	if (max_results > VEHICLE_GRID_MAX_RESULTS) max_results = VEHICLE_GRID_MAX_RESULTS;
+	if (ids.empty() || max_results <= 0) return 0;
+
+	int min_x = CellOf(position.x - radius);
+	int max_x = CellOf(position.x + radius);
+	int min_y = CellOf(position.y - radius);
+	int max_y = CellOf(position.y + radius);
+
+	// Nearest so far, kept sorted by an insertion per car
+	float distances[VEHICLE_GRID_MAX_RESULTS];
+	const float radius_sqr = radius * radius;
+	int found = 0;
+
+	auto consider = [&](int first_slot, int last_slot)
+	{
+		for (int slot = first_slot; slot < last_slot; ++slot)
+		{
+			float distance = b2DistanceSquared(positions[slot], position);
+			if (distance >= radius_sqr || ids[slot] == exclude_id) continue;
+			if (found == max_results && distance >= distances[found - 1]) continue;
+
+			int i = found < max_results ? found++ : found - 1;
+			for (; i > 0 && distances[i - 1] > distance; --i)
+			{
+				distances[i] = distances[i - 1];
+				results[i] = results[i - 1];
+			}
+			distances[i] = distance;
+			results[i] = ids[slot];
+		}
+	};
+
+	// A radius covering more cells than there are buckets (or than fit in
+	// visited) would visit every bucket anyway, so look at every car instead
+	double cells = ((double)max_x - min_x + 1.0) * ((double)max_y - min_y + 1.0);
+	if (cells > VEHICLE_GRID_MAX_CELLS || cells >= (double)bucket_mask + 1.0)
+	{
+		consider(0, (int)ids.size());
+		return found;
+	}
+
+	// Different cells can share a bucket, visit each bucket once
+	int visited[VEHICLE_GRID_MAX_CELLS];
+	int visited_count = 0;
+
+	for (int cy = min_y; cy <= max_y; ++cy)
+	{
+		for (int cx = min_x; cx <= max_x; ++cx)
+		{
+			int bucket = BucketOf(cx, cy);
+
+			bool seen = false;
+			for (int i = 0; i < visited_count && !seen; ++i) seen = visited[i] == bucket;
+			if (seen) continue;
+			visited[visited_count++] = bucket;
+
+			consider(bucket_start[bucket], bucket_start[bucket + 1]);
+		}
+	}
+
+	return found;
+}
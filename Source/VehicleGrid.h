@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+class VehicleSystem;
+
+#define VEHICLE_GRID_CELL 8.0f		// meters, about the usual query radius
+#define VEHICLE_GRID_MAX_CELLS 64	// cells a query visits one by one, wider ones scan every car
+#define VEHICLE_GRID_MAX_RESULTS 32	// nearest cars a single query may return
+
+// Uniform grid of every car of a VehicleSystem, hashed into a table sized to
+// the car count so the track size doesn't matter. It is rebuilt from the
+// cached positions after each physics update with a counting sort, and
+// queries only look at the cells around the point, so neighbour searches
+// stay linear in the number of cars.
+class VehicleGrid
+{
+public:
+	void Build(const VehicleSystem& vehicles);
+	void Clear();
+
+	// Writes the ids of the max_results cars nearest to position, closer than
+	// radius and other than exclude_id (-1 keeps all), nearest first. Returns
+	// how many were written. Any radius works, one spanning more cells than
+	// the table has buckets looks at every car. Safe to call from several
+	// threads at once.
+	int Query(const b2Vec2& position, float radius, int exclude_id, int* results, int max_results) const;
+
+	int GetCount() const { return (int)ids.size(); }
+
+private:
+	int CellOf(float coordinate) const { return (int)floorf(coordinate / VEHICLE_GRID_CELL); }
+	int BucketOf(int cx, int cy) const { return (int)(((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & bucket_mask); }
+
+	// Cars sorted by bucket, bucket b holds [bucket_start[b], bucket_start[b + 1])
+	std::vector<int> bucket_start;
+	std::vector<int> ids;
+	std::vector<b2Vec2> positions;
+	unsigned int bucket_mask = 0;
+
+	// Build scratch, kept to avoid allocating every frame
+	std::vector<int> car_bucket;
+	std::vector<int> fill;
+};
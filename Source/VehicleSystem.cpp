@@ -0,0 +1,299 @@
+#include "VehicleSystem.h"
+
+#include <cmath>
+
+int VehicleSystem::AddTuning(const VehicleTuning& tuning)
+{
+	profiles.push_back(tuning);
+	return (int)profiles.size() - 1;
+}
+
+int VehicleSystem::AddVehicle(b2Body* body, int tuning_profile)
+{
+	int id;
+	if (!free_ids.empty())
+	{
+		id = free_ids.back();
+		free_ids.pop_back();
+	}
+	else
+	{
+		id = (int)index_of_id.size();
+		index_of_id.push_back(-1);
+	}
+
+	int index = (int)bodies.size();
+	index_of_id[id] = index;
+	id_of_index.push_back(id);
+
+	bodies.push_back(body);
+	profile.push_back(tuning_profile);
+
+	throttle.push_back(0.0f);
+	brake.push_back(0.0f);
+	steer.push_back(0.0f);
+	speed_limit.push_back(0.0f);
+	launch.push_back(0.0f);
+	handbrake.push_back(0);
+	boost.push_back(0);
+
+	position.push_back(b2Vec2_zero);
+	velocity.push_back(b2Vec2_zero);
+	forward.push_back(b2Vec2(0.0f, -1.0f));
+	angle.push_back(0.0f);
+	speed.push_back(0.0f);
+	forward_speed.push_back(0.0f);
+	mass.push_back(0.0f);
+
+	return id;
+}
+
+void VehicleSystem::RemoveVehicle(int id)
+{
+	if (!IsValid(id)) return;
+
+	int index = index_of_id[id];
+	int last = (int)bodies.size() - 1;
+
+	// Swap the last car into the hole
+	if (index != last)
+	{
+		int moved_id = id_of_index[last];
+		index_of_id[moved_id] = index;
+		id_of_index[index] = moved_id;
+
+		bodies[index] = bodies[last];
+		profile[index] = profile[last];
+
+		throttle[index] = throttle[last];
+		brake[index] = brake[last];
+		steer[index] = steer[last];
+		speed_limit[index] = speed_limit[last];
+		launch[index] = launch[last];
+		handbrake[index] = handbrake[last];
+		boost[index] = boost[last];
+
+		position[index] = position[last];
+		velocity[index] = velocity[last];
+		forward[index] = forward[last];
+		angle[index] = angle[last];
+		speed[index] = speed[last];
+		forward_speed[index] = forward_speed[last];
+		mass[index] = mass[last];
+	}
+
+	id_of_index.pop_back();
+	bodies.pop_back();
+	profile.pop_back();
+
+	throttle.pop_back();
+	brake.pop_back();
+	steer.pop_back();
+	speed_limit.pop_back();
+	launch.pop_back();
+	handbrake.pop_back();
+	boost.pop_back();
+
+	position.pop_back();
+	velocity.pop_back();
+	forward.pop_back();
+	angle.pop_back();
+	speed.pop_back();
+	forward_speed.pop_back();
+	mass.pop_back();
+
+	index_of_id[id] = -1;
+	free_ids.push_back(id);
+}
+
+void VehicleSystem::Clear()
+{
+	while (!id_of_index.empty())
+	{
+		RemoveVehicle(id_of_index.back());
+	}
+}
+
+void VehicleSystem::SetControls(int id, const VehicleControls& controls)
+{
+	if (!IsValid(id)) return;
+
+	int index = index_of_id[id];
+	throttle[index] = b2Clamp(controls.throttle, -1.0f, 1.0f);
+	brake[index] = b2Clamp(controls.brake, 0.0f, 1.0f);
+	steer[index] = b2Clamp(controls.steer, -1.0f, 1.0f);
+	speed_limit[index] = controls.speed_limit;
+	// One shot, a launch not applied yet survives the next controls
+	if (controls.launch != 0.0f) launch[index] = controls.launch;
+	handbrake[index] = controls.handbrake ? 1 : 0;
+	boost[index] = controls.boost ? 1 : 0;
+}
+
+VehicleControls VehicleSystem::GetControls(int id) const
+{
+	int index = index_of_id[id];
+	VehicleControls controls;
+	controls.throttle = throttle[index];
+	controls.brake = brake[index];
+	controls.steer = steer[index];
+	controls.speed_limit = speed_limit[index];
+	controls.launch = launch[index];
+	controls.handbrake = handbrake[index] != 0;
+	controls.boost = boost[index] != 0;
+	return controls;
+}
+
+void VehicleSystem::ResetControls(int index)
+{
+	throttle[index] = 0.0f;
+	brake[index] = 0.0f;
+	steer[index] = 0.0f;
+	speed_limit[index] = 0.0f;
+	launch[index] = 0.0f;
+	handbrake[index] = 0;
+	boost[index] = 0;
+}
+
+void VehicleSystem::Gather()
+{
+	int count = (int)bodies.size();
+	for (int i = 0; i < count; ++i)
+	{
+		const b2Body* body = bodies[i];
+		const b2Transform& xf = body->GetTransform();
+		b2Vec2 v = body->GetLinearVelocity();
+
+		// Local (0, -1) is the front of the car
+		b2Vec2 fwd(xf.q.s, -xf.q.c);
+
+		position[i] = xf.p;
+		velocity[i] = v;
+		forward[i] = fwd;
+		angle[i] = body->GetAngle();
+		speed[i] = v.Length();
+		forward_speed[i] = b2Dot(fwd, v);
+		mass[i] = body->GetMass();
+	}
+}
+
+uint32_t VehicleSystem::Hash() const
+{
+	uint32_t hash = 2166136261u;
+	for (int id = 0; id < (int)index_of_id.size(); ++id)
+	{
+		int index = index_of_id[id];
+		if (index < 0) continue;
+
+		float values[5] = { position[index].x, position[index].y, velocity[index].x, velocity[index].y, angle[index] };
+		const unsigned char* bytes = (const unsigned char*)values;
+		for (size_t i = 0; i < sizeof(values); ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+
+void VehicleSystem::Apply(float dt)
+{
+	// Fresh state, bodies may have been moved or stopped since the last step
+	Gather();
+
+	// Grip and steer release are decay rates, the fraction kept after a step
+	// only depends on the time it covers and not on how many steps it takes
+	int count = (int)bodies.size();
+	for (int i = 0; i < count; ++i)
+	{
+		b2Body* body = bodies[i];
+		const VehicleTuning& t = profiles[profile[i]];
+
+		// Kinematic cars are moved by their owner
+		if (body->GetType() != b2_dynamicBody)
+		{
+			ResetControls(i);
+			continue;
+		}
+
+		b2Vec2 v = velocity[i];
+		b2Vec2 fwd = forward[i];
+		b2Vec2 right(-fwd.y, fwd.x);
+		float m = mass[i];
+		float s = speed[i];
+
+		bool moving_forward = forward_speed[i] > 0.1f;
+		bool moving_backward = forward_speed[i] < -0.1f;
+		bool is_stopped = s < 0.1f;
+		bool is_steering = steer[i] != 0.0f;
+
+		float accel = t.engine_accel * (boost[i] ? t.boost_accel : 1.0f);
+		float max_forward = t.max_speed_forward * (boost[i] ? t.boost_speed : 1.0f);
+		float limit = speed_limit[i] > 0.0f ? speed_limit[i] : max_forward;
+
+		// Forces are turned into the impulse of this step, world forces are
+		// only cleared once per frame
+		b2Vec2 force = b2Vec2_zero;
+		b2Vec2 impulse = b2Vec2_zero;
+
+		// Engine, no push past the speed limit
+		if (throttle[i] > 0.0f && s < limit) force += (throttle[i] * accel * m) * fwd;
+		else if (throttle[i] < 0.0f) force += (throttle[i] * accel * m) * fwd;
+
+		if (brake[i] > 0.0f) force -= (brake[i] * t.brake_strength * m) * v;
+
+		float lateral_speed = b2Dot(right, v);
+
+		if (handbrake[i])
+		{
+			if (is_steering && !is_stopped)
+			{
+				// Drift: the back slides, little grip and some braking
+				impulse -= (lateral_speed * (1.0f - expf(-t.drift_grip * dt)) * m) * right;
+				body->ApplyAngularImpulse(steer[i] * t.drift_torque * (s / max_forward) * dt, true);
+				force -= (t.drift_brake * m) * v;
+			}
+			else
+			{
+				force -= (t.handbrake_strength * m) * v;
+			}
+		}
+		else
+		{
+			if (s > 0.5f && is_steering)
+			{
+				float speed_ratio = moving_forward ? s / max_forward : s / t.max_speed_reverse;
+				float reduction = b2Max(1.0f - speed_ratio * t.turn_falloff, t.turn_min);
+				float low_speed = b2Min(s / t.steer_full_speed, 1.0f);
+
+				body->SetAngularVelocity(steer[i] * t.turn_speed * reduction * low_speed);
+			}
+			else if (!is_steering)
+			{
+				body->SetAngularVelocity(body->GetAngularVelocity() * expf(-t.steer_release * dt));
+			}
+
+			// Tyres remove part of the sideways speed
+			impulse -= (lateral_speed * (1.0f - expf(-t.lateral_grip * dt)) * m) * right;
+		}
+
+		// One shot, only the first step after it was set
+		if (launch[i] != 0.0f)
+		{
+			impulse += (launch[i] * m) * fwd;
+			launch[i] = 0.0f;
+		}
+
+		impulse += dt * force;
+		if (impulse.x != 0.0f || impulse.y != 0.0f) body->ApplyLinearImpulseToCenter(impulse, true);
+
+		// Hard speed caps
+		if (moving_forward && s > max_forward)
+		{
+			body->SetLinearVelocity((max_forward / s) * v);
+		}
+		else if (moving_backward && s > t.max_speed_reverse)
+		{
+			body->SetLinearVelocity((t.max_speed_reverse / s) * v);
+		}
+	}
+}
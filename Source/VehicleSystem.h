@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 26495)
+#include "box2d/box2d.h"
+#pragma warning(pop)
+
+// Drive model parameters. Cars share tuning profiles, the player has its own
+// and all the AI cars use another one.
+struct VehicleTuning
+{
+	float engine_accel = 6.0f;		// m/s2 at full throttle, forward and reverse
+	float max_speed_forward = 15.0f;	// hard cap, m/s
+	float max_speed_reverse = 4.5f;
+	float turn_speed = 3.0f;		// rad/s at full steer
+	float steer_full_speed = 0.5f;	// steering is scaled down below this speed
+	float turn_falloff = 0.0f;		// fraction of turn rate lost at max speed
+	float turn_min = 1.0f;			// lower bound of the high speed reduction
+	float steer_release = 6.3f;		// 1/s, decay rate of the angular velocity without steering
+	float lateral_grip = 1000.0f;	// 1/s, decay rate of the sideways speed
+	float brake_strength = 8.0f;
+	float handbrake_strength = 5.0f;
+	float drift_grip = 21.4f;		// 1/s, lateral_grip while drifting
+	float drift_brake = 2.0f;
+	float drift_torque = 25.0f;
+	float boost_accel = 2.5f;		// engine multiplier with boost
+	float boost_speed = 1.8f;		// max speed multiplier with boost
+};
+
+// Inputs of one car. They stay until the next SetControls and are applied
+// before every physics step, whatever the number of steps of a frame.
+struct VehicleControls
+{
+	float throttle = 0.0f;		// -1 full reverse, 1 full forward
+	float brake = 0.0f;			// 0..1
+	float steer = 0.0f;			// -1 left, 1 right
+	float speed_limit = 0.0f;	// no engine force above this speed, 0 uses the tuning
+	float launch = 0.0f;		// one shot forward speed change on the next step, m/s
+	bool handbrake = false;
+	bool boost = false;
+};
+
+// Every car's controls and cached body state in structure-of-arrays form.
+// Player and AI only differ in how they fill the controls, forces for all the
+// cars are applied in one loop before every physics step.
+class VehicleSystem
+{
+public:
+	int AddTuning(const VehicleTuning& tuning);
+	VehicleTuning& GetTuning(int profile) { return profiles[profile]; }
+	const VehicleTuning& GetTuning(int profile) const { return profiles[profile]; }
+	int GetTuningCount() const { return (int)profiles.size(); }
+
+	// Ids are stable, removing a car moves the last one into its slot
+	int AddVehicle(b2Body* body, int tuning_profile);
+	void RemoveVehicle(int id);
+	void Clear();
+
+	void SetControls(int id, const VehicleControls& controls);
+	// Controls in use
+	VehicleControls GetControls(int id) const;
+
+	// Reads position and velocities of every car, called after stepping
+	void Gather();
+	// Applies the controls of every car as impulses for a step of dt seconds,
+	// called before every step. Kinematic cars have theirs cleared
+	void Apply(float dt);
+
+	int GetCount() const { return (int)bodies.size(); }
+	int GetId(int index) const { return id_of_index[index]; }
+	bool IsValid(int id) const { return id >= 0 && id < (int)index_of_id.size() && index_of_id[id] >= 0; }
+	int GetIdCount() const { return (int)index_of_id.size(); }
+	b2Body* GetBody(int id) const { return bodies[index_of_id[id]]; }
+	int GetProfile(int id) const { return profile[index_of_id[id]]; }
+
+	// Cached state, valid after Gather
+	const b2Vec2& GetPosition(int id) const { return position[index_of_id[id]]; }
+	const b2Vec2& GetVelocity(int id) const { return velocity[index_of_id[id]]; }
+	const b2Vec2& GetForward(int id) const { return forward[index_of_id[id]]; }
+	float GetAngle(int id) const { return angle[index_of_id[id]]; }
+	float GetSpeed(int id) const { return speed[index_of_id[id]]; }
+	float GetForwardSpeed(int id) const { return forward_speed[index_of_id[id]]; }
+
+	// FNV-1a of the cached state of every car in id order, compares two runs of a race
+	uint32_t Hash() const;
+
+private:
+	void ResetControls(int index);
+
+	std::vector<VehicleTuning> profiles;
+
+	// id -> dense index and back
+	std::vector<int> index_of_id;
+	std::vector<int> id_of_index;
+	std::vector<int> free_ids;
+
+	// Dense arrays, one entry per car
+	std::vector<b2Body*> bodies;
+	std::vector<int> profile;
+
+	// Controls
+	std::vector<float> throttle;
+	std::vector<float> brake;
+	std::vector<float> steer;
+	std::vector<float> speed_limit;
+	std::vector<float> launch;
+	std::vector<unsigned char> handbrake;
+	std::vector<unsigned char> boost;
+
+	// Cached body state
+	std::vector<b2Vec2> position;
+	std::vector<b2Vec2> velocity;
+	std::vector<b2Vec2> forward;
+	std::vector<float> angle;
+	std::vector<float> speed;
+	std::vector<float> forward_speed;
+	std::vector<float> mass;
+};
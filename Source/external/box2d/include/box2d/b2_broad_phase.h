@@ -37,21 +37,24 @@ struct B2_API b2Pair
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+/// Proxies of static bodies live in their own tree, which is never queried against
+/// itself and can be rebuilt in bulk once the level geometry is loaded.
 class B2_API b2BroadPhase
 {
 public:
 
 	enum
 	{
-		e_nullProxy = -1
+		e_nullProxy = -1,
+		e_staticProxy = 0x40000000	// flag bit of proxy ids in the static tree
 	};
 
 	b2BroadPhase();
 	~b2BroadPhase();
 
 	/// Create a proxy with an initial AABB. Pairs are not reported until
-	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// UpdatePairs is called. Static proxies go to the static tree.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic = false);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
@@ -97,6 +100,24 @@ public:
 	/// Get the height of the embedded tree.
 	int32 GetTreeHeight() const;
 
+	/// Get the height of the static tree.
+	int32 GetStaticTreeHeight() const;
+
+	/// Get the number of proxies in the static tree.
+	int32 GetStaticProxyCount() const;
+
+	/// Number of tree queries made by the last UpdatePairs against the dynamic
+	/// and the static tree.
+	int32 GetDynamicQueryCount() const;
+	int32 GetStaticQueryCount() const;
+
+	/// Rebuild the static tree in one pass. Call after adding the level geometry.
+	void RebuildStaticTree();
+
+	/// Start both trees over like a new broad-phase. Every proxy must have
+	/// been destroyed.
+	void Reset();
+
 	/// Get the balance of the embedded tree.
 	int32 GetTreeBalance() const;
 
@@ -117,9 +138,17 @@ private:
 
 	bool QueryCallback(int32 proxyId);
 
+	static bool IsStaticProxy(int32 proxyId);
+	const b2DynamicTree& GetTree(int32 proxyId) const;
+
+	template <typename T>
+	struct TreeCallback;
+
 	b2DynamicTree m_tree;
+	b2DynamicTree m_staticTree;
 
 	int32 m_proxyCount;
+	int32 m_staticProxyCount;
 
 	int32* m_moveBuffer;
 	int32 m_moveCapacity;
@@ -130,23 +159,68 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+	bool m_queryStaticTree;
+
+	int32 m_dynamicQueryCount;
+	int32 m_staticQueryCount;
 };
 
+/// Forwards tree callbacks with the proxy ids of one tree and remembers if the
+/// client stopped early, so the second tree can be skipped.
+template <typename T>
+struct b2BroadPhase::TreeCallback
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		proceed = callback->QueryCallback(proxyId | flag);
+		return proceed;
+	}
+
+	float RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		float value = callback->RayCastCallback(input, proxyId | flag);
+		if (value == 0.0f)
+		{
+			proceed = false;
+		}
+		else if (value > 0.0f)
+		{
+			maxFraction = value;
+		}
+		return value;
+	}
+
+	T* callback;
+	int32 flag;
+	bool proceed;
+	float maxFraction;
+};
+
+inline bool b2BroadPhase::IsStaticProxy(int32 proxyId)
+{
+	return (proxyId & e_staticProxy) != 0;
+}
+
+inline const b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId) const
+{
+	return IsStaticProxy(proxyId) ? m_staticTree : m_tree;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	return GetTree(proxyId).GetUserData(proxyId & ~e_staticProxy);
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	return GetTree(proxyId).GetFatAABB(proxyId & ~e_staticProxy);
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -169,11 +243,33 @@ inline float b2BroadPhase::GetTreeQuality() const
 	return m_tree.GetAreaRatio();
 }
 
+inline int32 b2BroadPhase::GetStaticTreeHeight() const
+{
+	return m_staticTree.GetHeight();
+}
+
+inline int32 b2BroadPhase::GetStaticProxyCount() const
+{
+	return m_staticProxyCount;
+}
+
+inline int32 b2BroadPhase::GetDynamicQueryCount() const
+{
+	return m_dynamicQueryCount;
+}
+
+inline int32 b2BroadPhase::GetStaticQueryCount() const
+{
+	return m_staticQueryCount;
+}
+
 template <typename T>
 void b2BroadPhase::UpdatePairs(T* callback)
 {
 	// Reset pair buffer
 	m_pairCount = 0;
+	m_dynamicQueryCount = 0;
+	m_staticQueryCount = 0;
 
 	// Perform tree queries for all moving proxies.
 	for (int32 i = 0; i < m_moveCount; ++i)
@@ -186,18 +282,28 @@ void b2BroadPhase::UpdatePairs(T* callback)
 
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
 
 		// Query tree, create pairs and add them pair buffer.
+		// Static proxies only need the dynamic tree.
+		m_queryStaticTree = false;
 		m_tree.Query(this, fatAABB);
+		++m_dynamicQueryCount;
+
+		if (IsStaticProxy(m_queryProxyId) == false)
+		{
+			m_queryStaticTree = true;
+			m_staticTree.Query(this, fatAABB);
+			++m_staticQueryCount;
+		}
 	}
 
 	// Send pairs to caller
 	for (int32 i = 0; i < m_pairCount; ++i)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 	}
@@ -211,7 +317,14 @@ void b2BroadPhase::UpdatePairs(T* callback)
 			continue;
 		}
 
-		m_tree.ClearMoved(proxyId);
+		if (IsStaticProxy(proxyId))
+		{
+			m_staticTree.ClearMoved(proxyId & ~e_staticProxy);
+		}
+		else
+		{
+			m_tree.ClearMoved(proxyId);
+		}
 	}
 
 	// Reset move buffer
@@ -221,18 +334,36 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	TreeCallback<T> treeCallback = { callback, 0, true, 0.0f };
+	m_tree.Query(&treeCallback, aabb);
+
+	if (treeCallback.proceed)
+	{
+		treeCallback.flag = e_staticProxy;
+		m_staticTree.Query(&treeCallback, aabb);
+	}
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	TreeCallback<T> treeCallback = { callback, 0, true, input.maxFraction };
+	m_tree.RayCast(&treeCallback, input);
+
+	if (treeCallback.proceed)
+	{
+		// Keep the clipping done by the client on the first tree.
+		b2RayCastInput staticInput = input;
+		staticInput.maxFraction = treeCallback.maxFraction;
+		treeCallback.flag = e_staticProxy;
+		m_staticTree.RayCast(&treeCallback, staticInput);
+	}
 }
 
 inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	m_tree.ShiftOrigin(newOrigin);
+	m_staticTree.ShiftOrigin(newOrigin);
 }
 
 #endif
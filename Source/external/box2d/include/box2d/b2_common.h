@@ -106,6 +106,15 @@
 #define b2_baumgarte				0.2f
 #define b2_toiBaumgarte				0.75f
 
+/// Soft step contact stiffness in Hertz and its damping ratio. Contacts with static
+/// bodies use twice the stiffness. The stiffness is capped at a quarter of the
+/// sub-step rate.
+#define b2_contactHertz				30.0f
+#define b2_contactDampingRatio		10.0f
+
+/// The maximum velocity the soft step uses to push overlapping shapes apart. Meters per second.
+#define b2_contactPushMaxVelocity	(3.0f * b2_lengthUnitsPerMeter)
+
 
 // Sleep
 
@@ -128,6 +128,14 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Rebuild the tree top-down with a binned surface area heuristic. O(n log n),
+	/// meant for proxies that never move once created, like static geometry.
+	void RebuildTopDownSAH();
+
+	/// Free every node and start over with the pool of a new tree, so proxies
+	/// created from here get the same ids a new tree would give them.
+	void Reset();
+
 	/// Shift the world origin. Useful for large worlds.
 	/// The shift formula is: position -= newOrigin
 	/// @param newOrigin the new origin with respect to the old origin
@@ -143,6 +151,8 @@ private:
 
 	int32 Balance(int32 index);
 
+	int32 BuildTopDownSAH(int32* leaves, int32 count);
+
 	int32 ComputeHeight() const;
 	int32 ComputeHeight(int32 nodeId) const;
 
@@ -47,6 +47,8 @@ struct B2_API b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool wideContacts;	// use the SIMD contact solver
+	int32 softStepCount;	// soft contact sub-steps, 0 uses the iterative solver
 };
 
 /// This is an internal structure.
@@ -40,6 +40,22 @@ class b2Draw;
 class b2Fixture;
 class b2Joint;
 
+/// Instruction sets of the wide contact solver.
+enum b2SimdLevel
+{
+	b2_simdScalar = 0,
+	b2_simdSSE2,
+	b2_simdAVX2
+};
+
+/// Get the best instruction set the wide contact solver can use on this CPU.
+B2_API b2SimdLevel b2GetSupportedSimdLevel();
+
+/// Get/set the instruction set used by the wide contact solver. Levels above the
+/// supported one are clamped. Shared by all worlds.
+B2_API b2SimdLevel b2GetSimdLevel();
+B2_API void b2SetSimdLevel(b2SimdLevel level);
+
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
 /// management facilities.
@@ -162,6 +178,18 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable the wide (SIMD) contact solver. Two point manifolds are relaxed
+	/// point by point instead of with the block solver.
+	void SetWideContactSolver(bool flag) { m_wideContactSolver = flag; }
+	bool GetWideContactSolver() const { return m_wideContactSolver; }
+
+	/// Use the sub-stepped soft contact solver. Each step is split into count
+	/// sub-steps with soft contacts, the iteration counts passed to Step are then
+	/// only used for joint position correction. Zero restores the iterative solver.
+	/// The wide contact solver is not used in this mode.
+	void SetSoftStepCount(int32 count) { m_softStepCount = b2Max(count, 0); }
+	int32 GetSoftStepCount() const { return m_softStepCount; }
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -184,6 +212,21 @@ public:
 	/// The minimum is 1.
 	float GetTreeQuality() const;
 
+	/// Get the height of the static tree.
+	int32 GetStaticTreeHeight() const;
+
+	/// Rebuild the tree of static proxies in one pass. Call once the static
+	/// geometry of a level has been created.
+	void RebuildStaticTree();
+
+	/// Destroy every contact, rebuild the broad-phase with the proxies in the
+	/// order the bodies and fixtures were created and forget what the last step
+	/// leaves for the next one (warm starting ratio, sleep timers, forces). The
+	/// world then steps on exactly like a new world created with the same bodies
+	/// in the same state, which is what replays need. Call RebuildStaticTree
+	/// after it if the static tree was built in bulk.
+	void ResetContacts();
+
 	/// Change the global gravity vector.
 	void SetGravity(const b2Vec2& gravity);
 
@@ -255,6 +298,8 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_wideContactSolver;
+	int32 m_softStepCount;
 
 	bool m_stepComplete;
 
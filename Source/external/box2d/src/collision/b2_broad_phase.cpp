@@ -26,6 +26,7 @@
 b2BroadPhase::b2BroadPhase()
 {
 	m_proxyCount = 0;
+	m_staticProxyCount = 0;
 
 	m_pairCapacity = 16;
 	m_pairCount = 0;
@@ -34,6 +35,11 @@ b2BroadPhase::b2BroadPhase()
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_queryProxyId = e_nullProxy;
+	m_queryStaticTree = false;
+	m_dynamicQueryCount = 0;
+	m_staticQueryCount = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
@@ -42,9 +48,22 @@ b2BroadPhase::~b2BroadPhase()
 	b2Free(m_pairBuffer);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	int32 proxyId;
+	if (isStatic)
+	{
+		proxyId = m_staticTree.CreateProxy(aabb, userData);
+		b2Assert(proxyId < e_staticProxy);
+		proxyId |= e_staticProxy;
+		++m_staticProxyCount;
+	}
+	else
+	{
+		proxyId = m_tree.CreateProxy(aabb, userData);
+		b2Assert(proxyId < e_staticProxy);
+	}
+
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
@@ -54,18 +73,52 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+
+	if (IsStaticProxy(proxyId))
+	{
+		--m_staticProxyCount;
+		m_staticTree.DestroyProxy(proxyId & ~e_staticProxy);
+	}
+	else
+	{
+		m_tree.DestroyProxy(proxyId);
+	}
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer;
+	if (IsStaticProxy(proxyId))
+	{
+		buffer = m_staticTree.MoveProxy(proxyId & ~e_staticProxy, aabb, displacement);
+	}
+	else
+	{
+		buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	}
+
 	if (buffer)
 	{
 		BufferMove(proxyId);
 	}
 }
 
+void b2BroadPhase::RebuildStaticTree()
+{
+	m_staticTree.RebuildTopDownSAH();
+}
+
+void b2BroadPhase::Reset()
+{
+	b2Assert(m_proxyCount == 0);
+
+	m_tree.Reset();
+	m_staticTree.Reset();
+	m_staticProxyCount = 0;
+	m_moveCount = 0;
+	m_pairCount = 0;
+}
+
 void b2BroadPhase::TouchProxy(int32 proxyId)
 {
 	BufferMove(proxyId);
@@ -100,17 +153,34 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 // This is called from b2DynamicTree::Query when we are gathering pairs.
 bool b2BroadPhase::QueryCallback(int32 proxyId)
 {
-	// A proxy cannot form a pair with itself.
-	if (proxyId == m_queryProxyId)
+	if (m_queryStaticTree)
 	{
-		return true;
+		// A dynamic proxy against the static tree. Moved static proxies don't report
+		// moved dynamic ones, so every hit here is a new pair.
+		proxyId |= e_staticProxy;
 	}
-
-	const bool moved = m_tree.WasMoved(proxyId);
-	if (moved && proxyId > m_queryProxyId)
+	else if (IsStaticProxy(m_queryProxyId))
 	{
-		// Both proxies are moving. Avoid duplicate pairs.
-		return true;
+		if (m_tree.WasMoved(proxyId))
+		{
+			// The dynamic proxy reports this pair from its own query.
+			return true;
+		}
+	}
+	else
+	{
+		// A proxy cannot form a pair with itself.
+		if (proxyId == m_queryProxyId)
+		{
+			return true;
+		}
+
+		const bool moved = m_tree.WasMoved(proxyId);
+		if (moved && proxyId > m_queryProxyId)
+		{
+			// Both proxies are moving. Avoid duplicate pairs.
+			return true;
+		}
 	}
 
 	// Grow the pair buffer as needed.
@@ -24,6 +24,14 @@
 
 b2DynamicTree::b2DynamicTree()
 {
+	m_nodes = nullptr;
+	Reset();
+}
+
+void b2DynamicTree::Reset()
+{
+	b2Free(m_nodes);
+
 	m_root = b2_nullNode;
 
 	m_nodeCapacity = 16;
@@ -790,6 +798,186 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+void b2DynamicTree::RebuildTopDownSAH()
+{
+	int32* nodes = (int32*)b2Alloc(b2Max(m_nodeCount, 1) * sizeof(int32));
+	int32 count = 0;
+
+	// Build array of leaves. Free the rest.
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf())
+		{
+			m_nodes[i].parent = b2_nullNode;
+			nodes[count] = i;
+			++count;
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	m_root = count > 0 ? BuildTopDownSAH(nodes, count) : b2_nullNode;
+	b2Free(nodes);
+
+	Validate();
+}
+
+// Split the leaves with the cheapest plane among a few bins along the longest
+// centroid axis. Falls back to a median split when the centroids coincide.
+int32 b2DynamicTree::BuildTopDownSAH(int32* leaves, int32 count)
+{
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	const int32 binCount = 16;
+
+	b2Vec2 lower = m_nodes[leaves[0]].aabb.GetCenter();
+	b2Vec2 upper = lower;
+	for (int32 i = 1; i < count; ++i)
+	{
+		b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+		lower = b2Min(lower, c);
+		upper = b2Max(upper, c);
+	}
+
+	b2Vec2 extent = upper - lower;
+	int32 axis = extent.x >= extent.y ? 0 : 1;
+	float axisLower = axis == 0 ? lower.x : lower.y;
+	float axisExtent = axis == 0 ? extent.x : extent.y;
+
+	int32 split = count / 2;
+
+	if (axisExtent > b2_epsilon)
+	{
+		int32 binLeafCounts[binCount] = {};
+		// The lowest and highest centers land in the first and last bins, so
+		// neither of those is ever empty
+		b2AABB binBoxes[binCount];
+		float scale = binCount / axisExtent;
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			const b2AABB& aabb = m_nodes[leaves[i]].aabb;
+			b2Vec2 c = aabb.GetCenter();
+			int32 bin = b2Min(int32(scale * ((axis == 0 ? c.x : c.y) - axisLower)), binCount - 1);
+			if (binLeafCounts[bin] == 0)
+			{
+				binBoxes[bin] = aabb;
+			}
+			else
+			{
+				binBoxes[bin].Combine(aabb);
+			}
+			++binLeafCounts[bin];
+		}
+
+		// Sweep from the right to get the cost of every right hand side.
+		float rightCosts[binCount];
+		int32 rightCount = 0;
+		b2AABB rightBox = binBoxes[binCount - 1];
+		for (int32 i = binCount - 1; i > 0; --i)
+		{
+			if (binLeafCounts[i] > 0)
+			{
+				if (rightCount == 0)
+				{
+					rightBox = binBoxes[i];
+				}
+				else
+				{
+					rightBox.Combine(binBoxes[i]);
+				}
+				rightCount += binLeafCounts[i];
+			}
+			rightCosts[i] = rightCount > 0 ? rightBox.GetPerimeter() * rightCount : 0.0f;
+		}
+
+		float bestCost = b2_maxFloat;
+		int32 bestBin = -1;
+		int32 leftCount = 0;
+		b2AABB leftBox = binBoxes[0];
+		for (int32 i = 0; i < binCount - 1; ++i)
+		{
+			if (binLeafCounts[i] > 0)
+			{
+				if (leftCount == 0)
+				{
+					leftBox = binBoxes[i];
+				}
+				else
+				{
+					leftBox.Combine(binBoxes[i]);
+				}
+				leftCount += binLeafCounts[i];
+			}
+
+			if (leftCount == 0 || leftCount == count)
+			{
+				continue;
+			}
+
+			float cost = leftBox.GetPerimeter() * leftCount + rightCosts[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestBin = i;
+			}
+		}
+
+		if (bestBin >= 0)
+		{
+			// Partition in place, bins up to bestBin go left.
+			int32 left = 0;
+			for (int32 i = 0; i < count; ++i)
+			{
+				b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+				int32 bin = b2Min(int32(scale * ((axis == 0 ? c.x : c.y) - axisLower)), binCount - 1);
+				if (bin <= bestBin)
+				{
+					int32 temp = leaves[left];
+					leaves[left] = leaves[i];
+					leaves[i] = temp;
+					++left;
+				}
+			}
+
+			if (0 < left && left < count)
+			{
+				split = left;
+			}
+		}
+	}
+
+	int32 index1 = BuildTopDownSAH(leaves, split);
+	int32 index2 = BuildTopDownSAH(leaves + split, count - split);
+
+	// AllocateNode can grow the pool, so take pointers after it.
+	int32 parentIndex = AllocateNode();
+	b2TreeNode* parent = m_nodes + parentIndex;
+	b2TreeNode* child1 = m_nodes + index1;
+	b2TreeNode* child2 = m_nodes + index2;
+	parent->child1 = index1;
+	parent->child2 = index2;
+	parent->height = 1 + b2Max(child1->height, child2->height);
+	parent->aabb.Combine(child1->aabb, child2->aabb);
+	parent->parent = b2_nullNode;
+
+	child1->parent = parentIndex;
+	child2->parent = parentIndex;
+
+	return parentIndex;
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	// Build array of leaves. Free the rest.
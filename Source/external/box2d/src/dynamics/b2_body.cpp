@@ -121,6 +121,7 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	bool staticChanged = (m_type == b2_staticBody) != (type == b2_staticBody);
 	m_type = type;
 
 	ResetMassData();
@@ -154,6 +155,14 @@ void b2Body::SetType(b2BodyType type)
 	b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
 	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
 	{
+		if (staticChanged && f->m_proxyCount > 0)
+		{
+			// Static proxies live in their own tree, recreating them also buffers the move.
+			f->DestroyProxies(broadPhase);
+			f->CreateProxies(broadPhase, m_xf);
+			continue;
+		}
+
 		int32 proxyCount = f->m_proxyCount;
 		for (int32 i = 0; i < proxyCount; ++i)
 		{
@@ -21,6 +21,7 @@
 // SOFTWARE.
 
 #include "b2_contact_solver.h"
+#include "b2_contact_solver_wide.h"
 
 #include "box2d/b2_body.h"
 #include "box2d/b2_contact.h"
@@ -33,21 +34,6 @@
 
 B2_API bool g_blockSolve = true;
 
-struct b2ContactPositionConstraint
-{
-	b2Vec2 localPoints[b2_maxManifoldPoints];
-	b2Vec2 localNormal;
-	b2Vec2 localPoint;
-	int32 indexA;
-	int32 indexB;
-	float invMassA, invMassB;
-	b2Vec2 localCenterA, localCenterB;
-	float invIA, invIB;
-	b2Manifold::Type type;
-	float radiusA, radiusB;
-	int32 pointCount;
-};
-
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -58,6 +44,9 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_wideColors = nullptr;
+	m_wide = nullptr;
+	m_softStartPositions = nullptr;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -138,6 +127,12 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wide)
+	{
+		m_allocator->Free(m_wide);
+		m_allocator->Free(m_wideColors);
+	}
+
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -195,6 +190,9 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			vcp->rA = worldManifold.points[j] - cA;
 			vcp->rB = worldManifold.points[j] - cB;
 
+			// Separation without the anchor offset, the soft step adds it back as the bodies move.
+			vcp->adjustedSeparation = worldManifold.separations[j] - b2Dot(vcp->rB - vcp->rA, vc->normal);
+
 			float rnA = b2Cross(vcp->rA, vc->normal);
 			float rnB = b2Cross(vcp->rB, vc->normal);
 
@@ -252,6 +250,11 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	if (m_step.wideContacts && m_count > 0)
+	{
+		PrepareWide();
+	}
 }
 
 void b2ContactSolver::WarmStart()
@@ -296,6 +299,12 @@ void b2ContactSolver::WarmStart()
 
 void b2ContactSolver::SolveVelocityConstraints()
 {
+	if (m_wide)
+	{
+		SolveVelocityConstraintsWide();
+		return;
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -608,6 +617,11 @@ void b2ContactSolver::SolveVelocityConstraints()
 
 void b2ContactSolver::StoreImpulses()
 {
+	if (m_wide)
+	{
+		UnpackWideImpulses();
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -621,6 +635,201 @@ void b2ContactSolver::StoreImpulses()
 	}
 }
 
+// Soft constraint coefficients for a spring of the given stiffness and damping
+// ratio, integrated over the sub-step h. See Erin Catto's "Solver2D" notes.
+static void b2MakeSoft(float hertz, float zeta, float h, float* biasRate, float* massScale, float* impulseScale)
+{
+	if (hertz == 0.0f)
+	{
+		*biasRate = 0.0f;
+		*massScale = 1.0f;
+		*impulseScale = 0.0f;
+		return;
+	}
+
+	float omega = 2.0f * b2_pi * hertz;
+	float a1 = 2.0f * zeta + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+	*biasRate = omega / a1;
+	*massScale = a2 * a3;
+	*impulseScale = a3;
+}
+
+void b2ContactSolver::PrepareSoft(const b2Position* startPositions, float h)
+{
+	m_softStartPositions = startPositions;
+	m_softInvH = h > 0.0f ? 1.0f / h : 0.0f;
+
+	// Stiffer than the sub-step rate can resolve would only add energy.
+	float contactHertz = b2Min(b2_contactHertz, 0.25f * m_softInvH);
+	b2MakeSoft(contactHertz, b2_contactDampingRatio, h, &m_softBiasRate, &m_softMassScale, &m_softImpulseScale);
+	b2MakeSoft(2.0f * contactHertz, b2_contactDampingRatio, h, &m_staticSoftBiasRate, &m_staticSoftMassScale, &m_staticSoftImpulseScale);
+}
+
+void b2ContactSolver::SolveSoftVelocityConstraints(bool useBias)
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+		int32 pointCount = vc->pointCount;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		// Body motion since the start of the step.
+		b2Vec2 dcA = m_positions[indexA].c - m_softStartPositions[indexA].c;
+		b2Vec2 dcB = m_positions[indexB].c - m_softStartPositions[indexB].c;
+		b2Rot dqA(m_positions[indexA].a - m_softStartPositions[indexA].a);
+		b2Rot dqB(m_positions[indexB].a - m_softStartPositions[indexB].a);
+
+		bool isStatic = mA == 0.0f || mB == 0.0f;
+		float biasRate = isStatic ? m_staticSoftBiasRate : m_softBiasRate;
+		float softMassScale = isStatic ? m_staticSoftMassScale : m_softMassScale;
+		float softImpulseScale = isStatic ? m_staticSoftImpulseScale : m_softImpulseScale;
+
+		b2Vec2 normal = vc->normal;
+		b2Vec2 tangent = b2Cross(normal, 1.0f);
+		float friction = vc->friction;
+
+		// Solve normal constraints first, friction needs the normal impulse.
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2VelocityConstraintPoint* vcp = vc->points + j;
+
+			// Current separation from the anchors rotated with their bodies.
+			b2Vec2 d = dcB - dcA + b2Mul(dqB, vcp->rB) - b2Mul(dqA, vcp->rA);
+			float s = b2Dot(d, normal) + vcp->adjustedSeparation;
+
+			float bias = 0.0f;
+			float massScale = 1.0f;
+			float impulseScale = 0.0f;
+			if (s > 0.0f)
+			{
+				// Speculative, allow the gap to close within this sub-step.
+				bias = s * m_softInvH;
+			}
+			else if (useBias)
+			{
+				bias = b2Max(biasRate * s, -b2_contactPushMaxVelocity);
+				massScale = softMassScale;
+				impulseScale = softImpulseScale;
+			}
+
+			// Relative normal velocity at the fixed anchors.
+			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			float vn = b2Dot(dv, normal);
+
+			float impulse = -vcp->normalMass * massScale * (vn + bias) - impulseScale * vcp->normalImpulse;
+
+			// Clamp the accumulated impulse.
+			float newImpulse = b2Max(vcp->normalImpulse + impulse, 0.0f);
+			impulse = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+
+			b2Vec2 P = impulse * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(vcp->rA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(vcp->rB, P);
+		}
+
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			b2VelocityConstraintPoint* vcp = vc->points + j;
+
+			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			float vt = b2Dot(dv, tangent) - vc->tangentSpeed;
+			float lambda = vcp->tangentMass * (-vt);
+
+			float maxFriction = friction * vcp->normalImpulse;
+			float newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+			lambda = newImpulse - vcp->tangentImpulse;
+			vcp->tangentImpulse = newImpulse;
+
+			b2Vec2 P = lambda * tangent;
+			vA -= mA * P;
+			wA -= iA * b2Cross(vcp->rA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(vcp->rB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
+// The soft step has no position pass, so bounce is applied once at the end of the step.
+void b2ContactSolver::ApplySoftRestitution()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		if (vc->restitution == 0.0f)
+		{
+			continue;
+		}
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float mA = vc->invMassA;
+		float iA = vc->invIA;
+		float mB = vc->invMassB;
+		float iB = vc->invIB;
+
+		b2Vec2 vA = m_velocities[indexA].v;
+		float wA = m_velocities[indexA].w;
+		b2Vec2 vB = m_velocities[indexB].v;
+		float wB = m_velocities[indexB].w;
+
+		b2Vec2 normal = vc->normal;
+
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			b2VelocityConstraintPoint* vcp = vc->points + j;
+
+			// Only points that were approaching fast enough to bounce.
+			if (vcp->velocityBias == 0.0f)
+			{
+				continue;
+			}
+
+			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			float vn = b2Dot(dv, normal);
+
+			float impulse = -vcp->normalMass * (vn - vcp->velocityBias);
+			float newImpulse = b2Max(vcp->normalImpulse + impulse, 0.0f);
+			impulse = newImpulse - vcp->normalImpulse;
+			vcp->normalImpulse = newImpulse;
+
+			b2Vec2 P = impulse * normal;
+			vA -= mA * P;
+			wA -= iA * b2Cross(vcp->rA, P);
+
+			vB += mB * P;
+			wB += iB * b2Cross(vcp->rB, P);
+		}
+
+		m_velocities[indexA].v = vA;
+		m_velocities[indexA].w = wA;
+		m_velocities[indexB].v = vB;
+		m_velocities[indexB].w = wB;
+	}
+}
+
 struct b2PositionSolverManifold
 {
 	void Initialize(b2ContactPositionConstraint* pc, const b2Transform& xfA, const b2Transform& xfB, int32 index)
@@ -675,6 +884,11 @@ struct b2PositionSolverManifold
 // Sequential solver.
 bool b2ContactSolver::SolvePositionConstraints()
 {
+	if (m_wide)
+	{
+		return SolvePositionConstraintsWide();
+	}
+
 	float minSeparation = 0.0f;
 
 	for (int32 i = 0; i < m_count; ++i)
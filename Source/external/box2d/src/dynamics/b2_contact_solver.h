@@ -30,7 +30,7 @@
 class b2Contact;
 class b2Body;
 class b2StackAllocator;
-struct b2ContactPositionConstraint;
+struct b2WideContacts;
 
 struct b2VelocityConstraintPoint
 {
@@ -41,6 +41,7 @@ struct b2VelocityConstraintPoint
 	float normalMass;
 	float tangentMass;
 	float velocityBias;
+	float adjustedSeparation;
 };
 
 struct b2ContactVelocityConstraint
@@ -61,6 +62,21 @@ struct b2ContactVelocityConstraint
 	int32 contactIndex;
 };
 
+struct b2ContactPositionConstraint
+{
+	b2Vec2 localPoints[b2_maxManifoldPoints];
+	b2Vec2 localNormal;
+	b2Vec2 localPoint;
+	int32 indexA;
+	int32 indexB;
+	float invMassA, invMassB;
+	b2Vec2 localCenterA, localCenterB;
+	float invIA, invIB;
+	b2Manifold::Type type;
+	float radiusA, radiusB;
+	int32 pointCount;
+};
+
 struct b2ContactSolverDef
 {
 	b2TimeStep step;
@@ -86,6 +102,17 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	// Soft step, see b2Island::SolveSoft
+	void PrepareSoft(const b2Position* startPositions, float h);
+	void SolveSoftVelocityConstraints(bool useBias);
+	void ApplySoftRestitution();
+
+	// Wide path, see b2_contact_solver_wide.h
+	void PrepareWide();
+	void SolveVelocityConstraintsWide();
+	bool SolvePositionConstraintsWide();
+	void UnpackWideImpulses();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -94,6 +121,14 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+	int32* m_wideColors;
+	b2WideContacts* m_wide;
+
+	// Soft step state
+	const b2Position* m_softStartPositions;
+	float m_softInvH;
+	float m_softBiasRate, m_softMassScale, m_softImpulseScale;
+	float m_staticSoftBiasRate, m_staticSoftMassScale, m_staticSoftImpulseScale;
 };
 
 #endif
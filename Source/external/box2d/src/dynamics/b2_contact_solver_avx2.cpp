@@ -0,0 +1,81 @@
+// MIT License
+
+// Copyright (c) 2025 MarcPladellorensPerez
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// This file is compiled with AVX2 enabled. It must not call any non-template inline
+// function shared with the rest of the library, the linker could pick this copy.
+
+#include "b2_contact_solver_wide.h"
+
+#include <math.h>
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && defined(_M_X64))
+#include <immintrin.h>
+
+namespace
+{
+
+struct b2WideAVX2
+{
+	static const int32 width = 8;
+	__m256 v;
+
+	static b2WideAVX2 Make(__m256 x) { b2WideAVX2 r; r.v = x; return r; }
+	static b2WideAVX2 Load(const float* p) { return Make(_mm256_loadu_ps(p)); }
+	void Store(float* p) const { _mm256_storeu_ps(p, v); }
+	static b2WideAVX2 Splat(float x) { return Make(_mm256_set1_ps(x)); }
+	static b2WideAVX2 Sqrt(b2WideAVX2 a) { return Make(_mm256_sqrt_ps(a.v)); }
+	static b2WideAVX2 Min(b2WideAVX2 a, b2WideAVX2 b) { return Make(_mm256_min_ps(a.v, b.v)); }
+	static b2WideAVX2 Max(b2WideAVX2 a, b2WideAVX2 b) { return Make(_mm256_max_ps(a.v, b.v)); }
+
+	static b2WideAVX2 Greater(b2WideAVX2 a, b2WideAVX2 b) { return Make(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+	static b2WideAVX2 And(b2WideAVX2 a, b2WideAVX2 b) { return Make(_mm256_and_ps(a.v, b.v)); }
+	static b2WideAVX2 Select(b2WideAVX2 mask, b2WideAVX2 a, b2WideAVX2 b) { return Make(_mm256_blendv_ps(b.v, a.v, mask.v)); }
+
+	static void SinCos(const float* angles, float* s, float* c) { for (int32 i = 0; i < 8; ++i) { s[i] = sinf(angles[i]); c[i] = cosf(angles[i]); } }
+};
+
+inline b2WideAVX2 operator+(b2WideAVX2 a, b2WideAVX2 b) { return b2WideAVX2::Make(_mm256_add_ps(a.v, b.v)); }
+inline b2WideAVX2 operator-(b2WideAVX2 a, b2WideAVX2 b) { return b2WideAVX2::Make(_mm256_sub_ps(a.v, b.v)); }
+inline b2WideAVX2 operator*(b2WideAVX2 a, b2WideAVX2 b) { return b2WideAVX2::Make(_mm256_mul_ps(a.v, b.v)); }
+inline b2WideAVX2 operator/(b2WideAVX2 a, b2WideAVX2 b) { return b2WideAVX2::Make(_mm256_div_ps(a.v, b.v)); }
+
+void b2SolveVelocityWideAVX2Impl(b2WideContacts* contacts, b2Velocity* velocities)
+{
+	b2SolveVelocityWide<b2WideAVX2>(contacts, velocities);
+}
+
+float b2SolvePositionWideAVX2Impl(b2WideContacts* contacts, b2Position* positions)
+{
+	return b2SolvePositionWide<b2WideAVX2>(contacts, positions);
+}
+
+} // namespace
+
+b2SolveVelocityWideFcn* const b2SolveVelocityWideAVX2 = b2SolveVelocityWideAVX2Impl;
+b2SolvePositionWideFcn* const b2SolvePositionWideAVX2 = b2SolvePositionWideAVX2Impl;
+
+#else
+
+b2SolveVelocityWideFcn* const b2SolveVelocityWideAVX2 = nullptr;
+b2SolvePositionWideFcn* const b2SolvePositionWideAVX2 = nullptr;
+
+#endif
@@ -0,0 +1,428 @@
+// MIT License
+
+// Copyright (c) 2025 MarcPladellorensPerez
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "b2_contact_solver.h"
+#include "b2_contact_solver_wide.h"
+
+#include "box2d/b2_stack_allocator.h"
+#include "box2d/b2_world.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_WIDE_SSE2 1
+#include <emmintrin.h>
+#else
+#define B2_WIDE_SSE2 0
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+// Portable fallback. Same lane layout as SSE2 so the kernels can be checked against it.
+struct b2WideFloat4
+{
+	static const int32 width = 4;
+	float v[4];
+
+	static b2WideFloat4 Load(const float* p) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+	void Store(float* p) const { for (int32 i = 0; i < 4; ++i) p[i] = v[i]; }
+	static b2WideFloat4 Splat(float x) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = x; return r; }
+	static b2WideFloat4 Sqrt(b2WideFloat4 a) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = sqrtf(a.v[i]); return r; }
+	static b2WideFloat4 Min(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+	static b2WideFloat4 Max(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+
+	// Masks are 1 or 0 per lane.
+	static b2WideFloat4 Greater(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? 1.0f : 0.0f; return r; }
+	static b2WideFloat4 And(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i]; return r; }
+	static b2WideFloat4 Select(b2WideFloat4 mask, b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i]; return r; }
+
+	static void SinCos(const float* angles, float* s, float* c) { for (int32 i = 0; i < 4; ++i) { s[i] = sinf(angles[i]); c[i] = cosf(angles[i]); } }
+};
+
+inline b2WideFloat4 operator+(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] + b.v[i]; return r; }
+inline b2WideFloat4 operator-(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] - b.v[i]; return r; }
+inline b2WideFloat4 operator*(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i]; return r; }
+inline b2WideFloat4 operator/(b2WideFloat4 a, b2WideFloat4 b) { b2WideFloat4 r; for (int32 i = 0; i < 4; ++i) r.v[i] = b.v[i] != 0.0f ? a.v[i] / b.v[i] : 0.0f; return r; }
+
+#if B2_WIDE_SSE2
+struct b2WideSSE2
+{
+	static const int32 width = 4;
+	__m128 v;
+
+	static b2WideSSE2 Make(__m128 x) { b2WideSSE2 r; r.v = x; return r; }
+	static b2WideSSE2 Load(const float* p) { return Make(_mm_loadu_ps(p)); }
+	void Store(float* p) const { _mm_storeu_ps(p, v); }
+	static b2WideSSE2 Splat(float x) { return Make(_mm_set1_ps(x)); }
+	static b2WideSSE2 Sqrt(b2WideSSE2 a) { return Make(_mm_sqrt_ps(a.v)); }
+	static b2WideSSE2 Min(b2WideSSE2 a, b2WideSSE2 b) { return Make(_mm_min_ps(a.v, b.v)); }
+	static b2WideSSE2 Max(b2WideSSE2 a, b2WideSSE2 b) { return Make(_mm_max_ps(a.v, b.v)); }
+
+	// Masks are all bits set or clear per lane.
+	static b2WideSSE2 Greater(b2WideSSE2 a, b2WideSSE2 b) { return Make(_mm_cmpgt_ps(a.v, b.v)); }
+	static b2WideSSE2 And(b2WideSSE2 a, b2WideSSE2 b) { return Make(_mm_and_ps(a.v, b.v)); }
+	static b2WideSSE2 Select(b2WideSSE2 mask, b2WideSSE2 a, b2WideSSE2 b) { return Make(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))); }
+
+	static void SinCos(const float* angles, float* s, float* c) { for (int32 i = 0; i < 4; ++i) { s[i] = sinf(angles[i]); c[i] = cosf(angles[i]); } }
+};
+
+inline b2WideSSE2 operator+(b2WideSSE2 a, b2WideSSE2 b) { return b2WideSSE2::Make(_mm_add_ps(a.v, b.v)); }
+inline b2WideSSE2 operator-(b2WideSSE2 a, b2WideSSE2 b) { return b2WideSSE2::Make(_mm_sub_ps(a.v, b.v)); }
+inline b2WideSSE2 operator*(b2WideSSE2 a, b2WideSSE2 b) { return b2WideSSE2::Make(_mm_mul_ps(a.v, b.v)); }
+inline b2WideSSE2 operator/(b2WideSSE2 a, b2WideSSE2 b) { return b2WideSSE2::Make(_mm_div_ps(a.v, b.v)); }
+#endif
+
+b2SimdLevel b2DetectSimdLevel()
+{
+	b2SimdLevel level = b2_simdScalar;
+
+#if B2_WIDE_SSE2
+	level = b2_simdSSE2;
+
+	if (b2SolveVelocityWideAVX2 != nullptr)
+	{
+#if defined(_MSC_VER)
+		// AVX2 needs the CPU flag and the OS saving the ymm registers.
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] >= 7)
+		{
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			__cpuidex(info, 7, 0);
+			bool avx2 = (info[1] & (1 << 5)) != 0;
+			if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+			{
+				level = b2_simdAVX2;
+			}
+		}
+#elif defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			level = b2_simdAVX2;
+		}
+#endif
+	}
+#endif
+
+	return level;
+}
+
+b2SimdLevel b2GetSupportedSimdLevelCached()
+{
+	static b2SimdLevel supported = b2DetectSimdLevel();
+	return supported;
+}
+
+b2SimdLevel s_simdLevel = b2GetSupportedSimdLevelCached();
+
+} // namespace
+
+void b2SolveVelocityWideScalar(b2WideContacts* contacts, b2Velocity* velocities)
+{
+	b2SolveVelocityWide<b2WideFloat4>(contacts, velocities);
+}
+
+float b2SolvePositionWideScalar(b2WideContacts* contacts, b2Position* positions)
+{
+	return b2SolvePositionWide<b2WideFloat4>(contacts, positions);
+}
+
+void b2SolveVelocityWideSSE2(b2WideContacts* contacts, b2Velocity* velocities)
+{
+#if B2_WIDE_SSE2
+	b2SolveVelocityWide<b2WideSSE2>(contacts, velocities);
+#else
+	b2SolveVelocityWide<b2WideFloat4>(contacts, velocities);
+#endif
+}
+
+float b2SolvePositionWideSSE2(b2WideContacts* contacts, b2Position* positions)
+{
+#if B2_WIDE_SSE2
+	return b2SolvePositionWide<b2WideSSE2>(contacts, positions);
+#else
+	return b2SolvePositionWide<b2WideFloat4>(contacts, positions);
+#endif
+}
+
+b2SimdLevel b2GetSupportedSimdLevel()
+{
+	return b2GetSupportedSimdLevelCached();
+}
+
+b2SimdLevel b2GetSimdLevel()
+{
+	return s_simdLevel;
+}
+
+void b2SetSimdLevel(b2SimdLevel level)
+{
+	b2SimdLevel supported = b2GetSupportedSimdLevelCached();
+	s_simdLevel = level < supported ? level : supported;
+}
+
+// Color the constraints and pack them into lane groups. Called after the velocity
+// constraints are initialized.
+void b2ContactSolver::PrepareWide()
+{
+	b2Assert(m_wide == nullptr);
+
+	const int32 width = s_simdLevel == b2_simdAVX2 ? 8 : 4;
+	const int32 maxColors = 32;
+
+	// Assign each constraint the lowest color not used by its dynamic bodies. Static
+	// bodies don't receive impulses, so they can be shared by every lane.
+	m_wideColors = (int32*)m_allocator->Allocate(b2Max(m_count, 1) * sizeof(int32));
+
+	int32 bodyCount = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		bodyCount = b2Max(bodyCount, b2Max(m_velocityConstraints[i].indexA, m_velocityConstraints[i].indexB) + 1);
+	}
+
+	uint32* bodyColors = (uint32*)m_allocator->Allocate(b2Max(bodyCount, 1) * sizeof(uint32));
+	memset(bodyColors, 0, bodyCount * sizeof(uint32));
+
+	int32 colorCounts[maxColors] = {};
+	int32 overflowCount = 0;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bool dynamicA = vc->invMassA > 0.0f || vc->invIA > 0.0f;
+		bool dynamicB = vc->invMassB > 0.0f || vc->invIB > 0.0f;
+
+		uint32 used = (dynamicA ? bodyColors[vc->indexA] : 0) | (dynamicB ? bodyColors[vc->indexB] : 0);
+		if (used == 0xFFFFFFFF)
+		{
+			// Out of colors, this constraint gets a group of its own.
+			m_wideColors[i] = -1;
+			++overflowCount;
+			continue;
+		}
+
+		int32 color = 0;
+		while (used & (1u << color))
+		{
+			++color;
+		}
+
+		m_wideColors[i] = color;
+		++colorCounts[color];
+
+		if (dynamicA)
+		{
+			bodyColors[vc->indexA] |= 1u << color;
+		}
+
+		if (dynamicB)
+		{
+			bodyColors[vc->indexB] |= 1u << color;
+		}
+	}
+
+	m_allocator->Free(bodyColors);
+
+	int32 groupCount = overflowCount;
+	for (int32 c = 0; c < maxColors; ++c)
+	{
+		groupCount += (colorCounts[c] + width - 1) / width;
+	}
+
+	// One block: header, lane counts, lane indices, then the float rows.
+	int32 laneTotal = groupCount * width;
+	int32 headerSize = (int32)((sizeof(b2WideContacts) + 15) & ~(size_t)15);
+	int32 indexSize = (groupCount + 3 * laneTotal) * (int32)sizeof(int32);
+	indexSize = (indexSize + 15) & ~15;
+	int32 floatSize = laneTotal * (b2_wideVelocityFieldCount + b2_widePositionFieldCount) * (int32)sizeof(float);
+
+	char* block = (char*)m_allocator->Allocate(headerSize + indexSize + floatSize);
+	memset(block, 0, headerSize + indexSize + floatSize);
+
+	m_wide = (b2WideContacts*)block;
+	m_wide->width = width;
+	m_wide->groupCount = groupCount;
+	m_wide->laneCounts = (int32*)(block + headerSize);
+	m_wide->indexA = m_wide->laneCounts + groupCount;
+	m_wide->indexB = m_wide->indexA + laneTotal;
+	m_wide->constraintIndex = m_wide->indexB + laneTotal;
+	m_wide->velocity = (float*)(block + headerSize + indexSize);
+	m_wide->position = m_wide->velocity + laneTotal * b2_wideVelocityFieldCount;
+
+	// Group start per color, overflow groups go last.
+	int32 groupStart[maxColors + 1];
+	int32 start = 0;
+	for (int32 c = 0; c < maxColors; ++c)
+	{
+		groupStart[c] = start;
+		start += (colorCounts[c] + width - 1) / width;
+	}
+	groupStart[maxColors] = start;
+
+	int32 colorFill[maxColors] = {};
+	int32 overflowFill = 0;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		int32 color = m_wideColors[i];
+		int32 group, lane;
+		if (color >= 0)
+		{
+			group = groupStart[color] + colorFill[color] / width;
+			lane = colorFill[color] % width;
+			++colorFill[color];
+		}
+		else
+		{
+			group = groupStart[maxColors] + overflowFill;
+			lane = 0;
+			++overflowFill;
+		}
+
+		m_wide->laneCounts[group] = lane + 1;
+
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		const b2ContactPositionConstraint* pc = m_positionConstraints + i;
+
+		int32 slot = group * width + lane;
+		m_wide->indexA[slot] = vc->indexA;
+		m_wide->indexB[slot] = vc->indexB;
+		m_wide->constraintIndex[slot] = i;
+
+		float* v = m_wide->velocity + group * b2_wideVelocityFieldCount * width + lane;
+		v[b2_wvInvMassA * width] = vc->invMassA;
+		v[b2_wvInvIA * width] = vc->invIA;
+		v[b2_wvInvMassB * width] = vc->invMassB;
+		v[b2_wvInvIB * width] = vc->invIB;
+		v[b2_wvNormalX * width] = vc->normal.x;
+		v[b2_wvNormalY * width] = vc->normal.y;
+		v[b2_wvFriction * width] = vc->friction;
+		v[b2_wvTangentSpeed * width] = vc->tangentSpeed;
+
+		// Missing points keep zero mass, so they never apply an impulse.
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			const b2VelocityConstraintPoint* vcp = vc->points + j;
+			float* p = v + (b2_wvPoints + j * b2_wvPointFieldCount) * width;
+			p[b2_wvRAX * width] = vcp->rA.x;
+			p[b2_wvRAY * width] = vcp->rA.y;
+			p[b2_wvRBX * width] = vcp->rB.x;
+			p[b2_wvRBY * width] = vcp->rB.y;
+			p[b2_wvNormalMass * width] = vcp->normalMass;
+			p[b2_wvTangentMass * width] = vcp->tangentMass;
+			p[b2_wvVelocityBias * width] = vcp->velocityBias;
+			p[b2_wvNormalImpulse * width] = vcp->normalImpulse;
+			p[b2_wvTangentImpulse * width] = vcp->tangentImpulse;
+		}
+
+		float* q = m_wide->position + group * b2_widePositionFieldCount * width + lane;
+		q[b2_wpLocalCenterAX * width] = pc->localCenterA.x;
+		q[b2_wpLocalCenterAY * width] = pc->localCenterA.y;
+		q[b2_wpLocalCenterBX * width] = pc->localCenterB.x;
+		q[b2_wpLocalCenterBY * width] = pc->localCenterB.y;
+		q[b2_wpInvMassA * width] = pc->invMassA;
+		q[b2_wpInvIA * width] = pc->invIA;
+		q[b2_wpInvMassB * width] = pc->invMassB;
+		q[b2_wpInvIB * width] = pc->invIB;
+		q[b2_wpLocalNormalX * width] = pc->localNormal.x;
+		q[b2_wpLocalNormalY * width] = pc->localNormal.y;
+		q[b2_wpLocalPointX * width] = pc->localPoint.x;
+		q[b2_wpLocalPointY * width] = pc->localPoint.y;
+		q[b2_wpRadius * width] = pc->radiusA + pc->radiusB;
+		q[b2_wpIsCircles * width] = pc->type == b2Manifold::e_circles ? 1.0f : 0.0f;
+		q[b2_wpIsFaceB * width] = pc->type == b2Manifold::e_faceB ? 1.0f : 0.0f;
+		q[b2_wpHasPoint2 * width] = pc->pointCount > 1 ? 1.0f : 0.0f;
+		for (int32 j = 0; j < pc->pointCount; ++j)
+		{
+			q[(b2_wpLocalPoint1X + 2 * j) * width] = pc->localPoints[j].x;
+			q[(b2_wpLocalPoint1Y + 2 * j) * width] = pc->localPoints[j].y;
+		}
+	}
+}
+
+void b2ContactSolver::SolveVelocityConstraintsWide()
+{
+	switch (s_simdLevel)
+	{
+	case b2_simdAVX2:
+		b2SolveVelocityWideAVX2(m_wide, m_velocities);
+		break;
+
+	case b2_simdSSE2:
+		b2SolveVelocityWideSSE2(m_wide, m_velocities);
+		break;
+
+	default:
+		b2SolveVelocityWideScalar(m_wide, m_velocities);
+		break;
+	}
+}
+
+bool b2ContactSolver::SolvePositionConstraintsWide()
+{
+	float minSeparation;
+	switch (s_simdLevel)
+	{
+	case b2_simdAVX2:
+		minSeparation = b2SolvePositionWideAVX2(m_wide, m_positions);
+		break;
+
+	case b2_simdSSE2:
+		minSeparation = b2SolvePositionWideSSE2(m_wide, m_positions);
+		break;
+
+	default:
+		minSeparation = b2SolvePositionWideScalar(m_wide, m_positions);
+		break;
+	}
+
+	return minSeparation >= -3.0f * b2_linearSlop;
+}
+
+// Copy the accumulated impulses back so warm starting and contact reports see them.
+void b2ContactSolver::UnpackWideImpulses()
+{
+	const int32 width = m_wide->width;
+	for (int32 g = 0; g < m_wide->groupCount; ++g)
+	{
+		const float* row = m_wide->velocity + g * b2_wideVelocityFieldCount * width;
+		for (int32 lane = 0; lane < m_wide->laneCounts[g]; ++lane)
+		{
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + m_wide->constraintIndex[g * width + lane];
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				const float* p = row + (b2_wvPoints + j * b2_wvPointFieldCount) * width + lane;
+				vc->points[j].normalImpulse = p[b2_wvNormalImpulse * width];
+				vc->points[j].tangentImpulse = p[b2_wvTangentImpulse * width];
+			}
+		}
+	}
+}
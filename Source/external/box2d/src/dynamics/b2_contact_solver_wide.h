@@ -0,0 +1,456 @@
+// MIT License
+
+// Copyright (c) 2025 MarcPladellorensPerez
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef B2_CONTACT_SOLVER_WIDE_H
+#define B2_CONTACT_SOLVER_WIDE_H
+
+#include "box2d/b2_common.h"
+#include "box2d/b2_time_step.h"
+
+/*
+Wide Contact Solver
+===================
+The wide solver packs contact constraints into lane groups of 4 (SSE2) or 8 (AVX2)
+constraints stored as structure-of-arrays. The constraints are graph colored so that
+no two lanes of a group touch the same non-static body. This means a lane group can be
+gathered, solved with one instruction per scalar operation and scattered back without
+write conflicts. Groups are solved one after another, so the solver is still
+Gauss-Seidel across groups.
+
+Differences with the scalar solver:
+- Two point manifolds are relaxed point by point instead of using the block solver.
+- The position solver integrates the rotation incrementally between the two points
+  instead of recomputing sin/cos.
+
+The kernels are templates over a small SIMD wrapper type. This header is included by
+translation units compiled with different instruction sets, so it must only contain
+templates. Anything else would be emitted with the wider instruction set and might be
+picked by the linker for the scalar path.
+*/
+
+/// Velocity constraint fields, each stored as one row of lanes.
+enum b2WideVelocityField
+{
+	b2_wvInvMassA = 0,
+	b2_wvInvIA,
+	b2_wvInvMassB,
+	b2_wvInvIB,
+	b2_wvNormalX,
+	b2_wvNormalY,
+	b2_wvFriction,
+	b2_wvTangentSpeed,
+	b2_wvPoints
+};
+
+/// Per manifold point velocity fields. Point j starts at b2_wvPoints + j * b2_wvPointFieldCount.
+enum b2WideVelocityPointField
+{
+	b2_wvRAX = 0,
+	b2_wvRAY,
+	b2_wvRBX,
+	b2_wvRBY,
+	b2_wvNormalMass,
+	b2_wvTangentMass,
+	b2_wvVelocityBias,
+	b2_wvNormalImpulse,
+	b2_wvTangentImpulse,
+	b2_wvPointFieldCount
+};
+
+const int32 b2_wideVelocityFieldCount = b2_wvPoints + b2_maxManifoldPoints * b2_wvPointFieldCount;
+
+/// Position constraint fields, each stored as one row of lanes.
+enum b2WidePositionField
+{
+	b2_wpLocalCenterAX = 0,
+	b2_wpLocalCenterAY,
+	b2_wpLocalCenterBX,
+	b2_wpLocalCenterBY,
+	b2_wpInvMassA,
+	b2_wpInvIA,
+	b2_wpInvMassB,
+	b2_wpInvIB,
+	b2_wpLocalNormalX,
+	b2_wpLocalNormalY,
+	b2_wpLocalPointX,
+	b2_wpLocalPointY,
+	b2_wpRadius,
+	b2_wpIsCircles,
+	b2_wpIsFaceB,
+	b2_wpHasPoint2,
+	b2_wpLocalPoint1X,
+	b2_wpLocalPoint1Y,
+	b2_wpLocalPoint2X,
+	b2_wpLocalPoint2Y,
+	b2_widePositionFieldCount
+};
+
+/// Packed constraints of one island. Lanes past laneCounts[g] are padding.
+struct b2WideContacts
+{
+	int32 width;
+	int32 groupCount;
+	int32* laneCounts;
+	int32* indexA;
+	int32* indexB;
+	int32* constraintIndex;
+	float* velocity;
+	float* position;
+};
+
+typedef void b2SolveVelocityWideFcn(b2WideContacts* contacts, b2Velocity* velocities);
+typedef float b2SolvePositionWideFcn(b2WideContacts* contacts, b2Position* positions);
+
+// Kernel entry points per instruction set. The AVX2 entries are null when the
+// library was built without AVX2 support.
+void b2SolveVelocityWideScalar(b2WideContacts* contacts, b2Velocity* velocities);
+float b2SolvePositionWideScalar(b2WideContacts* contacts, b2Position* positions);
+void b2SolveVelocityWideSSE2(b2WideContacts* contacts, b2Velocity* velocities);
+float b2SolvePositionWideSSE2(b2WideContacts* contacts, b2Position* positions);
+extern b2SolveVelocityWideFcn* const b2SolveVelocityWideAVX2;
+extern b2SolvePositionWideFcn* const b2SolvePositionWideAVX2;
+
+template <typename W>
+inline void b2WideRotate(W& qc, W& qs, W da)
+{
+	// Small angle update of a rotation followed by normalization.
+	W c = qc - da * qs;
+	W s = qs + da * qc;
+	W invLength = W::Splat(1.0f) / W::Sqrt(c * c + s * s);
+	qc = c * invLength;
+	qs = s * invLength;
+}
+
+template <typename W>
+void b2SolveVelocityWide(b2WideContacts* contacts, b2Velocity* velocities)
+{
+	const int32 width = W::width;
+
+	float vAx[W::width], vAy[W::width], wA[W::width];
+	float vBx[W::width], vBy[W::width], wB[W::width];
+
+	for (int32 g = 0; g < contacts->groupCount; ++g)
+	{
+		const int32 laneCount = contacts->laneCounts[g];
+		const int32* indexA = contacts->indexA + g * width;
+		const int32* indexB = contacts->indexB + g * width;
+		float* row = contacts->velocity + g * b2_wideVelocityFieldCount * width;
+
+		// Gather body velocities. Padding lanes see a resting body.
+		for (int32 lane = 0; lane < width; ++lane)
+		{
+			if (lane < laneCount)
+			{
+				const b2Velocity& a = velocities[indexA[lane]];
+				const b2Velocity& b = velocities[indexB[lane]];
+				vAx[lane] = a.v.x; vAy[lane] = a.v.y; wA[lane] = a.w;
+				vBx[lane] = b.v.x; vBy[lane] = b.v.y; wB[lane] = b.w;
+			}
+			else
+			{
+				vAx[lane] = 0.0f; vAy[lane] = 0.0f; wA[lane] = 0.0f;
+				vBx[lane] = 0.0f; vBy[lane] = 0.0f; wB[lane] = 0.0f;
+			}
+		}
+
+		W vax = W::Load(vAx), vay = W::Load(vAy), wa = W::Load(wA);
+		W vbx = W::Load(vBx), vby = W::Load(vBy), wb = W::Load(wB);
+
+		W mA = W::Load(row + b2_wvInvMassA * width);
+		W iA = W::Load(row + b2_wvInvIA * width);
+		W mB = W::Load(row + b2_wvInvMassB * width);
+		W iB = W::Load(row + b2_wvInvIB * width);
+		W nx = W::Load(row + b2_wvNormalX * width);
+		W ny = W::Load(row + b2_wvNormalY * width);
+		W friction = W::Load(row + b2_wvFriction * width);
+		W tangentSpeed = W::Load(row + b2_wvTangentSpeed * width);
+
+		// tangent = b2Cross(normal, 1.0f)
+		W tx = ny;
+		W ty = W::Splat(0.0f) - nx;
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+		{
+			float* point = row + (b2_wvPoints + j * b2_wvPointFieldCount) * width;
+			W rAx = W::Load(point + b2_wvRAX * width);
+			W rAy = W::Load(point + b2_wvRAY * width);
+			W rBx = W::Load(point + b2_wvRBX * width);
+			W rBy = W::Load(point + b2_wvRBY * width);
+			W tangentMass = W::Load(point + b2_wvTangentMass * width);
+			W normalImpulse = W::Load(point + b2_wvNormalImpulse * width);
+			W tangentImpulse = W::Load(point + b2_wvTangentImpulse * width);
+
+			// Relative velocity at contact
+			W dvx = vbx - wb * rBy - vax + wa * rAy;
+			W dvy = vby + wb * rBx - vay - wa * rAx;
+
+			// Compute tangent force
+			W vt = dvx * tx + dvy * ty - tangentSpeed;
+			W lambda = W::Splat(0.0f) - tangentMass * vt;
+
+			// Clamp the accumulated force
+			W maxFriction = friction * normalImpulse;
+			W newImpulse = W::Max(W::Splat(0.0f) - maxFriction, W::Min(tangentImpulse + lambda, maxFriction));
+			lambda = newImpulse - tangentImpulse;
+			newImpulse.Store(point + b2_wvTangentImpulse * width);
+
+			// Apply contact impulse
+			W Px = lambda * tx;
+			W Py = lambda * ty;
+
+			vax = vax - mA * Px;
+			vay = vay - mA * Py;
+			wa = wa - iA * (rAx * Py - rAy * Px);
+
+			vbx = vbx + mB * Px;
+			vby = vby + mB * Py;
+			wb = wb + iB * (rBx * Py - rBy * Px);
+		}
+
+		// Solve normal constraints
+		for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+		{
+			float* point = row + (b2_wvPoints + j * b2_wvPointFieldCount) * width;
+			W rAx = W::Load(point + b2_wvRAX * width);
+			W rAy = W::Load(point + b2_wvRAY * width);
+			W rBx = W::Load(point + b2_wvRBX * width);
+			W rBy = W::Load(point + b2_wvRBY * width);
+			W normalMass = W::Load(point + b2_wvNormalMass * width);
+			W velocityBias = W::Load(point + b2_wvVelocityBias * width);
+			W normalImpulse = W::Load(point + b2_wvNormalImpulse * width);
+
+			// Relative velocity at contact
+			W dvx = vbx - wb * rBy - vax + wa * rAy;
+			W dvy = vby + wb * rBx - vay - wa * rAx;
+
+			// Compute normal impulse
+			W vn = dvx * nx + dvy * ny;
+			W lambda = W::Splat(0.0f) - normalMass * (vn - velocityBias);
+
+			// Clamp the accumulated impulse
+			W newImpulse = W::Max(normalImpulse + lambda, W::Splat(0.0f));
+			lambda = newImpulse - normalImpulse;
+			newImpulse.Store(point + b2_wvNormalImpulse * width);
+
+			// Apply contact impulse
+			W Px = lambda * nx;
+			W Py = lambda * ny;
+
+			vax = vax - mA * Px;
+			vay = vay - mA * Py;
+			wa = wa - iA * (rAx * Py - rAy * Px);
+
+			vbx = vbx + mB * Px;
+			vby = vby + mB * Py;
+			wb = wb + iB * (rBx * Py - rBy * Px);
+		}
+
+		vax.Store(vAx); vay.Store(vAy); wa.Store(wA);
+		vbx.Store(vBx); vby.Store(vBy); wb.Store(wB);
+
+		// Scatter. Lanes never share a dynamic body, and static bodies are written
+		// back unchanged.
+		for (int32 lane = 0; lane < laneCount; ++lane)
+		{
+			b2Velocity& a = velocities[indexA[lane]];
+			b2Velocity& b = velocities[indexB[lane]];
+			a.v.x = vAx[lane]; a.v.y = vAy[lane]; a.w = wA[lane];
+			b.v.x = vBx[lane]; b.v.y = vBy[lane]; b.w = wB[lane];
+		}
+	}
+}
+
+template <typename W>
+float b2SolvePositionWide(b2WideContacts* contacts, b2Position* positions)
+{
+	const int32 width = W::width;
+
+	float cAx[W::width], cAy[W::width], aA[W::width], qAc[W::width], qAs[W::width];
+	float cBx[W::width], cBy[W::width], aB[W::width], qBc[W::width], qBs[W::width];
+	float separation[W::width];
+
+	W minSeparation = W::Splat(0.0f);
+
+	for (int32 g = 0; g < contacts->groupCount; ++g)
+	{
+		const int32 laneCount = contacts->laneCounts[g];
+		const int32* indexA = contacts->indexA + g * width;
+		const int32* indexB = contacts->indexB + g * width;
+		const float* row = contacts->position + g * b2_widePositionFieldCount * width;
+
+		for (int32 lane = 0; lane < width; ++lane)
+		{
+			if (lane < laneCount)
+			{
+				const b2Position& a = positions[indexA[lane]];
+				const b2Position& b = positions[indexB[lane]];
+				cAx[lane] = a.c.x; cAy[lane] = a.c.y; aA[lane] = a.a;
+				cBx[lane] = b.c.x; cBy[lane] = b.c.y; aB[lane] = b.a;
+			}
+			else
+			{
+				cAx[lane] = 0.0f; cAy[lane] = 0.0f; aA[lane] = 0.0f;
+				cBx[lane] = 0.0f; cBy[lane] = 0.0f; aB[lane] = 0.0f;
+			}
+		}
+
+		W::SinCos(aA, qAs, qAc);
+		W::SinCos(aB, qBs, qBc);
+
+		W cax = W::Load(cAx), cay = W::Load(cAy), aa = W::Load(aA);
+		W cbx = W::Load(cBx), cby = W::Load(cBy), ab = W::Load(aB);
+		W qac = W::Load(qAc), qas = W::Load(qAs);
+		W qbc = W::Load(qBc), qbs = W::Load(qBs);
+
+		W lcAx = W::Load(row + b2_wpLocalCenterAX * width);
+		W lcAy = W::Load(row + b2_wpLocalCenterAY * width);
+		W lcBx = W::Load(row + b2_wpLocalCenterBX * width);
+		W lcBy = W::Load(row + b2_wpLocalCenterBY * width);
+		W mA = W::Load(row + b2_wpInvMassA * width);
+		W iA = W::Load(row + b2_wpInvIA * width);
+		W mB = W::Load(row + b2_wpInvMassB * width);
+		W iB = W::Load(row + b2_wpInvIB * width);
+		W lnx = W::Load(row + b2_wpLocalNormalX * width);
+		W lny = W::Load(row + b2_wpLocalNormalY * width);
+		W lpx = W::Load(row + b2_wpLocalPointX * width);
+		W lpy = W::Load(row + b2_wpLocalPointY * width);
+		W radius = W::Load(row + b2_wpRadius * width);
+
+		W half = W::Splat(0.5f);
+		W zero = W::Splat(0.0f);
+		W isCircles = W::Greater(W::Load(row + b2_wpIsCircles * width), half);
+		W isFaceB = W::Greater(W::Load(row + b2_wpIsFaceB * width), half);
+		W hasPoint2 = W::Greater(W::Load(row + b2_wpHasPoint2 * width), half);
+		W isActive = W::Greater(W::Load(row + b2_wpInvMassA * width) + W::Load(row + b2_wpInvMassB * width) +
+			W::Load(row + b2_wpInvIA * width) + W::Load(row + b2_wpInvIB * width), zero);
+
+		for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+		{
+			W lcx = W::Load(row + (b2_wpLocalPoint1X + 2 * j) * width);
+			W lcy = W::Load(row + (b2_wpLocalPoint1Y + 2 * j) * width);
+
+			// Body origins
+			W pAx = cax - (qac * lcAx - qas * lcAy);
+			W pAy = cay - (qas * lcAx + qac * lcAy);
+			W pBx = cbx - (qbc * lcBx - qbs * lcBy);
+			W pBy = cby - (qbs * lcBx + qbc * lcBy);
+
+			// The reference body holds the manifold plane, the incident body the clip points.
+			W refC = W::Select(isFaceB, qbc, qac);
+			W refS = W::Select(isFaceB, qbs, qas);
+			W refX = W::Select(isFaceB, pBx, pAx);
+			W refY = W::Select(isFaceB, pBy, pAy);
+			W incC = W::Select(isFaceB, qac, qbc);
+			W incS = W::Select(isFaceB, qas, qbs);
+			W incX = W::Select(isFaceB, pAx, pBx);
+			W incY = W::Select(isFaceB, pAy, pBy);
+
+			W planeX = refC * lpx - refS * lpy + refX;
+			W planeY = refS * lpx + refC * lpy + refY;
+			W clipX = incC * lcx - incS * lcy + incX;
+			W clipY = incS * lcx + incC * lcy + incY;
+			W dx = clipX - planeX;
+			W dy = clipY - planeY;
+
+			// Face normal
+			W fnx = refC * lnx - refS * lny;
+			W fny = refS * lnx + refC * lny;
+
+			// Circle normal
+			W length = W::Sqrt(dx * dx + dy * dy);
+			W invLength = W::Select(W::Greater(length, W::Splat(b2_epsilon)), W::Splat(1.0f) / length, zero);
+			W cnx = dx * invLength;
+			W cny = dy * invLength;
+
+			W sep = W::Select(isCircles, dx * cnx + dy * cny, dx * fnx + dy * fny) - radius;
+			W normalX = W::Select(isCircles, cnx, W::Select(isFaceB, zero - fnx, fnx));
+			W normalY = W::Select(isCircles, cny, W::Select(isFaceB, zero - fny, fny));
+			W pointX = W::Select(isCircles, half * (planeX + clipX), clipX);
+			W pointY = W::Select(isCircles, half * (planeY + clipY), clipY);
+
+			// Padding lanes and missing second points report no error and apply no impulse.
+			W mask = j == 0 ? isActive : W::And(isActive, hasPoint2);
+			sep = W::Select(mask, sep, zero);
+
+			W rAx = pointX - cax;
+			W rAy = pointY - cay;
+			W rBx = pointX - cbx;
+			W rBy = pointY - cby;
+
+			// Track max constraint error.
+			minSeparation = W::Min(minSeparation, sep);
+
+			// Prevent large corrections and allow slop.
+			W C = W::Max(W::Splat(-b2_maxLinearCorrection), W::Min(W::Splat(b2_baumgarte) * (sep + W::Splat(b2_linearSlop)), zero));
+
+			// Compute the effective mass.
+			W rnA = rAx * normalY - rAy * normalX;
+			W rnB = rBx * normalY - rBy * normalX;
+			W K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+
+			// Compute normal impulse
+			W impulse = W::Select(W::And(mask, W::Greater(K, zero)), (zero - C) / K, zero);
+
+			W Px = impulse * normalX;
+			W Py = impulse * normalY;
+
+			cax = cax - mA * Px;
+			cay = cay - mA * Py;
+			W daA = zero - iA * (rAx * Py - rAy * Px);
+			aa = aa + daA;
+
+			cbx = cbx + mB * Px;
+			cby = cby + mB * Py;
+			W daB = iB * (rBx * Py - rBy * Px);
+			ab = ab + daB;
+
+			if (j + 1 < b2_maxManifoldPoints)
+			{
+				b2WideRotate(qac, qas, daA);
+				b2WideRotate(qbc, qbs, daB);
+			}
+		}
+
+		cax.Store(cAx); cay.Store(cAy); aa.Store(aA);
+		cbx.Store(cBx); cby.Store(cBy); ab.Store(aB);
+
+		for (int32 lane = 0; lane < laneCount; ++lane)
+		{
+			b2Position& a = positions[indexA[lane]];
+			b2Position& b = positions[indexB[lane]];
+			a.c.x = cAx[lane]; a.c.y = cAy[lane]; a.a = aA[lane];
+			b.c.x = cBx[lane]; b.c.y = cBy[lane]; b.a = aB[lane];
+		}
+	}
+
+	minSeparation.Store(separation);
+	float result = 0.0f;
+	for (int32 lane = 0; lane < width; ++lane)
+	{
+		result = separation[lane] < result ? separation[lane] : result;
+	}
+	return result;
+}
+
+#endif
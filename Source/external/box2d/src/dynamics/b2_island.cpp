@@ -187,6 +187,12 @@ b2Island::~b2Island()
 
 void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep)
 {
+	if (step.softStepCount > 0)
+	{
+		SolveSoft(profile, step, gravity, allowSleep);
+		return;
+	}
+
 	b2Timer timer;
 
 	float h = step.dt;
@@ -348,41 +354,228 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 
 	if (allowSleep)
 	{
-		float minSleepTime = b2_maxFloat;
+		UpdateSleep(h, positionSolved);
+	}
+}
 
-		const float linTolSqr = b2_linearSleepTolerance * b2_linearSleepTolerance;
-		const float angTolSqr = b2_angularSleepTolerance * b2_angularSleepTolerance;
+void b2Island::UpdateSleep(float h, bool positionSolved)
+{
+	float minSleepTime = b2_maxFloat;
+
+	const float linTolSqr = b2_linearSleepTolerance * b2_linearSleepTolerance;
+	const float angTolSqr = b2_angularSleepTolerance * b2_angularSleepTolerance;
 
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		b2Body* b = m_bodies[i];
+		if (b->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+
+		if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
+			b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
+			b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+		{
+			b->m_sleepTime = 0.0f;
+			minSleepTime = 0.0f;
+		}
+		else
+		{
+			b->m_sleepTime += h;
+			minSleepTime = b2Min(minSleepTime, b->m_sleepTime);
+		}
+	}
+
+	if (minSleepTime >= b2_timeToSleep && positionSolved)
+	{
 		for (int32 i = 0; i < m_bodyCount; ++i)
 		{
 			b2Body* b = m_bodies[i];
-			if (b->GetType() == b2_staticBody)
+			b->SetAwake(false);
+		}
+	}
+}
+
+// Soft step: every sub-step integrates velocities, solves the contacts as soft
+// springs with position feedback, integrates positions and then relaxes the
+// contacts without feedback to remove the energy the springs added. There is
+// no position pass for contacts, penetration is handled by the springs.
+void b2Island::SolveSoft(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep)
+{
+	b2Timer timer;
+
+	const int32 subStepCount = step.softStepCount;
+	const float h = step.dt / subStepCount;
+
+	// Initialize the body state. Velocities are integrated per sub-step.
+	for (int32 i = 0; i < m_bodyCount; ++i)
+	{
+		b2Body* b = m_bodies[i];
+
+		// Store positions for continuous collision.
+		b->m_sweep.c0 = b->m_sweep.c;
+		b->m_sweep.a0 = b->m_sweep.a;
+
+		m_positions[i].c = b->m_sweep.c;
+		m_positions[i].a = b->m_sweep.a;
+		m_velocities[i].v = b->m_linearVelocity;
+		m_velocities[i].w = b->m_angularVelocity;
+	}
+
+	// Contact separations are tracked relative to the start of the step.
+	b2Position* startPositions = (b2Position*)m_allocator->Allocate(m_bodyCount * sizeof(b2Position));
+	memcpy(startPositions, m_positions, m_bodyCount * sizeof(b2Position));
+
+	{
+		timer.Reset();
+
+		b2TimeStep subStep = step;
+		subStep.dt = h;
+		subStep.inv_dt = h > 0.0f ? 1.0f / h : 0.0f;
+
+		// Joints run at the sub-step rate.
+		b2SolverData solverData;
+		solverData.step = subStep;
+		solverData.positions = m_positions;
+		solverData.velocities = m_velocities;
+
+		b2ContactSolverDef contactSolverDef;
+		contactSolverDef.step = step;
+		contactSolverDef.contacts = m_contacts;
+		contactSolverDef.count = m_contactCount;
+		contactSolverDef.positions = m_positions;
+		contactSolverDef.velocities = m_velocities;
+		contactSolverDef.allocator = m_allocator;
+
+		b2ContactSolver contactSolver(&contactSolverDef);
+		contactSolver.InitializeVelocityConstraints();
+		contactSolver.PrepareSoft(startPositions, h);
+
+		profile->solveInit = timer.GetMilliseconds();
+
+		timer.Reset();
+		for (int32 subStepIndex = 0; subStepIndex < subStepCount; ++subStepIndex)
+		{
+			// Integrate velocities and apply damping.
+			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
-				continue;
+				b2Body* b = m_bodies[i];
+				if (b->m_type != b2_dynamicBody)
+				{
+					continue;
+				}
+
+				b2Vec2 v = m_velocities[i].v;
+				float w = m_velocities[i].w;
+
+				v += h * b->m_invMass * (b->m_gravityScale * b->m_mass * gravity + b->m_force);
+				w += h * b->m_invI * b->m_torque;
+
+				v *= 1.0f / (1.0f + h * b->m_linearDamping);
+				w *= 1.0f / (1.0f + h * b->m_angularDamping);
+
+				m_velocities[i].v = v;
+				m_velocities[i].w = w;
 			}
 
-			if ((b->m_flags & b2Body::e_autoSleepFlag) == 0 ||
-				b->m_angularVelocity * b->m_angularVelocity > angTolSqr ||
-				b2Dot(b->m_linearVelocity, b->m_linearVelocity) > linTolSqr)
+			// Joints warm start in their initialization.
+			for (int32 i = 0; i < m_jointCount; ++i)
 			{
-				b->m_sleepTime = 0.0f;
-				minSleepTime = 0.0f;
+				m_joints[i]->InitVelocityConstraints(solverData);
 			}
-			else
+
+			if (step.warmStarting)
+			{
+				contactSolver.WarmStart();
+			}
+
+			for (int32 i = 0; i < m_jointCount; ++i)
+			{
+				m_joints[i]->SolveVelocityConstraints(solverData);
+			}
+
+			contactSolver.SolveSoftVelocityConstraints(true);
+
+			// Integrate positions
+			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
-				b->m_sleepTime += h;
-				minSleepTime = b2Min(minSleepTime, b->m_sleepTime);
+				b2Vec2 v = m_velocities[i].v;
+				float w = m_velocities[i].w;
+
+				// Check for large velocities
+				b2Vec2 translation = h * v;
+				if (b2Dot(translation, translation) > b2_maxTranslationSquared)
+				{
+					float ratio = b2_maxTranslation / translation.Length();
+					v *= ratio;
+				}
+
+				float rotation = h * w;
+				if (rotation * rotation > b2_maxRotationSquared)
+				{
+					float ratio = b2_maxRotation / b2Abs(rotation);
+					w *= ratio;
+				}
+
+				m_positions[i].c += h * v;
+				m_positions[i].a += h * w;
+				m_velocities[i].v = v;
+				m_velocities[i].w = w;
 			}
+
+			// Relax
+			for (int32 i = 0; i < m_jointCount; ++i)
+			{
+				m_joints[i]->SolveVelocityConstraints(solverData);
+			}
+
+			contactSolver.SolveSoftVelocityConstraints(false);
 		}
 
-		if (minSleepTime >= b2_timeToSleep && positionSolved)
+		contactSolver.ApplySoftRestitution();
+		contactSolver.StoreImpulses();
+		profile->solveVelocity = timer.GetMilliseconds();
+
+		// Joints keep their position correction.
+		timer.Reset();
+		for (int32 i = 0; i < step.positionIterations; ++i)
 		{
-			for (int32 i = 0; i < m_bodyCount; ++i)
+			bool jointsOkay = true;
+			for (int32 j = 0; j < m_jointCount; ++j)
 			{
-				b2Body* b = m_bodies[i];
-				b->SetAwake(false);
+				bool jointOkay = m_joints[j]->SolvePositionConstraints(solverData);
+				jointsOkay = jointsOkay && jointOkay;
 			}
+
+			if (jointsOkay)
+			{
+				break;
+			}
+		}
+
+		// Copy state buffers back to the bodies
+		for (int32 i = 0; i < m_bodyCount; ++i)
+		{
+			b2Body* body = m_bodies[i];
+			body->m_sweep.c = m_positions[i].c;
+			body->m_sweep.a = m_positions[i].a;
+			body->m_linearVelocity = m_velocities[i].v;
+			body->m_angularVelocity = m_velocities[i].w;
+			body->SynchronizeTransform();
 		}
+
+		profile->solvePosition = timer.GetMilliseconds();
+
+		Report(contactSolver.m_velocityConstraints);
+	}
+
+	// The contact solver allocations are gone, so this is the top of the stack again.
+	m_allocator->Free(startPositions);
+
+	if (allowSleep)
+	{
+		UpdateSleep(step.dt, true);
 	}
 }
 
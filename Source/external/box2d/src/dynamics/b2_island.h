@@ -51,6 +51,9 @@ public:
 
 	void Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep);
 
+	/// Sub-stepped solver with soft contacts, used when step.softStepCount > 0.
+	void SolveSoft(b2Profile* profile, const b2TimeStep& step, const b2Vec2& gravity, bool allowSleep);
+
 	void SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB);
 
 	void Add(b2Body* body)
@@ -75,6 +78,8 @@ public:
 
 	void Report(const b2ContactVelocityConstraint* constraints);
 
+	void UpdateSleep(float h, bool positionSolved);
+
 	b2StackAllocator* m_allocator;
 	b2ContactListener* m_listener;
 
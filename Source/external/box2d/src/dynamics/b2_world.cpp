@@ -54,6 +54,8 @@ b2World::b2World(const b2Vec2& gravity)
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_wideContactSolver = false;
+	m_softStepCount = 0;
 
 	m_stepComplete = true;
 
@@ -868,6 +870,8 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.wideContacts = false;
+		subStep.softStepCount = 0;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -931,6 +935,8 @@ void b2World::Step(float dt, int32 velocityIterations, int32 positionIterations)
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideContacts = m_wideContactSolver && m_softStepCount == 0;
+	step.softStepCount = m_softStepCount;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -1234,6 +1240,94 @@ float b2World::GetTreeQuality() const
 	return m_contactManager.m_broadPhase.GetTreeQuality();
 }
 
+int32 b2World::GetStaticTreeHeight() const
+{
+	return m_contactManager.m_broadPhase.GetStaticTreeHeight();
+}
+
+void b2World::RebuildStaticTree()
+{
+	b2Assert(m_locked == false);
+	if (m_locked)
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.RebuildStaticTree();
+}
+
+void b2World::ResetContacts()
+{
+	b2Assert(m_locked == false);
+	if (m_locked)
+	{
+		return;
+	}
+
+	b2Contact* c = m_contactManager.m_contactList;
+	while (c)
+	{
+		b2Contact* next = c->GetNext();
+		m_contactManager.Destroy(c);
+		c = next;
+	}
+
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			f->DestroyProxies(broadPhase);
+		}
+	}
+	broadPhase->Reset();
+
+	// Bodies and fixtures are listed newest first, the proxies go back oldest first
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2Body*));
+	int32 bodyCount = 0;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		bodies[bodyCount++] = b;
+	}
+
+	for (int32 i = bodyCount - 1; i >= 0; --i)
+	{
+		b2Body* b = bodies[i];
+
+		// What b2Body's constructor and ResetMassData leave for the first step
+		b->m_xf.q.Set(b->m_sweep.a);
+		b->m_sweep.c0 = b->m_sweep.c = b2Mul(b->m_xf, b->m_sweep.localCenter);
+		b->m_sweep.a0 = b->m_sweep.a;
+		b->m_sweep.alpha0 = 0.0f;
+		b->m_force.SetZero();
+		b->m_torque = 0.0f;
+		b->m_sleepTime = 0.0f;
+
+		if (b->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		b2Fixture** fixtures = (b2Fixture**)m_stackAllocator.Allocate(b->m_fixtureCount * sizeof(b2Fixture*));
+		int32 fixtureCount = 0;
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			fixtures[fixtureCount++] = f;
+		}
+
+		for (int32 j = fixtureCount - 1; j >= 0; --j)
+		{
+			fixtures[j]->CreateProxies(broadPhase, b->m_xf);
+		}
+		m_stackAllocator.Free(fixtures);
+	}
+	m_stackAllocator.Free(bodies);
+
+	m_inv_dt0 = 0.0f;
+	m_newContacts = true;
+	m_stepComplete = true;
+}
+
 void b2World::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	b2Assert(m_locked == false);